@@ -45,6 +45,30 @@ carve::mesh::MeshSet<3> *makeCube(
   return new carve::mesh::MeshSet<3>(data.points, data.getFaceCount(), data.faceIndices);
 }
 
+carve::mesh::MeshSet<3> *makeBox(
+    const carve::geom3d::Vector &lo,
+    const carve::geom3d::Vector &hi) {
+  carve::input::PolyhedronData data;
+
+  data.addVertex(carve::geom::VECTOR(hi.x, hi.y, hi.z));
+  data.addVertex(carve::geom::VECTOR(lo.x, hi.y, hi.z));
+  data.addVertex(carve::geom::VECTOR(lo.x, lo.y, hi.z));
+  data.addVertex(carve::geom::VECTOR(hi.x, lo.y, hi.z));
+  data.addVertex(carve::geom::VECTOR(hi.x, hi.y, lo.z));
+  data.addVertex(carve::geom::VECTOR(lo.x, hi.y, lo.z));
+  data.addVertex(carve::geom::VECTOR(lo.x, lo.y, lo.z));
+  data.addVertex(carve::geom::VECTOR(hi.x, lo.y, lo.z));
+
+  data.addFace(0, 1, 2, 3);
+  data.addFace(7, 6, 5, 4);
+  data.addFace(0, 4, 5, 1);
+  data.addFace(1, 5, 6, 2);
+  data.addFace(2, 6, 7, 3);
+  data.addFace(3, 7, 4, 0);
+
+  return new carve::mesh::MeshSet<3>(data.points, data.getFaceCount(), data.faceIndices);
+}
+
 static bool _all(int /* x */, int /* y */, int /* z */) {
   return true;
 }
@@ -30,6 +30,12 @@
 carve::mesh::MeshSet<3> *makeCube(
     const carve::math::Matrix &transform = carve::math::Matrix());
 
+// the axis aligned box with corners lo and hi, with faces ordered as
+// for makeCube().
+carve::mesh::MeshSet<3> *makeBox(
+    const carve::geom3d::Vector &lo,
+    const carve::geom3d::Vector &hi);
+
 carve::mesh::MeshSet<3> *makeSubdividedCube(
     int sub_x = 3,
     int sub_y = 3,
@@ -150,6 +150,64 @@ namespace carve {
 namespace carve {
   namespace geom3d {
     typedef carve::geom::aabb<3> AABB;
+
+    // A sequence of 3-dimensional AABBs, stored in blocks of four
+    // with each coordinate held contiguously, so that one box can be
+    // tested against many at once using SIMD instructions.
+    class AABBBatch {
+      struct block_t {
+        double pos[3][4];
+        double extent[3][4];
+      };
+
+      std::vector<block_t> blocks;
+      size_t n;
+
+    public:
+      AABBBatch() : blocks(), n(0) {
+      }
+
+      size_t size() const { return n; }
+      bool empty() const { return n == 0; }
+
+      void clear() {
+        blocks.clear();
+        n = 0;
+      }
+
+      void reserve(size_t size) {
+        blocks.reserve((size + 3) / 4);
+      }
+
+      void push_back(const AABB &box) {
+        if ((n & 3) == 0) blocks.push_back(block_t());
+        block_t &b = blocks.back();
+        for (unsigned i = 0; i < 3; ++i) {
+          b.pos[i][n & 3] = box.pos.v[i];
+          b.extent[i][n & 3] = box.extent.v[i];
+        }
+        ++n;
+      }
+
+      AABB operator[](size_t i) const {
+        const block_t &b = blocks[i >> 2];
+        return AABB(carve::geom::VECTOR(b.pos[0][i & 3], b.pos[1][i & 3], b.pos[2][i & 3]),
+                    carve::geom::VECTOR(b.extent[0][i & 3], b.extent[1][i & 3], b.extent[2][i & 3]));
+      }
+
+      size_t blockCount() const { return blocks.size(); }
+
+      // Return a mask with bit j set if box 4 * block + j is within
+      // tolerance of box, by the same test as intersects(). Bits for
+      // slots past the end of the batch are clear.
+      unsigned blockMask(size_t block, const AABB &box, double tolerance = 0.0) const;
+
+      // Append to out, in increasing order, the index of each box b
+      // for which b.maxAxisSeparation(box) <= tolerance. The result
+      // is the same as that of the scalar test. Returns the number
+      // of indices appended.
+      size_t intersects(const AABB &box, std::vector<size_t> &out, double tolerance = 0.0) const;
+    };
   }
 }
 
@@ -0,0 +1,169 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#pragma once
+
+#include <carve/carve.hpp>
+
+#include <carve/geom.hpp>
+
+#include <vector>
+#include <algorithm>
+
+namespace carve {
+  namespace geom {
+
+    template<unsigned ndim>
+    vector<ndim> lerp(double t, const vector<ndim> &p1, const vector<ndim> &p2) {
+      return (1-t)*p1 + t*p2;
+    }
+
+
+
+    template<unsigned ndim>
+    class cubic_bezier {
+
+    public:
+      typedef vector<ndim> vec_t;
+      typedef cubic_bezier<ndim> cubic_bezier_t;
+
+      vec_t p[4];
+
+      cubic_bezier() {
+      }
+
+      cubic_bezier(const vec_t &p1, const vec_t &p2, const vec_t &p3, const vec_t &p4) {
+        p[0] = p1; p[1] = p2; p[2] = p3; p[3] = p4;
+      }
+
+      template<typename iter_t>
+      cubic_bezier(iter_t begin, iter_t end) {
+        if (std::distance(begin, end) != 4) throw carve::exception("cubic_bezier requires 4 control points");
+        std::copy(begin, end, p);
+      }
+
+      vec_t eval(double t) const {
+        double u = 1-t;
+        return u*u*u*p[0] + 3*t*u*u*p[1] + 3*t*t*u*p[2] + t*t*t*p[3];
+      }
+
+      // An upper bound on the distance between the curve and its
+      // chord: the curve lies within the convex hull of its control
+      // points, so the larger of the control point distances from
+      // the chord bounds the deviation.
+      double flatness() const {
+        if (distance2(p[0], p[3]) < EPSILON2) {
+          return sqrt(std::max(distance2(p[0], p[1]), distance2(p[0], p[2])));
+        }
+        ray<ndim> r = rayThrough(p[0], p[3]);
+        return sqrt(std::max(distance2(r, p[1]), distance2(r, p[2])));
+      }
+
+      void split(double t, cubic_bezier_t &a, cubic_bezier_t &b) const {
+        a.p[0] = p[0]; b.p[3] = p[3];
+        a.p[1] = lerp(t, p[0], p[1]);
+        vec_t m = lerp(t, p[1], p[2]);
+        b.p[2] = lerp(t, p[2], p[3]);
+        a.p[2] = lerp(t, a.p[1], m);
+        b.p[1] = lerp(t, m, b.p[2]);
+        a.p[3] = b.p[0] = lerp(t, a.p[2], b.p[1]);
+      }
+
+      void approximateSimple(std::vector<vec_t> &out, double max_flatness) const {
+        double f = flatness();
+        if (f < max_flatness) {
+          out.push_back(p[3]);
+        } else {
+          cubic_bezier a, b;
+          split(0.5, a, b);
+          a.approximateSimple(out, max_flatness);
+          b.approximateSimple(out, max_flatness);
+        }
+      }
+
+      void approximate(std::vector<vec_t> &out, double max_flatness, unsigned n_tests = 128) const {
+        double f = flatness();
+        if (f < max_flatness) {
+          out.push_back(p[3]);
+        } else {
+          double best_t = .5;
+          double best_f = f;
+          cubic_bezier a, b;
+          for (size_t i = 1; i < n_tests; ++i) {
+            double t = double(i) / n_tests;
+            split(t, a, b);
+            double f = a.flatness() + b.flatness();
+            if (f < best_f) {
+              best_t = t;
+              best_f = f;
+            }
+          }
+          split(best_t, a, b);
+          a.approximate(out, max_flatness, n_tests);
+          b.approximate(out, max_flatness, n_tests);
+        }
+      }
+
+      // Adaptive flattening to a distance tolerance. Appends the end
+      // points of a polyline approximating the curve (p[0] is not
+      // emitted, so consecutive segments can be flattened into the
+      // same output vector). Subdivision is iterative, and bounded by
+      // max_depth to guard against degenerate input.
+      void flatten(std::vector<vec_t> &out, double tolerance, unsigned max_depth = 16) const {
+        std::vector<std::pair<cubic_bezier_t, unsigned> > stack;
+        stack.push_back(std::make_pair(*this, 0U));
+        while (stack.size()) {
+          cubic_bezier_t c = stack.back().first;
+          unsigned depth = stack.back().second;
+          stack.pop_back();
+          if (depth >= max_depth || c.flatness() <= tolerance) {
+            out.push_back(c.p[3]);
+          } else {
+            cubic_bezier_t a, b;
+            c.split(0.5, a, b);
+            // b is pushed first so that a is processed first.
+            stack.push_back(std::make_pair(b, depth + 1));
+            stack.push_back(std::make_pair(a, depth + 1));
+          }
+        }
+      }
+    };
+
+
+
+    template<unsigned ndim>
+    cubic_bezier<ndim> make_bezier(const vector<ndim> &p1,
+                                   const vector<ndim> &p2,
+                                   const vector<ndim> &p3,
+                                   const vector<ndim> &p4) {
+      return cubic_bezier<ndim>(p1, p2, p3, p4);
+    }
+
+
+
+    // Flatten a connected sequence of cubic segments (each segment
+    // starting where the previous one ends) into a polyline.
+    template<unsigned ndim, typename iter_t>
+    void flattenPath(iter_t begin, iter_t end, double tolerance, std::vector<vector<ndim> > &out) {
+      if (begin == end) return;
+      out.push_back((*begin).p[0]);
+      for (; begin != end; ++begin) {
+        (*begin).flatten(out, tolerance);
+      }
+    }
+  }
+}
@@ -0,0 +1,86 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#pragma once
+
+#include <carve/carve.hpp>
+
+#include <string>
+
+namespace carve {
+
+  /**
+   * \brief Thrown by long running operations that observe a
+   *        CancellationToken, when that token has been cancelled.
+   */
+  struct cancelled : public carve::exception {
+    cancelled(const std::string &phase) : carve::exception("cancelled during " + phase) {
+    }
+  };
+
+
+
+  /**
+   * \class CancellationToken
+   * \brief Cooperative cancellation of long running operations.
+   *
+   * A token becomes cancelled when cancel() is called (which may be
+   * done from another thread), or when its deadline passes. Code that
+   * observes a token polls it at convenient points, and abandons its
+   * work by throwing carve::cancelled.
+   */
+  class CancellationToken {
+    volatile bool is_cancelled;
+    double deadline;
+
+  public:
+    CancellationToken() : is_cancelled(false), deadline(-1.0) {
+    }
+
+    void cancel() {
+      is_cancelled = true;
+    }
+
+    // Cancel the token \a seconds from now.
+    void setDeadline(double seconds) {
+      deadline = now() + seconds;
+    }
+
+    void clearDeadline() {
+      deadline = -1.0;
+    }
+
+    void reset() {
+      is_cancelled = false;
+      deadline = -1.0;
+    }
+
+    bool isCancelled() const {
+      return is_cancelled || (deadline >= 0.0 && now() >= deadline);
+    }
+
+    void check(const char *phase) const {
+      if (isCancelled()) throw carve::cancelled(phase);
+    }
+
+    // The current time, in seconds, from an arbitrary origin. Uses a
+    // monotonic clock (QueryPerformanceCounter on Windows), so
+    // deadlines are unaffected by changes to the system time.
+    static double now();
+  };
+
+}
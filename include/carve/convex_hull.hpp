@@ -24,9 +24,26 @@
 #include <carve/carve.hpp>
 
 #include <carve/geom2d.hpp>
+#include <carve/geom3d.hpp>
+#include <carve/mesh.hpp>
+#include <carve/executor.hpp>
 
 namespace carve {
   namespace geom {
+    /**
+     * \brief The convex hull of a set of points in the plane.
+     *
+     * Computed with Andrew's monotone chain in O(n log n) time, using
+     * exact orientation tests, so duplicate and collinear points are
+     * handled consistently.
+     *
+     * @return The indices of the hull vertices in anticlockwise
+     *         order, starting from the point of greatest x (and of
+     *         greatest y among those). Points that lie on an edge of
+     *         the hull are not included, and of a set of equal points
+     *         only the lowest index is used. If all points are
+     *         collinear, the two extreme points are returned.
+     */
     std::vector<int> convexHull(const std::vector<carve::geom2d::P2> &points);
 
     template<typename project_t, typename polygon_container_t>
@@ -49,4 +66,23 @@ namespace carve {
       return convexHull(proj);
     }
   }
+
+  namespace geom3d {
+    /**
+     * \brief The convex hull of a set of points in space.
+     *
+     * Computed by quickhull. Points are assigned to the faces they
+     * lie outside of in parallel on \a executor (or
+     * carve::defaultExecutor() if it is NULL), and the result does
+     * not depend on the executor. Orientation tests are exact, and
+     * points on the surface of the hull do not become vertices.
+     *
+     * @return A newly allocated MeshSet owned by the caller, holding a
+     *         single closed mesh of triangles with outward facing
+     *         normals. Adjacent coplanar triangles are not merged.
+     *         Returns NULL if the points do not span three dimensions.
+     */
+    carve::mesh::MeshSet<3> *convexHull(const std::vector<Vector> &points,
+                                        carve::Executor *executor = NULL);
+  }
 }
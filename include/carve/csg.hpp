@@ -33,20 +33,72 @@
 #include <carve/faceloop.hpp>
 #include <carve/intersection.hpp>
 #include <carve/rtree.hpp>
+#include <carve/cancel.hpp>
+#include <carve/executor.hpp>
+#include <carve/memory_accounting.hpp>
 
 namespace carve {
+  namespace line {
+    struct PolylineSet;
+  }
+
   namespace csg {
 
+    /**
+     * \class VertexPool
+     * \brief Storage for the vertices created by a CSG operation.
+     *
+     * Vertices are placed in fixed size blocks that are aligned to
+     * their size and never moved, so pointers to them remain valid
+     * until reset(). The block holding a vertex is found by masking
+     * its address, which makes inPool() a single hash lookup.
+     *
+     * Blocks are taken from slabs that start at a single block and
+     * double in size up to a limit, so that small operations allocate
+     * little. A pool is not thread safe; vertices are created by the
+     * serial intersection step of a single CSG computation.
+     */
     class VertexPool {
+    public:
       typedef carve::mesh::MeshSet<3>::vertex_t vertex_t;
 
-      const static unsigned blocksize = 1024;
-      typedef std::list<std::vector<vertex_t> > pool_t;
-      pool_t pool;
+    private:
+      // must be a power of two.
+      const static size_t block_bytes = 1 << 12;
+      // the number of blocks in the largest slab.
+      const static size_t max_slab_blocks = 256;
+
+      // a raw allocation of n_blocks + 1 blocks, from which n_blocks
+      // aligned blocks are taken.
+      struct slab_t {
+        char *mem;
+        size_t n_blocks;
+        slab_t(char *_mem, size_t _n_blocks) : mem(_mem), n_blocks(_n_blocks) {
+        }
+      };
+
+      std::vector<slab_t> slabs;
+      size_t slab_used;
+      std::unordered_set<size_t> blocks;
+      vertex_t *next;
+      vertex_t *end;
+
+      VertexPool(const VertexPool &);
+      VertexPool &operator=(const VertexPool &);
+
+      void acquireBlock();
+
     public:
       void reset();
-      vertex_t *get(const vertex_t::vector_t &v = vertex_t::vector_t::ZERO());
-      bool inPool(vertex_t *v) const;
+
+      vertex_t *get(const vertex_t::vector_t &v = vertex_t::vector_t::ZERO()) {
+        if (next == end) acquireBlock();
+        return new (next++) vertex_t(v);
+      }
+
+      bool inPool(const vertex_t *v) const {
+        return blocks.find((size_t)v & ~(block_bytes - 1)) != blocks.end();
+      }
 
       VertexPool();
       ~VertexPool();
@@ -59,6 +111,8 @@ namespace carve {
       class LoopEdges;
     }
 
+    class CSG_TreeCache;
+
     /** 
      * \class CSG
      * \brief The class responsible for the computation of CSG operations.
@@ -92,6 +146,9 @@ namespace carve {
                                   const meshset_t::vertex_t * /* v1 */,
                                   const meshset_t::vertex_t * /* v2 */) {
         }
+        virtual void progress(const char * /* phase */,
+                              double /* fraction */) {
+        }
 
         virtual ~Hook() {
         }
@@ -109,16 +166,22 @@ namespace carve {
           PROCESS_OUTPUT_FACE_HOOK = 1,
           INTERSECTION_VERTEX_HOOK = 2,
           EDGE_DIVISION_HOOK       = 3,
-          HOOK_MAX                 = 4,
+          PROGRESS_HOOK            = 4,
+          HOOK_MAX                 = 5,
 
           RESULT_FACE_BIT          = 0x0001,
           PROCESS_OUTPUT_FACE_BIT  = 0x0002, 
           INTERSECTION_VERTEX_BIT  = 0x0004,
-          EDGE_DIVISION_BIT        = 0x0008
+          EDGE_DIVISION_BIT        = 0x0008,
+          PROGRESS_BIT             = 0x0010
        };
 
         std::vector<std::list<Hook *> > hooks;
 
+        /// If not NULL, polled at phase boundaries and within long
+        /// running loops of the computation. Not owned.
+        const carve::CancellationToken *cancellation;
+
         bool hasHook(unsigned hook_num);
 
         void intersectionVertex(const meshset_t::vertex_t *vertex,
@@ -137,6 +200,24 @@ namespace carve {
                           const meshset_t::vertex_t *v1,
                           const meshset_t::vertex_t *v2);
 
+        /// Report progress through \a phase of the computation,
+        /// as a fraction between 0 and 1.
+        void progress(const char *phase, double fraction);
+
+        /// Throw carve::cancelled if the computation has been
+        /// cancelled.
+        void checkCancelled(const char *phase) const {
+          if (cancellation != NULL) cancellation->check(phase);
+        }
+
+        /// Report progress, and check for cancellation, every 64
+        /// iterations of a loop over \a n items.
+        void poll(const char *phase, size_t i, size_t n) {
+          if (i & 63) return;
+          checkCancelled(phase);
+          if (hasHook(PROGRESS_HOOK)) progress(phase, n ? double(i) / double(n) : 1.0);
+        }
+
         void registerHook(Hook *hook, unsigned hook_bits);
         void unregisterHook(Hook *hook);
 
@@ -158,10 +239,12 @@ namespace carve {
       protected:
 
       public:
+        carve::Executor *executor; /**< Set by CSG::compute() to the executor of the CSG instance, for use in building the result. Not owned. */
+
         virtual void collect(FaceLoopGroup *group, CSG::Hooks &) =0;
         virtual meshset_t *done(CSG::Hooks &) =0;
 
-        Collector() {}
+        Collector() : executor(NULL) {}
         virtual ~Collector() {}
       };
 
@@ -211,6 +294,7 @@ namespace carve {
       void generateEdgeFaceIntersections(meshset_t::face_t *a,
                                          const std::vector<meshset_t::face_t *> &b);
 
+      // a_node and b_node must already be known to intersect.
       void generateIntersectionCandidates(meshset_t *a,
                                           const face_rtree_t *a_node,
                                           meshset_t *b,
@@ -454,6 +538,12 @@ namespace carve {
 
       CSG::Hooks hooks;         /**< The manager for calculation hooks. */
 
+      CSG_TreeCache *tree_cache; /**< If not NULL, caches the results of CSG tree evaluation (see carve/tree.hpp). */
+
+      bool reorder_results;     /**< If true, results are passed through MeshSet::reorder() before being returned. */
+
+      carve::Executor *executor; /**< If not NULL, runs the parallel work of this CSG instance. Otherwise carve::defaultExecutor() is used. Not owned. */
+
       CSG();
       ~CSG();
 
@@ -493,6 +583,107 @@ namespace carve {
         V2Set *shared_edges = NULL,
         CLASSIFY_TYPE classify_type = CLASSIFY_NORMAL);
 
+      /** 
+       * \brief Compute several CSG operations between two polyhedra,
+       * \a a and \a b, from a single intersection and classification
+       * pass.
+       * 
+       * Each classified face loop group is passed to every collector,
+       * and then each collector's done() method is called in turn.
+       * 
+       * @param a Polyhedron a
+       * @param b Polyhedron b
+       * @param collectors The collectors (one per result). Not owned.
+       * @param results The results; results[i] is the result of collectors[i].
+       * @param shared_edges If not NULL, (*shared_edges)[i] is populated with the shared edges of results[i].
+       * @param classify_type The type of classifier to use.
+       */
+      void compute(
+        meshset_t *a,
+        meshset_t *b,
+        const std::vector<CSG::Collector *> &collectors,
+        std::vector<meshset_t *> &results,
+        std::vector<V2Set> *shared_edges = NULL,
+        CLASSIFY_TYPE classify_type = CLASSIFY_NORMAL);
+
+      /** 
+       * \brief Compute several CSG operations between two closed
+       * polyhedra, \a a and \a b, from a single intersection and
+       * classification pass.
+       * 
+       * @param a Polyhedron a
+       * @param b Polyhedron b
+       * @param ops The CSG operations (collectors are created automatically).
+       * @param results The results; results[i] is the result of ops[i].
+       * @param shared_edges If not NULL, (*shared_edges)[i] is populated with the shared edges of results[i].
+       * @param classify_type The type of classifier to use.
+       */
+      void compute(
+        meshset_t *a,
+        meshset_t *b,
+        const std::vector<OP> &ops,
+        std::vector<meshset_t *> &results,
+        std::vector<V2Set> *shared_edges = NULL,
+        CLASSIFY_TYPE classify_type = CLASSIFY_NORMAL);
+
+      /**
+       * \brief Compute the curves along which polyhedra \a a and \a b intersect.
+       *
+       * Only intersection generation and edge construction are
+       * performed, so the cost depends on the size of the
+       * intersection, rather than on the size of the inputs. Edges
+       * are chained into maximal polylines; curves are broken at
+       * vertices where more than two intersection edges meet, and
+       * closed loops are returned as closed polylines. Coplanar
+       * regions of contact do not contribute curves.
+       *
+       * @param a Polyhedron a
+       * @param b Polyhedron b
+       *
+       * @return A newly allocated PolylineSet, owned by the caller.
+       */
+      carve::line::PolylineSet *intersectionCurves(
+        meshset_t *a,
+        meshset_t *b);
+
+      /**
+       * \brief Compute an approximation of a CSG operation between two
+       *        closed polyhedra, \a a and \a b.
+       *
+       * Each polyhedron is sampled as a signed distance field on a
+       * regular grid that covers the region where the result can lie.
+       * Inside/outside is decided by casting a ray along each row of
+       * the grid, and exact distances are only computed in a narrow
+       * band of two cells around the surface. The fields are combined
+       * with min/max according to \a op, and the zero level set is
+       * extracted by marching tetrahedra, which gives a closed,
+       * manifold triangle mesh.
+       *
+       * The error of the result is of the order of the cell size, and
+       * sharp edges and features smaller than a cell are lost. The
+       * cost grows with the square of \a resolution for ray casting
+       * and extraction of the surface, and with its cube for the
+       * grid itself.
+       *
+       * Ray casting, grid sampling and surface extraction run on this
+       * instance's executor. The result does not depend on the number
+       * of threads.
+       *
+       * @param a Polyhedron a
+       * @param b Polyhedron b
+       * @param op The CSG operation. ALL is not supported.
+       * @param resolution The number of grid cells along the longest
+       *                   side of the sampled region.
+       *
+       * @return A newly allocated MeshSet owned by the caller, or NULL
+       *         if \a op is not supported.
+       */
+      meshset_t *computePreview(
+        meshset_t *a,
+        meshset_t *b,
+        OP op,
+        unsigned resolution = 64);
+
       void slice(
         meshset_t *a,
         meshset_t *b,
@@ -505,6 +696,29 @@ namespace carve {
         meshset_t *open,
         std::list<std::pair<FaceClass, meshset_t *> > &result,
         V2Set *shared_edges = NULL);
+
+    private:
+      carve::Executor &getExecutor() {
+        return executor != NULL ? *executor : carve::defaultExecutor();
+      }
+
+      /** 
+       * \brief Compute intersections, classify the resulting face
+       * loop groups and pass them to \a collector. The collector's
+       * done() method is not called.
+       * 
+       * @param[in] a Polyhedron a
+       * @param[in] b Polyhedron b
+       * @param[in] collector The collector that receives face loop groups.
+       * @param[out] shared_edges The edges shared by a and b.
+       * @param[in] classify_type The type of classifier to use.
+       */
+      void classifyAndCollect(
+        meshset_t *a,
+        meshset_t *b,
+        CSG::Collector &collector,
+        V2Set &shared_edges,
+        CLASSIFY_TYPE classify_type);
     };
   }
 }
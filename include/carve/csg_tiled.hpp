@@ -0,0 +1,238 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#pragma once
+
+#include <carve/carve.hpp>
+#include <carve/geom3d.hpp>
+#include <carve/mesh.hpp>
+#include <carve/csg.hpp>
+#include <carve/executor.hpp>
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+namespace carve {
+  namespace csg {
+
+    /**
+     * \class TiledCSG
+     * \brief Evaluates a CSG operation between two closed polyhedra
+     *        that are too large to hold in memory, one spatial tile at
+     *        a time.
+     *
+     * Space is divided into a regular grid of cubic tiles covering a
+     * given bounding box. Faces of the two operands are added one at
+     * a time; each is triangulated, clipped to the tiles it overlaps,
+     * and the pieces are appended to a file per tile and operand in a
+     * work directory. Neither operand is ever held in memory.
+     *
+     * compute() then processes each tile independently: the pieces of
+     * both operands in the tile are loaded, sliced against each other,
+     * and each resulting surface patch is classified as inside or
+     * outside the other operand. Classification uses a reference point
+     * per tile, whose status is found when faces are added by counting
+     * the crossings of a line through each row of tiles, and the
+     * crossings between the reference point and the patch, which lie
+     * in the tile. Pieces of faces that lie in the plane between two
+     * tiles are kept by the higher tile only.
+     *
+     * The patches that make up the result are passed to an Output in
+     * tile order. Vertices on the walls between tiles are merged with
+     * those of neighbouring tiles, so the output is a single connected
+     * surface. Peak memory depends on the tile size and the number of
+     * tiles processed at once (the concurrency of the executor), not
+     * on the size of the operands. The result does not depend on the
+     * number of threads.
+     *
+     * Limitations: faces outside the bounding box are discarded;
+     * coplanar overlapping faces of the two operands are not treated
+     * specially, so results where the operands touch are approximate;
+     * and a face that lies exactly in a wall between tiles is not cut
+     * by the other operand where it crosses the wall. The grid is
+     * offset from the bounding box by an irregular fraction of a tile
+     * to make the last case unlikely.
+     */
+    class TiledCSG {
+    public:
+      typedef carve::geom::vector<3> vector_t;
+      typedef carve::geom::aabb<3> aabb_t;
+      typedef carve::mesh::MeshSet<3> meshset_t;
+
+      enum operand_t {
+        A = 0,
+        B = 1
+      };
+
+      /**
+       * \brief Receives the result of a tiled CSG operation.
+       *
+       * Vertices are numbered from 0 in the order in which they are
+       * passed to vertex(). face() receives the indices of vertices
+       * that have already been passed, in anticlockwise order seen
+       * from outside.
+       */
+      class Output {
+      public:
+        virtual void vertex(const vector_t &v) =0;
+        virtual void face(const std::vector<size_t> &vertices) =0;
+
+        virtual ~Output() {
+        }
+      };
+
+      /**
+       * \brief Writes the result to a stream as Wavefront OBJ.
+       */
+      class ObjOutput : public Output {
+        std::ostream &out;
+
+      public:
+        ObjOutput(std::ostream &_out) : out(_out) {
+          out.precision(17);
+        }
+
+        virtual void vertex(const vector_t &v) {
+          out << "v " << v.x << " " << v.y << " " << v.z << "\n";
+        }
+
+        virtual void face(const std::vector<size_t> &vertices) {
+          out << "f";
+          for (size_t i = 0; i < vertices.size(); ++i) out << " " << vertices[i] + 1;
+          out << "\n";
+        }
+      };
+
+      /**
+       * \brief Collects the result in memory.
+       */
+      class MeshSetOutput : public Output {
+        std::vector<vector_t> points;
+        std::vector<int> face_indices;
+        size_t n_faces;
+
+      public:
+        MeshSetOutput() : points(), face_indices(), n_faces(0) {
+        }
+
+        virtual void vertex(const vector_t &v) {
+          points.push_back(v);
+        }
+
+        virtual void face(const std::vector<size_t> &vertices) {
+          face_indices.push_back((int)vertices.size());
+          for (size_t i = 0; i < vertices.size(); ++i) face_indices.push_back((int)vertices[i]);
+          ++n_faces;
+        }
+
+        // A newly allocated MeshSet containing the faces received so far.
+        meshset_t *createMeshSet() const {
+          return new meshset_t(points, n_faces, face_indices);
+        }
+      };
+
+    private:
+      struct tile_t {
+        // pieces not yet written to disk.
+        std::vector<double> buffer[2];
+        bool on_disk[2];
+        // parity of the crossings of the row line with an operand,
+        // before (bit 0) and after (bit 1) the reference point.
+        unsigned char crossings[2];
+
+        tile_t() {
+          on_disk[0] = on_disk[1] = false;
+          crossings[0] = crossings[1] = 0;
+        }
+      };
+
+      aabb_t bounds;
+      double tile_size;
+      size_t n[3];
+      // wall[d][i] is the coordinate of the lower wall of tiles with
+      // index i along axis d. wall[d][0] <= bounds.min(d).
+      std::vector<double> wall[3];
+      std::string work_dir;
+
+      std::vector<tile_t> tiles;
+      size_t buffered_bytes;
+
+      TiledCSG(const TiledCSG &);
+      TiledCSG &operator=(const TiledCSG &);
+
+      size_t tileIndex(size_t i, size_t j, size_t k) const {
+        return i + n[0] * (j + n[1] * k);
+      }
+
+      std::string tilePath(size_t tile, int operand) const;
+      vector_t referencePoint(size_t tile) const;
+
+      void addTriangle(int operand, const vector_t &a, const vector_t &b, const vector_t &c);
+      void countRowCrossings(int operand, const vector_t &a, const vector_t &b, const vector_t &c);
+      void clipToTile(int operand, const size_t *idx, const vector_t *tri);
+
+      void flush(size_t tile, int operand);
+      void flushAll();
+      void readTile(size_t tile, int operand, std::vector<std::vector<vector_t> > &polygons) const;
+
+      struct tile_result_t;
+      class TileTask;
+
+      // inside has bit n set if the reference point of the tile is
+      // inside operand n.
+      void processTile(size_t tile, CSG::OP op, unsigned inside, tile_result_t &result) const;
+
+    public:
+      carve::Executor *executor; /**< If not NULL, runs the tiles of this instance. Otherwise carve::defaultExecutor() is used. Not owned. */
+
+      /**
+       * @param bounds A box that contains both operands.
+       * @param tile_size The side length of the cubic tiles.
+       * @param work_dir An existing directory for the tile files, which
+       *                 are removed by the destructor. Tile files left
+       *                 in it by another instance are overwritten, so
+       *                 instances that run at the same time need
+       *                 separate directories.
+       */
+      TiledCSG(const aabb_t &bounds, double tile_size, const std::string &work_dir);
+      ~TiledCSG();
+
+      size_t tileCount() const {
+        return tiles.size();
+      }
+
+      /**
+       * \brief Add a planar polygon to the surface of an operand. The
+       *        vertices are in anticlockwise order seen from outside.
+       */
+      void addFace(operand_t operand, const std::vector<vector_t> &polygon);
+
+      /**
+       * \brief Add all of the faces of a MeshSet to an operand.
+       */
+      void addMeshSet(operand_t operand, const meshset_t *meshset);
+
+      /**
+       * \brief Compute \a op between the faces added so far, and pass
+       *        the result to \a output. ALL is not supported.
+       */
+      void compute(CSG::OP op, Output &output);
+    };
+
+  }
+}
@@ -0,0 +1,182 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#pragma once
+
+#include <carve/carve.hpp>
+
+#include <vector>
+
+namespace carve {
+
+  /**
+   * \brief A loop body, run by an Executor over chunks of an index
+   *        range.
+   *
+   * run() may be called concurrently from several threads, and must
+   * not throw.
+   */
+  class ParallelTask {
+  public:
+    virtual void run(size_t begin, size_t end) =0;
+
+    virtual ~ParallelTask() {
+    }
+  };
+
+
+
+  /**
+   * \brief A unit of work for a TaskGroup. run() must not throw.
+   */
+  class Task {
+  public:
+    virtual void run() =0;
+
+    virtual ~Task() {
+    }
+  };
+
+
+
+  /**
+   * \class Executor
+   * \brief Runs carve's parallel loops.
+   *
+   * All parallel work in carve is submitted through an Executor, so
+   * that an embedding application can route it to its own scheduler,
+   * or limit the number of threads carve uses. Implementations must
+   * be safe to call from several threads at once, and from within a
+   * task that is itself being run by the executor.
+   */
+  class Executor {
+  public:
+    /**
+     * Split [0, n) into chunks [c * grain, min(n, (c + 1) * grain)),
+     * and call task.run() once for each chunk. Chunks may run
+     * concurrently and in any order; parallelFor() returns when all
+     * have completed. The chunk boundaries do not depend on the
+     * executor, so callers may use them to make results independent
+     * of scheduling.
+     */
+    virtual void parallelFor(size_t n, size_t grain, ParallelTask &task) =0;
+
+    /// The maximum number of chunks that may run concurrently.
+    virtual unsigned concurrency() const =0;
+
+    virtual ~Executor() {
+    }
+  };
+
+
+
+  /**
+   * \brief Runs every chunk in order on the calling thread.
+   */
+  class SerialExecutor : public Executor {
+  public:
+    virtual void parallelFor(size_t n, size_t grain, ParallelTask &task);
+    virtual unsigned concurrency() const;
+  };
+
+
+
+  /**
+   * \brief The default executor. Chunks are distributed dynamically
+   * over OpenMP threads, so idle threads take further chunks as they
+   * finish. Without OpenMP, behaves as SerialExecutor.
+   *
+   * Calls made from within a parallel region run serially, so that
+   * nested loops do not oversubscribe the machine.
+   */
+  class OpenMPExecutor : public Executor {
+    unsigned max_threads;
+
+  public:
+    /// \a _max_threads of 0 uses the OpenMP default.
+    OpenMPExecutor(unsigned _max_threads = 0) : max_threads(_max_threads) {
+    }
+
+    virtual void parallelFor(size_t n, size_t grain, ParallelTask &task);
+    virtual unsigned concurrency() const;
+  };
+
+
+
+  /**
+   * \brief Runs work on another executor, using at most \a limit of
+   * its threads at a time.
+   */
+  class LimitedExecutor : public Executor {
+    Executor &base;
+    unsigned limit;
+
+  public:
+    LimitedExecutor(Executor &_base, unsigned _limit) : base(_base), limit(_limit ? _limit : 1) {
+    }
+
+    virtual void parallelFor(size_t n, size_t grain, ParallelTask &task);
+    virtual unsigned concurrency() const;
+  };
+
+
+
+  /**
+   * \class TaskGroup
+   * \brief A set of independent tasks, run together by an Executor.
+   *
+   * Tasks are not owned, and are run by wait(), which returns when
+   * they have all completed.
+   */
+  class TaskGroup {
+    Executor &executor;
+    std::vector<Task *> tasks;
+
+    TaskGroup(const TaskGroup &);
+    TaskGroup &operator=(const TaskGroup &);
+
+  public:
+    TaskGroup(Executor &_executor);
+
+    void add(Task *task) {
+      tasks.push_back(task);
+    }
+
+    void wait();
+  };
+
+
+
+  /// The executor used by carve when no other is specified.
+  Executor &defaultExecutor();
+
+  /// Replace the default executor. \a executor is not owned; passing
+  /// NULL restores the built in OpenMPExecutor.
+  void setDefaultExecutor(Executor *executor);
+
+  /**
+   * Run \a task over [0, n) on \a executor, or serially on the
+   * calling thread if there are fewer than two chunks.
+   */
+  inline void parallelFor(Executor &executor, size_t n, size_t grain, ParallelTask &task) {
+    if (n <= grain) {
+      if (n) task.run(0, n);
+      return;
+    }
+    executor.parallelFor(n, grain, task);
+  }
+
+}
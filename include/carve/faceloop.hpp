@@ -20,6 +20,7 @@
 #include <carve/carve.hpp>
 #include <carve/classification.hpp>
 #include <carve/collection_types.hpp>
+#include <carve/memory_accounting.hpp>
 
 namespace carve {
   namespace csg {
@@ -32,7 +33,17 @@ namespace carve {
       std::vector<carve::mesh::MeshSet<3>::vertex_t *> vertices;
       FaceLoopGroup *group;
 
-      FaceLoop(const carve::mesh::MeshSet<3>::face_t *f, const std::vector<carve::mesh::MeshSet<3>::vertex_t *> &v) : next(NULL), prev(NULL), orig_face(f), vertices(v), group(NULL) {}
+      FaceLoop(const carve::mesh::MeshSet<3>::face_t *f, const std::vector<carve::mesh::MeshSet<3>::vertex_t *> &v) : next(NULL), prev(NULL), orig_face(f), vertices(v), group(NULL) {
+        if (carve::MemoryAccounting::enabled()) carve::MemoryAccounting::allocated(bytes());
+      }
+
+      ~FaceLoop() {
+        if (carve::MemoryAccounting::enabled()) carve::MemoryAccounting::released(bytes());
+      }
+
+      size_t bytes() const {
+        return sizeof(FaceLoop) + vertices.capacity() * sizeof(carve::mesh::MeshSet<3>::vertex_t *);
+      }
     };
 
 
@@ -184,6 +184,10 @@ namespace carve {
         if (i != options.end()) {
           opts.avoid_cavities(_bool((*i).second));
         }
+        i = options.find("reorder");
+        if (i != options.end()) {
+          opts.reorder(_bool((*i).second));
+        }
         return new carve::mesh::MeshSet<3>(points, faceCount, faceIndices, opts);
       }
     };
@@ -0,0 +1,238 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#pragma once
+
+#include <carve/carve.hpp>
+
+#include <carve/geom3d.hpp>
+#include <carve/aabb.hpp>
+#include <carve/executor.hpp>
+
+#include <carve/polyhedron_base.hpp>
+
+#include <vector>
+
+namespace carve {
+
+  namespace csg {
+
+    /**
+     * \class LinearOctree
+     * \brief A pointer free octree over the faces, edges and vertices
+     *        of a poly::Polyhedron, or over a set of bare points.
+     *
+     * Each primitive is stored exactly once, keyed by the Morton code
+     * of the centre of its bounding box. Primitives are ordered by a
+     * (parallel) radix sort of their codes, after which every octree
+     * cell corresponds to a contiguous range of the sorted primitive
+     * array. Nodes are stored in a single array in depth first order,
+     * each with a bounding box fitted to its contents and the index of
+     * the next node outside its subtree, so that queries need neither
+     * recursion nor an explicit stack.
+     *
+     * The query interface mirrors that of carve::csg::Octree. Results
+     * are candidates whose (slightly padded) bounding boxes satisfy
+     * the query; because each primitive is stored once, no tagging is
+     * needed to remove duplicates, and concurrent queries against a
+     * built tree are safe.
+     */
+    class LinearOctree {
+    public:
+      typedef carve::poly::Geometry<3>::vertex_t vertex_t;
+      typedef carve::poly::Geometry<3>::edge_t edge_t;
+      typedef carve::poly::Geometry<3>::face_t face_t;
+      typedef carve::geom3d::Vector point_t;
+
+      // Morton codes interleave MORTON_BITS bits per axis.
+      static const unsigned MORTON_BITS = 10;
+      static const unsigned LEAF_SIZE = 8;
+
+      struct Node {
+        carve::geom3d::AABB aabb;
+        // range of the sorted primitive array covered by this node.
+        unsigned begin, end;
+        // index of the next node (in depth first order) that is not a
+        // descendant of this node.
+        unsigned skip;
+        bool is_leaf;
+      };
+
+      /**
+       * \brief A linear octree over a single type of primitive.
+       */
+      template<typename item_t>
+      struct Index {
+        std::vector<const item_t *> items;
+        std::vector<carve::geom3d::AABB> item_aabbs;
+        std::vector<Node> nodes;
+
+        void clear() {
+          items.clear();
+          item_aabbs.clear();
+          nodes.clear();
+        }
+
+        template<typename test_t, typename filter_t>
+        void query(const test_t &test, filter_t filter, std::vector<const item_t *> &out) const {
+          const unsigned n_nodes = (unsigned)nodes.size();
+          unsigned i = 0;
+          while (i < n_nodes) {
+            const Node &node = nodes[i];
+            if (!test(node.aabb)) {
+              i = node.skip;
+              continue;
+            }
+            if (node.is_leaf) {
+              for (unsigned j = node.begin; j < node.end; ++j) {
+                if (test(item_aabbs[j]) && filter(items[j])) {
+                  out.push_back(items[j]);
+                }
+              }
+            }
+            ++i;
+          }
+        }
+      };
+
+
+
+      struct no_filter {
+        bool operator()(const edge_t *) { return true; }
+        bool operator()(const face_t *) { return true; }
+        bool operator()(const vertex_t *) { return true; }
+        bool operator()(const point_t *) { return true; }
+      };
+
+
+
+      Index<face_t> faces;
+      Index<edge_t> edges;
+      Index<vertex_t> vertices;
+      Index<point_t> points;
+
+      carve::Executor *executor; /**< If not NULL, runs the parallel work of build(). Otherwise carve::defaultExecutor() is used. Not owned. */
+
+
+
+      LinearOctree();
+      ~LinearOctree();
+
+
+
+      // Primitives are accumulated by the add*() calls, and become
+      // visible to queries after build().
+      void addEdges(const std::vector<edge_t> &edges);
+      void addFaces(const std::vector<face_t> &faces);
+      void addVertices(const std::vector<const vertex_t *> &vertices);
+      // Points are stored by address, like edges and faces, so a
+      // result's position in p is its offset from &p[0].
+      void addPoints(const std::vector<point_t> &p);
+
+      void build();
+
+      void clear();
+
+
+
+      template<typename filter_t>
+      void findEdgesNear(const face_t &f,
+                         std::vector<const edge_t *> &out,
+                         filter_t filter) const;
+
+      void findEdgesNear(const face_t &f,
+                         std::vector<const edge_t *> &out) const {
+        findEdgesNear(f, out, no_filter());
+      }
+
+      void findEdgesNear(const carve::geom::aabb<3> &aabb, std::vector<const edge_t *> &out) const;
+      void findEdgesNear(const carve::geom3d::LineSegment &l, std::vector<const edge_t *> &out) const;
+      void findEdgesNear(const edge_t &e, std::vector<const edge_t *> &out) const;
+      void findEdgesNear(const carve::geom3d::Vector &v, std::vector<const edge_t *> &out) const;
+
+
+
+      void findFacesNear(const carve::geom::aabb<3> &aabb, std::vector<const face_t *> &out) const;
+      void findFacesNear(const carve::geom3d::LineSegment &l, std::vector<const face_t *> &out) const;
+      void findFacesNear(const edge_t &e, std::vector<const face_t *> &out) const;
+
+
+
+      // Find vertices within carve::EPSILON (per axis) of v. Vertices
+      // that were added more than once are reported more than once.
+      void findVerticesNearAllowDupes(const carve::geom3d::Vector &v,
+                                      std::vector<const vertex_t *> &out) const;
+
+      void findVerticesNearAllowDupes(const carve::geom3d::Vector &v,
+                                      double radius,
+                                      std::vector<const vertex_t *> &out) const;
+
+      // As findVerticesNearAllowDupes(), for points added by addPoints().
+      void findPointsNearAllowDupes(const carve::geom3d::Vector &v,
+                                    std::vector<const point_t *> &out) const;
+
+      void findPointsNearAllowDupes(const carve::geom3d::Vector &v,
+                                    double radius,
+                                    std::vector<const point_t *> &out) const;
+
+
+
+      // Sort (key, value) pairs by key using a stable LSD radix sort
+      // whose histogram and scatter passes run in parallel on
+      // executor (or carve::defaultExecutor() if it is NULL).
+      static void radixSort(std::vector<uint32_t> &keys,
+                            std::vector<uint32_t> &values,
+                            carve::Executor *executor = NULL);
+
+      static uint32_t mortonCode(const carve::geom3d::Vector &v,
+                                 const carve::geom3d::Vector &base,
+                                 const carve::geom3d::Vector &scale);
+
+    private:
+      LinearOctree(const LinearOctree &); // undefined.
+      LinearOctree &operator=(const LinearOctree &); // undefined.
+
+      // Sort primitives into Morton order, permuting items to match,
+      // and build the node array over the sorted primitives.
+      template<typename item_t>
+      static void buildIndex(Index<item_t> &index, carve::Executor *executor);
+
+      static void buildNodes(const std::vector<carve::geom3d::AABB> &aabbs,
+                             std::vector<unsigned> &order,
+                             std::vector<Node> &nodes,
+                             carve::Executor *executor);
+
+      struct face_test {
+        const face_t &f;
+        face_test(const face_t &_f) : f(_f) {}
+        bool operator()(const carve::geom3d::AABB &a) const {
+          return a.intersects(f.aabb) && a.intersects(f.plane_eqn);
+        }
+      };
+    };
+
+
+
+    template<typename filter_t>
+    void LinearOctree::findEdgesNear(const face_t &f,
+                                     std::vector<const edge_t *> &out,
+                                     filter_t filter) const {
+      edges.query(face_test(f), filter, out);
+    }
+
+  }
+}
@@ -0,0 +1,234 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#pragma once
+
+#include <carve/carve.hpp>
+
+#include <memory>
+#include <new>
+#include <cstddef>
+#include <iostream>
+
+namespace carve {
+
+  /**
+   * \class MemoryAccounting
+   * \brief Opt-in accounting of the memory used by carve's internal
+   *        containers and pools.
+   *
+   * When enabled, tracked allocations are attributed to the innermost
+   * active phase. Phases are opened by carve::TimingBlock, so each
+   * record corresponds to a TimingName. For every phase the number of
+   * allocations, the bytes allocated and released, and the peak of
+   * live tracked bytes while the phase was active are recorded.
+   *
+   * Only memory that is routed through tracking_allocator, or reported
+   * explicitly, is counted. Accounting should be enabled, disabled and
+   * reset outside of any CSG computation.
+   */
+  class MemoryAccounting {
+  public:
+    struct Record {
+      const char *name;
+      unsigned n_calls;
+      uint64_t n_allocs;
+      uint64_t n_frees;
+      uint64_t bytes_allocated;
+      uint64_t bytes_released;
+      // highest number of live tracked bytes seen while the phase was active.
+      uint64_t peak_live;
+      // highest increase in live tracked bytes over the value at phase entry.
+      uint64_t peak_growth;
+
+      Record(const char *_name = NULL) :
+        name(_name), n_calls(0), n_allocs(0), n_frees(0),
+        bytes_allocated(0), bytes_released(0), peak_live(0), peak_growth(0) {
+      }
+    };
+
+  private:
+    static bool is_enabled;
+
+  public:
+    static bool enabled() {
+      return is_enabled;
+    }
+    static void enable();
+    static void disable();
+
+    // Discard all records, and the current live and peak counts.
+    static void reset();
+
+    static void allocated(size_t bytes);
+    static void released(size_t bytes);
+
+    // Open a phase identified by \a key. Returns false (and opens
+    // nothing) when called from within a parallel region. Phases are
+    // closed by key, so threads that open phases concurrently do not
+    // close each other's.
+    static bool enter(const void *key, const char *name);
+    static void leave(const void *key);
+
+    static int64_t liveBytes();
+    static int64_t peakBytes();
+
+    // Records of all phases seen since the last reset, ordered by
+    // decreasing peak_growth.
+    static void records(std::vector<Record> &out);
+
+    // The record for the phase named \a name, or a zeroed record if
+    // that phase has not been seen.
+    static Record record(const char *name);
+
+    static void print(std::ostream &out);
+  };
+
+
+
+  /**
+   * \brief A scoped accounting phase.
+   */
+  class MemoryPhase {
+    const void *key;
+    bool active;
+
+    MemoryPhase(const MemoryPhase &);
+    MemoryPhase &operator=(const MemoryPhase &);
+
+  public:
+    MemoryPhase() : key(NULL), active(false) {
+    }
+    MemoryPhase(const void *_key, const char *name) :
+        key(_key), active(MemoryAccounting::enabled() && MemoryAccounting::enter(_key, name)) {
+    }
+    ~MemoryPhase() {
+      if (active) MemoryAccounting::leave(key);
+    }
+  };
+
+
+
+  /**
+   * \brief Reports the footprint of structures that cannot use a
+   *        tracking_allocator (such as the unordered collections) as an
+   *        estimate that is updated at convenient points.
+   */
+  class MemoryGauge {
+    size_t bytes;
+
+    MemoryGauge(const MemoryGauge &);
+    MemoryGauge &operator=(const MemoryGauge &);
+
+  public:
+    MemoryGauge() : bytes(0) {
+    }
+    ~MemoryGauge() {
+      set(0);
+    }
+
+    size_t get() const {
+      return bytes;
+    }
+
+    void set(size_t new_bytes) {
+      if (new_bytes > bytes) {
+        if (MemoryAccounting::enabled()) MemoryAccounting::allocated(new_bytes - bytes);
+      } else if (new_bytes < bytes) {
+        if (MemoryAccounting::enabled()) MemoryAccounting::released(bytes - new_bytes);
+      }
+      bytes = new_bytes;
+    }
+
+    void add(size_t delta) {
+      set(bytes + delta);
+    }
+  };
+
+
+
+  /**
+   * \brief A standard allocator that reports its allocations to
+   *        MemoryAccounting when accounting is enabled.
+   */
+  template<typename T>
+  class tracking_allocator {
+  public:
+    typedef T value_type;
+    typedef T *pointer;
+    typedef const T *const_pointer;
+    typedef T &reference;
+    typedef const T &const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<typename U>
+    struct rebind {
+      typedef tracking_allocator<U> other;
+    };
+
+    tracking_allocator() {
+    }
+    tracking_allocator(const tracking_allocator &) {
+    }
+    template<typename U>
+    tracking_allocator(const tracking_allocator<U> &) {
+    }
+
+    pointer address(reference x) const {
+      return &x;
+    }
+    const_pointer address(const_reference x) const {
+      return &x;
+    }
+
+    size_type max_size() const {
+      return size_type(-1) / sizeof(T);
+    }
+
+    pointer allocate(size_type n, const void * /* hint */ = 0) {
+      if (n > max_size()) throw std::bad_alloc();
+      pointer p = static_cast<pointer>(::operator new(n * sizeof(T)));
+      if (MemoryAccounting::enabled()) MemoryAccounting::allocated(n * sizeof(T));
+      return p;
+    }
+
+    void deallocate(pointer p, size_type n) {
+      if (MemoryAccounting::enabled()) MemoryAccounting::released(n * sizeof(T));
+      ::operator delete(p);
+    }
+
+    void construct(pointer p, const T &val) {
+      new(static_cast<void *>(p)) T(val);
+    }
+
+    void destroy(pointer p) {
+      p->~T();
+    }
+  };
+
+  template<typename T, typename U>
+  inline bool operator==(const tracking_allocator<T> &, const tracking_allocator<U> &) {
+    return true;
+  }
+
+  template<typename T, typename U>
+  inline bool operator!=(const tracking_allocator<T> &, const tracking_allocator<U> &) {
+    return false;
+  }
+
+}
@@ -25,10 +25,14 @@
 #include <carve/djset.hpp>
 #include <carve/aabb.hpp>
 #include <carve/rtree.hpp>
+#include <carve/matrix.hpp>
+#include <carve/executor.hpp>
 
 #include <iostream>
 
 namespace carve {
+  class CancellationToken;
+
   namespace poly {
     class Polyhedron;
   }
@@ -292,15 +296,23 @@ namespace carve {
       unproject_t unproject;
 
     private:
+      // bounding box of the edge loop. Filled by recalc(), setPlane()
+      // or the first getAABB() after invalidate(), which drops it.
+      // Filling it is not synchronised, so the first query must not
+      // race with another.
+      mutable aabb_t aabb;
+      mutable bool aabb_valid;
+
       Face &operator=(const Face &other);
 
     protected:
-      Face() : edge(NULL), n_edges(0), mesh(NULL), id(0), plane(), project(NULL), unproject(NULL) {
+      Face() : edge(NULL), n_edges(0), mesh(NULL), id(0), plane(), project(NULL), unproject(NULL), aabb(), aabb_valid(false) {
       }
 
       Face(const Face &other) :
         edge(NULL), n_edges(other.n_edges), mesh(NULL), id(other.id),
-        plane(other.plane), project(other.project), unproject(other.unproject) {
+        plane(other.plane), project(other.project), unproject(other.unproject),
+        aabb(other.aabb), aabb_valid(other.aabb_valid) {
       }
 
       project_t getProjector(bool positive_facing, int axis) const;
@@ -327,8 +339,20 @@ namespace carve {
 
       aabb_t getAABB() const;
 
+      // refit the plane of the face to its vertices, and refresh its
+      // bounding box.
       bool recalc();
 
+      // set the plane of the face, and the projection that goes with
+      // it, without refitting the plane to the vertices.
+      void setPlane(const plane_t &_plane);
+
+      // drop the cached bounding box of the face and the derived
+      // properties of its mesh. Must be called by code that moves
+      // the vertices of the face or edits its edge loop without
+      // calling recalc().
+      void invalidate();
+
       void clearEdges();
 
       // build an edge loop in forward orientation from an iterator pair
@@ -381,7 +405,7 @@ namespace carve {
 
       static Face *closeLoop(edge_t *open_edge);
 
-      Face(edge_t *e) : edge(e), n_edges(0), mesh(NULL) {
+      Face(edge_t *e) : edge(e), n_edges(0), mesh(NULL), aabb_valid(false) {
         do {
           e->face = this;
           n_edges++;
@@ -390,18 +414,18 @@ namespace carve {
         recalc();
       }
 
-      Face(vertex_t *a, vertex_t *b, vertex_t *c) : edge(NULL), n_edges(0), mesh(NULL) {
+      Face(vertex_t *a, vertex_t *b, vertex_t *c) : edge(NULL), n_edges(0), mesh(NULL), aabb_valid(false) {
         init(a, b, c);
         recalc();
       }
 
-      Face(vertex_t *a, vertex_t *b, vertex_t *c, vertex_t *d) : edge(NULL), n_edges(0), mesh(NULL) {
+      Face(vertex_t *a, vertex_t *b, vertex_t *c, vertex_t *d) : edge(NULL), n_edges(0), mesh(NULL), aabb_valid(false) {
         init(a, b, c, d);
         recalc();
       }
 
       template<typename iter_t>
-      Face(iter_t begin, iter_t end) : edge(NULL), n_edges(0), mesh(NULL) {
+      Face(iter_t begin, iter_t end) : edge(NULL), n_edges(0), mesh(NULL), aabb_valid(false) {
         init(begin, end);
         recalc();
       }
@@ -466,15 +490,32 @@ namespace carve {
 
     struct MeshOptions {
       bool opt_avoid_cavities;
+      bool opt_reorder;
+      carve::Executor *opt_executor;
 
       MeshOptions() :
-        opt_avoid_cavities(false) {
+        opt_avoid_cavities(false),
+        opt_reorder(false),
+        opt_executor(NULL) {
       }
 
       MeshOptions &avoid_cavities(bool val) {
         opt_avoid_cavities = val;
         return *this;
       }
+
+      // if set, MeshSet::reorder() is applied on construction.
+      MeshOptions &reorder(bool val) {
+        opt_reorder = val;
+        return *this;
+      }
+
+      // runs the parallel parts of construction. NULL uses the
+      // default executor. Not owned.
+      MeshOptions &executor(carve::Executor *val) {
+        opt_executor = val;
+        return *this;
+      }
     };
 
 
@@ -634,6 +675,24 @@ namespace carve {
 
       meshset_t *meshset;
 
+    private:
+      enum {
+        CACHED_AABB   = 1,
+        CACHED_VOLUME = 2,
+        CACHED_CONVEX = 4
+      };
+
+      // derived properties, computed on first use and dropped by
+      // invalidate(). Filling them is not synchronised, so the first
+      // query of a property must not race with another.
+      mutable unsigned cached;
+      mutable aabb_t cached_aabb;
+      mutable double cached_volume;
+      mutable bool cached_convex;
+
+      double calcVolume() const;
+      bool calcConvex() const;
+
     protected:
       Mesh(std::vector<face_t *> &_faces,
            std::vector<edge_t *> &_open_edges,
@@ -649,7 +708,11 @@ namespace carve {
       static void create(iter_t begin, iter_t end, std::vector<Mesh<ndim> *> &meshes, const MeshOptions &opts);
 
       aabb_t getAABB() const {
-        return aabb_t(faces.begin(), faces.end());
+        if (!(cached & CACHED_AABB)) {
+          cached_aabb = aabb_t(faces.begin(), faces.end());
+          cached |= CACHED_AABB;
+        }
+        return cached_aabb;
       }
 
       bool isClosed() const {
@@ -661,19 +724,28 @@ namespace carve {
       }
 
       double volume() const {
-        if (is_negative || !faces.size()) return 0.0;
-
-        double vol = 0.0;
-        typename vertex_t::vector_t origin = faces[0]->edge->vert->v;
+        if (!(cached & CACHED_VOLUME)) {
+          cached_volume = calcVolume();
+          cached |= CACHED_VOLUME;
+        }
+        return cached_volume;
+      }
 
-        for (size_t f = 0; f < faces.size(); ++f) {
-          face_t *face = faces[f];
-          edge_t *e1 = face->edge;
-          for (edge_t *e2 = e1->next ;e2->next != e1; e2 = e2->next) {
-            vol += carve::geom3d::tetrahedronVolume(e1->vert->v, e2->vert->v, e2->next->vert->v, origin);
-          }
+      // true if the mesh is closed, positive, and bends away from
+      // the outside at every edge.
+      bool isConvex() const {
+        if (!(cached & CACHED_CONVEX)) {
+          cached_convex = calcConvex();
+          cached |= CACHED_CONVEX;
         }
-        return vol;
+        return cached_convex;
+      }
+
+      // drop the derived properties (bounding box, volume, convexity)
+      // of the mesh. Called by cacheEdges(), calcOrientation() and
+      // Face::invalidate().
+      void invalidate() {
+        cached = 0;
       }
 
       struct IsClosed {
@@ -701,6 +773,7 @@ namespace carve {
           faces[i]->invert();
         }
         if (isClosed()) is_negative = !is_negative;
+        invalidate();
       }
 
       Mesh *clone(const vertex_t *old_base, vertex_t *new_base) const;
@@ -803,6 +876,17 @@ namespace carve {
         }
       }
 
+      // Apply an affine transformation. Vertices and face planes are
+      // transformed in parallel on executor (or the default executor
+      // if it is NULL), and planes are mapped by the cofactor (inverse
+      // transpose) of the linear part rather than refitted. Only
+      // defined for ndim == 3.
+      void transform(const carve::math::Matrix &matrix, carve::Executor *executor = NULL);
+
+      void transform(const carve::math::matrix_transformation &func, carve::Executor *executor = NULL) {
+        transform(func.matrix, executor);
+      }
+
       MeshSet(const std::vector<typename vertex_t::vector_t> &points,
               size_t n_faces,
               const std::vector<int> &face_indices,
@@ -821,7 +905,7 @@ namespace carve {
 
       // This constructor consolidates and rewrites vertex pointers in
       // each mesh, repointing them to local storage.
-      MeshSet(std::vector<mesh_t *> &_meshes);
+      MeshSet(std::vector<mesh_t *> &_meshes, carve::Executor *executor = NULL);
 
       MeshSet *clone() const;
 
@@ -834,6 +918,14 @@ namespace carve {
         return true;
       }
 
+      // drop the cached properties of every face and mesh. Must be
+      // called after moving vertices in vertex_storage directly.
+      void invalidate() {
+        for (face_iter i = faceBegin(); i != faceEnd(); ++i) {
+          (*i)->invalidate();
+        }
+      }
+
 
       void invert() {
         for (size_t i = 0; i < meshes.size(); ++i) {
@@ -841,11 +933,25 @@ namespace carve {
         }
       }
 
-      void collectVertices();
+      // Rebuild vertex_storage to hold only the vertices referenced
+      // by edges, in parallel on executor (or the default executor if
+      // it is NULL).
+      void collectVertices(carve::Executor *executor = NULL);
 
       void canonicalize();
 
-      void separateMeshes();
+      // Renumber vertices, and the faces of each mesh, in Morton
+      // (Z-order) curve order, and reallocate faces and edges in the
+      // new face order, so that elements that are close in space are
+      // also close in memory. Vertex, face and edge pointers into the
+      // MeshSet are invalidated. If keep_faces is true, faces and
+      // edges are not reallocated, and only vertex pointers are
+      // invalidated.
+      void reorder(bool keep_faces = false);
+
+      // As collectVertices(), but a vertex shared between meshes is
+      // duplicated, so that each mesh refers to its own copy.
+      void separateMeshes(carve::Executor *executor = NULL);
     };
 
 
@@ -856,7 +962,8 @@ namespace carve {
         const carve::geom::vector<3> &v,
         bool even_odd = false,
         const carve::mesh::Mesh<3> *mesh = NULL,
-        const carve::mesh::Face<3> **hit_face = NULL);
+        const carve::mesh::Face<3> **hit_face = NULL,
+        const carve::CancellationToken *cancellation = NULL);
 
 
 
@@ -0,0 +1,64 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#pragma once
+
+#include <carve/carve.hpp>
+#include <carve/mesh.hpp>
+
+#include <istream>
+#include <ostream>
+
+namespace carve {
+  namespace mesh {
+
+    /**
+     * \brief Write a MeshSet to a stream in a compact binary format.
+     *
+     * Faces are visited breadth first across the rev links of their
+     * edges, so that for each face after the first in a mesh only the
+     * vertices that are not on the edge it was reached through need
+     * to be stored. A vertex is stored when it is first used, as the
+     * difference from a parallelogram prediction made from the face
+     * it was reached from. Everything is entropy coded with adaptive
+     * binary models.
+     *
+     * Vertices and faces are renumbered in the order of traversal,
+     * and vertices that are not used by any face are not stored.
+     *
+     * @param[out] out The stream to write to.
+     * @param[in] meshset The MeshSet to write.
+     * @param[in] quantum If greater than zero, coordinates are rounded
+     *                    to the nearest multiple of \a quantum from the
+     *                    minimum corner of the bounding box. Otherwise
+     *                    they are stored exactly.
+     */
+    void writeCompressed(std::ostream &out, const MeshSet<3> *meshset, double quantum = 0.0);
+
+    /**
+     * \brief Read a MeshSet written by writeCompressed().
+     *
+     * Reads exactly the bytes that were written, so several meshes may
+     * be stored one after another in a stream. Throws carve::exception
+     * if the data is not valid.
+     *
+     * @return A newly allocated MeshSet owned by the caller.
+     */
+    MeshSet<3> *readCompressed(std::istream &in);
+
+  }
+}
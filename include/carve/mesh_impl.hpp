@@ -20,6 +20,8 @@
 #include <carve/geom2d.hpp>
 #include <carve/geom3d.hpp>
 #include <carve/djset.hpp>
+#include <carve/executor.hpp>
+#include <carve/timing.hpp>
 
 #include <iostream>
 #include <deque>
@@ -131,6 +133,9 @@ namespace carve {
       revface->n_edges = 0;
       revface->edge = NULL;
 
+      fwdface->invalidate();
+      revface->invalidate();
+
       _setloopface(left_loop, NULL);
       _setloopface(left_loop->rev, NULL);
 
@@ -144,6 +149,7 @@ namespace carve {
       Edge *n = NULL;
       if (face) {
         face->n_edges--;
+        face->invalidate();
       }
 
       if (next == this) {
@@ -178,6 +184,7 @@ namespace carve {
       if (face) {
         face->n_edges--;
         if (face->edge == this) face->edge = next;
+        face->invalidate();
         face = NULL;
       }
 
@@ -198,6 +205,8 @@ namespace carve {
       prev->next = this;
 
       if (prev->rev) { prev->rev->rev = NULL;  prev->rev = NULL; }
+
+      if (other->face) other->face->invalidate();
     }
 
 
@@ -211,6 +220,8 @@ namespace carve {
       prev->next = this;
 
       if (prev->rev) { prev->rev->rev = NULL;  prev->rev = NULL; }
+
+      if (other->face) other->face->invalidate();
     }
 
 
@@ -265,15 +276,28 @@ namespace carve {
 
     template<unsigned ndim>
     typename Face<ndim>::aabb_t Face<ndim>::getAABB() const {
-      aabb_t aabb;
-      aabb.fit(begin(), end(), vector_mapping());
+      if (!aabb_valid) {
+        aabb.fit(begin(), end(), vector_mapping());
+        aabb_valid = true;
+      }
       return aabb;
     }
 
 
 
+    template<unsigned ndim>
+    void Face<ndim>::invalidate() {
+      aabb_valid = false;
+      if (mesh) mesh->invalidate();
+    }
+
+
+
     template<unsigned ndim>
     bool Face<ndim>::recalc() {
+      aabb.fit(begin(), end(), vector_mapping());
+      aabb_valid = true;
+
       if (!carve::geom3d::fitPlane(begin(), end(), vector_mapping(), plane)) {
         return false;
       }
@@ -293,6 +317,21 @@ namespace carve {
 
 
 
+    template<unsigned ndim>
+    void Face<ndim>::setPlane(const plane_t &_plane) {
+      plane = _plane;
+
+      aabb.fit(begin(), end(), vector_mapping());
+      aabb_valid = true;
+
+      int da = carve::geom::largestAxis(plane.N);
+
+      project = getProjector(plane.N.v[da] > 0, da);
+      unproject = getUnprojector(plane.N.v[da] > 0, da);
+    }
+
+
+
     template<unsigned ndim>
     void Face<ndim>::clearEdges() {
       if (!edge) return;
@@ -307,6 +346,8 @@ namespace carve {
       edge = NULL;
 
       n_edges = 0;
+
+      invalidate();
     }
 
 
@@ -448,6 +489,9 @@ namespace carve {
       r->project = r->getProjector(r->plane.N.v[da] > 0, da);
       r->unproject = r->getUnprojector(r->plane.N.v[da] > 0, da);
 
+      r->aabb.fit(r->begin(), r->end(), vector_mapping());
+      r->aabb_valid = true;
+
       return r;
     }
 
@@ -500,6 +544,7 @@ namespace carve {
       std::swap(closed_edges, _closed_edges);
       is_negative = _is_negative;
       meshset = NULL;
+      cached = 0;
 
       for (size_t i = 0; i < faces.size(); ++i) {
         faces[i]->mesh = this;
@@ -574,6 +619,7 @@ namespace carve {
     void Mesh<ndim>::cacheEdges() {
       closed_edges.clear();
       open_edges.clear();
+      invalidate();
 
       for (size_t i = 0; i < faces.size(); ++i) {
         face_t *face = faces[i];
@@ -592,7 +638,7 @@ namespace carve {
 
 
     template<unsigned ndim>
-    Mesh<ndim>::Mesh(std::vector<face_t *> &_faces) : faces(), open_edges(), closed_edges(), meshset(NULL) {
+    Mesh<ndim>::Mesh(std::vector<face_t *> &_faces) : faces(), open_edges(), closed_edges(), meshset(NULL), cached(0) {
       faces.swap(_faces);
       for (size_t i = 0; i < faces.size(); ++i) {
         faces[i]->mesh = this;
@@ -653,6 +699,8 @@ namespace carve {
 
     template<unsigned ndim>
     void Mesh<ndim>::calcOrientation() {
+      invalidate();
+
       if (open_edges.size() || !closed_edges.size()) {
         is_negative = false;
         return;
@@ -680,6 +728,43 @@ namespace carve {
 
 
 
+    template<unsigned ndim>
+    double Mesh<ndim>::calcVolume() const {
+      if (is_negative || !faces.size()) return 0.0;
+
+      double vol = 0.0;
+      typename vertex_t::vector_t origin = faces[0]->edge->vert->v;
+
+      for (size_t f = 0; f < faces.size(); ++f) {
+        face_t *face = faces[f];
+        edge_t *e1 = face->edge;
+        for (edge_t *e2 = e1->next ;e2->next != e1; e2 = e2->next) {
+          vol += carve::geom3d::tetrahedronVolume(e1->vert->v, e2->vert->v, e2->next->vert->v, origin);
+        }
+      }
+      return vol;
+    }
+
+
+
+    template<unsigned ndim>
+    bool Mesh<ndim>::calcConvex() const {
+      if (!isClosed() || is_negative || !faces.size()) return false;
+
+      // a closed surface that is locally convex at every edge is
+      // convex. For each side of an edge, the vertex of the
+      // neighbouring face that follows the edge must not lie in front
+      // of the plane of the face.
+      for (size_t i = 0; i < closed_edges.size(); ++i) {
+        const edge_t *e = closed_edges[i];
+        if (carve::geom::distance(e->face->plane, e->rev->next->v2()->v) > carve::EPSILON) return false;
+        if (carve::geom::distance(e->rev->face->plane, e->next->v2()->v) > carve::EPSILON) return false;
+      }
+      return true;
+    }
+
+
+
     template<unsigned ndim>
     Mesh<ndim> *Mesh<ndim>::clone(const vertex_t *old_base,
                                   vertex_t *new_base) const {
@@ -733,44 +818,27 @@ namespace carve {
 
 
 
-    template<unsigned ndim>
-    template<typename iter_t>
-    void MeshSet<ndim>::_init_from_faces(iter_t begin, iter_t end, const MeshOptions &opts) {
-      typedef std::unordered_map<const vertex_t *, size_t> map_t;
-      map_t vmap;
-
-      for (iter_t i = begin; i != end; ++i) {
-        face_t *f = *i;
-        edge_t *e = f->edge;
-        do {
-          typename map_t::const_iterator j = vmap.find(e->vert);
-          if (j == vmap.end()) {
-            size_t idx = vmap.size();
-            vmap[e->vert] = idx;
-          }
-          e = e->next;
-        } while (e != f->edge);
-      }
+    namespace detail {
+      template<unsigned ndim>
+      void rebuildVertexStorage(MeshSet<ndim> *meshset, bool per_mesh, carve::Executor &executor);
+    }
 
-      vertex_storage.resize(vmap.size());
-      for (typename map_t::const_iterator i = vmap.begin(); i != vmap.end(); ++i) {
-        vertex_storage[(*i).second].v = (*i).first->v;
-      }
 
-      for (iter_t i = begin; i != end; ++i) {
-        face_t *f = *i;
-        edge_t *e = f->edge;
-        do {
-          e->vert = &vertex_storage[vmap[e->vert]];
-          e = e->next;
-        } while (e != f->edge);
-      }
 
+    template<unsigned ndim>
+    template<typename iter_t>
+    void MeshSet<ndim>::_init_from_faces(iter_t begin, iter_t end, const MeshOptions &opts) {
+      // faces are stitched while they still refer to their original
+      // vertices, which are then copied into local storage.
       mesh_t::create(begin, end, meshes, opts);
 
       for (size_t i = 0; i < meshes.size(); ++i) {
         meshes[i]->meshset = this;
       }
+
+      detail::rebuildVertexStorage(this, false, opts.opt_executor != NULL ? *opts.opt_executor : carve::defaultExecutor());
+
+      if (opts.opt_reorder) reorder();
     }
 
 
@@ -806,6 +874,8 @@ namespace carve {
       for (size_t i = 0; i < meshes.size(); ++i) {
         meshes[i]->meshset = this;
       }
+
+      if (opts.opt_reorder) reorder();
     }
 
 
@@ -838,42 +908,15 @@ namespace carve {
 
 
     template<unsigned ndim>
-    MeshSet<ndim>::MeshSet(std::vector<typename MeshSet<ndim>::mesh_t *> &_meshes) {
+    MeshSet<ndim>::MeshSet(std::vector<typename MeshSet<ndim>::mesh_t *> &_meshes, carve::Executor *executor) {
       meshes.swap(_meshes);
-      std::unordered_map<vertex_t *, size_t> vert_idx;
 
       for (size_t m = 0; m < meshes.size(); ++m) {
-        mesh_t *mesh = meshes[m];
-        CARVE_ASSERT(mesh->meshset == NULL);
-        mesh->meshset = this;
-        for (size_t f = 0; f < mesh->faces.size(); ++f) {
-          face_t *face = mesh->faces[f];
-          edge_t *edge = face->edge;
-          do {
-            vert_idx[edge->vert] = 0;
-            edge = edge->next;
-          } while (edge != face->edge);
-        }
-      }
-
-      vertex_storage.reserve(vert_idx.size());
-      for (typename std::unordered_map<vertex_t *, size_t>::iterator i = vert_idx.begin(); i != vert_idx.end(); ++i) {
-        (*i).second = vertex_storage.size();
-        vertex_storage.push_back(*(*i).first);
+        CARVE_ASSERT(meshes[m]->meshset == NULL);
+        meshes[m]->meshset = this;
       }
 
-      for (size_t m = 0; m < meshes.size(); ++m) {
-        mesh_t *mesh = meshes[m];
-        for (size_t f = 0; f < mesh->faces.size(); ++f) {
-          face_t *face = mesh->faces[f];
-          edge_t *edge = face->edge;
-          do {
-            size_t i = vert_idx[edge->vert];
-            edge->vert = &vertex_storage[i];
-            edge = edge->next;
-          } while (edge != face->edge);
-        }
-      }
+      detail::rebuildVertexStorage(this, false, executor != NULL ? *executor : carve::defaultExecutor());
     }
 
 
@@ -982,45 +1025,196 @@ namespace carve {
 
 
 
-    template<unsigned ndim>
-    void MeshSet<ndim>::collectVertices() {
-      std::unordered_map<vertex_t *, size_t> vert_idx;
+    namespace detail {
+      // a reference from a half-edge to its vertex. The key is the
+      // offset of the vertex from the lowest vertex address, in units
+      // of the vertex size, so distinct vertices have distinct keys.
+      template<unsigned ndim>
+      struct VertexRef {
+        uint64_t key;
+        Edge<ndim> *edge;
+      };
 
-      for (size_t m = 0; m < meshes.size(); ++m) {
-        mesh_t *mesh = meshes[m];
+      const unsigned RADIX_BITS = 11;
+      const size_t RADIX_SIZE = (size_t)1 << RADIX_BITS;
 
-        for (size_t f = 0; f < mesh->faces.size(); ++f) {
-          face_t *face = mesh->faces[f];
-          edge_t *edge = face->edge;
-          do {
-            vert_idx[edge->vert] = 0;
-            edge = edge->next;
-          } while (edge != face->edge);
+      // counts the digits of the keys in each chunk of a range.
+      template<typename ref_t>
+      class RadixCountTask : public carve::ParallelTask {
+        const std::vector<ref_t> &refs;
+        std::vector<size_t> &counts;
+        size_t chunk;
+        unsigned shift;
+
+      public:
+        RadixCountTask(const std::vector<ref_t> &_refs, std::vector<size_t> &_counts, size_t _chunk, unsigned _shift) :
+            refs(_refs), counts(_counts), chunk(_chunk), shift(_shift) {
         }
-      }
 
-      std::vector<vertex_t> new_vertex_storage;
-      new_vertex_storage.reserve(vert_idx.size());
-      for (typename std::unordered_map<vertex_t *, size_t>::iterator
-             i = vert_idx.begin(); i != vert_idx.end(); ++i) {
-        (*i).second = new_vertex_storage.size();
-        new_vertex_storage.push_back(*(*i).first);
+        virtual void run(size_t begin, size_t end) {
+          for (size_t c = begin; c < end; ++c) {
+            size_t *count = &counts[c * RADIX_SIZE];
+            std::fill(count, count + RADIX_SIZE, (size_t)0);
+            const size_t e = std::min(refs.size(), (c + 1) * chunk);
+            for (size_t i = c * chunk; i < e; ++i) {
+              count[(refs[i].key >> shift) & (RADIX_SIZE - 1)]++;
+            }
+          }
+        }
+      };
+
+      // moves each chunk of a range to the positions given by its
+      // digit offsets, preserving order within a digit.
+      template<typename ref_t>
+      class RadixScatterTask : public carve::ParallelTask {
+        const std::vector<ref_t> &refs;
+        std::vector<ref_t> &out;
+        std::vector<size_t> &offsets;
+        size_t chunk;
+        unsigned shift;
+
+      public:
+        RadixScatterTask(const std::vector<ref_t> &_refs, std::vector<ref_t> &_out, std::vector<size_t> &_offsets, size_t _chunk, unsigned _shift) :
+            refs(_refs), out(_out), offsets(_offsets), chunk(_chunk), shift(_shift) {
+        }
+
+        virtual void run(size_t begin, size_t end) {
+          for (size_t c = begin; c < end; ++c) {
+            size_t *offset = &offsets[c * RADIX_SIZE];
+            const size_t e = std::min(refs.size(), (c + 1) * chunk);
+            for (size_t i = c * chunk; i < e; ++i) {
+              out[offset[(refs[i].key >> shift) & (RADIX_SIZE - 1)]++] = refs[i];
+            }
+          }
+        }
+      };
+
+      // stable LSD radix sort of refs by key, with each pass split
+      // into one chunk per thread of executor.
+      template<typename ref_t>
+      void radixSortRefs(std::vector<ref_t> &refs, uint64_t max_key, carve::Executor &executor) {
+        const size_t n = refs.size();
+        const size_t n_chunks = std::max((size_t)1, std::min((size_t)executor.concurrency(), n / 65536));
+        const size_t chunk = (n + n_chunks - 1) / n_chunks;
+
+        std::vector<ref_t> tmp(n);
+        std::vector<size_t> counts(n_chunks * RADIX_SIZE);
+        for (unsigned shift = 0; shift < 64 && (max_key >> shift) != 0; shift += RADIX_BITS) {
+          RadixCountTask<ref_t> count_task(refs, counts, chunk, shift);
+          carve::parallelFor(executor, n_chunks, 1, count_task);
+
+          size_t total = 0;
+          for (size_t d = 0; d < RADIX_SIZE; ++d) {
+            for (size_t c = 0; c < n_chunks; ++c) {
+              size_t k = counts[c * RADIX_SIZE + d];
+              counts[c * RADIX_SIZE + d] = total;
+              total += k;
+            }
+          }
+
+          RadixScatterTask<ref_t> scatter_task(refs, tmp, counts, chunk, shift);
+          carve::parallelFor(executor, n_chunks, 1, scatter_task);
+          refs.swap(tmp);
+        }
       }
 
-      for (size_t m = 0; m < meshes.size(); ++m) {
-        mesh_t *mesh = meshes[m];
-        for (size_t f = 0; f < mesh->faces.size(); ++f) {
-          face_t *face = mesh->faces[f];
-          edge_t *edge = face->edge;
-          do {
-            size_t i = vert_idx[edge->vert];
-            edge->vert = &new_vertex_storage[i];
-            edge = edge->next;
-          } while (edge != face->edge);
+      // copies the vertex of each run of sorted references into new
+      // storage, and points the edges of the run at the copy.
+      template<unsigned ndim>
+      class RemapVertexTask : public carve::ParallelTask {
+        const std::vector<VertexRef<ndim> > &refs;
+        const std::vector<size_t> &runs;
+        std::vector<Vertex<ndim> > &storage;
+
+      public:
+        RemapVertexTask(const std::vector<VertexRef<ndim> > &_refs,
+                        const std::vector<size_t> &_runs,
+                        std::vector<Vertex<ndim> > &_storage) :
+            refs(_refs), runs(_runs), storage(_storage) {
+        }
+
+        virtual void run(size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            storage[i].v = refs[runs[i]].edge->vert->v;
+            for (size_t j = runs[i]; j < runs[i + 1]; ++j) {
+              refs[j].edge->vert = &storage[i];
+            }
+          }
+        }
+      };
+
+      // replace the vertex storage of a meshset with a copy of each
+      // vertex that is referenced by an edge, made once per mesh that
+      // refers to it if per_mesh is true. References are radix sorted
+      // by vertex address, so that gathering vertices and remapping
+      // edges are sequential passes rather than hash table lookups.
+      template<unsigned ndim>
+      void rebuildVertexStorage(MeshSet<ndim> *meshset, bool per_mesh, carve::Executor &executor) {
+        typedef VertexRef<ndim> ref_t;
+
+        size_t n_refs = 0;
+        uintptr_t lo = ~(uintptr_t)0, hi = 0;
+        for (size_t m = 0; m < meshset->meshes.size(); ++m) {
+          const Mesh<ndim> *mesh = meshset->meshes[m];
+          for (size_t f = 0; f < mesh->faces.size(); ++f) {
+            const Face<ndim> *face = mesh->faces[f];
+            const Edge<ndim> *edge = face->edge;
+            do {
+              uintptr_t a = (uintptr_t)edge->vert;
+              lo = std::min(lo, a);
+              hi = std::max(hi, a);
+              edge = edge->next;
+            } while (edge != face->edge);
+            n_refs += face->n_edges;
+          }
         }
+
+        // references are generated in mesh order, and the sort is
+        // stable, so the references to a vertex from each mesh are
+        // contiguous.
+        std::vector<ref_t> refs(n_refs);
+        size_t r = 0;
+        for (size_t m = 0; m < meshset->meshes.size(); ++m) {
+          Mesh<ndim> *mesh = meshset->meshes[m];
+          for (size_t f = 0; f < mesh->faces.size(); ++f) {
+            Face<ndim> *face = mesh->faces[f];
+            Edge<ndim> *edge = face->edge;
+            do {
+              refs[r].key = (uint64_t)(((uintptr_t)edge->vert - lo) / sizeof(Vertex<ndim>));
+              refs[r].edge = edge;
+              ++r;
+              edge = edge->next;
+            } while (edge != face->edge);
+          }
+        }
+
+        if (n_refs) radixSortRefs(refs, (uint64_t)((hi - lo) / sizeof(Vertex<ndim>)), executor);
+
+        std::vector<size_t> runs;
+        for (size_t i = 0; i < refs.size(); ++i) {
+          if (i == 0 || refs[i].key != refs[i - 1].key ||
+              (per_mesh && refs[i].edge->face->mesh != refs[i - 1].edge->face->mesh)) {
+            runs.push_back(i);
+          }
+        }
+        runs.push_back(refs.size());
+
+        std::vector<Vertex<ndim> > storage(runs.size() - 1);
+        RemapVertexTask<ndim> task(refs, runs, storage);
+        carve::parallelFor(executor, storage.size(), 4096, task);
+
+        meshset->vertex_storage.swap(storage);
       }
+    }
+
+
 
-      std::swap(vertex_storage, new_vertex_storage);
+    template<unsigned ndim>
+    void MeshSet<ndim>::collectVertices(carve::Executor *executor) {
+      static carve::TimingName FUNC_NAME("MeshSet::collectVertices()");
+      carve::TimingBlock block(FUNC_NAME);
+
+      detail::rebuildVertexStorage(this, false, executor != NULL ? *executor : carve::defaultExecutor());
     }
 
 
@@ -1059,37 +1253,213 @@ namespace carve {
 
 
     template<unsigned ndim>
-    void MeshSet<ndim>::separateMeshes() {
-      size_t n;
-      typedef std::unordered_map<std::pair<mesh_t *, vertex_t *>, vertex_t *> vmap_t;
-      vmap_t vmap;
-      typename vmap_t::iterator vmap_iter;
+    void MeshSet<ndim>::separateMeshes(carve::Executor *executor) {
+      static carve::TimingName FUNC_NAME("MeshSet::separateMeshes()");
+      carve::TimingBlock block(FUNC_NAME);
 
-      for (face_iter i = faceBegin(); i != faceEnd(); ++i) {
-        face_t *f = *i;
-        for (typename face_t::edge_iter_t j = f->begin(); j != f->end(); ++j) {
-          edge_t &e = *j;
-          vmap[std::make_pair(f->mesh, e.vert)] = e.vert;
+      detail::rebuildVertexStorage(this, true, executor != NULL ? *executor : carve::defaultExecutor());
+    }
+
+
+
+    namespace detail {
+      // the number of bits per axis of a Morton code.
+      template<unsigned ndim>
+      unsigned mortonBits() {
+        return 63 / ndim < 21 ? 63 / ndim : 21;
+      }
+
+      // position of v along a Morton curve through the box with
+      // minimum corner lo, where scale maps the box onto the range of
+      // quantized coordinates.
+      template<unsigned ndim>
+      uint64_t mortonCode(const carve::geom::vector<ndim> &v,
+                          const carve::geom::vector<ndim> &lo,
+                          const carve::geom::vector<ndim> &scale) {
+        const unsigned bits = mortonBits<ndim>();
+        const double q_max = (double)((1U << bits) - 1);
+        uint32_t q[ndim];
+        for (unsigned d = 0; d < ndim; ++d) {
+          double x = (v.v[d] - lo.v[d]) * scale.v[d];
+          q[d] = (uint32_t)(x < 0.0 ? 0.0 : x > q_max ? q_max : x);
         }
+        uint64_t code = 0;
+        for (unsigned b = bits; b--; ) {
+          for (unsigned d = 0; d < ndim; ++d) {
+            code = (code << 1) | ((q[d] >> b) & 1U);
+          }
+        }
+        return code;
       }
+    }
 
-      std::vector<vertex_t> vout;
-      vout.reserve(vmap.size());
 
-      for (n = 0, vmap_iter = vmap.begin(); vmap_iter != vmap.end(); ++vmap_iter, ++n) {
-        vout.push_back(*(*vmap_iter).second);
-        (*vmap_iter).second = & vout.back();
+
+    template<unsigned ndim>
+    void MeshSet<ndim>::reorder(bool keep_faces) {
+      typedef typename vertex_t::vector_t vector_t;
+      const size_t N = vertex_storage.size();
+      if (!N) return;
+
+      vector_t lo = vertex_storage[0].v, hi = lo;
+      for (size_t i = 1; i < N; ++i) {
+        assign_op(lo, lo, vertex_storage[i].v, carve::util::min_functor());
+        assign_op(hi, hi, vertex_storage[i].v, carve::util::max_functor());
+      }
+      vector_t scale;
+      for (unsigned d = 0; d < ndim; ++d) {
+        double extent = hi.v[d] - lo.v[d];
+        scale.v[d] = extent > 0.0 ? (double)((1U << detail::mortonBits<ndim>()) - 1) / extent : 0.0;
+      }
+
+      // vertices.
+      std::vector<std::pair<uint64_t, size_t> > key(N);
+      for (size_t i = 0; i < N; ++i) {
+        key[i] = std::make_pair(detail::mortonCode(vertex_storage[i].v, lo, scale), i);
+      }
+      std::sort(key.begin(), key.end());
+
+      std::vector<vertex_t> vout;
+      std::vector<size_t> vmap(N);
+      vout.reserve(N);
+      for (size_t i = 0; i < N; ++i) {
+        vmap[key[i].second] = i;
+        vout.push_back(vertex_storage[key[i].second]);
       }
 
       for (face_iter i = faceBegin(); i != faceEnd(); ++i) {
-        face_t *f = *i;
-        for (typename face_t::edge_iter_t j = f->begin(); j != f->end(); ++j) {
-          edge_t &e = *j;
-          e.vert = vmap[std::make_pair(f->mesh, e.vert)];
+        edge_t *e = (*i)->edge;
+        do {
+          e->vert = &vout[vmap[(size_t)(e->vert - &vertex_storage[0])]];
+          e = e->next;
+        } while (e != (*i)->edge);
+      }
+      vertex_storage.swap(vout);
+
+      // faces, ordered by centroid. unless the caller holds face
+      // pointers, each mesh is then cloned, which allocates its faces,
+      // and the edges of each face, in order.
+      std::vector<std::pair<uint64_t, size_t> > fkey;
+      std::vector<face_t *> faces;
+      for (size_t m = 0; m < meshes.size(); ++m) {
+        mesh_t *mesh = meshes[m];
+        const size_t F = mesh->faces.size();
+        fkey.resize(F);
+        for (size_t i = 0; i < F; ++i) {
+          fkey[i] = std::make_pair(detail::mortonCode(mesh->faces[i]->centroid(), lo, scale), i);
+        }
+        std::sort(fkey.begin(), fkey.end());
+
+        faces.resize(F);
+        for (size_t i = 0; i < F; ++i) {
+          faces[i] = mesh->faces[fkey[i].second];
         }
+        mesh->faces.swap(faces);
+
+        if (keep_faces) {
+          mesh->cacheEdges();
+          continue;
+        }
+
+        mesh_t *r = mesh->clone(&vertex_storage[0], &vertex_storage[0]);
+        r->cacheEdges();
+        r->meshset = this;
+        meshes[m] = r;
+        delete mesh;
       }
+    }
 
-      vertex_storage.swap(vout);
+
+
+    namespace detail {
+      // applies x' = A x + t to a range of vertices.
+      class AffineVertexTask : public carve::ParallelTask {
+        Vertex<3> *verts;
+        double a[3][3], t[3];
+
+      public:
+        AffineVertexTask(Vertex<3> *_verts, const carve::math::Matrix &m) : verts(_verts) {
+          a[0][0] = m._11; a[0][1] = m._21; a[0][2] = m._31; t[0] = m._41;
+          a[1][0] = m._12; a[1][1] = m._22; a[1][2] = m._32; t[1] = m._42;
+          a[2][0] = m._13; a[2][1] = m._23; a[2][2] = m._33; t[2] = m._43;
+        }
+
+        virtual void run(size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            double *v = verts[i].v.v;
+            const double x = v[0], y = v[1], z = v[2];
+            v[0] = a[0][0] * x + a[0][1] * y + a[0][2] * z + t[0];
+            v[1] = a[1][0] * x + a[1][1] * y + a[1][2] * z + t[1];
+            v[2] = a[2][0] * x + a[2][1] * y + a[2][2] * z + t[2];
+          }
+        }
+      };
+
+      // maps the plane of each face of a range. Normals are
+      // transformed by the cofactor matrix of A, which keeps them
+      // consistent with the winding of the transformed vertices even
+      // when A is a reflection. Faces whose normal collapses are
+      // refitted to their (already transformed) vertices.
+      class AffinePlaneTask : public carve::ParallelTask {
+        Face<3> **faces;
+        const carve::math::Matrix &m;
+        double c[3][3];
+
+      public:
+        AffinePlaneTask(Face<3> **_faces, const carve::math::Matrix &_m) : faces(_faces), m(_m) {
+          const double a11 = m._11, a12 = m._21, a13 = m._31;
+          const double a21 = m._12, a22 = m._22, a23 = m._32;
+          const double a31 = m._13, a32 = m._23, a33 = m._33;
+          c[0][0] = a22 * a33 - a23 * a32; c[0][1] = a23 * a31 - a21 * a33; c[0][2] = a21 * a32 - a22 * a31;
+          c[1][0] = a13 * a32 - a12 * a33; c[1][1] = a11 * a33 - a13 * a31; c[1][2] = a12 * a31 - a11 * a32;
+          c[2][0] = a12 * a23 - a13 * a22; c[2][1] = a13 * a21 - a11 * a23; c[2][2] = a11 * a22 - a12 * a21;
+        }
+
+        virtual void run(size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            Face<3> *face = faces[i];
+            const carve::geom::vector<3> &N = face->plane.N;
+            carve::geom::vector<3> N2 = carve::geom::VECTOR(
+                c[0][0] * N.x + c[0][1] * N.y + c[0][2] * N.z,
+                c[1][0] * N.x + c[1][1] * N.y + c[1][2] * N.z,
+                c[2][0] * N.x + c[2][1] * N.y + c[2][2] * N.z);
+            double l = N2.length();
+            if (!(l > 0.0)) {
+              face->recalc();
+              continue;
+            }
+            N2 /= l;
+            // -d * N is the point of the old plane closest to the origin.
+            face->setPlane(carve::geom::plane<3>(N2, m * (-face->plane.d * N)));
+          }
+        }
+      };
+    }
+
+
+
+    template<>
+    inline void MeshSet<3>::transform(const carve::math::Matrix &matrix, carve::Executor *executor) {
+      static carve::TimingName FUNC_NAME("MeshSet::transform(Matrix)");
+      carve::TimingBlock block(FUNC_NAME);
+
+      carve::Executor &exec = executor != NULL ? *executor : carve::defaultExecutor();
+
+      if (vertex_storage.size()) {
+        detail::AffineVertexTask vtask(&vertex_storage[0], matrix);
+        carve::parallelFor(exec, vertex_storage.size(), 4096, vtask);
+      }
+
+      std::vector<face_t *> faces;
+      for (face_iter i = faceBegin(); i != faceEnd(); ++i) faces.push_back(*i);
+      if (faces.size()) {
+        detail::AffinePlaneTask ftask(&faces[0], matrix);
+        carve::parallelFor(exec, faces.size(), 1024, ftask);
+      }
+
+      for (size_t i = 0; i < meshes.size(); ++i) {
+        meshes[i]->calcOrientation();
+      }
     }
 
   }
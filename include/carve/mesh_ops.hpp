@@ -936,6 +936,10 @@ namespace carve {
       detail::link(t1[0], t2[2], t1[1], f1);
       detail::link(t2[0], t1[2], t2[1], f2);
 
+      // link() refits both faces, but the shape of the mesh has changed.
+      if (f1->mesh) f1->mesh->invalidate();
+      if (f2->mesh) f2->mesh->invalidate();
+
       if (t1[0]->rev) CARVE_ASSERT(t1[0]->v2() == t1[0]->rev->v1());
       if (t2[0]->rev) CARVE_ASSERT(t2[0]->v2() == t2[0]->rev->v1());
       if (t1[2]->rev) CARVE_ASSERT(t1[2]->v2() == t1[2]->rev->v1());
@@ -0,0 +1,163 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#pragma once
+
+#include <carve/carve.hpp>
+#include <carve/geom.hpp>
+#include <carve/aabb.hpp>
+#include <carve/mesh.hpp>
+#include <carve/executor.hpp>
+
+#include <vector>
+#include <limits>
+
+namespace carve {
+  namespace mesh {
+
+    /**
+     * \brief A ray-face intersection.
+     *
+     * The hit point is
+     * (1 - u - v) * vertex[0]->v + u * vertex[1]->v + v * vertex[2]->v,
+     * where vertex[] is the triangle of the (triangulated) face that
+     * was hit. For a triangular face, vertex[] are the face vertices
+     * in order. The point is also ray.v + t * ray.D, so t is a
+     * distance when the ray direction is of unit length.
+     */
+    struct RayHit {
+      const Face<3> *face;
+      const Vertex<3> *vertex[3];
+      double t;
+      double u, v;
+
+      RayHit() : face(NULL), t(0.0), u(0.0), v(0.0) {
+        vertex[0] = vertex[1] = vertex[2] = NULL;
+      }
+
+      bool isHit() const { return face != NULL; }
+
+      bool operator<(const RayHit &other) const { return t < other.t; }
+    };
+
+
+
+    /**
+     * \class RayCaster
+     * \brief Intersects batches of rays with the faces of a MeshSet.
+     *
+     * Faces are triangulated once, and the face RTree is flattened
+     * into a preorder node array. Rays are traced in packets of
+     * PACKET_SIZE consecutive rays, which descend the tree together,
+     * so rays that are coherent (close in origin and direction) should
+     * be adjacent in the input. Ray-box and ray-triangle tests are
+     * evaluated for a whole packet at a time. Packets are distributed
+     * over threads by the caster's executor, and the results do not
+     * depend on the number of threads.
+     *
+     * Faces are two sided. The meshset must outlive the RayCaster, and
+     * must not be modified while it is in use.
+     */
+    class RayCaster {
+    public:
+      enum { PACKET_SIZE = 8 };
+
+      typedef MeshSet<3> meshset_t;
+      typedef carve::geom::ray<3> ray_t;
+
+      struct Node {
+        carve::geom::vector<3> lo, hi;
+        // index of the next node that is not a descendant of this one.
+        uint32_t skip;
+        // range of triangles, for a leaf.
+        uint32_t begin, end;
+        bool is_leaf;
+      };
+
+      struct Triangle {
+        carve::geom::vector<3> v0, e1, e2;
+      };
+
+    private:
+      std::vector<Node> nodes;
+      std::vector<Triangle> tris;
+      std::vector<const Face<3> *> tri_face;
+      std::vector<const Vertex<3> *> tri_vert;
+
+      RayCaster(const RayCaster &);
+      RayCaster &operator=(const RayCaster &);
+
+      template<typename node_t>
+      void flatten(const node_t *node);
+
+      void addFace(const Face<3> *face);
+      void makeHit(unsigned tri, double t, double u, double v, RayHit &hit) const;
+
+      class FirstHitsTask;
+      class AllHitsTask;
+
+      template<typename visitor_t>
+      void trace(const ray_t *rays, size_t n_rays, double *t_max, visitor_t &visit) const;
+
+      carve::Executor &getExecutor() const {
+        return executor != NULL ? *executor : carve::defaultExecutor();
+      }
+
+    public:
+      carve::Executor *executor; /**< If not NULL, runs ray queries. Otherwise carve::defaultExecutor() is used. Not owned. */
+
+      RayCaster(const meshset_t *meshset, carve::Executor *_executor = NULL);
+
+      size_t triangleCount() const {
+        return tris.size();
+      }
+
+      const std::vector<Node> &getNodes() const {
+        return nodes;
+      }
+
+      const std::vector<Triangle> &getTriangles() const {
+        return tris;
+      }
+
+      /**
+       * Find the nearest intersection of each ray with a face, at
+       * distance (in units of ray.D) in [0, t_max]. hits[i] is the
+       * first hit of rays[i], and isHit() is false for rays that miss.
+       */
+      void firstHits(const std::vector<ray_t> &rays,
+                     std::vector<RayHit> &hits,
+                     double t_max = std::numeric_limits<double>::infinity()) const;
+
+      /**
+       * Find all intersections of each ray with the faces, at distance
+       * in [0, t_max]. The hits of rays[i] are
+       * hits[offsets[i], offsets[i + 1]), in order of increasing
+       * distance. Each face is reported at most once per ray.
+       */
+      void allHits(const std::vector<ray_t> &rays,
+                   std::vector<size_t> &offsets,
+                   std::vector<RayHit> &hits,
+                   double t_max = std::numeric_limits<double>::infinity()) const;
+
+      bool firstHit(const ray_t &ray,
+                    RayHit &hit,
+                    double t_max = std::numeric_limits<double>::infinity()) const;
+    };
+
+  }
+}
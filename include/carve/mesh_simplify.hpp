@@ -23,6 +23,9 @@
 #include <carve/geom2d.hpp>
 #include <carve/heap.hpp>
 #include <carve/rtree.hpp>
+#include <carve/djset.hpp>
+#include <carve/executor.hpp>
+#include <carve/triangulator.hpp>
 #include <carve/triangle_intersection.hpp>
 
 #include <fstream>
@@ -798,6 +801,10 @@ namespace carve {
           v2->v = merge;
           ++n_mods;
 
+          for (std::set<face_t *>::iterator i = affected_faces.begin(); i != affected_faces.end(); ++i) {
+            (*i)->invalidate();
+          }
+
           for (size_t i = 0; i < v1_incident.size(); ++i) {
             if (v1_incident[i]->edge->vert == v1) {
               v1_incident[i]->edge->vert = v2;
@@ -908,6 +915,257 @@ namespace carve {
 
 
 
+      typedef std::unordered_map<const face_t *, size_t> face_region_map_t;
+
+      // A region of faces joined across edges between coplanar faces,
+      // and the loop of edges that will bound the single face that
+      // replaces it. The loop is empty if the region is to be left as
+      // it is.
+      struct CoplanarRegion {
+        std::vector<face_t *> faces;
+        std::vector<edge_t *> loop;
+      };
+
+
+
+      static bool interiorEdge(const edge_t *e, size_t region, const face_region_map_t &face_region) {
+        return e->rev != NULL && (*face_region.find(e->rev->face)).second == region;
+      }
+
+
+
+      // Find the boundary of a region without modifying the mesh. The
+      // boundary edges of each loop keep their direction, so an outer
+      // loop has the orientation of the faces and a hole the opposite.
+      // Holes are joined to the outer loop by pairs of new bridging
+      // edges.
+      static void findRegionLoop(CoplanarRegion &region, size_t r, const face_region_map_t &face_region) {
+        std::vector<edge_t *> boundary;
+        size_t n_edges = 0;
+        for (size_t i = 0; i < region.faces.size(); ++i) {
+          edge_t *e = region.faces[i]->edge;
+          do {
+            if (!interiorEdge(e, r, face_region)) boundary.push_back(e);
+            ++n_edges;
+            e = e->next;
+          } while (e != region.faces[i]->edge);
+        }
+        if (boundary.empty()) return;
+
+        std::unordered_set<edge_t *> unvisited;
+        unvisited.insert(boundary.begin(), boundary.end());
+        std::vector<std::vector<edge_t *> > loops;
+        for (size_t i = 0; i < boundary.size(); ++i) {
+          if (!unvisited.count(boundary[i])) continue;
+          loops.push_back(std::vector<edge_t *>());
+          std::vector<edge_t *> &loop = loops.back();
+          edge_t *e = boundary[i];
+          do {
+            if (!unvisited.erase(e)) return;
+            loop.push_back(e);
+            // the next boundary edge is found by turning about the end
+            // vertex of e, across the interior edges that leave it.
+            edge_t *n = e->next;
+            for (size_t guard = 0; interiorEdge(n, r, face_region); n = n->rev->next) {
+              if (++guard > n_edges) return;
+            }
+            e = n;
+          } while (e != boundary[i]);
+          if (loop.size() < 3) return;
+        }
+
+        if (loops.size() == 1) {
+          region.loop.swap(loops[0]);
+          return;
+        }
+
+        // an outer loop has the same orientation, in projection, as the
+        // faces of the region.
+        face_t *ref = region.faces[0];
+        face_t::projection_mapping proj(ref->project);
+        bool ref_positive = carve::geom2d::signedArea(ref->begin(), ref->end(), proj) > 0.0;
+        size_t outer = loops.size();
+        for (size_t i = 0; i < loops.size(); ++i) {
+          if ((carve::geom2d::signedArea(loops[i].begin(), loops[i].end(), proj) > 0.0) == ref_positive) {
+            if (outer != loops.size()) return;
+            outer = i;
+          }
+        }
+        if (outer == loops.size()) return;
+
+        typedef std::pair<vertex_t *, vertex_t *> vpair_t;
+        std::unordered_map<vpair_t, edge_t *> boundary_edges;
+        std::vector<vertex_t *> f_loop;
+        std::vector<std::vector<vertex_t *> > h_loops;
+        for (size_t i = 0; i < loops.size(); ++i) {
+          std::vector<vertex_t *> verts;
+          for (size_t j = 0; j < loops[i].size(); ++j) {
+            edge_t *e = loops[i][j];
+            verts.push_back(e->v1());
+            boundary_edges[vpair_t(e->v1(), e->v2())] = e;
+          }
+          if (i == outer) {
+            f_loop.swap(verts);
+          } else {
+            h_loops.push_back(verts);
+          }
+        }
+
+        std::vector<vertex_t *> merged = carve::triangulate::incorporateHolesIntoPolygon(proj, f_loop, h_loops);
+
+        // every boundary edge must be used once, and every bridge must
+        // be traversed once in each direction.
+        std::vector<edge_t *> loop;
+        std::vector<edge_t *> bridges;
+        std::unordered_map<vpair_t, edge_t *> unpaired;
+        bool ok = true;
+        for (size_t i = 0; ok && i < merged.size(); ++i) {
+          vertex_t *a = merged[i];
+          vertex_t *b = merged[(i + 1) % merged.size()];
+          if (a == b) {
+            ok = false;
+            break;
+          }
+          std::unordered_map<vpair_t, edge_t *>::iterator j = boundary_edges.find(vpair_t(a, b));
+          if (j != boundary_edges.end()) {
+            loop.push_back((*j).second);
+            boundary_edges.erase(j);
+            continue;
+          }
+          edge_t *bridge = new edge_t(a, NULL);
+          bridges.push_back(bridge);
+          loop.push_back(bridge);
+          j = unpaired.find(vpair_t(b, a));
+          if (j != unpaired.end()) {
+            bridge->rev = (*j).second;
+            (*j).second->rev = bridge;
+            unpaired.erase(j);
+          } else if (!unpaired.insert(std::make_pair(vpair_t(a, b), bridge)).second) {
+            ok = false;
+          }
+        }
+
+        if (!ok || boundary_edges.size() || unpaired.size()) {
+          for (size_t i = 0; i < bridges.size(); ++i) delete bridges[i];
+          return;
+        }
+        region.loop.swap(loop);
+      }
+
+
+
+      // Replace the faces of a region with a single face bounded by
+      // its loop. Only the edges of the region's faces are modified.
+      static size_t mergeRegion(CoplanarRegion &region) {
+        if (region.loop.empty()) return 0;
+
+        std::unordered_set<edge_t *> keep;
+        keep.insert(region.loop.begin(), region.loop.end());
+        std::vector<edge_t *> removed;
+        for (size_t i = 0; i < region.faces.size(); ++i) {
+          face_t *f = region.faces[i];
+          edge_t *e = f->edge;
+          do {
+            if (!keep.count(e)) removed.push_back(e);
+            e = e->next;
+          } while (e != f->edge);
+        }
+        for (size_t i = 0; i < region.faces.size(); ++i) {
+          region.faces[i]->edge = NULL;
+          region.faces[i]->n_edges = 0;
+        }
+
+        face_t *face = region.faces[0];
+        const size_t n = region.loop.size();
+        for (size_t i = 0; i < n; ++i) {
+          edge_t *e = region.loop[i];
+          edge_t *next = region.loop[(i + 1) % n];
+          e->next = next;
+          next->prev = e;
+          e->face = face;
+        }
+        face->edge = region.loop[0];
+        face->n_edges = n;
+        face->recalc();
+
+        for (size_t i = 0; i < removed.size(); ++i) delete removed[i];
+        return region.faces.size() - 1;
+      }
+
+
+
+      struct CoplanarRegionTask : public carve::ParallelTask {
+        std::vector<CoplanarRegion> &regions;
+        const std::vector<size_t> &todo;
+        const face_region_map_t &face_region;
+        bool apply;
+        std::vector<size_t> &n_removed;
+
+        CoplanarRegionTask(std::vector<CoplanarRegion> &_regions,
+                           const std::vector<size_t> &_todo,
+                           const face_region_map_t &_face_region,
+                           bool _apply,
+                           std::vector<size_t> &_n_removed) :
+            regions(_regions), todo(_todo), face_region(_face_region), apply(_apply), n_removed(_n_removed) {
+        }
+
+        virtual void run(size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            if (apply) {
+              n_removed[i] = mergeRegion(regions[todo[i]]);
+            } else {
+              findRegionLoop(regions[todo[i]], todo[i], face_region);
+            }
+          }
+        }
+      };
+
+
+
+      size_t mergeCoplanarRegions(mesh_t *mesh, double min_normal_angle, carve::Executor &executor) {
+        double min_dp = cos(min_normal_angle);
+
+        face_region_map_t face_region;
+        for (size_t i = 0; i < mesh->faces.size(); ++i) {
+          face_region[mesh->faces[i]] = i;
+        }
+
+        carve::djset::djset dj(mesh->faces.size());
+        for (size_t i = 0; i < mesh->closed_edges.size(); ++i) {
+          edge_t *e = mesh->closed_edges[i];
+          if (carve::geom::dot(e->face->plane.N, e->rev->face->plane.N) < min_dp) continue;
+          dj.merge_sets(face_region[e->face], face_region[e->rev->face]);
+        }
+
+        std::vector<size_t> region_of, region_size;
+        dj.get_index_to_set(region_of, region_size);
+
+        std::vector<CoplanarRegion> regions(region_size.size());
+        for (size_t i = 0; i < mesh->faces.size(); ++i) {
+          face_region[mesh->faces[i]] = region_of[i];
+          regions[region_of[i]].faces.push_back(mesh->faces[i]);
+        }
+
+        std::vector<size_t> todo;
+        for (size_t i = 0; i < regions.size(); ++i) {
+          if (regions[i].faces.size() > 1) todo.push_back(i);
+        }
+
+        // all loops are found before any region is modified, because
+        // finding them looks at the faces of neighbouring regions.
+        std::vector<size_t> n_removed(todo.size(), 0);
+        CoplanarRegionTask find_task(regions, todo, face_region, false, n_removed);
+        carve::parallelFor(executor, todo.size(), 16, find_task);
+        CoplanarRegionTask merge_task(regions, todo, face_region, true, n_removed);
+        carve::parallelFor(executor, todo.size(), 16, merge_task);
+
+        size_t total = 0;
+        for (size_t i = 0; i < n_removed.size(); ++i) total += n_removed[i];
+        return total;
+      }
+
+
+
       uint8_t affected_axes(const face_t *face) {
         uint8_t r = 0;
         if (fabs(carve::geom::dot(face->plane.N, carve::geom::VECTOR(1,0,0))) > 0.001) r |= 1;
@@ -1177,6 +1435,27 @@ namespace carve {
         return n_removed;
       }
 
+      // Merge coplanar faces as mergeCoplanarFaces() does, but a
+      // region of faces at a time: regions are found with union-find,
+      // and each is rebuilt as one face from its boundary loops, so the
+      // time taken is linear in the size of the mesh. Holes in a region
+      // are joined to its outer boundary by bridging edges. A region
+      // whose boundary does not resolve into a single outer loop is
+      // left unmerged. Regions are processed in parallel on
+      // \a executor, or carve::defaultExecutor() if it is NULL.
+      // Returns the number of faces removed.
+      size_t mergeCoplanarRegions(meshset_t *meshset, double min_normal_angle, carve::Executor *executor = NULL) {
+        carve::Executor &exec = executor != NULL ? *executor : carve::defaultExecutor();
+        size_t n_removed = 0;
+        for (size_t i = 0; i < meshset->meshes.size(); ++i) {
+          n_removed += mergeCoplanarRegions(meshset->meshes[i], min_normal_angle, exec);
+          removeRemnantFaces(meshset->meshes[i]);
+          cleanFaceEdges(meshset->meshes[i]);
+          meshset->meshes[i]->cacheEdges();
+        }
+        return n_removed;
+      }
+
       size_t improveMesh_conservative(meshset_t *meshset) {
         initEdgeInfo(meshset);
         size_t modifications = flipEdges(meshset, FlippableConservative());
@@ -1336,6 +1615,10 @@ namespace carve {
             vert->v = v_best;
           }
         }
+
+        // snapFaces() only refits the faces around each snapped
+        // region, and the loop above moves vertices without refitting.
+        meshset->invalidate();
       }
 
 
@@ -1556,6 +1839,9 @@ namespace carve {
 
             if (n_intersections == 0) {
               vert->v = q_pt;
+              for (std::set<face_t *>::iterator f = qi.faces.begin(); f != qi.faces.end(); ++f) {
+                (*f)->invalidate();
+              }
               quantized.push_back((*i).first);
               tree->updateExtents(aabb);
             }
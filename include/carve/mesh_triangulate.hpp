@@ -0,0 +1,55 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#pragma once
+
+#include <carve/carve.hpp>
+#include <carve/mesh.hpp>
+#include <carve/executor.hpp>
+
+namespace carve {
+  namespace mesh {
+
+    /**
+     * \brief Triangulate, in place, every face of a MeshSet that has
+     *        more than three edges.
+     *
+     * Each polygon is replaced by triangles that reuse its boundary
+     * edges, so the rev links between neighbouring faces are kept,
+     * and the new internal edges are linked to each other. The first
+     * triangle of a polygon reuses its Face object; the others are
+     * inserted into the mesh directly after it, and share its id.
+     * Vertices are not changed.
+     *
+     * Quads are split along the shorter diagonal that gives two
+     * correctly oriented triangles. Other faces are triangulated by
+     * ear clipping in the face's projection, and if \a improve is set,
+     * the result is improved by minimising the length of internal
+     * edges. A face that cannot be triangulated is left as it is.
+     *
+     * Faces are processed in parallel on \a executor (or
+     * carve::defaultExecutor() if it is NULL), and the result does not
+     * depend on the number of threads.
+     *
+     * @return The number of faces that were triangulated.
+     */
+    size_t triangulateFaces(MeshSet<3> *meshset,
+                            bool improve = false,
+                            carve::Executor *executor = NULL);
+
+  }
+}
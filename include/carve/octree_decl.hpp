@@ -56,6 +56,9 @@ namespace carve {
 
         carve::geom3d::AABB aabb;
 
+        // bounding boxes of the children, filled by split().
+        carve::geom3d::AABBBatch child_aabbs;
+
         Node();
 
         Node(const carve::geom3d::Vector &newMin, const carve::geom3d::Vector &newMax);
@@ -66,6 +69,9 @@ namespace carve {
         bool mightContain(const carve::poly::Geometry<3>::face_t &face);
         bool mightContain(const carve::poly::Geometry<3>::edge_t &edge);
         bool mightContain(const carve::poly::Geometry<3>::vertex_t &p);
+        // Return a mask with bit i set if children[i]->aabb intersects box.
+        unsigned childrenIntersecting(const carve::geom::aabb<3> &box) const;
+
         bool hasChildren();
         bool hasGeometry();
 
@@ -130,12 +136,29 @@ namespace carve {
                        std::vector<const carve::poly::Geometry<3>::face_t *> &out,
                        unsigned depth) const;
 
+      // As doFindEdges() and doFindFaces(), for a node already known
+      // to intersect aabb. Children are selected with a batched box test.
+      void doFindEdgesInside(const carve::geom::aabb<3> &aabb,
+                             Node *node,
+                             std::vector<const carve::poly::Geometry<3>::edge_t *> &out,
+                             unsigned depth) const;
+      void doFindFacesInside(const carve::geom::aabb<3> &aabb,
+                             Node *node,
+                             std::vector<const carve::poly::Geometry<3>::face_t *> &out,
+                             unsigned depth) const;
+
 
 
       void doFindVerticesAllowDupes(const carve::geom3d::Vector &v,
                                     Node *node,
                                     std::vector<const carve::poly::Geometry<3>::vertex_t *> &out,
                                     unsigned depth) const;
+      // As doFindVerticesAllowDupes(), with the point given as a box of
+      // zero extent that is already known to lie inside node.
+      void doFindVerticesInside(const carve::geom::aabb<3> &aabb,
+                                Node *node,
+                                std::vector<const carve::poly::Geometry<3>::vertex_t *> &out,
+                                unsigned depth) const;
 
       void findVerticesNearAllowDupes(const carve::geom3d::Vector &v,
                                       std::vector<const carve::poly::Geometry<3>::vertex_t *> &out) const;
@@ -0,0 +1,151 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#pragma once
+
+#include <carve/carve.hpp>
+#include <carve/geom3d.hpp>
+#include <carve/pointset.hpp>
+#include <carve/executor.hpp>
+
+#include <vector>
+
+namespace carve {
+  namespace point {
+
+    /**
+     * \class KdTree
+     * \brief A static kd-tree over a set of points, packed into flat
+     *        arrays, for bulk nearest neighbour and radius queries.
+     *
+     * Unlike carve::geom::kd_node, the tree is built once, by median
+     * splits on the axis of greatest extent, and is not modified
+     * afterwards. Nodes are stored in preorder, so the left child of
+     * a node immediately follows it, and the points of each leaf are
+     * contiguous. Construction and the batched queries run on the
+     * tree's executor; results do not depend on the number of
+     * threads.
+     *
+     * Query results are indices into the point array the tree was
+     * built from (PointSet::vertices, for a PointSet).
+     */
+    class KdTree {
+    public:
+      enum { LEAF_SIZE = 8 };
+
+      struct Node {
+        double split;
+        // index of the right child; the left child is this + 1.
+        uint32_t right;
+        // range of points, for a leaf.
+        uint32_t begin, end;
+        // split axis, or -1 for a leaf.
+        int axis;
+
+        bool isLeaf() const { return axis < 0; }
+      };
+
+    private:
+      std::vector<Node> nodes;
+      // points, in leaf order.
+      std::vector<carve::geom3d::Vector> points;
+      // maps leaf order to input order.
+      std::vector<uint32_t> index;
+
+      typedef std::vector<std::pair<double, uint32_t> > heap_t;
+
+      class BuildTask;
+      class GatherTask;
+      class NearestTask;
+      class RadiusTask;
+
+      KdTree(const KdTree &);
+      KdTree &operator=(const KdTree &);
+
+      void build(const std::vector<carve::geom3d::Vector> &input);
+      uint32_t splitNode(size_t node, uint32_t begin, uint32_t end, const std::vector<carve::geom3d::Vector> &input);
+      void buildNode(size_t node, uint32_t begin, uint32_t end, const std::vector<carve::geom3d::Vector> &input);
+
+      void search(const carve::geom3d::Vector &p, size_t k, heap_t &heap) const;
+      void search(const carve::geom3d::Vector &p, double r2, std::vector<size_t> &out_idx) const;
+
+      carve::Executor &getExecutor() const {
+        return executor != NULL ? *executor : carve::defaultExecutor();
+      }
+
+    public:
+      carve::Executor *executor; /**< If not NULL, runs construction and batched queries. Otherwise carve::defaultExecutor() is used. Not owned. */
+
+      KdTree(const PointSet &pointset, carve::Executor *_executor = NULL);
+      KdTree(const std::vector<carve::geom3d::Vector> &points, carve::Executor *_executor = NULL);
+
+      size_t size() const {
+        return points.size();
+      }
+
+      const std::vector<Node> &getNodes() const {
+        return nodes;
+      }
+
+      /**
+       * Find the \a k points nearest to \a p.
+       *
+       * @param[in] p The query point.
+       * @param[in] k The number of neighbours to find.
+       * @param[out] out_idx The indices of the min(k, size()) nearest
+       *             points, ordered by increasing distance.
+       * @param[out] out_dist2 If not NULL, the corresponding squared
+       *             distances.
+       */
+      void nearest(const carve::geom3d::Vector &p,
+                   size_t k,
+                   std::vector<size_t> &out_idx,
+                   std::vector<double> *out_dist2 = NULL) const;
+
+      /**
+       * Find the points within distance \a r of \a p (inclusive), in
+       * no particular order.
+       */
+      void withinRadius(const carve::geom3d::Vector &p,
+                        double r,
+                        std::vector<size_t> &out_idx) const;
+
+      /**
+       * Batched k nearest neighbour query. Results for query i occupy
+       * out_idx[i * stride, (i + 1) * stride), where stride = min(k,
+       * size()) is returned, ordered by increasing distance.
+       */
+      size_t nearest(const std::vector<carve::geom3d::Vector> &queries,
+                     size_t k,
+                     std::vector<size_t> &out_idx,
+                     std::vector<double> *out_dist2 = NULL) const;
+
+      /**
+       * Batched radius query. Results for query i occupy
+       * out_idx[out_offsets[i], out_offsets[i + 1]).
+       */
+      void withinRadius(const std::vector<carve::geom3d::Vector> &queries,
+                        double r,
+                        std::vector<size_t> &out_offsets,
+                        std::vector<size_t> &out_idx) const;
+
+      // The number of nodes in a tree over n points.
+      static size_t nodeCount(size_t n);
+    };
+
+  }
+}
@@ -22,7 +22,7 @@
 #include <carve/geom3d.hpp>
 
 #include <carve/polyhedron_base.hpp>
-#include <carve/octree_decl.hpp>
+#include <carve/linear_octree.hpp>
 #include <carve/collection_types.hpp>
 
 #include <assert.h>
@@ -79,7 +79,7 @@ namespace carve {
       std::vector<bool> manifold_is_negative;
 
       carve::geom3d::AABB aabb;
-      carve::csg::Octree octree;
+      carve::csg::LinearOctree octree;
 
 
 
@@ -0,0 +1,115 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#pragma once
+
+#include <carve/carve.hpp>
+#include <carve/mesh.hpp>
+#include <carve/polyline.hpp>
+#include <carve/rtree.hpp>
+#include <carve/executor.hpp>
+
+#include <vector>
+
+namespace carve {
+  namespace mesh {
+
+    /**
+     * \class PolylineClipper
+     * \brief Splits the polylines of a PolylineSet where they cross
+     * the surface of a MeshSet, and classifies the pieces as inside or
+     * outside.
+     *
+     * Crossings of each polyline edge are found by searching the face
+     * RTree of the meshset with the edge. Along a polyline, the class
+     * of a piece follows from the direction in which the surface was
+     * crossed at its start (against the face normal when entering,
+     * with it when leaving), so a point needs to be classified with a
+     * ray cast only for the first piece of an open polyline, and after
+     * crossings that are not clean: through an edge or vertex of the
+     * surface, tangent to a face, or at several coincident faces.
+     *
+     * Polylines are processed in parallel, and the result does not
+     * depend on the number of threads. The meshset should be closed
+     * and consistently oriented, and must outlive the clipper.
+     */
+    class PolylineClipper {
+    public:
+      typedef MeshSet<3> meshset_t;
+      typedef carve::geom::RTreeNode<3, Face<3> *> face_rtree_t;
+
+      /**
+       * \brief A maximal run of a polyline in which all points have
+       * the same class.
+       *
+       * Positions along a polyline are given as the index of an edge
+       * plus the fraction of the way along it. For a closed polyline,
+       * a piece that wraps around the start has \a end greater than
+       * the number of edges.
+       */
+      struct Piece {
+        size_t line;  /**< Index of the polyline, in the order of PolylineSet::lines. */
+        double begin, end;
+        carve::PointClass cls; /**< POINT_IN, POINT_OUT, or POINT_ON for a piece that lies in the surface. */
+        bool closed;  /**< True if the piece is a whole closed polyline. */
+
+        Piece(size_t _line, double _begin, double _end, carve::PointClass _cls, bool _closed = false) :
+            line(_line), begin(_begin), end(_end), cls(_cls), closed(_closed) {
+        }
+      };
+
+    private:
+      const meshset_t *meshset;
+      face_rtree_t *face_rtree;
+
+      PolylineClipper(const PolylineClipper &);
+      PolylineClipper &operator=(const PolylineClipper &);
+
+      class ClipTask;
+
+      void clipLine(size_t index, const carve::line::Polyline *line, std::vector<Piece> &pieces) const;
+      carve::PointClass classify(const carve::geom3d::Vector &v) const;
+
+    public:
+      carve::Executor *executor; /**< If not NULL, runs the polylines of each call. Otherwise carve::defaultExecutor() is used. Not owned. */
+
+      PolylineClipper(const meshset_t *meshset);
+      ~PolylineClipper();
+
+      /**
+       * Split each polyline of \a lines at its crossings with the
+       * surface. The pieces of each polyline are appended to
+       * \a pieces in order along it, and the pieces of one polyline
+       * follow those of the previous one.
+       */
+      void classify(const carve::line::PolylineSet &lines, std::vector<Piece> &pieces) const;
+
+      /**
+       * Split each polyline of \a lines at its crossings with the
+       * surface, and return the pieces that are inside and outside as
+       * two new PolylineSets, either of which may be NULL if it is not
+       * wanted. Pieces that lie in the surface are not returned.
+       */
+      void clip(const carve::line::PolylineSet &lines,
+                carve::line::PolylineSet **inside,
+                carve::line::PolylineSet **outside) const;
+
+      /// The position of parameter \a t along \a line.
+      static carve::geom3d::Vector point(const carve::line::Polyline *line, double t);
+    };
+
+  }
+}
@@ -30,6 +30,45 @@
 namespace carve {
   namespace geom {
 
+    namespace detail {
+
+      // The bounding boxes of the children of an RTree node, tested
+      // against a query box in blocks of four. 3-dimensional trees
+      // keep them in an AABBBatch; other dimensions test each box in
+      // turn.
+      template<unsigned ndim>
+      class rtree_child_aabbs {
+        std::vector<aabb<ndim> > boxes;
+
+      public:
+        void clear() { boxes.clear(); }
+        void push_back(const aabb<ndim> &box) { boxes.push_back(box); }
+
+        // bit j is set if child 4 * block + j intersects box.
+        unsigned blockMask(size_t block, const aabb<ndim> &box) const {
+          unsigned mask = 0;
+          for (size_t j = 0; j < 4 && block * 4 + j < boxes.size(); ++j) {
+            if (boxes[block * 4 + j].intersects(box)) mask |= 1U << j;
+          }
+          return mask;
+        }
+      };
+
+      template<>
+      class rtree_child_aabbs<3> {
+        carve::geom3d::AABBBatch boxes;
+
+      public:
+        void clear() { boxes.clear(); }
+        void push_back(const aabb<3> &box) { boxes.push_back(box); }
+
+        unsigned blockMask(size_t block, const aabb<3> &box) const {
+          return boxes.blockMask(block, box);
+        }
+      };
+
+    }
+
     template<unsigned ndim,
              typename data_t,
              typename aabb_calc_t = carve::geom::get_aabb<ndim, data_t> >
@@ -43,6 +82,9 @@ namespace carve {
       node_t *sibling;
       std::vector<data_t> data;
 
+      // the bounding boxes of child and its siblings, in list order.
+      detail::rtree_child_aabbs<ndim> child_aabbs;
+
       aabb_t getAABB() const { return bbox; }
 
       struct data_aabb_t {
@@ -92,6 +134,14 @@ namespace carve {
           curr = curr->sibling;
         }
         bbox.fit(begin, end);
+        _updateChildAABBs();
+      }
+
+      void _updateChildAABBs() {
+        child_aabbs.clear();
+        for (node_t *node = child; node; node = node->sibling) {
+          child_aabbs.push_back(node->bbox);
+        }
       }
 
       // Search the rtree for objects that intersect obj (generally an aabb).
@@ -108,6 +158,29 @@ namespace carve {
         }
       }
 
+      // Search the rtree for objects that intersect an aabb. The
+      // children of each node are tested against obj in blocks.
+      template<typename out_iter_t>
+      void search(const aabb_t &obj, out_iter_t out) const {
+        if (!bbox.intersects(obj)) return;
+        _searchInside(obj, out);
+      }
+
+      template<typename out_iter_t>
+      void _searchInside(const aabb_t &obj, out_iter_t out) const {
+        if (child) {
+          const node_t *node = child;
+          for (size_t block = 0; node; ++block) {
+            const unsigned mask = child_aabbs.blockMask(block, obj);
+            for (unsigned j = 0; j < 4 && node; ++j, node = node->sibling) {
+              if (mask & (1U << j)) node->_searchInside(obj, out);
+            }
+          }
+        } else {
+          std::copy(data.begin(), data.end(), out);
+        }
+      }
+
       // update the bounding box extents of nodes that intersect obj (generally an aabb).
       // The aabb class must provide a method intersects(obj_t).
       template<typename obj_t>
@@ -122,6 +195,7 @@ namespace carve {
             node->updateExtents(obj);
             bbox.unionAABB(node->bbox);
           }
+          _updateChildAABBs();
         } else {
           bbox.fit(data.begin(), data.end());
         }
@@ -141,6 +215,7 @@ namespace carve {
             if (!removed) removed = node->remove(val, val_aabb);
             bbox.unionAABB(node->bbox);
           }
+          _updateChildAABBs();
           return removed;
         } else {
           typename std::vector<data_t>::iterator i = std::remove(data.begin(), data.end(), val);
@@ -154,7 +229,7 @@ namespace carve {
       }
 
       template<typename iter_t>
-      RTreeNode(iter_t begin, iter_t end) : bbox(), child(NULL), sibling(NULL), data() {
+      RTreeNode(iter_t begin, iter_t end) : bbox(), child(NULL), sibling(NULL), data(), child_aabbs() {
         _fill(begin, end, typename std::iterator_traits<iter_t>::value_type());
       }
 
@@ -0,0 +1,128 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#pragma once
+
+#include <carve/carve.hpp>
+
+#include <carve/geom2d.hpp>
+#include <carve/geom3d.hpp>
+#include <carve/bezier.hpp>
+#include <carve/mesh.hpp>
+#include <carve/executor.hpp>
+
+#include <vector>
+
+namespace carve {
+  namespace sweep {
+
+    typedef carve::geom2d::P2 P2;
+    typedef carve::geom::vector<3> vec3_t;
+    typedef carve::geom::cubic_bezier<3> segment_t;
+
+    /**
+     * \class Sweep
+     * \brief A profile to be swept along a path.
+     *
+     * The profile is a simple closed polygon (without a repeated
+     * closing vertex) in the (u, v) plane of the frame that travels
+     * along the path. Either winding is accepted. The path is a
+     * polyline of at least two distinct points; curved paths can be
+     * produced with carve::geom::flattenPath().
+     *
+     * If \a extrude is set, the profile is not reoriented along the
+     * path: it is placed in the z = 0 plane and translated by each
+     * path point, giving a (possibly oblique) prism for a two point
+     * path.
+     */
+    struct Sweep {
+      std::vector<P2> profile;
+      std::vector<vec3_t> path;
+      bool extrude;
+
+      Sweep() : profile(), path(), extrude(false) {
+      }
+
+      Sweep(const std::vector<P2> &_profile,
+            const std::vector<vec3_t> &_path,
+            bool _extrude = false) :
+        profile(_profile), path(_path), extrude(_extrude) {
+      }
+    };
+
+    /**
+     * \brief Sweep a profile along a polyline path.
+     *
+     * The profile is carried along the path by a rotation minimizing
+     * frame (computed by the double reflection method), and is
+     * placed perpendicular to the bisector of adjacent path
+     * segments at interior path points. The initial frame axes are
+     * chosen so that a path running along +z maps profile u and v to
+     * x and y.
+     *
+     * The resulting mesh has half-edge connectivity constructed
+     * directly from the known topology of the sweep (no
+     * FaceStitcher pass is required), and is closed.
+     *
+     * @param profile The profile polygon.
+     * @param path The path polyline.
+     *
+     * @return A newly allocated MeshSet containing one closed mesh.
+     */
+    carve::mesh::MeshSet<3> *sweep(const std::vector<P2> &profile,
+                                   const std::vector<vec3_t> &path);
+
+    /**
+     * \brief Sweep a profile along a path of cubic bezier segments.
+     *
+     * The path is flattened adaptively, such that no point of the
+     * curve is further than \a tolerance from the polyline used
+     * for the sweep.
+     */
+    carve::mesh::MeshSet<3> *sweep(const std::vector<P2> &profile,
+                                   const std::vector<segment_t> &path,
+                                   double tolerance);
+
+    /**
+     * \brief Extrude a profile placed in the z = 0 plane along \a dir.
+     *
+     * @param profile The profile polygon.
+     * @param dir The extrusion vector. Must not be parallel to the
+     *            z = 0 plane.
+     *
+     * @return A newly allocated MeshSet containing one closed mesh.
+     */
+    carve::mesh::MeshSet<3> *extrude(const std::vector<P2> &profile,
+                                     const vec3_t &dir);
+
+    /**
+     * \brief Generate many sweeps into a single MeshSet.
+     *
+     * Each sweep becomes one mesh of the result, in the order
+     * given. Sweeps are generated in parallel on \a executor (or
+     * carve::defaultExecutor() if it is NULL). All vertices share a
+     * single vertex_storage allocation.
+     *
+     * @throws carve::exception if any sweep is degenerate (fewer
+     *         than three distinct profile points, fewer than two
+     *         distinct path points, or a zero area profile).
+     */
+    carve::mesh::MeshSet<3> *sweepMany(const std::vector<Sweep> &sweeps,
+                                       carve::Executor *executor = NULL);
+
+  }
+}
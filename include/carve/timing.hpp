@@ -18,6 +18,7 @@
 #pragma once
 
 #include <carve/carve.hpp>
+#include <carve/memory_accounting.hpp>
 
 #ifndef CARVE_USE_TIMINGS
 #define CARVE_USE_TIMINGS 0
@@ -31,9 +32,11 @@ namespace carve {
   public:
     TimingName(const char *name);
     int id;  
+    const char *name;
   };
 
   class TimingBlock {
+    MemoryPhase phase;
   public:
     /**
      * Starts timing at the end of this constructor, using the given ID. To 
@@ -78,11 +81,14 @@ namespace carve {
 #else
 
   struct TimingName {
-    TimingName(const char *) {}
+    TimingName(const char *_name) : name(_name) {}
+    const char *name;
   };
   struct TimingBlock {
-    TimingBlock(int /* id */) {}
-    TimingBlock(const TimingName & /* name */) {}
+    // timing blocks also delimit MemoryAccounting phases.
+    MemoryPhase phase;
+    TimingBlock(int /* id */) : phase() {}
+    TimingBlock(const TimingName &name) : phase(&name, name.name) {}
   };
   struct Timing {
     static void start(int /* id */) {}
@@ -20,9 +20,11 @@
 
 #include <carve/carve.hpp>
 
+#include <carve/csg.hpp>
 #include <carve/matrix.hpp>
 #include <carve/timing.hpp>
 #include <carve/rescale.hpp>
+#include <carve/tree_cache.hpp>
 
 namespace carve {
   namespace csg {
@@ -31,10 +33,34 @@ namespace carve {
       CSG_TreeNode(const CSG_TreeNode &);
       CSG_TreeNode &operator=(const CSG_TreeNode &);
 
+      enum { DIGEST_UNKNOWN, DIGEST_VALID, DIGEST_NONE } digest_state;
+      CSG_TreeCache::key_t digest_key;
+
     protected:
-  
+      // If csg has a tree cache and this subtree is cacheable, look up
+      // its result. cacheable is set to indicate whether the result
+      // should be stored under key once computed. Hooks other than
+      // progress reporting observe or alter the output of each
+      // operation, which a cached result would skip, so their
+      // presence disables the cache. Every operation in the subtree
+      // depends on carve::EPSILON, so its current value is part of
+      // the key.
+      carve::mesh::MeshSet<3> *cacheLookup(CSG &csg, CSG_TreeCache::key_t &key, bool &cacheable) {
+        cacheable =
+          csg.tree_cache != NULL &&
+          !csg.hooks.hasHook(CSG::Hooks::RESULT_FACE_HOOK) &&
+          !csg.hooks.hasHook(CSG::Hooks::PROCESS_OUTPUT_FACE_HOOK) &&
+          !csg.hooks.hasHook(CSG::Hooks::INTERSECTION_VERTEX_HOOK) &&
+          !csg.hooks.hasHook(CSG::Hooks::EDGE_DIVISION_HOOK) &&
+          digest(key);
+        if (!cacheable) return NULL;
+        CSG_TreeCache::append(key, carve::EPSILON);
+        key.add(csg.reorder_results);
+        return csg.tree_cache->lookup(key);
+      }
+
     public:
-      CSG_TreeNode() {
+      CSG_TreeNode() : digest_state(DIGEST_UNKNOWN), digest_key() {
       }
 
       virtual ~CSG_TreeNode() {
@@ -42,6 +68,36 @@ namespace carve {
 
       virtual carve::mesh::MeshSet<3> *eval(bool &is_temp, CSG &csg) =0;
 
+      /**
+       * \brief Compute a key that identifies the result of this subtree.
+       *
+       * Nodes whose result is a function only of their own parameters
+       * and the results of their children add these, and the digest()
+       * of each child, to \a key. The default implementation marks
+       * the subtree as uncacheable.
+       *
+       * @return true if \a key was set.
+       */
+      virtual bool cacheKey(CSG_TreeCache::key_t & /* key */) {
+        return false;
+      }
+
+      /**
+       * \brief The key computed by cacheKey(), which is called once and
+       *        remembered, so a subtree must not be modified once it
+       *        has been used in a cached evaluation.
+       *
+       * @return true if \a key was set.
+       */
+      bool digest(CSG_TreeCache::key_t &key) {
+        if (digest_state == DIGEST_UNKNOWN) {
+          digest_state = cacheKey(digest_key) ? DIGEST_VALID : DIGEST_NONE;
+        }
+        if (digest_state != DIGEST_VALID) return false;
+        key = digest_key;
+        return true;
+      }
+
       virtual carve::mesh::MeshSet<3> *eval(CSG &csg) {
         bool temp;
         carve::mesh::MeshSet<3> *r = eval(temp, csg);
@@ -63,13 +119,33 @@ namespace carve {
         delete child;
       }
 
+      virtual bool cacheKey(CSG_TreeCache::key_t &key) {
+        CSG_TreeCache::key_t c_key;
+        if (!child->digest(c_key)) return false;
+        key.clear();
+        key.add('T');
+        CSG_TreeCache::append(key, transform);
+        key.add(c_key);
+        return true;
+      }
+
       virtual carve::mesh::MeshSet<3> *eval(bool &is_temp, CSG &csg) {
-        carve::mesh::MeshSet<3> *result = child->eval(is_temp, csg);
+        CSG_TreeCache::key_t key;
+        bool cacheable;
+        carve::mesh::MeshSet<3> *result = cacheLookup(csg, key, cacheable);
+        if (result) {
+          is_temp = true;
+          return result;
+        }
+
+        result = child->eval(is_temp, csg);
         if (!is_temp) {
           result = result->clone();
           is_temp = true;
         }
-        result->transform(carve::math::matrix_transformation(transform));
+        result->transform(carve::math::matrix_transformation(transform), csg.executor);
+
+        if (cacheable) csg.tree_cache->insert(key, result);
         return result;
       }
     };
@@ -102,6 +178,19 @@ namespace carve {
         }
       }
 
+      virtual bool cacheKey(CSG_TreeCache::key_t &key) {
+        CSG_TreeCache::key_t c_key;
+        if (!child->digest(c_key)) return false;
+        key.clear();
+        key.add('I');
+        key.add(c_key);
+        key.add(selected_meshes.size());
+        for (size_t i = 0; i < selected_meshes.size(); ++i) {
+          key.add(selected_meshes[i]);
+        }
+        return true;
+      }
+
       virtual carve::mesh::MeshSet<3> *eval(bool &is_temp, CSG &csg) {
         bool c_temp;
         carve::mesh::MeshSet<3> *c = child->eval(c_temp, csg);
@@ -147,6 +236,19 @@ namespace carve {
         delete child;
       }
 
+      virtual bool cacheKey(CSG_TreeCache::key_t &key) {
+        CSG_TreeCache::key_t c_key;
+        if (!child->digest(c_key)) return false;
+        key.clear();
+        key.add('S');
+        key.add(c_key);
+        key.add(selected_meshes.size());
+        for (size_t i = 0; i < selected_meshes.size(); ++i) {
+          key.add(selected_meshes[i]);
+        }
+        return true;
+      }
+
       virtual carve::mesh::MeshSet<3> *eval(bool &is_temp, CSG &csg) {
         bool c_temp;
         carve::mesh::MeshSet<3> *c = child->eval(c_temp, csg);
@@ -162,7 +264,7 @@ namespace carve {
           }
         }
         c->meshes.erase(c->meshes.begin() + j, c->meshes.end());
-        c->collectVertices();
+        c->collectVertices(csg.executor);
         is_temp = true;
         return c;
       }
@@ -187,6 +289,15 @@ namespace carve {
         }
       }
 
+      // the geometry key is computed on first use, so poly should not
+      // be modified once it has been used in a cached evaluation.
+      virtual bool cacheKey(CSG_TreeCache::key_t &key) {
+        key.clear();
+        key.add('P');
+        CSG_TreeCache::append(key, poly);
+        return true;
+      }
+
       virtual carve::mesh::MeshSet<3> *eval(bool &is_temp, CSG &csg) {
         is_temp = false;
         return poly;
@@ -214,6 +325,19 @@ namespace carve {
         delete right;
       }
 
+      virtual bool cacheKey(CSG_TreeCache::key_t &key) {
+        CSG_TreeCache::key_t l_key, r_key;
+        if (!left->digest(l_key) || !right->digest(r_key)) return false;
+        key.clear();
+        key.add('O');
+        key.add(op);
+        key.add(rescale);
+        key.add(classify_type);
+        key.add(l_key);
+        key.add(r_key);
+        return true;
+      }
+
       void minmax(double &min_x, double &min_y, double &min_z,
                   double &max_x, double &max_y, double &max_z,
                   const std::vector<carve::geom3d::Vector> &points) {
@@ -312,11 +436,22 @@ namespace carve {
   
 
       virtual carve::mesh::MeshSet<3> *eval(bool &is_temp, CSG &csg) {
+        CSG_TreeCache::key_t key;
+        bool cacheable;
+        carve::mesh::MeshSet<3> *result = cacheLookup(csg, key, cacheable);
+        if (result) {
+          is_temp = true;
+          return result;
+        }
+
         if (rescale) {
-          return evalScaled(is_temp, csg);
+          result = evalScaled(is_temp, csg);
         } else {
-          return evalUnscaled(is_temp, csg);
+          result = evalUnscaled(is_temp, csg);
         }
+
+        if (cacheable) csg.tree_cache->insert(key, result);
+        return result;
       }
     };
 
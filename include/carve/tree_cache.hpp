@@ -0,0 +1,177 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#pragma once
+
+#include <carve/carve.hpp>
+
+#include <carve/matrix.hpp>
+#include <carve/mesh.hpp>
+
+#include <list>
+#include <map>
+
+namespace carve {
+  namespace csg {
+
+    /**
+     * \class CSG_TreeCache
+     * \brief A size bounded LRU cache of CSG tree evaluation results.
+     *
+     * Results are keyed by a 128 bit digest of the subtree that
+     * produced them: the geometry of the input meshes, the
+     * transforms, operations and classifiers applied to them, and the
+     * value of carve::EPSILON. Keys depend only on content, so
+     * identical subtrees of different trees (or of successive
+     * evaluations of an edited tree) share entries. Entries are
+     * indexed by one word of their key, and a hit requires both words
+     * to match.
+     *
+     * A cache is used by setting CSG::tree_cache before evaluating a
+     * tree; see CSG_TreeNode::cacheKey(). The cache owns copies of the
+     * results it stores, and lookups return a fresh copy, so cached
+     * results remain valid however the caller modifies or deletes
+     * what it receives.
+     */
+    class CSG_TreeCache {
+    public:
+      typedef uint64_t hash_t;
+
+      /**
+       * \class key_t
+       * \brief A 128 bit digest of a sequence of words.
+       *
+       * Each word is folded into two independently mixed 64 bit
+       * lanes. Adding a key adds its two words, so the digest of a
+       * subtree is built from the digests of its children in constant
+       * time.
+       */
+      class key_t {
+        uint64_t h[2];
+
+        // the finaliser of MurmurHash3; a bijection on 64 bit words.
+        static uint64_t mix(uint64_t x) {
+          x ^= x >> 33;
+          x *= 0xff51afd7ed558ccdULL;
+          x ^= x >> 33;
+          x *= 0xc4ceb9fe1a85ec53ULL;
+          x ^= x >> 33;
+          return x;
+        }
+
+      public:
+        key_t() {
+          clear();
+        }
+
+        key_t(uint64_t h0, uint64_t h1) {
+          h[0] = h0;
+          h[1] = h1;
+        }
+
+        key_t &add(uint64_t w) {
+          h[0] = mix(h[0] ^ w);
+          h[1] = mix(h[1] + w * 0x9e3779b97f4a7c15ULL + 0x632be59bd9b4e019ULL);
+          return *this;
+        }
+
+        key_t &add(const key_t &k) {
+          return add(k.h[0]).add(k.h[1]);
+        }
+
+        void clear() {
+          h[0] = 0x6a09e667f3bcc908ULL;
+          h[1] = 0xbb67ae8584caa73bULL;
+        }
+
+        hash_t hash() const { return h[0]; }
+
+        bool operator==(const key_t &k) const { return h[0] == k.h[0] && h[1] == k.h[1]; }
+        bool operator!=(const key_t &k) const { return !(*this == k); }
+      };
+
+    private:
+      typedef carve::mesh::MeshSet<3> meshset_t;
+
+      struct entry_t {
+        key_t key;
+        meshset_t *result;
+        size_t bytes;
+        entry_t(const key_t &_key, meshset_t *_result, size_t _bytes) : key(_key), result(_result), bytes(_bytes) {
+        }
+      };
+
+      typedef std::list<entry_t> lru_t;
+      typedef std::multimap<hash_t, lru_t::iterator> index_t;
+
+      // most recently used entries are at the front.
+      lru_t lru;
+      index_t index;
+
+      size_t max_bytes;
+      size_t cur_bytes;
+
+      size_t n_hits;
+      size_t n_misses;
+
+      CSG_TreeCache(const CSG_TreeCache &); // undefined.
+      CSG_TreeCache &operator=(const CSG_TreeCache &); // undefined.
+
+      index_t::iterator find(const key_t &key);
+      void evict(size_t required);
+
+    public:
+      CSG_TreeCache(size_t _max_bytes);
+      ~CSG_TreeCache();
+
+      /**
+       * \brief Find a cached result.
+       *
+       * @return A newly allocated copy of the result stored for \a
+       *         key, or NULL if there is none.
+       */
+      meshset_t *lookup(const key_t &key);
+
+      /**
+       * \brief Store a copy of \a result under \a key, evicting least
+       *        recently used entries as required. Results larger than
+       *        the cache itself are not stored.
+       */
+      void insert(const key_t &key, const meshset_t *result);
+
+      void clear();
+
+      size_t size() const { return lru.size(); }
+      size_t bytes() const { return cur_bytes; }
+      size_t maxBytes() const { return max_bytes; }
+      size_t hits() const { return n_hits; }
+      size_t misses() const { return n_misses; }
+
+      // An estimate of the memory used by a MeshSet.
+      static size_t estimateBytes(const meshset_t *meshset);
+
+      // Append an exact description of a value to a key.
+      static void append(key_t &key, const meshset_t *meshset);
+      static void append(key_t &key, const carve::math::Matrix &matrix);
+      static void append(key_t &key, double v) { key.add(hash(v)); }
+
+      static hash_t hash(const meshset_t *meshset);
+      static hash_t hash(double v);
+    };
+
+  }
+}
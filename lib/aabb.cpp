@@ -22,8 +22,78 @@
 #include <carve/aabb.hpp>
 #include <carve/geom3d.hpp>
 
+#if defined(CARVE_USE_SIMD) && defined(__AVX__)
+#  include <immintrin.h>
+#elif defined(CARVE_USE_SIMD) && defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
 namespace carve {
   namespace geom3d {
+
+    unsigned AABBBatch::blockMask(size_t block, const AABB &box, double tolerance) const {
+      // each kernel computes, for a block of four boxes, a mask with
+      // bit j set if every axis separation of box j from the query box
+      // is within tolerance. The separation is evaluated in the same
+      // order as aabb::axisSeparation(), so the result is identical.
+      const block_t &b = blocks[block];
+      unsigned mask;
+
+#if defined(CARVE_USE_SIMD) && defined(__AVX__)
+      const __m256d sign = _mm256_set1_pd(-0.0);
+      __m256d hit = _mm256_castsi256_pd(_mm256_set1_epi32(-1));
+      for (unsigned k = 0; k < 3; ++k) {
+        __m256d d = _mm256_sub_pd(_mm256_set1_pd(box.pos.v[k]), _mm256_loadu_pd(b.pos[k]));
+        d = _mm256_andnot_pd(sign, d);
+        d = _mm256_sub_pd(d, _mm256_loadu_pd(b.extent[k]));
+        d = _mm256_sub_pd(d, _mm256_set1_pd(box.extent.v[k]));
+        hit = _mm256_and_pd(hit, _mm256_cmp_pd(d, _mm256_set1_pd(tolerance), _CMP_LE_OQ));
+      }
+      mask = (unsigned)_mm256_movemask_pd(hit);
+#elif defined(CARVE_USE_SIMD) && defined(__SSE2__)
+      const __m128d sign = _mm_set1_pd(-0.0);
+      mask = 0;
+      for (unsigned h = 0; h < 4; h += 2) {
+        __m128d hit = _mm_castsi128_pd(_mm_set1_epi32(-1));
+        for (unsigned k = 0; k < 3; ++k) {
+          __m128d d = _mm_sub_pd(_mm_set1_pd(box.pos.v[k]), _mm_loadu_pd(b.pos[k] + h));
+          d = _mm_andnot_pd(sign, d);
+          d = _mm_sub_pd(d, _mm_loadu_pd(b.extent[k] + h));
+          d = _mm_sub_pd(d, _mm_set1_pd(box.extent.v[k]));
+          hit = _mm_and_pd(hit, _mm_cmple_pd(d, _mm_set1_pd(tolerance)));
+        }
+        mask |= (unsigned)_mm_movemask_pd(hit) << h;
+      }
+#else
+      mask = 0;
+      for (unsigned j = 0; j < 4; ++j) {
+        bool hit = true;
+        for (unsigned k = 0; k < 3; ++k) {
+          hit &= fabs(box.pos.v[k] - b.pos[k][j]) - b.extent[k][j] - box.extent.v[k] <= tolerance;
+        }
+        if (hit) mask |= 1U << j;
+      }
+#endif
+
+      // the last block may be partially filled.
+      if (block == blocks.size() - 1 && (n & 3)) mask &= (1U << (n & 3)) - 1;
+
+      return mask;
+    }
+
+    size_t AABBBatch::intersects(const AABB &box, std::vector<size_t> &out, double tolerance) const {
+      const size_t before = out.size();
+
+      for (size_t i = 0; i < blocks.size(); ++i) {
+        unsigned mask = blockMask(i, box, tolerance);
+        for (unsigned j = 0; mask; ++j, mask >>= 1) {
+          if (mask & 1) out.push_back(i * 4 + j);
+        }
+      }
+
+      return out.size() - before;
+    }
+
   }
 }
 
@@ -19,82 +19,437 @@
 #  include <carve_config.h>
 #endif
 
-#include <carve/csg.hpp>
 #include <carve/convex_hull.hpp>
+#include <carve/shewchuk_predicates.hpp>
+#include <carve/timing.hpp>
 
 #include <algorithm>
+#include <deque>
 
 namespace {
 
-  bool grahamScan(const std::vector<carve::geom2d::P2> &points,
-                  int vpp, int vp,
-                  const std::vector<int> &ordered,
-                  int start,
-                  std::vector<int> &result, int _i = 0) {
-    carve::geom2d::P2 v1 = points[vp] - points[vpp];
-    if (start == (int)ordered.size()) return true;
+  struct LexicographicOrder {
+    const std::vector<carve::geom2d::P2> &points;
+
+    LexicographicOrder(const std::vector<carve::geom2d::P2> &_points) : points(_points) {
+    }
+
+    bool operator()(int a, int b) const {
+      const carve::geom2d::P2 &pa = points[a], &pb = points[b];
+      if (pa.x != pb.x) return pa.x < pb.x;
+      if (pa.y != pb.y) return pa.y < pb.y;
+      return a < b;
+    }
+  };
 
-    for (int i = start; i < (int)ordered.size(); ++i) {
-      int v = ordered[i];
-      carve::geom2d::P2 v2 = points[v] - points[vp];
 
-      double cp = v1.x * v2.y - v2.x * v1.y;
-      if (cp < 0) return false;
 
-      int j = i + 1;
-      while (j < (int)ordered.size() && points[ordered[j]] == points[v]) j++;
+  struct SamePoint {
+    const std::vector<carve::geom2d::P2> &points;
 
-      result.push_back(v);
-      if (grahamScan(points, vp, v, ordered, j, result, _i + 1)) return true;
-      result.pop_back();
+    SamePoint(const std::vector<carve::geom2d::P2> &_points) : points(_points) {
     }
 
-    return false;
+    bool operator()(int a, int b) const {
+      return points[a] == points[b];
+    }
+  };
+
+
+
+  inline double orient2d(const carve::geom2d::P2 &a, const carve::geom2d::P2 &b, const carve::geom2d::P2 &c) {
+    return shewchuk::orient2d(a.v, b.v, c.v);
+  }
+
+
+
+  typedef carve::geom3d::Vector vec3;
+
+  // negative if d is outside the triangle a, b, c, which is
+  // anticlockwise when viewed from outside.
+  inline double orient3d(const vec3 &a, const vec3 &b, const vec3 &c, const vec3 &d) {
+    return shewchuk::orient3d(a.v, b.v, c.v, d.v);
   }
 
+  const size_t NONE = ~(size_t)0;
+
+  // points are assigned to faces in chunks of this many.
+  const size_t ASSIGN_GRAIN = 4096;
+
+  struct HullFace {
+    // v[i] -> v[i+1] is shared with face n[i].
+    size_t v[3];
+    size_t n[3];
+    // unnormalised outward normal, for ranking points by distance.
+    vec3 N;
+    // the points that lie outside this face, and the furthest of them.
+    std::vector<size_t> outside;
+    size_t eye;
+    double eye_dist;
+    unsigned visible, hidden;
+    bool dead;
+
+    HullFace(size_t a, size_t b, size_t c, const std::vector<vec3> &points) :
+        outside(), eye(NONE), eye_dist(0.0), visible(0), hidden(0), dead(false) {
+      v[0] = a; v[1] = b; v[2] = c;
+      n[0] = n[1] = n[2] = NONE;
+      N = carve::geom::cross(points[b] - points[a], points[c] - points[a]);
+    }
+  };
+
+
+
+  // find, for each point, the first of a set of candidate faces that
+  // it lies outside, and its distance from that face.
+  class AssignTask : public carve::ParallelTask {
+    const std::vector<vec3> &points;
+    const std::deque<HullFace> &faces;
+    const std::vector<size_t> &candidates;
+    const std::vector<size_t> &pts;
+    std::vector<size_t> &target;
+    std::vector<double> &dist;
+
+  public:
+    AssignTask(const std::vector<vec3> &_points,
+               const std::deque<HullFace> &_faces,
+               const std::vector<size_t> &_candidates,
+               const std::vector<size_t> &_pts,
+               std::vector<size_t> &_target,
+               std::vector<double> &_dist) :
+        points(_points), faces(_faces), candidates(_candidates), pts(_pts), target(_target), dist(_dist) {
+    }
+
+    virtual void run(size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        const vec3 &p = points[pts[i]];
+        target[i] = NONE;
+        for (size_t c = 0; c < candidates.size(); ++c) {
+          const HullFace &f = faces[candidates[c]];
+          const vec3 &a = points[f.v[0]];
+          if (orient3d(a, points[f.v[1]], points[f.v[2]], p) < 0.0) {
+            target[i] = candidates[c];
+            dist[i] = carve::geom::dot(f.N, p - a);
+            break;
+          }
+        }
+      }
+    }
+  };
+
+
+
+  class QuickHull {
+    const std::vector<vec3> &points;
+    carve::Executor &executor;
+
+    std::deque<HullFace> faces;
+    std::vector<size_t> pending;
+    unsigned stamp;
+
+    // scratch.
+    std::vector<size_t> target;
+    std::vector<double> dist;
+    std::vector<size_t> visible;
+    std::vector<size_t> stack;
+    std::vector<std::pair<size_t, unsigned> > horizon;
+    std::vector<size_t> new_faces;
+    std::vector<size_t> orphans;
+    // the new face whose horizon edge starts at each point.
+    std::vector<size_t> face_from;
+
+    bool outside(const HullFace &f, const vec3 &p) const {
+      return orient3d(points[f.v[0]], points[f.v[1]], points[f.v[2]], p) < 0.0;
+    }
+
+    // distribute pts over the outside sets of candidates. Points
+    // that are outside none of them are dropped.
+    void assign(const std::vector<size_t> &pts, const std::vector<size_t> &candidates) {
+      target.resize(pts.size());
+      dist.resize(pts.size());
+      AssignTask task(points, faces, candidates, pts, target, dist);
+      carve::parallelFor(executor, pts.size(), ASSIGN_GRAIN, task);
+
+      for (size_t i = 0; i < pts.size(); ++i) {
+        if (target[i] == NONE) continue;
+        HullFace &f = faces[target[i]];
+        f.outside.push_back(pts[i]);
+        if (f.eye == NONE || dist[i] > f.eye_dist) {
+          f.eye = pts[i];
+          f.eye_dist = dist[i];
+        }
+      }
+
+      for (size_t c = 0; c < candidates.size(); ++c) {
+        if (faces[candidates[c]].outside.size()) pending.push_back(candidates[c]);
+      }
+    }
+
+    // add the furthest point outside face seed to the hull.
+    void addPoint(size_t seed) {
+      const size_t eye = faces[seed].eye;
+      const vec3 &p = points[eye];
+
+      // the faces visible from the eye form a connected region
+      // around seed. Walk it, collecting the edges of its boundary.
+      ++stamp;
+      visible.clear();
+      horizon.clear();
+      stack.clear();
+      stack.push_back(seed);
+      faces[seed].visible = stamp;
+      while (stack.size()) {
+        size_t fi = stack.back();
+        stack.pop_back();
+        visible.push_back(fi);
+        for (unsigned k = 0; k < 3; ++k) {
+          HullFace &nf = faces[faces[fi].n[k]];
+          if (nf.visible == stamp) continue;
+          if (nf.hidden != stamp) {
+            if (outside(nf, p)) {
+              nf.visible = stamp;
+              stack.push_back(faces[fi].n[k]);
+              continue;
+            }
+            nf.hidden = stamp;
+          }
+          horizon.push_back(std::make_pair(fi, k));
+        }
+      }
+
+      // join each horizon edge to the eye.
+      new_faces.clear();
+      for (size_t i = 0; i < horizon.size(); ++i) {
+        const HullFace &vf = faces[horizon[i].first];
+        const unsigned k = horizon[i].second;
+        const size_t a = vf.v[k], b = vf.v[(k + 1) % 3], ni = vf.n[k];
+        const size_t fi = faces.size();
+        faces.push_back(HullFace(a, b, eye, points));
+        faces[fi].n[0] = ni;
+        HullFace &nf = faces[ni];
+        for (unsigned j = 0; j < 3; ++j) {
+          if (nf.n[j] == horizon[i].first && nf.v[j] == b) nf.n[j] = fi;
+        }
+        face_from[a] = fi;
+        new_faces.push_back(fi);
+      }
+      for (size_t i = 0; i < new_faces.size(); ++i) {
+        HullFace &f = faces[new_faces[i]];
+        const size_t next = face_from[f.v[1]];
+        f.n[1] = next;
+        faces[next].n[2] = new_faces[i];
+      }
+
+      orphans.clear();
+      for (size_t i = 0; i < visible.size(); ++i) {
+        HullFace &f = faces[visible[i]];
+        for (size_t j = 0; j < f.outside.size(); ++j) {
+          if (f.outside[j] != eye) orphans.push_back(f.outside[j]);
+        }
+        std::vector<size_t>().swap(f.outside);
+        f.dead = true;
+      }
+
+      assign(orphans, new_faces);
+    }
+
+  public:
+    QuickHull(const std::vector<vec3> &_points, carve::Executor &_executor) :
+        points(_points), executor(_executor), faces(), pending(), stamp(0), face_from(_points.size(), NONE) {
+    }
+
+    // find four points that do not lie in a plane, ordered so that
+    // the triangle s[0], s[1], s[2] is anticlockwise when viewed from
+    // the side away from s[3].
+    bool initialSimplex(size_t s[4]) {
+      if (points.size() < 4) return false;
+
+      size_t extreme[6];
+      for (unsigned d = 0; d < 3; ++d) {
+        extreme[d * 2] = extreme[d * 2 + 1] = 0;
+        for (size_t i = 1; i < points.size(); ++i) {
+          if (points[i].v[d] < points[extreme[d * 2]].v[d]) extreme[d * 2] = i;
+          if (points[i].v[d] > points[extreme[d * 2 + 1]].v[d]) extreme[d * 2 + 1] = i;
+        }
+      }
+
+      double best = 0.0;
+      for (unsigned i = 0; i < 6; ++i) {
+        for (unsigned j = i + 1; j < 6; ++j) {
+          double d = (points[extreme[i]] - points[extreme[j]]).length2();
+          if (d > best) {
+            best = d;
+            s[0] = extreme[i];
+            s[1] = extreme[j];
+          }
+        }
+      }
+      if (best == 0.0) return false;
+
+      const vec3 &p0 = points[s[0]];
+      const vec3 d01 = points[s[1]] - p0;
+      best = -1.0;
+      for (size_t i = 0; i < points.size(); ++i) {
+        double d = carve::geom::cross(d01, points[i] - p0).length2();
+        if (d > best) {
+          best = d;
+          s[2] = i;
+        }
+      }
+
+      const vec3 N = carve::geom::cross(d01, points[s[2]] - p0);
+      best = -1.0;
+      for (size_t i = 0; i < points.size(); ++i) {
+        double d = fabs(carve::geom::dot(N, points[i] - p0));
+        if (d > best) {
+          best = d;
+          s[3] = i;
+        }
+      }
+
+      double o = orient3d(p0, points[s[1]], points[s[2]], points[s[3]]);
+      if (o == 0.0) {
+        // the points are close enough to coplanar that rounding hid
+        // the furthest; look for any point off the plane.
+        for (size_t i = 0; o == 0.0 && i < points.size(); ++i) {
+          o = orient3d(p0, points[s[1]], points[s[2]], points[i]);
+          s[3] = i;
+        }
+        if (o == 0.0) return false;
+      }
+      if (o < 0.0) std::swap(s[1], s[2]);
+      return true;
+    }
+
+    void build(const size_t s[4]) {
+      faces.push_back(HullFace(s[0], s[1], s[2], points));
+      faces.push_back(HullFace(s[1], s[0], s[3], points));
+      faces.push_back(HullFace(s[2], s[1], s[3], points));
+      faces.push_back(HullFace(s[0], s[2], s[3], points));
+      static const size_t adj[4][3] = { { 1, 2, 3 }, { 0, 3, 2 }, { 0, 1, 3 }, { 0, 2, 1 } };
+      std::vector<size_t> candidates;
+      for (size_t i = 0; i < 4; ++i) {
+        for (unsigned k = 0; k < 3; ++k) faces[i].n[k] = adj[i][k];
+        candidates.push_back(i);
+      }
+
+      std::vector<size_t> pts;
+      pts.reserve(points.size());
+      for (size_t i = 0; i < points.size(); ++i) {
+        if (i != s[0] && i != s[1] && i != s[2] && i != s[3]) pts.push_back(i);
+      }
+      assign(pts, candidates);
+
+      while (pending.size()) {
+        size_t fi = pending.back();
+        pending.pop_back();
+        if (faces[fi].dead || faces[fi].outside.empty()) continue;
+        addPoint(fi);
+      }
+    }
+
+    // the adjacency of the hull is already known, so the mesh is
+    // linked up directly rather than by matching edges.
+    carve::mesh::MeshSet<3> *createMeshSet() const {
+      typedef carve::mesh::MeshSet<3> meshset_t;
+
+      std::vector<size_t> vmap(points.size(), NONE);
+      std::vector<size_t> face_idx(faces.size(), NONE);
+      size_t n_verts = 0, n_faces = 0;
+      for (size_t i = 0; i < faces.size(); ++i) {
+        if (faces[i].dead) continue;
+        face_idx[i] = n_faces++;
+        for (unsigned k = 0; k < 3; ++k) {
+          if (vmap[faces[i].v[k]] == NONE) vmap[faces[i].v[k]] = n_verts++;
+        }
+      }
+
+      std::vector<meshset_t::vertex_t> vertex_storage(n_verts);
+      for (size_t i = 0; i < points.size(); ++i) {
+        if (vmap[i] != NONE) vertex_storage[vmap[i]].v = points[i];
+      }
+
+      std::vector<meshset_t::face_t *> mesh_faces;
+      std::vector<meshset_t::edge_t *> edges(n_faces * 3);
+      mesh_faces.reserve(n_faces);
+      for (size_t i = 0; i < faces.size(); ++i) {
+        if (faces[i].dead) continue;
+        const HullFace &f = faces[i];
+        meshset_t::face_t *face = new meshset_t::face_t(&vertex_storage[vmap[f.v[0]]],
+                                                        &vertex_storage[vmap[f.v[1]]],
+                                                        &vertex_storage[vmap[f.v[2]]]);
+        meshset_t::edge_t *e = face->edge;
+        for (unsigned k = 0; k < 3; ++k, e = e->next) edges[mesh_faces.size() * 3 + k] = e;
+        mesh_faces.push_back(face);
+      }
+
+      for (size_t i = 0; i < faces.size(); ++i) {
+        if (faces[i].dead) continue;
+        const HullFace &f = faces[i];
+        for (unsigned k = 0; k < 3; ++k) {
+          const HullFace &nf = faces[f.n[k]];
+          for (unsigned j = 0; j < 3; ++j) {
+            if (nf.n[j] == i && nf.v[j] == f.v[(k + 1) % 3]) {
+              edges[face_idx[i] * 3 + k]->rev = edges[face_idx[f.n[k]] * 3 + j];
+            }
+          }
+        }
+      }
+
+      std::vector<meshset_t::mesh_t *> meshes;
+      meshes.push_back(new meshset_t::mesh_t(mesh_faces));
+      return new meshset_t(vertex_storage, meshes);
+    }
+  };
+
 }
 
 namespace carve {
   namespace geom {
 
     std::vector<int> convexHull(const std::vector<carve::geom2d::P2> &points) {
-      double max_x = points[0].x;
-      unsigned max_v = 0;
+      std::vector<int> order;
+      order.reserve(points.size());
+      for (size_t i = 0; i < points.size(); ++i) order.push_back((int)i);
+      std::sort(order.begin(), order.end(), LexicographicOrder(points));
+      order.erase(std::unique(order.begin(), order.end(), SamePoint(points)), order.end());
 
-      for (unsigned i = 1; i < points.size(); ++i) {
-        if (points[i].x > max_x) {
-          max_x = points[i].x;
-          max_v = i;
-        }
-      }
+      const size_t n = order.size();
+      if (n < 3) return order;
 
-      std::vector<std::pair<double, double> > angle_dist;
-      std::vector<int> ordered;
-      angle_dist.reserve(points.size());
-      ordered.reserve(points.size() - 1);
-      for (unsigned i = 0; i < points.size(); ++i) {
-        if (i == max_v) continue;
-        angle_dist[i] = std::make_pair(carve::math::ANG(carve::geom2d::atan2(points[i] - points[max_v])), distance2(points[i], points[max_v]));
-        ordered.push_back(i);
+      // lower chain from the least point to the greatest, then the
+      // upper chain back again.
+      std::vector<int> hull(2 * n);
+      size_t k = 0;
+      for (size_t i = 0; i < n; ++i) {
+        while (k >= 2 && orient2d(points[hull[k - 2]], points[hull[k - 1]], points[order[i]]) <= 0.0) --k;
+        hull[k++] = order[i];
       }
-  
-      std::sort(ordered.begin(),
-                ordered.end(),
-                make_index_sort(angle_dist.begin()));
-
-      std::vector<int> result;
-      result.push_back(max_v);
-      result.push_back(ordered[0]);
-  
-      if (!grahamScan(points, max_v, ordered[0], ordered, 1, result)) {
-        result.clear();
-        throw carve::exception("convex hull failed!");
+      const size_t greatest = k - 1;
+      for (size_t i = n - 1, lower = k + 1; i-- > 0; ) {
+        while (k >= lower && orient2d(points[hull[k - 2]], points[hull[k - 1]], points[order[i]]) <= 0.0) --k;
+        hull[k++] = order[i];
       }
+      hull.resize(k - 1);
 
-      return result;
+      std::rotate(hull.begin(), hull.begin() + greatest, hull.end());
+      return hull;
     }
 
   }
-}
 
+  namespace geom3d {
+
+    carve::mesh::MeshSet<3> *convexHull(const std::vector<Vector> &points,
+                                        carve::Executor *executor) {
+      static carve::TimingName FUNC_NAME("geom3d::convexHull()");
+      carve::TimingBlock block(FUNC_NAME);
+
+      QuickHull hull(points, executor != NULL ? *executor : carve::defaultExecutor());
+      size_t simplex[4];
+      if (!hull.initialSimplex(simplex)) return NULL;
+      hull.build(simplex);
+      return hull.createMeshSet();
+    }
 
+  }
+}
@@ -48,7 +48,12 @@ namespace carve {
           };
         };
 
-        std::list<face_data_t> faces;
+        typedef std::list<face_data_t, carve::tracking_allocator<face_data_t> > face_list_t;
+        face_list_t faces;
+
+        // output faces are owned by the collector until done() hands
+        // them over to the result.
+        carve::MemoryGauge face_bytes;
 
         const carve::mesh::MeshSet<3> *src_a;
         const carve::mesh::MeshSet<3> *src_b;
@@ -72,6 +77,10 @@ namespace carve {
           hooks.processOutputFace(new_faces, orig_face, false);
           for (size_t i = 0; i < new_faces.size(); ++i) {
             faces.push_back(face_data_t(new_faces[i], orig_face, false));
+            if (carve::MemoryAccounting::enabled()) {
+              face_bytes.add(sizeof(carve::mesh::MeshSet<3>::face_t) +
+                             new_faces[i]->n_edges * sizeof(carve::mesh::MeshSet<3>::edge_t));
+            }
           }
 
 #if defined(CARVE_DEBUG) && defined(DEBUG_PRINT_RESULT_FACES)
@@ -94,6 +103,10 @@ namespace carve {
           hooks.processOutputFace(new_faces, orig_face, true);
           for (size_t i = 0; i < new_faces.size(); ++i) {
             faces.push_back(face_data_t(new_faces[i], orig_face, true));
+            if (carve::MemoryAccounting::enabled()) {
+              face_bytes.add(sizeof(carve::mesh::MeshSet<3>::face_t) +
+                             new_faces[i]->n_edges * sizeof(carve::mesh::MeshSet<3>::edge_t));
+            }
           }
 
 #if defined(CARVE_DEBUG) && defined(DEBUG_PRINT_RESULT_FACES)
@@ -201,14 +214,15 @@ namespace carve {
         virtual carve::mesh::MeshSet<3> *done(CSG::Hooks &hooks) {
           std::vector<carve::mesh::MeshSet<3>::face_t *> f;
           f.reserve(faces.size());
-          for (std::list<face_data_t>::iterator i = faces.begin(); i != faces.end(); ++i) {
+          for (face_list_t::iterator i = faces.begin(); i != faces.end(); ++i) {
             f.push_back((*i).face);
           }
 
-          carve::mesh::MeshSet<3> *p = new carve::mesh::MeshSet<3>(f);
+          carve::mesh::MeshSet<3> *p = new carve::mesh::MeshSet<3>(f, carve::mesh::MeshOptions().executor(executor));
+          face_bytes.set(0);
 
           if (hooks.hasHook(carve::csg::CSG::Hooks::RESULT_FACE_HOOK)) {
-            for (std::list<face_data_t>::iterator i = faces.begin(); i != faces.end(); ++i) {
+            for (face_list_t::iterator i = faces.begin(); i != faces.end(); ++i) {
               hooks.resultFace((*i).face, (*i).orig_face, (*i).flipped);
             }
           }
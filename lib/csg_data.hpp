@@ -49,4 +49,10 @@ struct carve::csg::detail::Data {
   // faces. Saves building the vertex to edge map for all faces of
   // both meshes.
   VEVecMap vert_to_edges;
+
+  // estimated footprint of the above, reported to MemoryAccounting.
+  carve::MemoryGauge gauge;
+
+  // update gauge, if memory accounting is enabled.
+  void account();
 };
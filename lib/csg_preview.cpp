@@ -0,0 +1,554 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/csg.hpp>
+#include <carve/mesh_raycast.hpp>
+#include <carve/rtree.hpp>
+#include <carve/timing.hpp>
+#include <carve/executor.hpp>
+#include <carve/djset.hpp>
+
+#include <algorithm>
+#include <memory>
+
+namespace {
+
+  typedef carve::mesh::MeshSet<3> meshset_t;
+  typedef meshset_t::vertex_t vertex_t;
+  typedef meshset_t::edge_t edge_t;
+  typedef meshset_t::face_t face_t;
+  typedef meshset_t::mesh_t mesh_t;
+  typedef carve::geom::vector<3> vector_t;
+  typedef carve::geom::aabb<3> aabb_t;
+  typedef carve::geom::tri<3> tri_t;
+  typedef carve::geom::RTreeNode<3, const tri_t *> tri_rtree_t;
+
+  // a grid edge, from sample a to sample a + (dx, dy, dz) with dx,
+  // dy, dz in {0, 1}, is identified by a * 8 + dx + 2dy + 4dz.
+  typedef size_t edge_key_t;
+
+  // the cells of the narrow band on either side of the surface.
+  const double BAND = 2.0;
+
+  // the grid is padded by this many cells on each side, so that the
+  // samples on its boundary are outside the result.
+  const size_t PAD = 2;
+
+  // the six tetrahedra of a cube that share its main diagonal, 0-7.
+  // Corners are numbered by x + 2y + 4z, and neighbouring cubes agree
+  // on the diagonals of their shared faces.
+  const unsigned CUBE_TETS[6][4] = {
+    { 0, 1, 3, 7 }, { 0, 1, 5, 7 },
+    { 0, 2, 3, 7 }, { 0, 2, 6, 7 },
+    { 0, 4, 5, 7 }, { 0, 4, 6, 7 }
+  };
+
+  // the sign of the volume of each tetrahedron of CUBE_TETS, with its
+  // corners taken in order.
+  const int CUBE_TET_SIGN[6] = {
+    +1, -1,
+    -1, +1,
+    +1, -1
+  };
+
+  // sample point (i, j, k) is at origin + h * (i, j, k).
+  struct grid_t {
+    vector_t origin;
+    double h;
+    size_t n[3];
+
+    size_t size() const {
+      return n[0] * n[1] * n[2];
+    }
+
+    size_t index(size_t i, size_t j, size_t k) const {
+      return i + n[0] * (j + n[1] * k);
+    }
+
+    vector_t point(size_t idx) const {
+      size_t i = idx % n[0]; idx /= n[0];
+      size_t j = idx % n[1];
+      size_t k = idx / n[1];
+      return origin + carve::geom::VECTOR(h * i, h * j, h * k);
+    }
+
+    edge_key_t edge(size_t a, size_t b) const {
+      if (b < a) std::swap(a, b);
+      size_t d = b - a, code = 0;
+      if (d >= n[0] * n[1]) { code |= 4; d -= n[0] * n[1]; }
+      if (d >= n[0]) { code |= 2; d -= n[0]; }
+      return a * 8 + (code | d);
+    }
+
+    size_t edgeStart(edge_key_t e) const {
+      return e >> 3;
+    }
+
+    size_t edgeEnd(edge_key_t e) const {
+      return (e >> 3) + (e & 1) + ((e >> 1) & 1) * n[0] + ((e >> 2) & 1) * n[0] * n[1];
+    }
+  };
+
+  // the point at which the field crosses zero along a grid edge. The
+  // end points are always taken in the same order, so the result does
+  // not depend on which cell asks for it.
+  vector_t edgePoint(const grid_t &grid, const std::vector<double> &field, edge_key_t e) {
+    size_t a = grid.edgeStart(e), b = grid.edgeEnd(e);
+    double fa = field[a], fb = field[b];
+    double t = fa / (fa - fb);
+    vector_t pa = grid.point(a), pb = grid.point(b);
+    return pa + t * (pb - pa);
+  }
+
+
+
+  // sets field to -1 for samples inside the meshset and +1 for those
+  // outside, from the parity of ray crossings along each row.
+  class SignTask : public carve::ParallelTask {
+    const grid_t &grid;
+    double t0;
+    const std::vector<size_t> &offsets;
+    const std::vector<carve::mesh::RayHit> &hits;
+    std::vector<double> &field;
+
+  public:
+    SignTask(const grid_t &_grid,
+             double _t0,
+             const std::vector<size_t> &_offsets,
+             const std::vector<carve::mesh::RayHit> &_hits,
+             std::vector<double> &_field) :
+        grid(_grid), t0(_t0), offsets(_offsets), hits(_hits), field(_field) {
+    }
+
+    virtual void run(size_t begin, size_t end) {
+      for (size_t row = begin; row < end; ++row) {
+        size_t h = offsets[row];
+        double *f = &field[row * grid.n[0]];
+        bool inside = false;
+        for (size_t i = 0; i < grid.n[0]; ++i) {
+          // the first sample is at distance t0 along the ray.
+          double t = t0 + grid.h * i;
+          for (; h < offsets[row + 1] && hits[h].t < t; ++h) inside = !inside;
+          f[i] = inside ? -1.0 : +1.0;
+        }
+      }
+    }
+  };
+
+
+
+  // replaces the signs in field with distances, clamped to the
+  // narrow band, one z slice of the grid at a time.
+  class DistanceTask : public carve::ParallelTask {
+    const grid_t &grid;
+    const tri_rtree_t *rtree;
+    std::vector<double> &field;
+
+  public:
+    DistanceTask(const grid_t &_grid,
+                 const tri_rtree_t *_rtree,
+                 std::vector<double> &_field) :
+        grid(_grid), rtree(_rtree), field(_field) {
+    }
+
+    virtual void run(size_t begin, size_t end) {
+      const double band = BAND * grid.h;
+      const size_t slice = grid.n[0] * grid.n[1];
+
+      std::vector<double> dist2;
+      std::vector<const tri_t *> near;
+
+      for (size_t k = begin; k < end; ++k) {
+        double z = grid.origin.z + grid.h * k;
+        aabb_t slab(carve::geom::VECTOR(grid.origin.x + grid.h * (grid.n[0] - 1) * 0.5,
+                                        grid.origin.y + grid.h * (grid.n[1] - 1) * 0.5,
+                                        z),
+                    carve::geom::VECTOR(grid.h * grid.n[0] * 0.5 + band,
+                                        grid.h * grid.n[1] * 0.5 + band,
+                                        band));
+        near.clear();
+        if (rtree) rtree->search(slab, std::back_inserter(near));
+        if (!near.size()) {
+          for (size_t s = 0; s < slice; ++s) field[k * slice + s] *= band;
+          continue;
+        }
+
+        dist2.assign(slice, band * band);
+        for (size_t t = 0; t < near.size(); ++t) {
+          aabb_t box = near[t]->getAABB();
+          vector_t lo = box.min() - grid.origin, hi = box.max() - grid.origin;
+          size_t i0 = (size_t)std::max(0.0, ceil((lo.x - band) / grid.h));
+          size_t j0 = (size_t)std::max(0.0, ceil((lo.y - band) / grid.h));
+          size_t i1 = std::min(grid.n[0] - 1, (size_t)std::max(0.0, floor((hi.x + band) / grid.h)));
+          size_t j1 = std::min(grid.n[1] - 1, (size_t)std::max(0.0, floor((hi.y + band) / grid.h)));
+
+          for (size_t j = j0; j <= j1; ++j) {
+            for (size_t i = i0; i <= i1; ++i) {
+              vector_t p = grid.origin + carve::geom::VECTOR(grid.h * i, grid.h * j, grid.h * k);
+              double &d = dist2[j * grid.n[0] + i];
+              d = std::min(d, carve::geom::distance2(*near[t], p));
+            }
+          }
+        }
+
+        for (size_t s = 0; s < slice; ++s) {
+          field[k * slice + s] *= sqrt(dist2[s]);
+        }
+      }
+    }
+  };
+
+
+
+  // sample the signed distance to the surface of meshset, negative
+  // inside. Distances are clamped to the narrow band.
+  void sampleField(const meshset_t *meshset,
+                   const grid_t &grid,
+                   carve::Executor &executor,
+                   std::vector<double> &field) {
+    static carve::TimingName FUNC_NAME("sampleField()");
+    carve::TimingBlock block(FUNC_NAME);
+
+    carve::mesh::RayCaster caster(meshset, &executor);
+
+    // rays start outside the meshset, and are offset from the rows by
+    // a small irregular amount, so that they do not pass through the
+    // edges of grid aligned faces.
+    const double start = std::min(grid.origin.x, meshset->getAABB().min().x) - grid.h;
+    const vector_t jitter = carve::geom::VECTOR(start - grid.origin.x,
+                                                grid.h * 1.4142135623e-4,
+                                                grid.h * 1.7320508075e-4);
+    std::vector<carve::geom::ray<3> > rays;
+    rays.reserve(grid.n[1] * grid.n[2]);
+    for (size_t k = 0; k < grid.n[2]; ++k) {
+      for (size_t j = 0; j < grid.n[1]; ++j) {
+        rays.push_back(carve::geom::ray<3>(carve::geom::VECTOR(1.0, 0.0, 0.0),
+                                           grid.point(grid.index(0, j, k)) + jitter));
+      }
+    }
+
+    std::vector<size_t> offsets;
+    std::vector<carve::mesh::RayHit> hits;
+    caster.allHits(rays, offsets, hits, grid.origin.x - start + grid.h * grid.n[0]);
+
+    field.resize(grid.size());
+    SignTask sign_task(grid, grid.origin.x - start, offsets, hits, field);
+    carve::parallelFor(executor, rays.size(), 64, sign_task);
+
+    const std::vector<carve::mesh::RayCaster::Triangle> &src = caster.getTriangles();
+    std::vector<tri_t> tris;
+    tris.reserve(src.size());
+    for (size_t i = 0; i < src.size(); ++i) {
+      tris.push_back(tri_t(src[i].v0, src[i].v0 + src[i].e1, src[i].v0 + src[i].e2));
+    }
+    std::vector<const tri_t *> tri_ptrs;
+    tri_ptrs.reserve(tris.size());
+    for (size_t i = 0; i < tris.size(); ++i) tri_ptrs.push_back(&tris[i]);
+
+    std::auto_ptr<tri_rtree_t> rtree(tri_ptrs.size() ? tri_rtree_t::construct_STR(tri_ptrs.begin(), tri_ptrs.end(), 4, 4) : NULL);
+
+    DistanceTask distance_task(grid, rtree.get(), field);
+    carve::parallelFor(executor, grid.n[2], 1, distance_task);
+  }
+
+
+
+  // extracts the zero level set of field, one slice of cubes at a
+  // time. Each triangle is emitted as the three grid edges its
+  // vertices lie on, oriented so that its normal points towards
+  // positive values.
+  //
+  // The orientation is decided combinatorially, so that it is
+  // consistent between neighbouring tetrahedra even when the
+  // triangles are degenerate. With the corners of a tetrahedron
+  // reordered as (inside..., outside...), the triangles below face
+  // outwards when that ordering has positive volume; its sign is that
+  // of the tetrahedron times the parity of the reordering.
+  class ExtractTask : public carve::ParallelTask {
+    const grid_t &grid;
+    const std::vector<double> &field;
+    std::vector<std::vector<edge_key_t> > &slice_tris;
+
+    void emit(std::vector<edge_key_t> &tris,
+              edge_key_t e0, edge_key_t e1, edge_key_t e2,
+              bool flip) {
+      if (flip) std::swap(e1, e2);
+      tris.push_back(e0);
+      tris.push_back(e1);
+      tris.push_back(e2);
+    }
+
+  public:
+    ExtractTask(const grid_t &_grid,
+                const std::vector<double> &_field,
+                std::vector<std::vector<edge_key_t> > &_slice_tris) :
+        grid(_grid), field(_field), slice_tris(_slice_tris) {
+    }
+
+    virtual void run(size_t begin, size_t end) {
+      for (size_t k = begin; k < end; ++k) {
+        std::vector<edge_key_t> &tris = slice_tris[k];
+
+        for (size_t j = 0; j + 1 < grid.n[1]; ++j) {
+          for (size_t i = 0; i + 1 < grid.n[0]; ++i) {
+            size_t corner[8];
+            unsigned n_inside = 0;
+            for (unsigned c = 0; c < 8; ++c) {
+              corner[c] = grid.index(i + (c & 1), j + ((c >> 1) & 1), k + ((c >> 2) & 1));
+              if (field[corner[c]] < 0.0) ++n_inside;
+            }
+            if (n_inside == 0 || n_inside == 8) continue;
+
+            for (unsigned t = 0; t < 6; ++t) {
+              size_t in[4], out[4];
+              unsigned n_in = 0, n_out = 0, n_swaps = 0;
+              for (unsigned c = 0; c < 4; ++c) {
+                size_t v = corner[CUBE_TETS[t][c]];
+                if (field[v] < 0.0) {
+                  // moved ahead of the outside corners seen so far.
+                  n_swaps += n_out;
+                  in[n_in++] = v;
+                } else {
+                  out[n_out++] = v;
+                }
+              }
+              const bool flip = (CUBE_TET_SIGN[t] < 0) != ((n_swaps & 1) != 0);
+
+              if (n_in == 1) {
+                emit(tris, grid.edge(in[0], out[0]), grid.edge(in[0], out[1]), grid.edge(in[0], out[2]), flip);
+              } else if (n_in == 3) {
+                emit(tris, grid.edge(out[0], in[0]), grid.edge(out[0], in[1]), grid.edge(out[0], in[2]), flip);
+              } else if (n_in == 2) {
+                edge_key_t e00 = grid.edge(in[0], out[0]), e01 = grid.edge(in[0], out[1]);
+                edge_key_t e10 = grid.edge(in[1], out[0]), e11 = grid.edge(in[1], out[1]);
+                emit(tris, e00, e01, e11, flip);
+                emit(tris, e00, e11, e10, flip);
+              }
+            }
+          }
+        }
+      }
+    }
+  };
+
+
+
+  // a half edge of triangle tri, from vertex a to vertex b.
+  struct half_edge_t {
+    size_t lo, hi;
+    bool fwd;
+    edge_t *edge;
+    size_t tri;
+
+    half_edge_t(size_t a, size_t b, edge_t *_edge, size_t _tri) :
+        lo(std::min(a, b)), hi(std::max(a, b)), fwd(a < b), edge(_edge), tri(_tri) {
+    }
+
+    bool operator<(const half_edge_t &other) const {
+      if (lo != other.lo) return lo < other.lo;
+      if (hi != other.hi) return hi < other.hi;
+      return fwd && !other.fwd;
+    }
+  };
+
+  // the surface should be a closed manifold, in which each edge has
+  // exactly one reverse, and the meshes can be assembled directly. If
+  // any edge cannot be paired in this way, the general purpose face
+  // stitcher is used instead.
+  meshset_t *buildMeshSet(std::vector<vertex_t> &vertex_storage,
+                          const std::vector<size_t> &tri_verts) {
+    const size_t n_tris = tri_verts.size() / 3;
+    std::vector<face_t *> faces;
+    std::vector<half_edge_t> half_edges;
+    faces.reserve(n_tris);
+    half_edges.reserve(tri_verts.size());
+
+    for (size_t t = 0; t < n_tris; ++t) {
+      const size_t *v = &tri_verts[t * 3];
+      face_t *face = new face_t(&vertex_storage[v[0]], &vertex_storage[v[1]], &vertex_storage[v[2]]);
+      edge_t *e = face->edge;
+      for (unsigned k = 0; k < 3; ++k, e = e->next) {
+        half_edges.push_back(half_edge_t(v[k], v[(k + 1) % 3], e, t));
+      }
+      faces.push_back(face);
+    }
+
+    std::sort(half_edges.begin(), half_edges.end());
+    bool paired = half_edges.size() % 2 == 0;
+    for (size_t i = 0; paired && i < half_edges.size(); i += 2) {
+      const half_edge_t &h1 = half_edges[i], &h2 = half_edges[i + 1];
+      paired = h1.lo == h2.lo && h1.hi == h2.hi && h1.fwd && !h2.fwd;
+    }
+    if (!paired) {
+      std::vector<mesh_t *> meshes;
+      mesh_t::create(faces.begin(), faces.end(), meshes, carve::mesh::MeshOptions());
+      return new meshset_t(vertex_storage, meshes);
+    }
+
+    carve::djset::djset components(n_tris);
+    for (size_t i = 0; i < half_edges.size(); i += 2) {
+      const half_edge_t &h1 = half_edges[i], &h2 = half_edges[i + 1];
+      h1.edge->rev = h2.edge;
+      h2.edge->rev = h1.edge;
+      components.merge_sets(h1.tri, h2.tri);
+    }
+
+    std::vector<std::vector<face_t *> > mesh_faces;
+    std::vector<size_t> mesh_index(n_tris, ~(size_t)0);
+    for (size_t t = 0; t < n_tris; ++t) {
+      size_t head = components.find_set_head(t);
+      if (mesh_index[head] == ~(size_t)0) {
+        mesh_index[head] = mesh_faces.size();
+        mesh_faces.push_back(std::vector<face_t *>());
+      }
+      std::vector<face_t *> &f = mesh_faces[mesh_index[head]];
+      faces[t]->id = f.size();
+      f.push_back(faces[t]);
+    }
+
+    std::vector<mesh_t *> meshes;
+    for (size_t m = 0; m < mesh_faces.size(); ++m) {
+      meshes.push_back(new mesh_t(mesh_faces[m]));
+    }
+    return new meshset_t(vertex_storage, meshes);
+  }
+
+
+
+  meshset_t *extractSurface(const grid_t &grid,
+                            const std::vector<double> &field,
+                            carve::Executor &executor) {
+    static carve::TimingName FUNC_NAME("extractSurface()");
+    carve::TimingBlock block(FUNC_NAME);
+
+    std::vector<std::vector<edge_key_t> > slice_tris(grid.n[2] - 1);
+    ExtractTask task(grid, field, slice_tris);
+    carve::parallelFor(executor, grid.n[2] - 1, 1, task);
+
+    std::vector<edge_key_t> tri_edges;
+    for (size_t k = 0; k < slice_tris.size(); ++k) {
+      tri_edges.insert(tri_edges.end(), slice_tris[k].begin(), slice_tris[k].end());
+      std::vector<edge_key_t>().swap(slice_tris[k]);
+    }
+
+    std::vector<edge_key_t> vert_edges(tri_edges);
+    std::sort(vert_edges.begin(), vert_edges.end());
+    vert_edges.erase(std::unique(vert_edges.begin(), vert_edges.end()), vert_edges.end());
+
+    std::vector<size_t> tri_verts(tri_edges.size());
+    for (size_t i = 0; i < tri_edges.size(); ++i) {
+      tri_verts[i] = std::lower_bound(vert_edges.begin(), vert_edges.end(), tri_edges[i]) - vert_edges.begin();
+    }
+
+    std::vector<vertex_t> vertex_storage;
+    vertex_storage.reserve(vert_edges.size());
+    for (size_t i = 0; i < vert_edges.size(); ++i) {
+      vertex_storage.push_back(vertex_t(edgePoint(grid, field, vert_edges[i])));
+    }
+
+    return buildMeshSet(vertex_storage, tri_verts);
+  }
+
+}
+
+
+
+carve::mesh::MeshSet<3> *carve::csg::CSG::computePreview(meshset_t *a,
+                                                         meshset_t *b,
+                                                         carve::csg::CSG::OP op,
+                                                         unsigned resolution) {
+  static carve::TimingName FUNC_NAME("CSG::computePreview()");
+  carve::TimingBlock block(FUNC_NAME);
+
+  // the region in which the result can lie.
+  aabb_t a_box = a->getAABB(), b_box = b->getAABB();
+  vector_t lo, hi;
+  switch (op) {
+  case UNION:
+  case SYMMETRIC_DIFFERENCE:
+    lo = carve::geom::VECTOR(std::min(a_box.min().x, b_box.min().x),
+                             std::min(a_box.min().y, b_box.min().y),
+                             std::min(a_box.min().z, b_box.min().z));
+    hi = carve::geom::VECTOR(std::max(a_box.max().x, b_box.max().x),
+                             std::max(a_box.max().y, b_box.max().y),
+                             std::max(a_box.max().z, b_box.max().z));
+    break;
+  case INTERSECTION:
+    lo = carve::geom::VECTOR(std::max(a_box.min().x, b_box.min().x),
+                             std::max(a_box.min().y, b_box.min().y),
+                             std::max(a_box.min().z, b_box.min().z));
+    hi = carve::geom::VECTOR(std::min(a_box.max().x, b_box.max().x),
+                             std::min(a_box.max().y, b_box.max().y),
+                             std::min(a_box.max().z, b_box.max().z));
+    break;
+  case A_MINUS_B:
+    lo = a_box.min(); hi = a_box.max();
+    break;
+  case B_MINUS_A:
+    lo = b_box.min(); hi = b_box.max();
+    break;
+  default:
+    return NULL;
+  }
+
+  vector_t size = hi - lo;
+  double longest = std::max(size.x, std::max(size.y, size.z));
+  if (!(size.x >= 0.0 && size.y >= 0.0 && size.z >= 0.0) || longest <= 0.0) {
+    std::vector<vector_t> no_points;
+    std::vector<int> no_faces;
+    return new meshset_t(no_points, 0, no_faces);
+  }
+
+  grid_t grid;
+  grid.h = longest / std::max(resolution, 1U);
+  grid.origin = lo - carve::geom::VECTOR(grid.h, grid.h, grid.h) * (double)PAD;
+  for (unsigned d = 0; d < 3; ++d) {
+    grid.n[d] = (size_t)ceil(size.v[d] / grid.h) + 1 + 2 * PAD;
+  }
+
+  carve::Executor &executor = getExecutor();
+
+  std::vector<double> field, b_field;
+  sampleField(a, grid, executor, field);
+  hooks.checkCancelled("sampleField");
+  sampleField(b, grid, executor, b_field);
+  hooks.checkCancelled("sampleField");
+
+  // samples that are (nearly) on the surface are moved off it, so
+  // that extracted vertices never coincide with samples.
+  const double eps = grid.h * 1e-6;
+  for (size_t i = 0; i < field.size(); ++i) {
+    double fa = field[i], fb = b_field[i];
+    double f;
+    switch (op) {
+    case UNION:                f = std::min(fa, fb); break;
+    case INTERSECTION:         f = std::max(fa, fb); break;
+    case A_MINUS_B:            f = std::max(fa, -fb); break;
+    case B_MINUS_A:            f = std::max(fb, -fa); break;
+    default:                   f = std::min(std::max(fa, -fb), std::max(fb, -fa)); break;
+    }
+    if (fabs(f) < eps) f = eps;
+    field[i] = f;
+  }
+  std::vector<double>().swap(b_field);
+
+  return extractSurface(grid, field, executor);
+}
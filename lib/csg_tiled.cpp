@@ -0,0 +1,800 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/csg_tiled.hpp>
+#include <carve/triangulator.hpp>
+#include <carve/timing.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <map>
+#include <deque>
+#include <new>
+#include <exception>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+  typedef carve::csg::TiledCSG::vector_t vector_t;
+  typedef carve::mesh::MeshSet<3> meshset_t;
+  typedef meshset_t::face_t face_t;
+  typedef meshset_t::edge_t edge_t;
+  typedef std::vector<vector_t> polygon_t;
+
+  // when the pieces held in memory exceed this size, they are
+  // written out to the tile files.
+  const size_t MAX_BUFFERED_BYTES = 64 * 1024 * 1024;
+
+  // the position of the reference point of a tile, as a fraction of
+  // the tile size. The row lines pass through the reference points,
+  // so the offsets are chosen to avoid the axis aligned edges and
+  // diagonals that are common in real models.
+  const double REF_OFFSET[3] = { 0.4903718, 0.5137931, 0.4871203 };
+
+  // the offset of the grid from the minimum corner of the bounding
+  // box, as a fraction of the tile size. Faces at round coordinates
+  // then rarely lie in the walls between tiles, where the pieces of
+  // the other operand would end exactly on them.
+  const double GRID_OFFSET[3] = { 0.1372549, 0.2156863, 0.0862745 };
+
+  // barycentric weights of the sample point of a triangle.
+  const double SAMPLE_WEIGHT[3] = { 0.3183, 0.3679, 0.3138 };
+
+
+
+  vector_t newellNormal(const polygon_t &poly) {
+    vector_t n = carve::geom::VECTOR(0.0, 0.0, 0.0);
+    for (size_t i = 0, j = poly.size() - 1; i < poly.size(); j = i++) {
+      const vector_t &a = poly[j];
+      const vector_t &b = poly[i];
+      n.x += (a.y - b.y) * (a.z + b.z);
+      n.y += (a.z - b.z) * (a.x + b.x);
+      n.z += (a.x - b.x) * (a.y + b.y);
+    }
+    return n;
+  }
+
+
+
+  // The point at which the segment pq crosses the plane v[d] == w.
+  // The result depends only on the unordered pair {p, q}, so that
+  // tiles on either side of a wall compute identical points.
+  vector_t wallPoint(const vector_t &p, const vector_t &q, unsigned d, double w) {
+    if (p.v[d] == w) return p;
+    if (q.v[d] == w) return q;
+    const vector_t &u = (p < q) ? p : q;
+    const vector_t &v = (p < q) ? q : p;
+    double t = (w - u.v[d]) / (v.v[d] - u.v[d]);
+    vector_t r = u + (v - u) * t;
+    r.v[d] = w;
+    return r;
+  }
+
+
+
+  // Clip poly to lo <= v[d] <= hi. Both walls are handled in one
+  // pass, so that every new point is computed from an edge of the
+  // input polygon.
+  void clipSlab(polygon_t &poly, unsigned d, double lo, double hi, polygon_t &out) {
+    out.clear();
+    for (size_t i = 0; i < poly.size(); ++i) {
+      const vector_t &p = poly[i];
+      const vector_t &q = poly[(i + 1) % poly.size()];
+      int sp = p.v[d] < lo ? -1 : (p.v[d] > hi ? +1 : 0);
+      int sq = q.v[d] < lo ? -1 : (q.v[d] > hi ? +1 : 0);
+
+      if (sp == 0) out.push_back(p);
+      if (sp == sq) continue;
+
+      if (sp == -1) {
+        out.push_back(wallPoint(p, q, d, lo));
+        if (sq == +1) out.push_back(wallPoint(p, q, d, hi));
+      } else if (sp == +1) {
+        out.push_back(wallPoint(p, q, d, hi));
+        if (sq == -1) out.push_back(wallPoint(p, q, d, lo));
+      } else {
+        out.push_back(wallPoint(p, q, d, sq == +1 ? hi : lo));
+      }
+    }
+    poly.swap(out);
+  }
+
+
+
+  meshset_t *makeMeshSet(const std::vector<polygon_t> &polygons) {
+    std::map<vector_t, int> index;
+    std::vector<vector_t> points;
+    std::vector<int> face_indices;
+
+    for (size_t i = 0; i < polygons.size(); ++i) {
+      face_indices.push_back((int)polygons[i].size());
+      for (size_t j = 0; j < polygons[i].size(); ++j) {
+        std::map<vector_t, int>::iterator k = index.find(polygons[i][j]);
+        if (k == index.end()) {
+          k = index.insert(std::make_pair(polygons[i][j], (int)points.size())).first;
+          points.push_back(polygons[i][j]);
+        }
+        face_indices.push_back(k->second);
+      }
+    }
+
+    return new meshset_t(points, polygons.size(), face_indices);
+  }
+
+
+
+  // A point strictly inside a face, away from its edges.
+  vector_t samplePoint(const face_t *face) {
+    std::vector<carve::geom2d::P2> projected;
+    std::vector<vector_t> verts;
+    const edge_t *e = face->edge;
+    do {
+      verts.push_back(e->vert->v);
+      projected.push_back(face->project(e->vert->v));
+      e = e->next;
+    } while (e != face->edge);
+
+    std::vector<carve::triangulate::tri_idx> tris;
+    try {
+      carve::triangulate::triangulate(projected, tris);
+    } catch (carve::exception &) {
+      tris.clear();
+    }
+    if (tris.empty()) return face->centroid();
+
+    size_t best = 0;
+    double best_area = -1.0;
+    for (size_t i = 0; i < tris.size(); ++i) {
+      double area = carve::geom::cross(verts[tris[i].b] - verts[tris[i].a],
+                                       verts[tris[i].c] - verts[tris[i].a]).length2();
+      if (area > best_area) {
+        best_area = area;
+        best = i;
+      }
+    }
+    return
+      verts[tris[best].a] * SAMPLE_WEIGHT[0] +
+      verts[tris[best].b] * SAMPLE_WEIGHT[1] +
+      verts[tris[best].c] * SAMPLE_WEIGHT[2];
+  }
+
+
+
+  // True if the segment cp crosses an odd number of the (convex)
+  // polygons.
+  bool crossesOdd(const vector_t &c, const vector_t &p, const std::vector<polygon_t> &polygons) {
+    bool odd = false;
+    for (size_t i = 0; i < polygons.size(); ++i) {
+      const polygon_t &poly = polygons[i];
+      vector_t n = newellNormal(poly);
+      double sc = carve::geom::dot(n, c - poly[0]);
+      double sp = carve::geom::dot(n, p - poly[0]);
+      if ((sc > 0.0) == (sp > 0.0) || sc == 0.0 || sp == 0.0) continue;
+
+      vector_t x = c + (p - c) * (sc / (sc - sp));
+      bool pos = false, neg = false;
+      for (size_t j = 0, k = poly.size() - 1; j < poly.size(); k = j++) {
+        double s = carve::geom::dot(carve::geom::cross(poly[j] - poly[k], x - poly[k]), n);
+        if (s > 0.0) pos = true;
+        if (s < 0.0) neg = true;
+      }
+      if (!(pos && neg)) odd = !odd;
+    }
+    return odd;
+  }
+
+
+
+  // 0 if a patch of operand is discarded by op, +1 if it is kept and
+  // -1 if it is kept with its orientation reversed.
+  int keepPatch(carve::csg::CSG::OP op, int operand, bool inside) {
+    switch (op) {
+    case carve::csg::CSG::UNION:
+      return inside ? 0 : +1;
+    case carve::csg::CSG::INTERSECTION:
+      return inside ? +1 : 0;
+    case carve::csg::CSG::A_MINUS_B:
+      if (operand == carve::csg::TiledCSG::A) return inside ? 0 : +1;
+      return inside ? -1 : 0;
+    case carve::csg::CSG::B_MINUS_A:
+      if (operand == carve::csg::TiledCSG::B) return inside ? 0 : +1;
+      return inside ? -1 : 0;
+    case carve::csg::CSG::SYMMETRIC_DIFFERENCE:
+      return inside ? -1 : +1;
+    default:
+      return 0;
+    }
+  }
+
+
+
+  struct weld_key_t {
+    long long k[3];
+
+    bool operator<(const weld_key_t &o) const {
+      return std::lexicographical_compare(k, k + 3, o.k, o.k + 3);
+    }
+  };
+
+  // Merges output vertices that lie on tile walls with those of
+  // neighbouring tiles that are within a tolerance. Vertices are
+  // inserted in tile order, and released once every tile that could
+  // share them has been emitted.
+  class wall_weld_t {
+    double tol;
+    std::map<weld_key_t, std::vector<std::pair<vector_t, size_t> > > cells;
+    // the cell and tile of each inserted vertex, in insertion order.
+    std::deque<std::pair<weld_key_t, size_t> > inserted;
+
+    weld_key_t key(const vector_t &v) const {
+      weld_key_t r;
+      for (unsigned d = 0; d < 3; ++d) r.k[d] = (long long)std::floor(v.v[d] / tol);
+      return r;
+    }
+
+  public:
+    wall_weld_t(double _tol) : tol(_tol), cells(), inserted() {
+    }
+
+    bool find(const vector_t &v, size_t &index) const {
+      weld_key_t base = key(v);
+      for (int dx = -1; dx <= 1; ++dx) {
+        for (int dy = -1; dy <= 1; ++dy) {
+          for (int dz = -1; dz <= 1; ++dz) {
+            weld_key_t k = base;
+            k.k[0] += dx; k.k[1] += dy; k.k[2] += dz;
+            std::map<weld_key_t, std::vector<std::pair<vector_t, size_t> > >::const_iterator i = cells.find(k);
+            if (i == cells.end()) continue;
+            for (size_t j = 0; j < (*i).second.size(); ++j) {
+              const vector_t &w = (*i).second[j].first;
+              if (std::fabs(w.x - v.x) <= tol && std::fabs(w.y - v.y) <= tol && std::fabs(w.z - v.z) <= tol) {
+                index = (*i).second[j].second;
+                return true;
+              }
+            }
+          }
+        }
+      }
+      return false;
+    }
+
+    void insert(const vector_t &v, size_t index, size_t tile) {
+      weld_key_t k = key(v);
+      cells[k].push_back(std::make_pair(v, index));
+      inserted.push_back(std::make_pair(k, tile));
+    }
+
+    // forget the vertices inserted by tiles up to and including tile.
+    void release(size_t tile) {
+      while (inserted.size() && inserted.front().second <= tile) {
+        std::map<weld_key_t, std::vector<std::pair<vector_t, size_t> > >::iterator i = cells.find(inserted.front().first);
+        // each cell holds its vertices in insertion order.
+        (*i).second.erase((*i).second.begin());
+        if ((*i).second.empty()) cells.erase(i);
+        inserted.pop_front();
+      }
+    }
+  };
+
+}
+
+
+
+struct carve::csg::TiledCSG::tile_result_t {
+  enum error_t {
+    TILE_OK,
+    TILE_CARVE_ERROR,
+    TILE_OUT_OF_MEMORY,
+    TILE_OTHER_ERROR
+  };
+
+  std::vector<vector_t> vertices;
+  // for each face, the number of vertices followed by their indices.
+  std::vector<size_t> faces;
+  error_t error;
+  std::string message;
+
+  tile_result_t() : vertices(), faces(), error(TILE_OK), message() {
+  }
+
+  // rethrow, on the calling thread, an exception caught while
+  // processing the tile.
+  void rethrow() const {
+    switch (error) {
+    case TILE_OK:
+      return;
+    case TILE_OUT_OF_MEMORY:
+      throw std::bad_alloc();
+    default:
+      throw carve::exception(message);
+    }
+  }
+};
+
+
+
+class carve::csg::TiledCSG::TileTask : public carve::ParallelTask {
+  const TiledCSG &tiled;
+  CSG::OP op;
+  const size_t *tile;
+  const std::vector<unsigned char> &inside;
+  std::vector<tile_result_t> &results;
+
+public:
+  TileTask(const TiledCSG &_tiled,
+           CSG::OP _op,
+           const size_t *_tile,
+           const std::vector<unsigned char> &_inside,
+           std::vector<tile_result_t> &_results) :
+      tiled(_tiled), op(_op), tile(_tile), inside(_inside), results(_results) {
+  }
+
+  virtual void run(size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      // exceptions must not escape a parallel task.
+      try {
+        tiled.processTile(tile[i], op, inside[tile[i]], results[i]);
+      } catch (carve::exception &e) {
+        results[i].error = tile_result_t::TILE_CARVE_ERROR;
+        results[i].message = e.str();
+      } catch (std::bad_alloc &) {
+        results[i].error = tile_result_t::TILE_OUT_OF_MEMORY;
+      } catch (std::exception &e) {
+        results[i].error = tile_result_t::TILE_OTHER_ERROR;
+        results[i].message = std::string("TiledCSG: ") + e.what();
+      } catch (...) {
+        results[i].error = tile_result_t::TILE_OTHER_ERROR;
+        results[i].message = "TiledCSG: unknown exception";
+      }
+    }
+  }
+};
+
+
+
+carve::csg::TiledCSG::TiledCSG(const aabb_t &_bounds, double _tile_size, const std::string &_work_dir) :
+    bounds(_bounds), tile_size(_tile_size), work_dir(_work_dir), tiles(), buffered_bytes(0), executor(NULL) {
+  if (!(tile_size > 0.0)) throw carve::exception("TiledCSG: tile size must be positive");
+
+  for (unsigned d = 0; d < 3; ++d) {
+    n[d] = (size_t)std::ceil(2.0 * bounds.extent.v[d] / tile_size + GRID_OFFSET[d]);
+    n[d] = std::max((size_t)1, n[d]);
+    wall[d].resize(n[d] + 1);
+    double origin = bounds.min(d) - tile_size * GRID_OFFSET[d];
+    for (size_t i = 0; i <= n[d]; ++i) wall[d][i] = origin + (double)i * tile_size;
+  }
+  tiles.resize(n[0] * n[1] * n[2]);
+}
+
+
+
+carve::csg::TiledCSG::~TiledCSG() {
+  for (size_t i = 0; i < tiles.size(); ++i) {
+    for (int o = 0; o < 2; ++o) {
+      if (tiles[i].on_disk[o]) std::remove(tilePath(i, o).c_str());
+    }
+  }
+}
+
+
+
+std::string carve::csg::TiledCSG::tilePath(size_t tile, int operand) const {
+  std::ostringstream path;
+  path << work_dir << "/carve_tile_" << tile << (operand == A ? "_a" : "_b") << ".bin";
+  return path.str();
+}
+
+
+
+carve::csg::TiledCSG::vector_t carve::csg::TiledCSG::referencePoint(size_t tile) const {
+  size_t idx[3] = { tile % n[0], (tile / n[0]) % n[1], tile / (n[0] * n[1]) };
+  vector_t r;
+  for (unsigned d = 0; d < 3; ++d) r.v[d] = wall[d][idx[d]] + tile_size * REF_OFFSET[d];
+  return r;
+}
+
+
+
+void carve::csg::TiledCSG::addFace(operand_t operand, const std::vector<vector_t> &polygon) {
+  if (polygon.size() < 3) return;
+  if (polygon.size() == 3) {
+    addTriangle(operand, polygon[0], polygon[1], polygon[2]);
+    return;
+  }
+
+  vector_t normal = newellNormal(polygon);
+  unsigned axis = carve::geom::largestAxis(normal);
+  if (normal.v[axis] == 0.0) return;
+
+  // project so that the polygon is anticlockwise in the plane.
+  unsigned u = (axis + 1) % 3, v = (axis + 2) % 3;
+  if (normal.v[axis] < 0.0) std::swap(u, v);
+
+  std::vector<carve::geom2d::P2> projected;
+  projected.reserve(polygon.size());
+  for (size_t i = 0; i < polygon.size(); ++i) {
+    projected.push_back(carve::geom::VECTOR(polygon[i].v[u], polygon[i].v[v]));
+  }
+
+  std::vector<carve::triangulate::tri_idx> tris;
+  try {
+    carve::triangulate::triangulate(projected, tris);
+  } catch (carve::exception &) {
+    tris.clear();
+  }
+  if (tris.empty()) {
+    for (unsigned i = 1; i + 1 < polygon.size(); ++i) {
+      tris.push_back(carve::triangulate::tri_idx(0, i, i + 1));
+    }
+  }
+
+  for (size_t i = 0; i < tris.size(); ++i) {
+    const vector_t &a = polygon[tris[i].a];
+    const vector_t &b = polygon[tris[i].b];
+    const vector_t &c = polygon[tris[i].c];
+    if (carve::geom::dot(carve::geom::cross(b - a, c - a), normal) < 0.0) {
+      addTriangle(operand, a, c, b);
+    } else {
+      addTriangle(operand, a, b, c);
+    }
+  }
+}
+
+
+
+void carve::csg::TiledCSG::addMeshSet(operand_t operand, const meshset_t *meshset) {
+  std::vector<vector_t> polygon;
+  for (size_t m = 0; m < meshset->meshes.size(); ++m) {
+    const std::vector<face_t *> &faces = meshset->meshes[m]->faces;
+    for (size_t f = 0; f < faces.size(); ++f) {
+      polygon.clear();
+      const edge_t *e = faces[f]->edge;
+      do {
+        polygon.push_back(e->vert->v);
+        e = e->next;
+      } while (e != faces[f]->edge);
+      addFace(operand, polygon);
+    }
+  }
+}
+
+
+
+void carve::csg::TiledCSG::addTriangle(int operand, const vector_t &a, const vector_t &b, const vector_t &c) {
+  countRowCrossings(operand, a, b, c);
+
+  vector_t tri[3] = { a, b, c };
+  size_t lo[3], hi[3];
+  for (unsigned d = 0; d < 3; ++d) {
+    double mn = std::min(a.v[d], std::min(b.v[d], c.v[d]));
+    double mx = std::max(a.v[d], std::max(b.v[d], c.v[d]));
+    if (mx < wall[d][0] || mn > wall[d][n[d]]) return;
+    lo[d] = (size_t)std::max(0.0, std::floor((mn - wall[d][0]) / tile_size));
+    hi[d] = (size_t)std::max(0.0, std::floor((mx - wall[d][0]) / tile_size));
+    lo[d] = std::min(lo[d], n[d] - 1);
+    hi[d] = std::min(hi[d], n[d] - 1);
+  }
+
+  size_t idx[3];
+  for (idx[2] = lo[2]; idx[2] <= hi[2]; ++idx[2]) {
+    for (idx[1] = lo[1]; idx[1] <= hi[1]; ++idx[1]) {
+      for (idx[0] = lo[0]; idx[0] <= hi[0]; ++idx[0]) {
+        clipToTile(operand, idx, tri);
+      }
+    }
+  }
+
+  if (buffered_bytes > MAX_BUFFERED_BYTES) flushAll();
+}
+
+
+
+void carve::csg::TiledCSG::countRowCrossings(int operand, const vector_t &a, const vector_t &b, const vector_t &c) {
+  double ymin = std::min(a.y, std::min(b.y, c.y)), ymax = std::max(a.y, std::max(b.y, c.y));
+  double zmin = std::min(a.z, std::min(b.z, c.z)), zmax = std::max(a.z, std::max(b.z, c.z));
+
+  double j0 = std::ceil((ymin - wall[1][0]) / tile_size - REF_OFFSET[1]);
+  double j1 = std::floor((ymax - wall[1][0]) / tile_size - REF_OFFSET[1]);
+  double k0 = std::ceil((zmin - wall[2][0]) / tile_size - REF_OFFSET[2]);
+  double k1 = std::floor((zmax - wall[2][0]) / tile_size - REF_OFFSET[2]);
+  if (j1 < 0.0 || k1 < 0.0 || j0 >= (double)n[1] || k0 >= (double)n[2]) return;
+  j0 = std::max(j0, 0.0); j1 = std::min(j1, (double)n[1] - 1);
+  k0 = std::max(k0, 0.0); k1 = std::min(k1, (double)n[2] - 1);
+
+  for (size_t k = (size_t)k0; k <= (size_t)k1; ++k) {
+    double z = wall[2][k] + tile_size * REF_OFFSET[2];
+    for (size_t j = (size_t)j0; j <= (size_t)j1; ++j) {
+      double y = wall[1][j] + tile_size * REF_OFFSET[1];
+
+      double wa = (c.y - b.y) * (z - b.z) - (c.z - b.z) * (y - b.y);
+      double wb = (a.y - c.y) * (z - c.z) - (a.z - c.z) * (y - c.y);
+      double wc = (b.y - a.y) * (z - a.z) - (b.z - a.z) * (y - a.y);
+      if (!((wa > 0.0 && wb > 0.0 && wc > 0.0) || (wa < 0.0 && wb < 0.0 && wc < 0.0))) continue;
+
+      double x = (wa * a.x + wb * b.x + wc * c.x) / (wa + wb + wc);
+      double fi = std::floor((x - wall[0][0]) / tile_size);
+      size_t i = (size_t)std::max(0.0, std::min(fi, (double)n[0] - 1));
+      double xc = wall[0][i] + tile_size * REF_OFFSET[0];
+      tiles[tileIndex(i, j, k)].crossings[operand] ^= (x < xc) ? 1 : 2;
+    }
+  }
+}
+
+
+
+void carve::csg::TiledCSG::clipToTile(int operand, const size_t *idx, const vector_t *tri) {
+  polygon_t poly(tri, tri + 3), tmp;
+  for (unsigned d = 0; d < 3 && poly.size() >= 3; ++d) {
+    clipSlab(poly, d, wall[d][idx[d]], wall[d][idx[d] + 1], tmp);
+  }
+
+  tmp.clear();
+  for (size_t i = 0; i < poly.size(); ++i) {
+    if (poly[i] != poly[(i + 1) % poly.size()]) tmp.push_back(poly[i]);
+  }
+  if (tmp.size() < 3) return;
+
+  // a piece in the wall between two tiles belongs to the higher one.
+  for (unsigned d = 0; d < 3; ++d) {
+    if (idx[d] + 1 == n[d]) continue;
+    size_t i = 0;
+    while (i < tmp.size() && tmp[i].v[d] == wall[d][idx[d] + 1]) ++i;
+    if (i == tmp.size()) return;
+  }
+
+  if (newellNormal(tmp).length() <= carve::EPSILON2 * tile_size * tile_size) return;
+
+  std::vector<double> &buf = tiles[tileIndex(idx[0], idx[1], idx[2])].buffer[operand];
+  buf.push_back((double)tmp.size());
+  for (size_t i = 0; i < tmp.size(); ++i) {
+    buf.push_back(tmp[i].x);
+    buf.push_back(tmp[i].y);
+    buf.push_back(tmp[i].z);
+  }
+  buffered_bytes += (1 + 3 * tmp.size()) * sizeof(double);
+}
+
+
+
+void carve::csg::TiledCSG::flush(size_t tile, int operand) {
+  std::vector<double> &buf = tiles[tile].buffer[operand];
+  if (buf.empty()) return;
+
+  // the first flush replaces any file left by an earlier instance.
+  std::string path = tilePath(tile, operand);
+  std::ofstream out(path.c_str(), std::ios::binary | (tiles[tile].on_disk[operand] ? std::ios::app : std::ios::trunc));
+  out.write((const char *)&buf[0], (std::streamsize)(buf.size() * sizeof(double)));
+  out.close();
+  if (out.fail()) throw carve::exception("TiledCSG: failed to write ") << path;
+
+  tiles[tile].on_disk[operand] = true;
+  buffered_bytes -= buf.size() * sizeof(double);
+  std::vector<double>().swap(buf);
+}
+
+
+
+void carve::csg::TiledCSG::flushAll() {
+  for (size_t i = 0; i < tiles.size(); ++i) {
+    flush(i, A);
+    flush(i, B);
+  }
+}
+
+
+
+void carve::csg::TiledCSG::readTile(size_t tile, int operand, std::vector<polygon_t> &polygons) const {
+  std::vector<double> data;
+  if (tiles[tile].on_disk[operand]) {
+    std::string path = tilePath(tile, operand);
+    std::ifstream in(path.c_str(), std::ios::binary | std::ios::ate);
+    std::streamoff size = in.tellg();
+    if (size < 0) throw carve::exception("TiledCSG: failed to read ") << path;
+    data.resize((size_t)size / sizeof(double));
+    in.seekg(0);
+    if (!data.empty()) in.read((char *)&data[0], (std::streamsize)(data.size() * sizeof(double)));
+    if (in.fail()) throw carve::exception("TiledCSG: failed to read ") << path;
+  }
+  const std::vector<double> &buf = tiles[tile].buffer[operand];
+  data.insert(data.end(), buf.begin(), buf.end());
+
+  size_t i = 0;
+  while (i < data.size()) {
+    size_t n_verts = (size_t)data[i++];
+    if (i + 3 * n_verts > data.size()) throw carve::exception("TiledCSG: corrupt tile file");
+    polygons.push_back(polygon_t());
+    polygon_t &poly = polygons.back();
+    poly.reserve(n_verts);
+    for (size_t j = 0; j < n_verts; ++j, i += 3) {
+      poly.push_back(carve::geom::VECTOR(data[i], data[i + 1], data[i + 2]));
+    }
+  }
+}
+
+
+
+void carve::csg::TiledCSG::processTile(size_t tile, CSG::OP op, unsigned inside, tile_result_t &result) const {
+  std::vector<polygon_t> polygons[2];
+  readTile(tile, A, polygons[A]);
+  readTile(tile, B, polygons[B]);
+
+  const vector_t ref = referencePoint(tile);
+  std::map<vector_t, size_t> index;
+  std::vector<size_t> face;
+
+  if (polygons[A].empty() || polygons[B].empty()) {
+    // only one surface passes through the tile, so the whole tile is
+    // on one side of the other.
+    for (int o = 0; o < 2; ++o) {
+      int keep = keepPatch(op, o, (inside >> (1 - o)) & 1);
+      if (!keep) continue;
+      for (size_t i = 0; i < polygons[o].size(); ++i) {
+        const polygon_t &poly = polygons[o][i];
+        face.clear();
+        for (size_t j = 0; j < poly.size(); ++j) {
+          std::map<vector_t, size_t>::iterator k = index.find(poly[j]);
+          if (k == index.end()) {
+            k = index.insert(std::make_pair(poly[j], result.vertices.size())).first;
+            result.vertices.push_back(poly[j]);
+          }
+          face.push_back(k->second);
+        }
+        if (keep < 0) std::reverse(face.begin(), face.end());
+        result.faces.push_back(face.size());
+        result.faces.insert(result.faces.end(), face.begin(), face.end());
+      }
+    }
+    return;
+  }
+
+  std::auto_ptr<meshset_t> meshes[2];
+  meshes[A].reset(makeMeshSet(polygons[A]));
+  meshes[B].reset(makeMeshSet(polygons[B]));
+
+  std::list<meshset_t *> patches[2];
+  CSG csg;
+  csg.executor = executor;
+  csg.slice(meshes[A].get(), meshes[B].get(), patches[A], patches[B]);
+
+  for (int o = 0; o < 2; ++o) {
+    for (std::list<meshset_t *>::iterator i = patches[o].begin(); i != patches[o].end(); ++i) {
+      std::auto_ptr<meshset_t> patch(*i);
+      if (patch->meshes.empty() || patch->meshes[0]->faces.empty()) continue;
+
+      // the other surface crosses cp an odd number of times if c and
+      // p are on opposite sides of it.
+      vector_t p = samplePoint(patch->meshes[0]->faces[0]);
+      bool in = (((inside >> (1 - o)) & 1) != 0) != crossesOdd(ref, p, polygons[1 - o]);
+
+      int keep = keepPatch(op, o, in);
+      if (!keep) continue;
+
+      for (meshset_t::face_iter f = patch->faceBegin(); f != patch->faceEnd(); ++f) {
+        face.clear();
+        const edge_t *e = (*f)->edge;
+        do {
+          std::map<vector_t, size_t>::iterator k = index.find(e->vert->v);
+          if (k == index.end()) {
+            k = index.insert(std::make_pair(e->vert->v, result.vertices.size())).first;
+            result.vertices.push_back(e->vert->v);
+          }
+          face.push_back(k->second);
+          e = e->next;
+        } while (e != (*f)->edge);
+        if (keep < 0) std::reverse(face.begin(), face.end());
+        result.faces.push_back(face.size());
+        result.faces.insert(result.faces.end(), face.begin(), face.end());
+      }
+    }
+  }
+}
+
+
+
+void carve::csg::TiledCSG::compute(CSG::OP op, Output &output) {
+  static carve::TimingName FUNC_NAME("TiledCSG::compute()");
+  carve::TimingBlock block(FUNC_NAME);
+
+  if (op == CSG::ALL) throw carve::exception("TiledCSG: ALL is not supported");
+
+  // the reference point of a tile is inside an operand if the row
+  // line crosses it an odd number of times before the point.
+  std::vector<unsigned char> inside(tiles.size(), 0);
+  std::vector<size_t> work;
+  for (size_t k = 0; k < n[2]; ++k) {
+    for (size_t j = 0; j < n[1]; ++j) {
+      unsigned before[2] = { 0, 0 };
+      for (size_t i = 0; i < n[0]; ++i) {
+        size_t t = tileIndex(i, j, k);
+        const tile_t &tile = tiles[t];
+        for (int o = 0; o < 2; ++o) {
+          unsigned c = tile.crossings[o];
+          if ((before[o] ^ c) & 1) inside[t] |= (unsigned char)(1 << o);
+          before[o] ^= (c ^ (c >> 1)) & 1;
+        }
+        if (tile.on_disk[A] || tile.on_disk[B] || !tile.buffer[A].empty() || !tile.buffer[B].empty()) {
+          work.push_back(t);
+        }
+      }
+    }
+  }
+
+  double scale = 1.0;
+  for (unsigned d = 0; d < 3; ++d) {
+    scale = std::max(scale, std::max(std::fabs(wall[d][0]), std::fabs(wall[d][n[d]])));
+  }
+  const double tol = carve::EPSILON * scale;
+  wall_weld_t weld(tol);
+  size_t n_out = 0;
+  // tiles are emitted in index order, and the highest index of a
+  // neighbouring tile is this far above that of the tile itself.
+  const size_t reach = n[0] * n[1] + n[0] + 1;
+
+  carve::Executor &exec = executor != NULL ? *executor : carve::defaultExecutor();
+  const size_t batch = std::max(1U, exec.concurrency());
+
+  std::vector<size_t> remap, face;
+  for (size_t b = 0; b < work.size(); b += batch) {
+    const size_t e = std::min(work.size(), b + batch);
+    std::vector<tile_result_t> results(e - b);
+    TileTask task(*this, op, &work[b], inside, results);
+    carve::parallelFor(exec, e - b, 1, task);
+
+    for (size_t r = 0; r < results.size(); ++r) {
+      const tile_result_t &result = results[r];
+      result.rethrow();
+
+      const size_t t = work[b + r];
+      const size_t idx[3] = { t % n[0], (t / n[0]) % n[1], t / (n[0] * n[1]) };
+
+      remap.resize(result.vertices.size());
+      for (size_t i = 0; i < result.vertices.size(); ++i) {
+        const vector_t &v = result.vertices[i];
+        bool on_wall = false;
+        for (unsigned d = 0; d < 3 && !on_wall; ++d) {
+          on_wall =
+            std::fabs(v.v[d] - wall[d][idx[d]]) <= tol ||
+            std::fabs(v.v[d] - wall[d][idx[d] + 1]) <= tol;
+        }
+        if (on_wall && weld.find(v, remap[i])) continue;
+        output.vertex(v);
+        remap[i] = n_out++;
+        if (on_wall) weld.insert(v, remap[i], t);
+      }
+      if (t >= reach) weld.release(t - reach);
+
+      for (size_t i = 0; i < result.faces.size(); ) {
+        size_t n_verts = result.faces[i++];
+        face.clear();
+        for (size_t j = 0; j < n_verts; ++j) {
+          size_t v = remap[result.faces[i + j]];
+          if (face.empty() || face.back() != v) face.push_back(v);
+        }
+        i += n_verts;
+        while (face.size() > 1 && face.front() == face.back()) face.pop_back();
+        if (face.size() >= 3) output.face(face);
+      }
+    }
+  }
+}
@@ -0,0 +1,162 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/executor.hpp>
+
+#include <algorithm>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+namespace carve {
+  namespace {
+
+    OpenMPExecutor builtin_executor;
+    Executor *default_executor = &builtin_executor;
+
+    // runs the chunks c, c + stride, c + 2 * stride, ... of a range on
+    // behalf of LimitedExecutor; one worker per call of run().
+    class StridedTask : public ParallelTask {
+      ParallelTask &task;
+      size_t n, grain, n_chunks, stride;
+
+    public:
+      StridedTask(ParallelTask &_task, size_t _n, size_t _grain, size_t _n_chunks, size_t _stride) :
+          task(_task), n(_n), grain(_grain), n_chunks(_n_chunks), stride(_stride) {
+      }
+
+      virtual void run(size_t begin, size_t end) {
+        for (size_t w = begin; w < end; ++w) {
+          for (size_t c = w; c < n_chunks; c += stride) {
+            task.run(c * grain, std::min(n, (c + 1) * grain));
+          }
+        }
+      }
+    };
+
+    class TaskListTask : public ParallelTask {
+      const std::vector<Task *> &tasks;
+
+    public:
+      TaskListTask(const std::vector<Task *> &_tasks) : tasks(_tasks) {
+      }
+
+      virtual void run(size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) tasks[i]->run();
+      }
+    };
+
+  }
+
+
+
+  void SerialExecutor::parallelFor(size_t n, size_t grain, ParallelTask &task) {
+    if (!grain) grain = 1;
+    for (size_t b = 0; b < n; b += grain) {
+      task.run(b, std::min(n, b + grain));
+    }
+  }
+
+
+
+  unsigned SerialExecutor::concurrency() const {
+    return 1;
+  }
+
+
+
+  void OpenMPExecutor::parallelFor(size_t n, size_t grain, ParallelTask &task) {
+    if (!grain) grain = 1;
+    const size_t n_chunks = (n + grain - 1) / grain;
+
+#if defined(_OPENMP)
+    if (n_chunks > 1 && max_threads != 1 && !omp_in_parallel()) {
+      const int n_threads = max_threads ? (int)max_threads : omp_get_max_threads();
+#pragma omp parallel for schedule(dynamic, 1) num_threads(n_threads)
+      for (int c = 0; c < (int)n_chunks; ++c) {
+        task.run(c * grain, std::min(n, (c + 1) * grain));
+      }
+      return;
+    }
+#endif
+
+    for (size_t c = 0; c < n_chunks; ++c) {
+      task.run(c * grain, std::min(n, (c + 1) * grain));
+    }
+  }
+
+
+
+  unsigned OpenMPExecutor::concurrency() const {
+#if defined(_OPENMP)
+    return max_threads ? max_threads : (unsigned)omp_get_max_threads();
+#else
+    return 1;
+#endif
+  }
+
+
+
+  void LimitedExecutor::parallelFor(size_t n, size_t grain, ParallelTask &task) {
+    if (!grain) grain = 1;
+    const size_t n_chunks = (n + grain - 1) / grain;
+    const size_t n_workers = std::min((size_t)concurrency(), n_chunks);
+    if (n_workers == n_chunks) {
+      base.parallelFor(n, grain, task);
+      return;
+    }
+    StridedTask strided(task, n, grain, n_chunks, n_workers);
+    base.parallelFor(n_workers, 1, strided);
+  }
+
+
+
+  unsigned LimitedExecutor::concurrency() const {
+    return std::min(limit, base.concurrency());
+  }
+
+
+
+  TaskGroup::TaskGroup(Executor &_executor) : executor(_executor), tasks() {
+  }
+
+
+
+  void TaskGroup::wait() {
+    TaskListTask list(tasks);
+    executor.parallelFor(tasks.size(), 1, list);
+    tasks.clear();
+  }
+
+
+
+  Executor &defaultExecutor() {
+    return *default_executor;
+  }
+
+
+
+  void setDefaultExecutor(Executor *executor) {
+    default_executor = executor ? executor : &builtin_executor;
+  }
+
+}
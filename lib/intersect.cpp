@@ -40,35 +40,113 @@
 
 #include <carve/timing.hpp>
 #include <carve/colour.hpp>
+#include <carve/executor.hpp>
 
 #include <memory>
 
 
 
-carve::csg::VertexPool::VertexPool() {
+namespace {
+  // approximate per-entry overheads of the node based containers.
+  const size_t HASH_NODE_OVERHEAD = 3 * sizeof(void *);
+  const size_t TREE_NODE_OVERHEAD = 4 * sizeof(void *);
+
+  template<typename container_t>
+  size_t hashBytes(const container_t &c) {
+    return c.size() * (sizeof(typename container_t::value_type) + HASH_NODE_OVERHEAD);
+  }
+
+  template<typename container_t>
+  size_t treeBytes(const container_t &c) {
+    return c.size() * (sizeof(typename container_t::value_type) + TREE_NODE_OVERHEAD);
+  }
+
+  template<typename map_t>
+  size_t hashOfTreesBytes(const map_t &m) {
+    size_t bytes = hashBytes(m);
+    for (typename map_t::const_iterator i = m.begin(); i != m.end(); ++i) {
+      bytes += treeBytes((*i).second);
+    }
+    return bytes;
+  }
+
+  template<typename map_t>
+  size_t hashOfVectorsBytes(const map_t &m) {
+    size_t bytes = hashBytes(m);
+    for (typename map_t::const_iterator i = m.begin(); i != m.end(); ++i) {
+      bytes += (*i).second.capacity() * sizeof(typename map_t::mapped_type::value_type);
+    }
+    return bytes;
+  }
+
+  // an edge added to face_a (the face a result belongs to) and face_b
+  // by makeFaceEdges(). v1 < v2.
+  struct face_edge_t {
+    carve::mesh::MeshSet<3>::face_t *face_b;
+    carve::mesh::MeshSet<3>::vertex_t *v1, *v2;
+
+    face_edge_t(carve::mesh::MeshSet<3>::face_t *_face_b,
+                carve::mesh::MeshSet<3>::vertex_t *_v1,
+                carve::mesh::MeshSet<3>::vertex_t *_v2) : face_b(_face_b), v1(_v1), v2(_v2) {
+    }
+  };
 }
 
-carve::csg::VertexPool::~VertexPool() {
+
+
+void carve::csg::detail::Data::account() {
+  if (!carve::MemoryAccounting::enabled()) return;
+
+  size_t bytes = hashBytes(vmap);
+  bytes += hashBytes(emap);
+  for (EIntMap::const_iterator i = emap.begin(); i != emap.end(); ++i) {
+    const EdgeIntInfo &info = (*i).second;
+    bytes += treeBytes(info);
+    for (EdgeIntInfo::const_iterator j = info.begin(); j != info.end(); ++j) {
+      bytes += treeBytes((*j).second);
+    }
+  }
+  bytes += hashOfTreesBytes(fmap);
+  bytes += hashOfTreesBytes(fmap_rev);
+  bytes += hashOfVectorsBytes(divided_edges);
+  bytes += hashOfTreesBytes(face_split_edges);
+  bytes += hashOfVectorsBytes(vert_to_edges);
+  gauge.set(bytes);
 }
 
-void carve::csg::VertexPool::reset() {
-  pool.clear();
+
+
+carve::csg::VertexPool::VertexPool() : slabs(), slab_used(0), blocks(), next(NULL), end(NULL) {
 }
 
-carve::csg::VertexPool::vertex_t *carve::csg::VertexPool::get(const vertex_t::vector_t &v) {
-  if (!pool.size() || pool.back().size() == blocksize) {
-    pool.push_back(std::vector<vertex_t>());
-    pool.back().reserve(blocksize);
-  }
-  pool.back().push_back(vertex_t(v));
-  return &pool.back().back();
+carve::csg::VertexPool::~VertexPool() {
+  reset();
 }
 
-bool carve::csg::VertexPool::inPool(vertex_t *v) const {
-  for (pool_t::const_iterator i = pool.begin(); i != pool.end(); ++i) {
-    if (v >= &(i->front()) && v <= &(i->back())) return true;
-  }
-  return false;
+void carve::csg::VertexPool::reset() {
+  // vertex_t has a trivial destructor, so the blocks are simply freed.
+  carve::tracking_allocator<char> alloc;
+  for (size_t i = 0; i < slabs.size(); ++i) {
+    alloc.deallocate(slabs[i].mem, (slabs[i].n_blocks + 1) * block_bytes);
+  }
+  slabs.clear();
+  slab_used = 0;
+  blocks.clear();
+  next = end = NULL;
+}
+
+void carve::csg::VertexPool::acquireBlock() {
+  if (slabs.empty() || slab_used == slabs.back().n_blocks) {
+    size_t n_blocks = slabs.empty() ? 1 : slabs.back().n_blocks * 2;
+    if (n_blocks > max_slab_blocks) n_blocks = max_slab_blocks;
+    slabs.push_back(slab_t(carve::tracking_allocator<char>().allocate((n_blocks + 1) * block_bytes), n_blocks));
+    slab_used = 0;
+  }
+  size_t base = ((size_t)slabs.back().mem + block_bytes - 1) & ~(block_bytes - 1);
+  base += slab_used++ * block_bytes;
+  blocks.insert(base);
+  next = (vertex_t *)base;
+  end = next + block_bytes / sizeof(vertex_t);
 }
 
 
@@ -418,6 +496,14 @@ void carve::csg::CSG::Hooks::edgeDivision(const meshset_t::edge_t *orig_edge,
   }
 }
 
+void carve::csg::CSG::Hooks::progress(const char *phase, double fraction) {
+  for (std::list<Hook *>::iterator j = hooks[PROGRESS_HOOK].begin();
+       j != hooks[PROGRESS_HOOK].end();
+       ++j) {
+    (*j)->progress(phase, fraction);
+  }
+}
+
 void carve::csg::CSG::Hooks::registerHook(Hook *hook, unsigned hook_bits) {
   for (unsigned i = 0; i < HOOK_MAX; ++i) {
     if (hook_bits & (1U << i)) {
@@ -445,7 +531,7 @@ void carve::csg::CSG::Hooks::reset() {
   }
 }
 
-carve::csg::CSG::Hooks::Hooks() : hooks() {
+carve::csg::CSG::Hooks::Hooks() : hooks(), cancellation(NULL) {
   hooks.resize(HOOK_MAX);
 }
  
@@ -561,26 +647,29 @@ void carve::csg::CSG::groupIntersections() {
     {
       vertices.push_back((*i).first);
     }
-  carve::geom3d::AABB aabb;
-  aabb.fit(vertices.begin(), vertices.end(), carve::poly::vec_adapt_vertex_ptr());
-  Octree vertex_intersections_octree;
-  vertex_intersections_octree.setBounds(aabb);
+  std::vector<carve::geom3d::Vector> points;
+  points.reserve(vertices.size());
+  for (size_t i = 0, l = vertices.size(); i != l; ++i) {
+    points.push_back(vertices[i]->v);
+  }
+  LinearOctree vertex_intersections_octree;
+  vertex_intersections_octree.addPoints(points);
+  vertex_intersections_octree.build();
 
-  vertex_intersections_octree.addVertices(vertices);
-      
-  std::vector<meshset_t::vertex_t *> out;
+  std::vector<const carve::geom3d::Vector *> out;
   for (size_t i = 0, l = vertices.size(); i != l; ++i) {
     // let's find all the vertices near this one. 
     out.clear();
-    vertex_intersections_octree.findVerticesNearAllowDupes(vertices[i]->v, out);
+    vertex_intersections_octree.findPointsNearAllowDupes(points[i], out);
 
     for (size_t j = 0; j < out.size(); ++j) {
-      if (vertices[i] != out[j] && carve::geom::equal(vertices[i]->v, out[j]->v)) {
+      meshset_t::vertex_t *near = vertices[out[j] - &points[0]];
+      if (vertices[i] != near && carve::geom::equal(vertices[i]->v, near->v)) {
 #if defined(CARVE_DEBUG)
-        std::cerr << "EQ: " << vertices[i] << "," << out[j] << " " << vertices[i]->v << "," << out[j]->v << std::endl;
+        std::cerr << "EQ: " << vertices[i] << "," << near << " " << vertices[i]->v << "," << near->v << std::endl;
 #endif
-        graph[vertices[i]].insert(out[j]);
-        graph[out[j]].insert(vertices[i]);
+        graph[vertices[i]].insert(near);
+        graph[near].insert(vertices[i]);
       }
     }
   }
@@ -668,6 +757,8 @@ void carve::csg::CSG::intersectingFacePairs(detail::Data &data) {
       data.fmap[f].insert(i_pt);
     }
   }
+
+  data.account();
 }
 
 
@@ -889,28 +980,42 @@ void carve::csg::CSG::generateIntersectionCandidates(meshset_t *a,
                                                      const face_rtree_t *b_node,
                                                      face_pairs_t &face_pairs,
                                                      bool descend_a) {
-  if (!a_node->bbox.intersects(b_node->bbox)) {
-    return;
-  }
-
+  // the children of the node being descended are tested against the
+  // other node in blocks; only those that intersect it are visited.
   if (a_node->child && (descend_a || !b_node->child)) {
-    for (face_rtree_t *node = a_node->child; node; node = node->sibling) {
-      generateIntersectionCandidates(a, node, b, b_node, face_pairs, false);
+    const face_rtree_t *node = a_node->child;
+    for (size_t block = 0; node; ++block) {
+      const unsigned mask = a_node->child_aabbs.blockMask(block, b_node->bbox);
+      for (unsigned j = 0; j < 4 && node; ++j, node = node->sibling) {
+        if (mask & (1U << j)) generateIntersectionCandidates(a, node, b, b_node, face_pairs, false);
+      }
     }
   } else if (b_node->child) {
-    for (face_rtree_t *node = b_node->child; node; node = node->sibling) {
-      generateIntersectionCandidates(a, a_node, b, node, face_pairs, true);
+    const face_rtree_t *node = b_node->child;
+    for (size_t block = 0; node; ++block) {
+      const unsigned mask = b_node->child_aabbs.blockMask(block, a_node->bbox);
+      for (unsigned j = 0; j < 4 && node; ++j, node = node->sibling) {
+        if (mask & (1U << j)) generateIntersectionCandidates(a, a_node, b, node, face_pairs, true);
+      }
     }
   } else {
+    carve::geom3d::AABBBatch b_aabbs;
+    b_aabbs.reserve(b_node->data.size());
+    for (size_t j = 0; j < b_node->data.size(); ++j) {
+      b_aabbs.push_back(b_node->data[j]->getAABB());
+    }
+
+    std::vector<size_t> b_hits;
     for (size_t i = 0; i < a_node->data.size(); ++i) {
       meshset_t::face_t *fa = a_node->data[i];
       carve::geom::aabb<3> aabb_a = fa->getAABB();
       if (aabb_a.maxAxisSeparation(b_node->bbox) > carve::EPSILON) continue;
 
-      for (size_t j = 0; j < b_node->data.size(); ++j) {
-        meshset_t::face_t *fb = b_node->data[j];
-        carve::geom::aabb<3> aabb_b = fb->getAABB();
-        if (aabb_b.maxAxisSeparation(aabb_a) > carve::EPSILON) continue;
+      b_hits.clear();
+      b_aabbs.intersects(aabb_a, b_hits, carve::EPSILON);
+
+      for (size_t j = 0; j < b_hits.size(); ++j) {
+        meshset_t::face_t *fb = b_node->data[b_hits[j]];
 
         std::pair<double, double> a_ra = fa->rangeInDirection(fa->plane.N, fa->edge->vert->v);
         std::pair<double, double> b_ra = fb->rangeInDirection(fa->plane.N, fa->edge->vert->v);
@@ -937,8 +1042,14 @@ void carve::csg::CSG::generateIntersections(meshset_t *a,
                                             meshset_t *b,
                                             const face_rtree_t *b_rtree,
                                             detail::Data &data) {
+  static carve::TimingName FUNC_NAME("CSG::generateIntersections()");
+  carve::TimingBlock block(FUNC_NAME);
+
   face_pairs_t face_pairs;
-  generateIntersectionCandidates(a, a_rtree, b, b_rtree, face_pairs);
+  if (a_rtree->bbox.intersects(b_rtree->bbox)) {
+    generateIntersectionCandidates(a, a_rtree, b, b_rtree, face_pairs);
+  }
+  size_t n;
 
   for (face_pairs_t::const_iterator i = face_pairs.begin(); i != face_pairs.end(); ++i) {
     meshset_t::face_t *f = (*i).first;
@@ -948,24 +1059,35 @@ void carve::csg::CSG::generateIntersections(meshset_t *a,
       e = e->next;
     } while (e != f->edge);
   }
+  data.account();
 
+  n = 0;
   for (face_pairs_t::const_iterator i = face_pairs.begin(); i != face_pairs.end(); ++i) {
+    hooks.poll("generateIntersections", n++, face_pairs.size());
     generateVertexVertexIntersections((*i).first, (*i).second);
   }
 
+  n = 0;
   for (face_pairs_t::const_iterator i = face_pairs.begin(); i != face_pairs.end(); ++i) {
+    hooks.poll("generateIntersections", n++, face_pairs.size());
     generateVertexEdgeIntersections((*i).first, (*i).second);
   }
 
+  n = 0;
   for (face_pairs_t::const_iterator i = face_pairs.begin(); i != face_pairs.end(); ++i) {
+    hooks.poll("generateIntersections", n++, face_pairs.size());
     generateEdgeEdgeIntersections((*i).first, (*i).second);
   }
 
+  n = 0;
   for (face_pairs_t::const_iterator i = face_pairs.begin(); i != face_pairs.end(); ++i) {
+    hooks.poll("generateIntersections", n++, face_pairs.size());
     generateVertexFaceIntersections((*i).first, (*i).second);
   }
 
+  n = 0;
   for (face_pairs_t::const_iterator i = face_pairs.begin(); i != face_pairs.end(); ++i) {
+    hooks.poll("generateIntersections", n++, face_pairs.size());
     generateEdgeFaceIntersections((*i).first, (*i).second);
   }
 
@@ -1010,169 +1132,264 @@ void carve::csg::CSG::generateIntersections(meshset_t *a,
 
 
 
-carve::csg::CSG::CSG() {
+carve::csg::CSG::CSG() : tree_cache(NULL), reorder_results(false), executor(NULL) {
 }
 
 
 
-/** 
- * \brief For each intersected edge, decompose into a set of vertex pairs representing an ordered set of edge fragments.
- * 
- * @tparam[in,out] data Internal intersection data. data.emap is used to produce data.divided_edges.
- */
-void carve::csg::CSG::divideIntersectedEdges(detail::Data &data) {
-  static carve::TimingName FUNC_NAME("CSG::divideIntersectedEdges()");
-  carve::TimingBlock block(FUNC_NAME);
-
-  for (detail::EIntMap::const_iterator i = data.emap.begin(), ei = data.emap.end(); i != ei; ++i) {
-    meshset_t::edge_t *edge = (*i).first;
-    const detail::EIntMap::mapped_type &int_info = (*i).second;
-    std::vector<meshset_t::vertex_t *> &verts = data.divided_edges[edge];
-    orderEdgeIntersectionVertices(int_info.begin(), int_info.end(),
-                                  edge->v2()->v - edge->v1()->v, edge->v1()->v,
-                                  verts);
-  }
-}
-
-
+namespace {
+  typedef carve::mesh::MeshSet<3> meshset_t;
 
-carve::csg::CSG::~CSG() {
-}
+  // loops over edges and faces are split into chunks of this many.
+  const size_t EDGE_GRAIN = 64;
+  const size_t FACE_GRAIN = 16;
 
+  // orders the intersection vertices of each intersected edge.
+  class DivideEdgesTask : public carve::ParallelTask {
+    const std::vector<carve::csg::detail::EIntMap::const_iterator> &edges;
+    std::vector<std::vector<meshset_t::vertex_t *> > &divided;
 
+  public:
+    DivideEdgesTask(const std::vector<carve::csg::detail::EIntMap::const_iterator> &_edges,
+                    std::vector<std::vector<meshset_t::vertex_t *> > &_divided) :
+        edges(_edges), divided(_divided) {
+    }
 
-void carve::csg::CSG::makeFaceEdges(carve::csg::EdgeClassification &eclass,
-                                    detail::Data &data) {
-  detail::FSet face_b_set;
-  for (detail::FVSMap::const_iterator
-         i = data.fmap.begin(), ie = data.fmap.end();
-       i != ie;
-       ++i) {
-    meshset_t::face_t *face_a = (*i).first;
-    const detail::FVSMap::mapped_type &face_a_intersections = ((*i).second);
-    face_b_set.clear();
+    virtual void run(size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        meshset_t::edge_t *edge = (*edges[i]).first;
+        const carve::csg::detail::EIntMap::mapped_type &int_info = (*edges[i]).second;
+        orderEdgeIntersectionVertices(int_info.begin(), int_info.end(),
+                                      edge->v2()->v - edge->v1()->v, edge->v1()->v,
+                                      divided[i]);
+      }
+    }
+  };
 
-    // work out the set of faces from the opposing polyhedron that intersect face_a.
-    for (detail::FVSMap::mapped_type::const_iterator
-           j = face_a_intersections.begin(), je = face_a_intersections.end();
-         j != je;
-         ++j) {
-      for (detail::VFSMap::mapped_type::const_iterator
-             k = data.fmap_rev[*j].begin(), ke = data.fmap_rev[*j].end();
-           k != ke;
-           ++k) {
-        meshset_t::face_t *face_b = (*k);
-        if (face_a != face_b && face_b->mesh->meshset != face_a->mesh->meshset) {
-          face_b_set.insert(face_b);
+  // finds the edges that each intersected face gains from its
+  // intersections with faces of the other polyhedron.
+  class FaceEdgesTask : public carve::ParallelTask {
+    const std::vector<carve::csg::detail::FVSMap::const_iterator> &faces;
+    const carve::csg::detail::Data &data;
+    std::vector<std::vector<face_edge_t> > &face_edges;
+
+    void findEdges(size_t f) {
+      meshset_t::face_t *face_a = (*faces[f]).first;
+      const carve::csg::detail::FVSMap::mapped_type &face_a_intersections = ((*faces[f]).second);
+      std::vector<face_edge_t> &result = face_edges[f];
+      carve::csg::detail::FSet face_b_set;
+
+      // work out the set of faces from the opposing polyhedron that intersect face_a.
+      for (carve::csg::detail::FVSMap::mapped_type::const_iterator
+             j = face_a_intersections.begin(), je = face_a_intersections.end();
+           j != je;
+           ++j) {
+        carve::csg::detail::VFSMap::const_iterator r = data.fmap_rev.find(*j);
+        if (r == data.fmap_rev.end()) continue;
+        for (carve::csg::detail::VFSMap::mapped_type::const_iterator
+               k = (*r).second.begin(), ke = (*r).second.end();
+             k != ke;
+             ++k) {
+          meshset_t::face_t *face_b = (*k);
+          if (face_a != face_b && face_b->mesh->meshset != face_a->mesh->meshset) {
+            face_b_set.insert(face_b);
+          }
         }
       }
-    }
 
-    // run through each intersecting face.
-    for (detail::FSet::const_iterator
-           j = face_b_set.begin(), je = face_b_set.end();
-         j != je;
-         ++j) {
-      meshset_t::face_t *face_b = (*j);
-      const detail::FVSMap::mapped_type &face_b_intersections = (data.fmap[face_b]);
+      // run through each intersecting face.
+      for (carve::csg::detail::FSet::const_iterator
+             j = face_b_set.begin(), je = face_b_set.end();
+           j != je;
+           ++j) {
+        meshset_t::face_t *face_b = (*j);
+        carve::csg::detail::FVSMap::const_iterator b = data.fmap.find(face_b);
+        if (b == data.fmap.end()) continue;
+        const carve::csg::detail::FVSMap::mapped_type &face_b_intersections = (*b).second;
 
-      std::vector<meshset_t::vertex_t *> vertices;
-      vertices.reserve(std::min(face_a_intersections.size(), face_b_intersections.size()));
+        std::vector<meshset_t::vertex_t *> vertices;
+        vertices.reserve(std::min(face_a_intersections.size(), face_b_intersections.size()));
 
-      // record the points of intersection between face_a and face_b
-      std::set_intersection(face_a_intersections.begin(),
-                            face_a_intersections.end(),
-                            face_b_intersections.begin(),
-                            face_b_intersections.end(),
-                            std::back_inserter(vertices));
+        // record the points of intersection between face_a and face_b
+        std::set_intersection(face_a_intersections.begin(),
+                              face_a_intersections.end(),
+                              face_b_intersections.begin(),
+                              face_b_intersections.end(),
+                              std::back_inserter(vertices));
 
 #if defined(CARVE_DEBUG)
-      std::cerr << "face pair: "
-                << face_a << ":" << face_b
-                << " N(verts) " << vertices.size() << std::endl;
-      for (std::vector<meshset_t::vertex_t *>::const_iterator i = vertices.begin(), e = vertices.end(); i != e; ++i) {
-        std::cerr << (*i) << " " << (*i)->v << " ("
-                  << carve::geom::distance(face_a->plane, (*i)->v) << ","
-                  << carve::geom::distance(face_b->plane, (*i)->v) << ")"
-                  << std::endl;
-        //CARVE_ASSERT(carve::geom3d::distance(face_a->plane_eqn, *(*i)) < EPSILON);
-        //CARVE_ASSERT(carve::geom3d::distance(face_b->plane_eqn, *(*i)) < EPSILON);
-      }
+        std::cerr << "face pair: "
+                  << face_a << ":" << face_b
+                  << " N(verts) " << vertices.size() << std::endl;
+        for (std::vector<meshset_t::vertex_t *>::const_iterator i = vertices.begin(), e = vertices.end(); i != e; ++i) {
+          std::cerr << (*i) << " " << (*i)->v << " ("
+                    << carve::geom::distance(face_a->plane, (*i)->v) << ","
+                    << carve::geom::distance(face_b->plane, (*i)->v) << ")"
+                    << std::endl;
+          //CARVE_ASSERT(carve::geom3d::distance(face_a->plane_eqn, *(*i)) < EPSILON);
+          //CARVE_ASSERT(carve::geom3d::distance(face_b->plane_eqn, *(*i)) < EPSILON);
+        }
 #endif
 
-      // if there are two points of intersection, then the added edge is simple to determine.
-      if (vertices.size() == 2) {
-        meshset_t::vertex_t *v1 = vertices[0];
-        meshset_t::vertex_t *v2 = vertices[1];
-        carve::geom3d::Vector c = (v1->v + v2->v) / 2;
+        // if there are two points of intersection, then the added edge is simple to determine.
+        if (vertices.size() == 2) {
+          meshset_t::vertex_t *v1 = vertices[0];
+          meshset_t::vertex_t *v2 = vertices[1];
+          carve::geom3d::Vector c = (v1->v + v2->v) / 2;
 
-        // determine whether the midpoint of the implied edge is contained in face_a and face_b
+          // determine whether the midpoint of the implied edge is contained in face_a and face_b
 
 #if defined(CARVE_DEBUG)
-        std::cerr << "face_a->nVertices() = " << face_a->nVertices() << " face_a->containsPointInProjection(c) = " << face_a->containsPointInProjection(c) << std::endl;
-        std::cerr << "face_b->nVertices() = " << face_b->nVertices() << " face_b->containsPointInProjection(c) = " << face_b->containsPointInProjection(c) << std::endl;
+          std::cerr << "face_a->nVertices() = " << face_a->nVertices() << " face_a->containsPointInProjection(c) = " << face_a->containsPointInProjection(c) << std::endl;
+          std::cerr << "face_b->nVertices() = " << face_b->nVertices() << " face_b->containsPointInProjection(c) = " << face_b->containsPointInProjection(c) << std::endl;
 #endif
 
-        if (face_a->containsPointInProjection(c) && face_b->containsPointInProjection(c)) {
+          if (face_a->containsPointInProjection(c) && face_b->containsPointInProjection(c)) {
 #if defined(CARVE_DEBUG)
-          std::cerr << "adding edge: " << v1 << "-" << v2 << std::endl;
+            std::cerr << "adding edge: " << v1 << "-" << v2 << std::endl;
 #if defined(DEBUG_DRAW_FACE_EDGES)
-          HOOK(drawEdge(v1, v2, 1, 1, 1, 1, 1, 1, 1, 1, 2.0););
+            HOOK(drawEdge(v1, v2, 1, 1, 1, 1, 1, 1, 1, 1, 2.0););
 #endif
 #endif
-          // record the edge, with class information.
-          if (v1 > v2) std::swap(v1, v2);
-          eclass[ordered_edge(v1, v2)] = carve::csg::EC2(carve::csg::EDGE_ON, carve::csg::EDGE_ON);
-          data.face_split_edges[face_a].insert(std::make_pair(v1, v2));
-          data.face_split_edges[face_b].insert(std::make_pair(v1, v2));
+            // record the edge; it is merged into eclass and
+            // face_split_edges below.
+            if (v1 > v2) std::swap(v1, v2);
+            result.push_back(face_edge_t(face_b, v1, v2));
+          }
+          continue;
         }
-        continue;
-      }
 
-      // otherwise, it's more complex.
-      carve::geom3d::Vector base, dir;
-      std::vector<meshset_t::vertex_t *> ordered;
-
-      // skip coplanar edges. this simplifies the resulting
-      // mesh. eventually all coplanar face regions of two polyhedra
-      // must reach a point where they are no longer coplanar (or the
-      // polyhedra are identical).
-      if (!facesAreCoplanar(face_a, face_b)) {
-        // order the intersection vertices (they must lie along a
-        // vector, as the faces aren't coplanar).
-        selectOrderingProjection(vertices.begin(), vertices.end(), dir, base);
-        orderVertices(vertices.begin(), vertices.end(), dir, base, ordered);
-
-        // for each possible edge in the ordering, test the midpoint,
-        // and record if it's contained in face_a and face_b.
-        for (int k = 0, ke = (int)ordered.size() - 1; k < ke; ++k) {
-          meshset_t::vertex_t *v1 = ordered[k];
-          meshset_t::vertex_t *v2 = ordered[k + 1];
-          carve::geom3d::Vector c = (v1->v + v2->v) / 2;
+        // otherwise, it's more complex.
+        carve::geom3d::Vector base, dir;
+        std::vector<meshset_t::vertex_t *> ordered;
+
+        // skip coplanar edges. this simplifies the resulting
+        // mesh. eventually all coplanar face regions of two polyhedra
+        // must reach a point where they are no longer coplanar (or the
+        // polyhedra are identical).
+        if (!facesAreCoplanar(face_a, face_b)) {
+          // order the intersection vertices (they must lie along a
+          // vector, as the faces aren't coplanar).
+          selectOrderingProjection(vertices.begin(), vertices.end(), dir, base);
+          orderVertices(vertices.begin(), vertices.end(), dir, base, ordered);
+
+          // for each possible edge in the ordering, test the midpoint,
+          // and record if it's contained in face_a and face_b.
+          for (int k = 0, ke = (int)ordered.size() - 1; k < ke; ++k) {
+            meshset_t::vertex_t *v1 = ordered[k];
+            meshset_t::vertex_t *v2 = ordered[k + 1];
+            carve::geom3d::Vector c = (v1->v + v2->v) / 2;
 
 #if defined(CARVE_DEBUG)
-          std::cerr << "testing edge: " << v1 << "-" << v2 << " at " << c << std::endl;
-          std::cerr << "a: " << face_a->containsPointInProjection(c) << " b: " << face_b->containsPointInProjection(c) << std::endl;
-          std::cerr << "face_a->containsPointInProjection(c): " << face_a->containsPointInProjection(c) << std::endl;
-          std::cerr << "face_b->containsPointInProjection(c): " << face_b->containsPointInProjection(c) << std::endl;
+            std::cerr << "testing edge: " << v1 << "-" << v2 << " at " << c << std::endl;
+            std::cerr << "a: " << face_a->containsPointInProjection(c) << " b: " << face_b->containsPointInProjection(c) << std::endl;
+            std::cerr << "face_a->containsPointInProjection(c): " << face_a->containsPointInProjection(c) << std::endl;
+            std::cerr << "face_b->containsPointInProjection(c): " << face_b->containsPointInProjection(c) << std::endl;
 #endif
 
-          if (face_a->containsPointInProjection(c) && face_b->containsPointInProjection(c)) {
+            if (face_a->containsPointInProjection(c) && face_b->containsPointInProjection(c)) {
 #if defined(CARVE_DEBUG)
-            std::cerr << "adding edge: " << v1 << "-" << v2 << std::endl;
+              std::cerr << "adding edge: " << v1 << "-" << v2 << std::endl;
 #if defined(DEBUG_DRAW_FACE_EDGES)
-            HOOK(drawEdge(v1, v2, .5, .5, .5, 1, .5, .5, .5, 1, 2.0););
+              HOOK(drawEdge(v1, v2, .5, .5, .5, 1, .5, .5, .5, 1, 2.0););
 #endif
 #endif
-            // record the edge, with class information.
-            if (v1 > v2) std::swap(v1, v2);
-            eclass[ordered_edge(v1, v2)] = carve::csg::EC2(carve::csg::EDGE_ON, carve::csg::EDGE_ON);
-            data.face_split_edges[face_a].insert(std::make_pair(v1, v2));
-            data.face_split_edges[face_b].insert(std::make_pair(v1, v2));
+              // record the edge.
+              if (v1 > v2) std::swap(v1, v2);
+              result.push_back(face_edge_t(face_b, v1, v2));
+            }
           }
         }
       }
     }
+
+  public:
+    FaceEdgesTask(const std::vector<carve::csg::detail::FVSMap::const_iterator> &_faces,
+                  const carve::csg::detail::Data &_data,
+                  std::vector<std::vector<face_edge_t> > &_face_edges) :
+        faces(_faces), data(_data), face_edges(_face_edges) {
+    }
+
+    virtual void run(size_t begin, size_t end) {
+      for (size_t f = begin; f < end; ++f) findEdges(f);
+    }
+  };
+}
+
+
+
+/** 
+ * \brief For each intersected edge, decompose into a set of vertex pairs representing an ordered set of edge fragments.
+ * 
+ * @tparam[in,out] data Internal intersection data. data.emap is used to produce data.divided_edges.
+ */
+void carve::csg::CSG::divideIntersectedEdges(detail::Data &data) {
+  static carve::TimingName FUNC_NAME("CSG::divideIntersectedEdges()");
+  carve::TimingBlock block(FUNC_NAME);
+
+  // edges are ordered independently into per-edge buffers, and then
+  // stored in emap iteration order, so the result does not depend on
+  // the number of threads.
+  std::vector<detail::EIntMap::const_iterator> edges;
+  edges.reserve(data.emap.size());
+  for (detail::EIntMap::const_iterator i = data.emap.begin(), ei = data.emap.end(); i != ei; ++i) {
+    edges.push_back(i);
+  }
+
+  const size_t n_edges = edges.size();
+  std::vector<std::vector<meshset_t::vertex_t *> > divided(n_edges);
+
+  DivideEdgesTask task(edges, divided);
+  carve::parallelFor(getExecutor(), n_edges, EDGE_GRAIN, task);
+
+  for (size_t i = 0; i < n_edges; ++i) {
+    data.divided_edges[(*edges[i]).first].swap(divided[i]);
+  }
+
+  data.account();
+}
+
+
+
+carve::csg::CSG::~CSG() {
+}
+
+
+
+void carve::csg::CSG::makeFaceEdges(carve::csg::EdgeClassification &eclass,
+                                    detail::Data &data) {
+  static carve::TimingName FUNC_NAME("CSG::makeFaceEdges()");
+  carve::TimingBlock block(FUNC_NAME);
+
+  // faces are processed independently, each collecting the edges it
+  // adds into its own buffer. buffers are then merged in fmap
+  // iteration order, which gives the same result as processing faces
+  // serially, regardless of the number of threads.
+  std::vector<detail::FVSMap::const_iterator> faces;
+  faces.reserve(data.fmap.size());
+  for (detail::FVSMap::const_iterator
+         i = data.fmap.begin(), ie = data.fmap.end();
+       i != ie;
+       ++i) {
+    faces.push_back(i);
+  }
+
+  const size_t n_faces = faces.size();
+  std::vector<std::vector<face_edge_t> > face_edges(n_faces);
+
+  FaceEdgesTask task(faces, data, face_edges);
+  carve::parallelFor(getExecutor(), n_faces, FACE_GRAIN, task);
+
+  // record the edges, with class information.
+  for (size_t f = 0; f < n_faces; ++f) {
+    meshset_t::face_t *face_a = (*faces[f]).first;
+    const std::vector<face_edge_t> &result = face_edges[f];
+    for (size_t i = 0; i < result.size(); ++i) {
+      const face_edge_t &e = result[i];
+      eclass[ordered_edge(e.v1, e.v2)] = carve::csg::EC2(carve::csg::EDGE_ON, carve::csg::EDGE_ON);
+      data.face_split_edges[face_a].insert(std::make_pair(e.v1, e.v2));
+      data.face_split_edges[e.face_b].insert(std::make_pair(e.v1, e.v2));
+    }
   }
 
 
@@ -1210,6 +1427,8 @@ void carve::csg::CSG::makeFaceEdges(carve::csg::EdgeClassification &eclass,
     ::writePLY(out, &intersection_graph, true);
   }
 #endif
+
+  data.account();
 }
 
 
@@ -1283,6 +1502,7 @@ void carve::csg::CSG::calc(meshset_t *a,
 #if defined(CARVE_DEBUG)
   std::cerr << "intersectingFacePairs" << std::endl;
 #endif
+  hooks.checkCancelled("intersectingFacePairs");
   intersectingFacePairs(data);
 
 #if defined(CARVE_DEBUG)
@@ -1305,17 +1525,20 @@ void carve::csg::CSG::calc(meshset_t *a,
 #if defined(CARVE_DEBUG)
   std::cerr << "divideIntersectedEdges" << std::endl;
 #endif
+  hooks.checkCancelled("divideIntersectedEdges");
   divideIntersectedEdges(data);
 
 #if defined(CARVE_DEBUG)
   std::cerr << "makeFaceEdges" << std::endl;
 #endif
   // makeFaceEdges(data.face_split_edges, eclass, data.fmap, data.fmap_rev);
+  hooks.checkCancelled("makeFaceEdges");
   makeFaceEdges(eclass, data);
 
 #if defined(CARVE_DEBUG)
   std::cerr << "generateFaceLoops" << std::endl;
 #endif
+  hooks.checkCancelled("generateFaceLoops");
   a_edge_count = generateFaceLoops(a, data, a_face_loops);
   b_edge_count = generateFaceLoops(b, data, b_face_loops);
 
@@ -1371,6 +1594,113 @@ void carve::csg::CSG::calc(meshset_t *a,
 
 
 
+carve::line::PolylineSet *carve::csg::CSG::intersectionCurves(meshset_t *a,
+                                                              meshset_t *b) {
+  static carve::TimingName FUNC_NAME("CSG::intersectionCurves()");
+  carve::TimingBlock block(FUNC_NAME);
+  hooks.checkCancelled("intersectionCurves");
+
+  std::auto_ptr<face_rtree_t> a_rtree(face_rtree_t::construct_STR(a->faceBegin(), a->faceEnd(), 4, 4));
+  std::auto_ptr<face_rtree_t> b_rtree(face_rtree_t::construct_STR(b->faceBegin(), b->faceEnd(), 4, 4));
+
+  detail::Data data;
+  EdgeClassification eclass;
+
+  init();
+
+  generateIntersections(a, a_rtree.get(), b, b_rtree.get(), data);
+
+  hooks.checkCancelled("intersectingFacePairs");
+  intersectingFacePairs(data);
+
+  hooks.checkCancelled("makeFaceEdges");
+  makeFaceEdges(eclass, data);
+
+  // the intersection graph is the union of the edges added to faces.
+  V2Set edges;
+  for (detail::FV2SMap::const_iterator i = data.face_split_edges.begin(); i != data.face_split_edges.end(); ++i) {
+    edges.insert((*i).second.begin(), (*i).second.end());
+  }
+
+  // number vertices in coordinate order, so that the output does
+  // not depend on allocation addresses.
+  std::vector<std::pair<carve::geom3d::Vector, meshset_t::vertex_t *> > vertices;
+  {
+    detail::VSet vset;
+    for (V2Set::const_iterator i = edges.begin(); i != edges.end(); ++i) {
+      vset.insert((*i).first);
+      vset.insert((*i).second);
+    }
+    vertices.reserve(vset.size());
+    for (detail::VSet::const_iterator i = vset.begin(); i != vset.end(); ++i) {
+      vertices.push_back(std::make_pair((*i)->v, *i));
+    }
+    std::sort(vertices.begin(), vertices.end());
+  }
+
+  std::unordered_map<const meshset_t::vertex_t *, size_t> vindex;
+  std::vector<carve::geom3d::Vector> points(vertices.size());
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    vindex[vertices[i].second] = i;
+    points[i] = vertices[i].first;
+  }
+
+  std::vector<std::vector<size_t> > adj(vertices.size());
+  for (V2Set::const_iterator i = edges.begin(); i != edges.end(); ++i) {
+    size_t v1 = vindex[(*i).first];
+    size_t v2 = vindex[(*i).second];
+    adj[v1].push_back(v2);
+    adj[v2].push_back(v1);
+  }
+  for (size_t i = 0; i < adj.size(); ++i) {
+    std::sort(adj[i].begin(), adj[i].end());
+  }
+
+  std::auto_ptr<carve::line::PolylineSet> result(new carve::line::PolylineSet(points));
+
+  // chain edges into maximal polylines. open polylines run between
+  // vertices that are not of degree 2 (curve ends and junctions);
+  // whatever remains is made up of closed loops.
+  std::vector<std::vector<bool> > used(adj.size());
+  for (size_t i = 0; i < adj.size(); ++i) {
+    used[i].resize(adj[i].size(), false);
+  }
+
+  std::vector<size_t> line;
+  for (int pass = 0; pass < 2; ++pass) {
+    for (size_t start = 0; start < adj.size(); ++start) {
+      if (pass == 0 && adj[start].size() == 2) continue;
+      for (size_t e = 0; e < adj[start].size(); ++e) {
+        if (used[start][e]) continue;
+        line.clear();
+        line.push_back(start);
+        size_t curr = start, k = e;
+        bool closed = false;
+        for (;;) {
+          size_t next = adj[curr][k];
+          used[curr][k] = true;
+          used[next][std::lower_bound(adj[next].begin(), adj[next].end(), curr) - adj[next].begin()] = true;
+          if (next == start) {
+            closed = true;
+            break;
+          }
+          line.push_back(next);
+          if (adj[next].size() != 2) break;
+          k = adj[next][0] == curr ? 1 : 0;
+          curr = next;
+        }
+        result->addPolyline(closed, line.begin(), line.end());
+      }
+    }
+  }
+
+  if (hooks.hasHook(Hooks::PROGRESS_HOOK)) hooks.progress("done", 1.0);
+
+  return result.release();
+}
+
+
+
 /** 
  * 
  * 
@@ -1411,20 +1741,14 @@ void returnSharedEdges(carve::csg::V2Set &shared_edges,
  * @param a 
  * @param b 
  * @param collector 
- * @param hooks 
- * @param shared_edges_ptr 
+ * @param shared_edges 
  * @param classify_type 
- * 
- * @return 
  */
-carve::mesh::MeshSet<3> *carve::csg::CSG::compute(meshset_t *a,
-                                                  meshset_t *b,
-                                                  carve::csg::CSG::Collector &collector,
-                                                  carve::csg::V2Set *shared_edges_ptr,
-                                                  CLASSIFY_TYPE classify_type) {
-  static carve::TimingName FUNC_NAME("CSG::compute");
-  carve::TimingBlock block(FUNC_NAME);
-
+void carve::csg::CSG::classifyAndCollect(meshset_t *a,
+                                         meshset_t *b,
+                                         carve::csg::CSG::Collector &collector,
+                                         carve::csg::V2Set &shared_edges,
+                                         CLASSIFY_TYPE classify_type) {
   VertexClassification vclass;
   EdgeClassification eclass;
 
@@ -1452,6 +1776,7 @@ carve::mesh::MeshSet<3> *carve::csg::CSG::compute(meshset_t *a,
   {
     static carve::TimingName FUNC_NAME("CSG::compute - makeEdgeMap()");
     carve::TimingBlock block(FUNC_NAME);
+    hooks.checkCancelled("makeEdgeMap");
     makeEdgeMap(a_face_loops, a_edge_count, a_edge_map);
     makeEdgeMap(b_face_loops, b_edge_count, b_edge_map);
 
@@ -1460,21 +1785,22 @@ carve::mesh::MeshSet<3> *carve::csg::CSG::compute(meshset_t *a,
   {
     static carve::TimingName FUNC_NAME("CSG::compute - sortFaceLoopLists()");
     carve::TimingBlock block(FUNC_NAME);
+    hooks.checkCancelled("sortFaceLoopLists");
     a_edge_map.sortFaceLoopLists();
     b_edge_map.sortFaceLoopLists();
   }
 
-  V2Set shared_edges;
-  
   {
     static carve::TimingName FUNC_NAME("CSG::compute - findSharedEdges()");
     carve::TimingBlock block(FUNC_NAME);
+    hooks.checkCancelled("findSharedEdges");
     findSharedEdges(a_edge_map, b_edge_map, shared_edges);
   }
 
   {
     static carve::TimingName FUNC_NAME("CSG::compute - groupFaceLoops()");
     carve::TimingBlock block(FUNC_NAME);
+    hooks.checkCancelled("groupFaceLoops");
     groupFaceLoops(a, a_face_loops, a_edge_map, shared_edges, a_loops_grouped);
     groupFaceLoops(b, b_face_loops, b_edge_map, shared_edges, b_loops_grouped);
 #if defined(CARVE_DEBUG)
@@ -1506,36 +1832,81 @@ carve::mesh::MeshSet<3> *carve::csg::CSG::compute(meshset_t *a,
   }
 #endif
 
-  switch (classify_type) {
-  case CLASSIFY_EDGE:
-    classifyFaceGroupsEdge(shared_edges,
-                           vclass,
-                           a,
-                           a_rtree.get(),
-                           a_loops_grouped,
-                           a_edge_map,
-                           b,
-                           b_rtree.get(),
-                           b_loops_grouped,
-                           b_edge_map,
-                           collector);
-    break;
-  case CLASSIFY_NORMAL:
-    classifyFaceGroups(shared_edges,
-                       vclass,
-                       a,
-                       a_rtree.get(),
-                       a_loops_grouped,
-                       a_edge_map,
-                       b,
-                       b_rtree.get(),
-                       b_loops_grouped,
-                       b_edge_map,
-                       collector);
-    break;
+  hooks.checkCancelled("classifyFaceGroups");
+  {
+    static carve::TimingName FUNC_NAME("CSG::compute - classify()");
+    carve::TimingBlock block(FUNC_NAME);
+    switch (classify_type) {
+    case CLASSIFY_EDGE:
+      classifyFaceGroupsEdge(shared_edges,
+                             vclass,
+                             a,
+                             a_rtree.get(),
+                             a_loops_grouped,
+                             a_edge_map,
+                             b,
+                             b_rtree.get(),
+                             b_loops_grouped,
+                             b_edge_map,
+                             collector);
+      break;
+    case CLASSIFY_NORMAL:
+      classifyFaceGroups(shared_edges,
+                         vclass,
+                         a,
+                         a_rtree.get(),
+                         a_loops_grouped,
+                         a_edge_map,
+                         b,
+                         b_rtree.get(),
+                         b_loops_grouped,
+                         b_edge_map,
+                         collector);
+      break;
+    }
   }
+}
+
+
+
+/** 
+ * 
+ * 
+ * @param a 
+ * @param b 
+ * @param collector 
+ * @param hooks 
+ * @param shared_edges_ptr 
+ * @param classify_type 
+ * 
+ * @return 
+ */
+carve::mesh::MeshSet<3> *carve::csg::CSG::compute(meshset_t *a,
+                                                  meshset_t *b,
+                                                  carve::csg::CSG::Collector &collector,
+                                                  carve::csg::V2Set *shared_edges_ptr,
+                                                  CLASSIFY_TYPE classify_type) {
+  static carve::TimingName FUNC_NAME("CSG::compute");
+  carve::TimingBlock block(FUNC_NAME);
+  hooks.checkCancelled("compute");
 
-  meshset_t *result = collector.done(hooks);
+  V2Set shared_edges;
+  collector.executor = executor;
+  classifyAndCollect(a, b, collector, shared_edges, classify_type);
+
+  hooks.checkCancelled("collect");
+  meshset_t *result;
+  {
+    static carve::TimingName FUNC_NAME("CSG::compute - collect()");
+    carve::TimingBlock block(FUNC_NAME);
+    result = collector.done(hooks);
+    // face hooks have seen the output faces by now, so they must
+    // keep their addresses.
+    if (result != NULL && reorder_results) {
+      result->reorder(hooks.hasHook(Hooks::RESULT_FACE_HOOK) || hooks.hasHook(Hooks::PROCESS_OUTPUT_FACE_HOOK));
+    }
+  }
+  if (hooks.hasHook(Hooks::PROGRESS_HOOK)) hooks.progress("done", 1.0);
   if (result != NULL && shared_edges_ptr != NULL) {
     std::list<meshset_t *> result_list;
     result_list.push_back(result);
@@ -1563,14 +1934,130 @@ carve::mesh::MeshSet<3> *carve::csg::CSG::compute(meshset_t *a,
                                                   carve::csg::CSG::OP op,
                                                   carve::csg::V2Set *shared_edges,
                                                   CLASSIFY_TYPE classify_type) {
-  Collector *coll = makeCollector(op, a, b);
-  if (!coll) return NULL;
+  // held by auto_ptr so that the collector is not leaked if the
+  // computation is cancelled.
+  std::auto_ptr<Collector> coll(makeCollector(op, a, b));
+  if (!coll.get()) return NULL;
 
-  meshset_t *result = compute(a, b, *coll, shared_edges, classify_type);
-     
-  delete coll;
+  return compute(a, b, *coll, shared_edges, classify_type);
+}
 
-  return result;
+
+
+namespace {
+  // passes each classified face loop group to several collectors.
+  class FanOutCollector : public carve::csg::CSG::Collector {
+    const std::vector<carve::csg::CSG::Collector *> &collectors;
+
+  public:
+    FanOutCollector(const std::vector<carve::csg::CSG::Collector *> &_collectors) :
+        carve::csg::CSG::Collector(), collectors(_collectors) {
+    }
+
+    virtual void collect(carve::csg::FaceLoopGroup *group, carve::csg::CSG::Hooks &hooks) {
+      for (size_t i = 0; i < collectors.size(); ++i) {
+        collectors[i]->collect(group, hooks);
+      }
+    }
+
+    virtual carve::mesh::MeshSet<3> *done(carve::csg::CSG::Hooks &) {
+      return NULL;
+    }
+  };
+}
+
+
+
+/** 
+ * 
+ * 
+ * @param a 
+ * @param b 
+ * @param collectors 
+ * @param results 
+ * @param shared_edges 
+ * @param classify_type 
+ */
+void carve::csg::CSG::compute(meshset_t *a,
+                              meshset_t *b,
+                              const std::vector<Collector *> &collectors,
+                              std::vector<meshset_t *> &results,
+                              std::vector<V2Set> *shared_edges,
+                              CLASSIFY_TYPE classify_type) {
+  static carve::TimingName FUNC_NAME("CSG::compute (multiple)");
+  carve::TimingBlock block(FUNC_NAME);
+  hooks.checkCancelled("compute");
+
+  results.clear();
+
+  V2Set edges;
+  for (size_t i = 0; i < collectors.size(); ++i) {
+    collectors[i]->executor = executor;
+  }
+  FanOutCollector fan_out(collectors);
+  classifyAndCollect(a, b, fan_out, edges, classify_type);
+
+  hooks.checkCancelled("collect");
+  results.reserve(collectors.size());
+  {
+    static carve::TimingName FUNC_NAME("CSG::compute - collect()");
+    carve::TimingBlock block(FUNC_NAME);
+    const bool keep_faces = hooks.hasHook(Hooks::RESULT_FACE_HOOK) || hooks.hasHook(Hooks::PROCESS_OUTPUT_FACE_HOOK);
+    for (size_t i = 0; i < collectors.size(); ++i) {
+      results.push_back(collectors[i]->done(hooks));
+      if (results.back() != NULL && reorder_results) results.back()->reorder(keep_faces);
+    }
+  }
+  if (hooks.hasHook(Hooks::PROGRESS_HOOK)) hooks.progress("done", 1.0);
+
+  if (shared_edges != NULL) {
+    shared_edges->clear();
+    shared_edges->resize(results.size());
+    for (size_t i = 0; i < results.size(); ++i) {
+      if (results[i] == NULL) continue;
+      std::list<meshset_t *> result_list;
+      result_list.push_back(results[i]);
+      returnSharedEdges(edges, result_list, &(*shared_edges)[i]);
+    }
+  }
+}
+
+
+
+/** 
+ * 
+ * 
+ * @param a 
+ * @param b 
+ * @param ops 
+ * @param results 
+ * @param shared_edges 
+ * @param classify_type 
+ */
+void carve::csg::CSG::compute(meshset_t *a,
+                              meshset_t *b,
+                              const std::vector<OP> &ops,
+                              std::vector<meshset_t *> &results,
+                              std::vector<V2Set> *shared_edges,
+                              CLASSIFY_TYPE classify_type) {
+  std::vector<Collector *> collectors;
+  collectors.reserve(ops.size());
+
+  try {
+    for (size_t i = 0; i < ops.size(); ++i) {
+      Collector *coll = makeCollector(ops[i], a, b);
+      if (coll == NULL) {
+        throw carve::exception() << "CSG::compute: unsupported operation " << (int)ops[i];
+      }
+      collectors.push_back(coll);
+    }
+    compute(a, b, collectors, results, shared_edges, classify_type);
+  } catch (...) {
+    for (size_t i = 0; i < collectors.size(); ++i) delete collectors[i];
+    throw;
+  }
+
+  for (size_t i = 0; i < collectors.size(); ++i) delete collectors[i];
 }
 
 
@@ -124,7 +124,10 @@ namespace carve {
                                               CSG::Collector &collector,
                                               CSG::Hooks &hooks) {
   
-      for (FLGroupList::iterator i = group.begin(); i != group.end();) {
+      const size_t n_groups = group.size();
+      size_t n_done = 0;
+      for (FLGroupList::iterator i = group.begin(); i != group.end(); ++n_done) {
+        hooks.poll("classifyEasyFaceGroups", n_done, n_groups);
 #if defined(CARVE_DEBUG)
         std::cerr << "............group " << &(*i) << std::endl;
 #endif
@@ -135,7 +138,7 @@ namespace carve {
         for (FaceLoop *f = curr.head; f; f = f->next) {
           for (size_t j = 0; j < f->vertices.size(); ++j) {
             if (!classifier.pointOn(vclass, f, j)) {
-              PointClass pc = carve::mesh::classifyPoint(poly_a, poly_a_rtree, f->vertices[j]->v);
+              PointClass pc = carve::mesh::classifyPoint(poly_a, poly_a_rtree, f->vertices[j]->v, false, NULL, NULL, hooks.cancellation);
               if (pc == POINT_IN || pc == POINT_OUT) {
                 classifier.explain(f, j, pc);
               }
@@ -162,8 +165,11 @@ namespace carve {
                                               const CLASSIFIER & /* classifier */,
                                               CSG::Collector &collector,
                                               CSG::Hooks &hooks) {
+      const size_t n_groups = group.size();
+      size_t n_done = 0;
       for (FLGroupList::iterator
-             i = group.begin(); i != group.end();) {
+             i = group.begin(); i != group.end(); ++n_done) {
+        hooks.poll("classifyHardFaceGroups", n_done, n_groups);
         int n_in = 0, n_out = 0, n_on = 0;
         FaceLoopGroup &grp = (*i);
         FaceLoopList &curr = (grp.face_loops);
@@ -178,7 +184,7 @@ namespace carve {
             if (v1 < v2 && perim.find(std::make_pair(v1, v2)) == perim.end()) {
               carve::geom3d::Vector c = (v1->v + v2->v) / 2.0;
 
-              PointClass pc = carve::mesh::classifyPoint(poly_a, poly_a_rtree, c);
+              PointClass pc = carve::mesh::classifyPoint(poly_a, poly_a_rtree, c, false, NULL, NULL, hooks.cancellation);
 
               switch (pc) {
               case POINT_IN: n_in++; break;
@@ -216,7 +222,10 @@ namespace carve {
                              const CLASSIFIER &classifier,
                              CSG::Collector &collector,
                              CSG::Hooks &hooks) {
-      for (FLGroupList::iterator i = b_loops_grouped.begin(), e = b_loops_grouped.end(); i != e;) {
+      const size_t n_groups = b_loops_grouped.size();
+      size_t n_done = 0;
+      for (FLGroupList::iterator i = b_loops_grouped.begin(), e = b_loops_grouped.end(); i != e; ++n_done) {
+        hooks.poll("performFaceLoopWork", n_done, n_groups);
         FaceClass fc;
 
         if (classifier.faceLoopSanityChecker(*i)) {
@@ -242,7 +251,7 @@ namespace carve {
         carve::geom3d::Vector v = f->unproject(pv, f->plane);
 
         const carve::mesh::MeshSet<3>::face_t *hit_face;
-        PointClass pc = carve::mesh::classifyPoint(poly_a, poly_a_rtree, v, false, NULL, &hit_face);
+        PointClass pc = carve::mesh::classifyPoint(poly_a, poly_a_rtree, v, false, NULL, &hit_face, hooks.cancellation);
         switch (pc) {
         case POINT_IN: fc = FACE_IN; break;
         case POINT_OUT: fc = FACE_OUT; break;
@@ -721,6 +721,7 @@ namespace carve {
       }
 
       for (FLGroupList::iterator i = a_loops_grouped.begin(); i != a_loops_grouped.end(); ++i) {
+        hooks.checkCancelled("classifyFaceGroupsEdge");
         if ((*i).classification.size() == 0) {
 #if defined(CARVE_DEBUG)
           std::cerr << " non intersecting group (poly a): " << &(*i) << std::endl;
@@ -729,7 +730,7 @@ namespace carve {
           for (FaceLoop *fl = (*i).face_loops.head; !classified && fl != NULL; fl = fl->next) {
             for (size_t fli = 0; !classified && fli < fl->vertices.size(); ++fli) {
               if (vclass[fl->vertices[fli]].cls[1] == POINT_UNK) { 
-                vclass[fl->vertices[fli]].cls[1] = carve::mesh::classifyPoint(poly_b, poly_b_rtree, fl->vertices[fli]->v);
+                vclass[fl->vertices[fli]].cls[1] = carve::mesh::classifyPoint(poly_b, poly_b_rtree, fl->vertices[fli]->v, false, NULL, NULL, hooks.cancellation);
               }
               switch (vclass[fl->vertices[fli]].cls[1]) {
                 case POINT_IN:
@@ -752,6 +753,7 @@ namespace carve {
       }
 
       for (FLGroupList::iterator i = b_loops_grouped.begin(); i != b_loops_grouped.end(); ++i) {
+        hooks.checkCancelled("classifyFaceGroupsEdge");
         if ((*i).classification.size() == 0) {
 #if defined(CARVE_DEBUG)
           std::cerr << " non intersecting group (poly b): " << &(*i) << std::endl;
@@ -760,7 +762,7 @@ namespace carve {
           for (FaceLoop *fl = (*i).face_loops.head; !classified && fl != NULL; fl = fl->next) {
             for (size_t fli = 0; !classified && fli < fl->vertices.size(); ++fli) {
               if (vclass[fl->vertices[fli]].cls[0] == POINT_UNK) { 
-                vclass[fl->vertices[fli]].cls[0] = carve::mesh::classifyPoint(poly_a, poly_a_rtree, fl->vertices[fli]->v);
+                vclass[fl->vertices[fli]].cls[0] = carve::mesh::classifyPoint(poly_a, poly_a_rtree, fl->vertices[fli]->v, false, NULL, NULL, hooks.cancellation);
               }
               switch (vclass[fl->vertices[fli]].cls[0]) {
                 case POINT_IN:
@@ -1660,9 +1660,11 @@ size_t carve::csg::CSG::generateFaceLoops(carve::mesh::MeshSet<3> *poly,
   size_t generated_edges = 0;
   std::vector<carve::mesh::MeshSet<3>::vertex_t *> base_loop;
   std::list<std::vector<carve::mesh::MeshSet<3>::vertex_t *> > face_loops;
+  size_t n_faces = poly->faceEnd() - poly->faceBegin(), n_done = 0;
   
   for (carve::mesh::MeshSet<3>::face_iter i = poly->faceBegin(); i != poly->faceEnd(); ++i) {
     carve::mesh::MeshSet<3>::face_t *face = (*i);
+    hooks.poll("generateFaceLoops", n_done++, n_faces);
 
 #if defined(CARVE_DEBUG)
     double in_area = 0.0, out_area = 0.0;
@@ -0,0 +1,451 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/linear_octree.hpp>
+
+#include <carve/poly_decl.hpp>
+#include <carve/timing.hpp>
+#include <carve/executor.hpp>
+
+#include <algorithm>
+
+namespace {
+
+  typedef carve::csg::LinearOctree::Node node_t;
+
+  // the number of elements handled by each chunk of the parallel
+  // radix sort.
+  const size_t RADIX_CHUNK = 32768;
+
+  inline uint32_t expandBits(uint32_t x) {
+    x &= 0x3ff;
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x <<  8)) & 0x0300f00f;
+    x = (x | (x <<  4)) & 0x030c30c3;
+    x = (x | (x <<  2)) & 0x09249249;
+    return x;
+  }
+
+  inline uint32_t quantize(double v, double base, double scale) {
+    double q = (v - base) * scale;
+    if (q <= 0.0) return 0;
+    if (q >= 1023.0) return 1023;
+    return (uint32_t)q;
+  }
+
+  // morton codes are computed in chunks of this many.
+  const size_t KEY_GRAIN = 4096;
+
+  class KeyTask : public carve::ParallelTask {
+    const std::vector<carve::geom3d::AABB> &aabbs;
+    const carve::geom3d::Vector &lo, &scale;
+    std::vector<uint32_t> &keys, &values;
+
+  public:
+    KeyTask(const std::vector<carve::geom3d::AABB> &_aabbs,
+            const carve::geom3d::Vector &_lo,
+            const carve::geom3d::Vector &_scale,
+            std::vector<uint32_t> &_keys,
+            std::vector<uint32_t> &_values) :
+        aabbs(_aabbs), lo(_lo), scale(_scale), keys(_keys), values(_values) {
+    }
+
+    virtual void run(size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        keys[i] = carve::csg::LinearOctree::mortonCode(aabbs[i].pos, lo, scale);
+        values[i] = (uint32_t)i;
+      }
+    }
+  };
+
+  // counts the digits of each chunk of keys.
+  class HistogramTask : public carve::ParallelTask {
+    const std::vector<uint32_t> &keys;
+    std::vector<size_t> &hist;
+    unsigned shift;
+
+  public:
+    HistogramTask(const std::vector<uint32_t> &_keys, std::vector<size_t> &_hist, unsigned _shift) :
+        keys(_keys), hist(_hist), shift(_shift) {
+    }
+
+    virtual void run(size_t begin, size_t end) {
+      size_t *h = &hist[(begin / RADIX_CHUNK) * 256];
+      for (size_t i = begin; i < end; ++i) {
+        ++h[(keys[i] >> shift) & 0xff];
+      }
+    }
+  };
+
+  // scatters each chunk of keys to the offsets computed from the
+  // histogram.
+  class ScatterTask : public carve::ParallelTask {
+    const std::vector<uint32_t> &keys, &values;
+    std::vector<uint32_t> &out_keys, &out_values;
+    std::vector<size_t> &hist;
+    unsigned shift;
+
+  public:
+    ScatterTask(const std::vector<uint32_t> &_keys,
+                const std::vector<uint32_t> &_values,
+                std::vector<uint32_t> &_out_keys,
+                std::vector<uint32_t> &_out_values,
+                std::vector<size_t> &_hist,
+                unsigned _shift) :
+        keys(_keys), values(_values), out_keys(_out_keys), out_values(_out_values), hist(_hist), shift(_shift) {
+    }
+
+    virtual void run(size_t begin, size_t end) {
+      size_t *h = &hist[(begin / RADIX_CHUNK) * 256];
+      for (size_t i = begin; i < end; ++i) {
+        size_t pos = h[(keys[i] >> shift) & 0xff]++;
+        out_keys[pos] = keys[i];
+        out_values[pos] = values[i];
+      }
+    }
+  };
+
+  struct aabb_test {
+    const carve::geom3d::AABB &aabb;
+    aabb_test(const carve::geom3d::AABB &_aabb) : aabb(_aabb) {}
+    bool operator()(const carve::geom3d::AABB &a) const { return a.intersects(aabb); }
+  };
+
+  struct linesegment_test {
+    const carve::geom3d::Vector &v1, &v2;
+    linesegment_test(const carve::geom3d::Vector &_v1, const carve::geom3d::Vector &_v2) : v1(_v1), v2(_v2) {}
+    bool operator()(const carve::geom3d::AABB &a) const { return a.intersectsLineSegment(v1, v2); }
+  };
+
+  struct point_test {
+    const carve::geom3d::Vector &v;
+    point_test(const carve::geom3d::Vector &_v) : v(_v) {}
+    bool operator()(const carve::geom3d::AABB &a) const { return a.containsPoint(v); }
+  };
+
+  carve::geom3d::AABB unionOf(const std::vector<carve::geom3d::AABB> &aabbs,
+                              const std::vector<unsigned> &order,
+                              unsigned begin,
+                              unsigned end) {
+    carve::geom3d::AABB result = aabbs[order[begin]];
+    for (unsigned i = begin + 1; i < end; ++i) {
+      result.unionAABB(aabbs[order[i]]);
+    }
+    return result;
+  }
+
+  // Append the subtree covering sorted primitives [begin, end) to
+  // nodes in depth first order. Levels at which every primitive in
+  // the range falls into the same octant are skipped, so that
+  // internal nodes always have at least two children.
+  void buildNode(const std::vector<uint32_t> &keys,
+                 const std::vector<carve::geom3d::AABB> &aabbs,
+                 const std::vector<unsigned> &order,
+                 unsigned begin,
+                 unsigned end,
+                 unsigned level,
+                 std::vector<node_t> &nodes) {
+    const unsigned MORTON_BITS = carve::csg::LinearOctree::MORTON_BITS;
+
+    unsigned idx = (unsigned)nodes.size();
+    nodes.push_back(node_t());
+    nodes[idx].begin = begin;
+    nodes[idx].end = end;
+
+    while (level < MORTON_BITS &&
+           (keys[begin] >> (3 * (MORTON_BITS - 1 - level))) == (keys[end - 1] >> (3 * (MORTON_BITS - 1 - level)))) {
+      ++level;
+    }
+
+    if (end - begin <= carve::csg::LinearOctree::LEAF_SIZE || level == MORTON_BITS) {
+      nodes[idx].is_leaf = true;
+      nodes[idx].aabb = unionOf(aabbs, order, begin, end);
+    } else {
+      nodes[idx].is_leaf = false;
+      const unsigned shift = 3 * (MORTON_BITS - 1 - level);
+      bool first = true;
+      carve::geom3d::AABB aabb;
+      for (unsigned i = begin; i < end; ) {
+        uint32_t limit = ((keys[i] >> shift) + 1) << shift;
+        unsigned j = (unsigned)(std::lower_bound(keys.begin() + i, keys.begin() + end, limit) - keys.begin());
+        unsigned child = (unsigned)nodes.size();
+        buildNode(keys, aabbs, order, i, j, level + 1, nodes);
+        if (first) {
+          aabb = nodes[child].aabb;
+          first = false;
+        } else {
+          aabb.unionAABB(nodes[child].aabb);
+        }
+        i = j;
+      }
+      nodes[idx].aabb = aabb;
+    }
+
+    nodes[idx].skip = (unsigned)nodes.size();
+  }
+
+}
+
+
+
+namespace carve {
+  namespace csg {
+
+    const unsigned LinearOctree::MORTON_BITS;
+    const unsigned LinearOctree::LEAF_SIZE;
+
+
+
+    LinearOctree::LinearOctree() : faces(), edges(), vertices(), executor(NULL) {
+    }
+
+    LinearOctree::~LinearOctree() {
+    }
+
+
+
+    void LinearOctree::addEdges(const std::vector<edge_t> &e) {
+      edges.items.reserve(edges.items.size() + e.size());
+      edges.item_aabbs.reserve(edges.item_aabbs.size() + e.size());
+      for (size_t i = 0; i < e.size(); ++i) {
+        carve::geom3d::AABB aabb;
+        aabb.fit(e[i].v1->v, e[i].v2->v);
+        aabb.expand(carve::EPSILON);
+        edges.items.push_back(&e[i]);
+        edges.item_aabbs.push_back(aabb);
+      }
+    }
+
+    void LinearOctree::addFaces(const std::vector<face_t> &f) {
+      faces.items.reserve(faces.items.size() + f.size());
+      faces.item_aabbs.reserve(faces.item_aabbs.size() + f.size());
+      for (size_t i = 0; i < f.size(); ++i) {
+        carve::geom3d::AABB aabb = f[i].aabb;
+        aabb.expand(carve::EPSILON);
+        faces.items.push_back(&f[i]);
+        faces.item_aabbs.push_back(aabb);
+      }
+    }
+
+    void LinearOctree::addVertices(const std::vector<const vertex_t *> &p) {
+      vertices.items.insert(vertices.items.end(), p.begin(), p.end());
+      vertices.item_aabbs.reserve(vertices.item_aabbs.size() + p.size());
+      for (size_t i = 0; i < p.size(); ++i) {
+        vertices.item_aabbs.push_back(carve::geom3d::AABB(p[i]->v, carve::geom3d::Vector::ZERO()));
+      }
+    }
+
+    void LinearOctree::addPoints(const std::vector<point_t> &p) {
+      points.items.reserve(points.items.size() + p.size());
+      points.item_aabbs.reserve(points.item_aabbs.size() + p.size());
+      for (size_t i = 0; i < p.size(); ++i) {
+        points.items.push_back(&p[i]);
+        points.item_aabbs.push_back(carve::geom3d::AABB(p[i], carve::geom3d::Vector::ZERO()));
+      }
+    }
+
+
+
+    void LinearOctree::build() {
+      static carve::TimingName FUNC_NAME("LinearOctree::build()");
+      carve::TimingBlock block(FUNC_NAME);
+
+      buildIndex(faces, executor);
+      buildIndex(edges, executor);
+      buildIndex(vertices, executor);
+      buildIndex(points, executor);
+    }
+
+    void LinearOctree::clear() {
+      faces.clear();
+      edges.clear();
+      vertices.clear();
+      points.clear();
+    }
+
+
+
+    template<typename item_t>
+    void LinearOctree::buildIndex(Index<item_t> &index, carve::Executor *executor) {
+      std::vector<unsigned> order;
+      buildNodes(index.item_aabbs, order, index.nodes, executor);
+
+      std::vector<const item_t *> items(order.size());
+      std::vector<carve::geom3d::AABB> item_aabbs(order.size());
+      for (size_t i = 0; i < order.size(); ++i) {
+        items[i] = index.items[order[i]];
+        item_aabbs[i] = index.item_aabbs[order[i]];
+      }
+      index.items.swap(items);
+      index.item_aabbs.swap(item_aabbs);
+    }
+
+
+
+    void LinearOctree::buildNodes(const std::vector<carve::geom3d::AABB> &aabbs,
+                                  std::vector<unsigned> &order,
+                                  std::vector<Node> &nodes,
+                                  carve::Executor *executor) {
+      const int n = (int)aabbs.size();
+
+      order.clear();
+      nodes.clear();
+      if (!n) return;
+
+      carve::geom3d::Vector lo = aabbs[0].pos, hi = aabbs[0].pos;
+      for (int i = 1; i < n; ++i) {
+        assign_op(lo, lo, aabbs[i].pos, carve::util::min_functor());
+        assign_op(hi, hi, aabbs[i].pos, carve::util::max_functor());
+      }
+      carve::geom3d::Vector scale;
+      for (unsigned k = 0; k < 3; ++k) {
+        double range = hi.v[k] - lo.v[k];
+        scale.v[k] = range > 0.0 ? 1023.0 / range : 0.0;
+      }
+
+      std::vector<uint32_t> keys(n), values(n);
+      KeyTask key_task(aabbs, lo, scale, keys, values);
+      carve::parallelFor(executor != NULL ? *executor : carve::defaultExecutor(), n, KEY_GRAIN, key_task);
+
+      radixSort(keys, values, executor);
+
+      order.assign(values.begin(), values.end());
+      nodes.reserve(2 * (n / LEAF_SIZE + 1));
+      buildNode(keys, aabbs, order, 0, (unsigned)n, 0, nodes);
+    }
+
+
+
+    uint32_t LinearOctree::mortonCode(const carve::geom3d::Vector &v,
+                                      const carve::geom3d::Vector &base,
+                                      const carve::geom3d::Vector &scale) {
+      return
+        (expandBits(quantize(v.x, base.x, scale.x)) << 2) |
+        (expandBits(quantize(v.y, base.y, scale.y)) << 1) |
+        (expandBits(quantize(v.z, base.z, scale.z)));
+    }
+
+
+
+    void LinearOctree::radixSort(std::vector<uint32_t> &keys,
+                                 std::vector<uint32_t> &values,
+                                 carve::Executor *executor) {
+      const size_t n = keys.size();
+      if (n < 2) return;
+
+      carve::Executor &exec = executor != NULL ? *executor : carve::defaultExecutor();
+
+      // the chunking depends only on n, so the result does not
+      // depend on the number of threads.
+      const int n_chunks = (int)((n + RADIX_CHUNK - 1) / RADIX_CHUNK);
+
+      std::vector<uint32_t> tmp_keys(n), tmp_values(n);
+      std::vector<size_t> hist(n_chunks * 256);
+
+      for (unsigned shift = 0; shift < 32; shift += 8) {
+        std::fill(hist.begin(), hist.end(), 0);
+
+        HistogramTask histogram_task(keys, hist, shift);
+        carve::parallelFor(exec, n, RADIX_CHUNK, histogram_task);
+
+        // convert counts to scatter offsets, ordered by digit and then
+        // by chunk, which keeps the sort stable.
+        size_t sum = 0;
+        bool trivial = false;
+        for (unsigned d = 0; d < 256; ++d) {
+          size_t digit_start = sum;
+          for (int c = 0; c < n_chunks; ++c) {
+            size_t t = hist[c * 256 + d];
+            hist[c * 256 + d] = sum;
+            sum += t;
+          }
+          if (sum - digit_start == n) trivial = true;
+        }
+        if (trivial) continue;
+
+        ScatterTask scatter_task(keys, values, tmp_keys, tmp_values, hist, shift);
+        carve::parallelFor(exec, n, RADIX_CHUNK, scatter_task);
+
+        keys.swap(tmp_keys);
+        values.swap(tmp_values);
+      }
+    }
+
+
+
+    void LinearOctree::findEdgesNear(const carve::geom::aabb<3> &aabb, std::vector<const edge_t *> &out) const {
+      edges.query(aabb_test(aabb), no_filter(), out);
+    }
+
+    void LinearOctree::findEdgesNear(const carve::geom3d::LineSegment &l, std::vector<const edge_t *> &out) const {
+      edges.query(linesegment_test(l.v1, l.v2), no_filter(), out);
+    }
+
+    void LinearOctree::findEdgesNear(const edge_t &e, std::vector<const edge_t *> &out) const {
+      edges.query(linesegment_test(e.v1->v, e.v2->v), no_filter(), out);
+    }
+
+    void LinearOctree::findEdgesNear(const carve::geom3d::Vector &v, std::vector<const edge_t *> &out) const {
+      edges.query(point_test(v), no_filter(), out);
+    }
+
+
+
+    void LinearOctree::findFacesNear(const carve::geom::aabb<3> &aabb, std::vector<const face_t *> &out) const {
+      faces.query(aabb_test(aabb), no_filter(), out);
+    }
+
+    void LinearOctree::findFacesNear(const carve::geom3d::LineSegment &l, std::vector<const face_t *> &out) const {
+      faces.query(linesegment_test(l.v1, l.v2), no_filter(), out);
+    }
+
+    void LinearOctree::findFacesNear(const edge_t &e, std::vector<const face_t *> &out) const {
+      faces.query(linesegment_test(e.v1->v, e.v2->v), no_filter(), out);
+    }
+
+
+
+    void LinearOctree::findVerticesNearAllowDupes(const carve::geom3d::Vector &v,
+                                                  std::vector<const vertex_t *> &out) const {
+      findVerticesNearAllowDupes(v, carve::EPSILON, out);
+    }
+
+    void LinearOctree::findVerticesNearAllowDupes(const carve::geom3d::Vector &v,
+                                                  double radius,
+                                                  std::vector<const vertex_t *> &out) const {
+      carve::geom3d::AABB aabb(v, carve::geom::VECTOR(radius, radius, radius));
+      vertices.query(aabb_test(aabb), no_filter(), out);
+    }
+
+    void LinearOctree::findPointsNearAllowDupes(const carve::geom3d::Vector &v,
+                                                std::vector<const point_t *> &out) const {
+      findPointsNearAllowDupes(v, carve::EPSILON, out);
+    }
+
+    void LinearOctree::findPointsNearAllowDupes(const carve::geom3d::Vector &v,
+                                                double radius,
+                                                std::vector<const point_t *> &out) const {
+      carve::geom3d::AABB aabb(v, carve::geom::VECTOR(radius, radius, radius));
+      points.query(aabb_test(aabb), no_filter(), out);
+    }
+
+  }
+}
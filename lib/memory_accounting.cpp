@@ -0,0 +1,238 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/memory_accounting.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+namespace carve {
+  namespace {
+
+    struct frame_t {
+      const void *key;
+      MemoryAccounting::Record *record;
+      int64_t live_at_entry;
+    };
+
+    struct state_t {
+      std::map<const void *, MemoryAccounting::Record> records;
+      std::vector<frame_t> stack;
+      int64_t live;
+      int64_t peak;
+
+      state_t() : records(), stack(), live(0), peak(0) {
+      }
+    };
+
+    state_t &state() {
+      static state_t s;
+      return s;
+    }
+
+    struct cmp_peak_growth {
+      bool operator()(const MemoryAccounting::Record &a, const MemoryAccounting::Record &b) const {
+        return a.peak_growth > b.peak_growth;
+      }
+    };
+
+    std::string formatBytes(uint64_t bytes) {
+      std::ostringstream out;
+      if (bytes >= 10 * 1024 * 1024) {
+        out << bytes / (1024 * 1024) << "MiB";
+      } else if (bytes >= 10 * 1024) {
+        out << bytes / 1024 << "KiB";
+      } else {
+        out << bytes << "B";
+      }
+      return out.str();
+    }
+
+  }
+
+
+
+  bool MemoryAccounting::is_enabled = false;
+
+
+
+  void MemoryAccounting::enable() {
+    is_enabled = true;
+  }
+
+
+
+  void MemoryAccounting::disable() {
+    is_enabled = false;
+  }
+
+
+
+  void MemoryAccounting::reset() {
+    state_t &s = state();
+    s.records.clear();
+    s.stack.clear();
+    s.live = s.peak = 0;
+  }
+
+
+
+  void MemoryAccounting::allocated(size_t bytes) {
+#pragma omp critical(carve_memory_accounting)
+    {
+      state_t &s = state();
+      s.live += bytes;
+      if (s.live > s.peak) s.peak = s.live;
+      if (s.stack.size()) {
+        Record *r = s.stack.back().record;
+        r->n_allocs++;
+        r->bytes_allocated += bytes;
+      }
+      for (size_t i = 0; i < s.stack.size(); ++i) {
+        Record *r = s.stack[i].record;
+        if ((uint64_t)s.live > r->peak_live) r->peak_live = s.live;
+        int64_t growth = s.live - s.stack[i].live_at_entry;
+        if (growth > 0 && (uint64_t)growth > r->peak_growth) r->peak_growth = growth;
+      }
+    }
+  }
+
+
+
+  void MemoryAccounting::released(size_t bytes) {
+#pragma omp critical(carve_memory_accounting)
+    {
+      state_t &s = state();
+      s.live -= bytes;
+      if (s.stack.size()) {
+        Record *r = s.stack.back().record;
+        r->n_frees++;
+        r->bytes_released += bytes;
+      }
+    }
+  }
+
+
+
+  bool MemoryAccounting::enter(const void *key, const char *name) {
+#if defined(_OPENMP)
+    if (omp_in_parallel()) return false;
+#endif
+#pragma omp critical(carve_memory_accounting)
+    {
+      state_t &s = state();
+      std::map<const void *, Record>::iterator i = s.records.find(key);
+      if (i == s.records.end()) {
+        i = s.records.insert(std::make_pair(key, Record(name))).first;
+      }
+      Record *r = &(*i).second;
+      r->n_calls++;
+      if (s.live > 0 && (uint64_t)s.live > r->peak_live) r->peak_live = s.live;
+
+      frame_t frame;
+      frame.key = key;
+      frame.record = r;
+      frame.live_at_entry = s.live;
+      s.stack.push_back(frame);
+    }
+    return true;
+  }
+
+
+
+  void MemoryAccounting::leave(const void *key) {
+#pragma omp critical(carve_memory_accounting)
+    {
+      state_t &s = state();
+      for (size_t i = s.stack.size(); i--; ) {
+        if (s.stack[i].key == key) {
+          s.stack.erase(s.stack.begin() + i);
+          break;
+        }
+      }
+    }
+  }
+
+
+
+  int64_t MemoryAccounting::liveBytes() {
+    int64_t live;
+#pragma omp critical(carve_memory_accounting)
+    live = state().live;
+    return live;
+  }
+
+
+
+  int64_t MemoryAccounting::peakBytes() {
+    int64_t peak;
+#pragma omp critical(carve_memory_accounting)
+    peak = state().peak;
+    return peak;
+  }
+
+
+
+  void MemoryAccounting::records(std::vector<Record> &out) {
+    state_t &s = state();
+    out.clear();
+    out.reserve(s.records.size());
+    for (std::map<const void *, Record>::const_iterator i = s.records.begin(); i != s.records.end(); ++i) {
+      out.push_back((*i).second);
+    }
+    std::stable_sort(out.begin(), out.end(), cmp_peak_growth());
+  }
+
+
+
+  MemoryAccounting::Record MemoryAccounting::record(const char *name) {
+    state_t &s = state();
+    for (std::map<const void *, Record>::const_iterator i = s.records.begin(); i != s.records.end(); ++i) {
+      if ((*i).second.name != NULL && !std::strcmp((*i).second.name, name)) return (*i).second;
+    }
+    return Record(name);
+  }
+
+
+
+  void MemoryAccounting::print(std::ostream &out) {
+    std::vector<Record> recs;
+    records(recs);
+
+    out << "Memory: live " << formatBytes(std::max(liveBytes(), (int64_t)0)) << " peak " << formatBytes(peakBytes()) << std::endl;
+    for (size_t i = 0; i < recs.size(); ++i) {
+      const Record &r = recs[i];
+      out << "  " << (r.name ? r.name : "(unnamed)")
+          << " - calls: " << r.n_calls
+          << " allocs: " << r.n_allocs
+          << " alloc: " << formatBytes(r.bytes_allocated)
+          << " freed: " << formatBytes(r.bytes_released)
+          << " peak growth: " << formatBytes(r.peak_growth)
+          << " peak live: " << formatBytes(r.peak_live)
+          << std::endl;
+    }
+  }
+
+}
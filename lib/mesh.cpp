@@ -22,6 +22,7 @@
 #include <carve/mesh.hpp>
 #include <carve/mesh_impl.hpp>
 #include <carve/rtree.hpp>
+#include <carve/cancel.hpp>
 
 #include <carve/poly.hpp>
 
@@ -1031,7 +1032,8 @@ carve::PointClass carve::mesh::classifyPoint(
     const carve::geom::vector<3> &v,
     bool even_odd,
     const carve::mesh::Mesh<3> *mesh,
-    const carve::mesh::Face<3> **hit_face) {
+    const carve::mesh::Face<3> **hit_face,
+    const carve::CancellationToken *cancellation) {
 
   if (hit_face) *hit_face = NULL;
 
@@ -1077,8 +1079,12 @@ carve::PointClass carve::mesh::classifyPoint(
 
 
   std::vector<std::pair<const carve::mesh::Face<3> *, carve::geom::vector<3> > > manifold_intersections;
+  unsigned n_tries = 0;
 
   for (;;) {
+    // degenerate input can make every ray fail; give callers a way out.
+    if (cancellation && !(++n_tries & 15)) cancellation->check("classifyPoint");
+
     double a1 = random() / double(RAND_MAX) * M_TWOPI;
     double a2 = random() / double(RAND_MAX) * M_TWOPI;
 
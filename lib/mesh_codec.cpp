@@ -0,0 +1,739 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/mesh_codec.hpp>
+#include <carve/timing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+namespace {
+
+  typedef carve::mesh::MeshSet<3> meshset_t;
+  typedef meshset_t::vertex_t vertex_t;
+  typedef meshset_t::edge_t edge_t;
+  typedef meshset_t::face_t face_t;
+  typedef meshset_t::mesh_t mesh_t;
+  typedef carve::geom::vector<3> vector_t;
+
+  // The stream starts with a fixed size header:
+  //
+  //   "CVMC", version, flags,
+  //   vertex count, face count, mesh count, payload size,
+  //   [origin x, y, z, quantum] if FLAG_QUANTISED is set,
+  //
+  // with integers and doubles stored as 8 byte little endian
+  // values, followed by the range coded payload.
+  const char MAGIC[4] = { 'C', 'V', 'M', 'C' };
+  const unsigned char VERSION = 1;
+  const unsigned char FLAG_QUANTISED = 1;
+
+  const size_t NONE = ~(size_t)0;
+
+  const unsigned PROB_BITS = 11;
+  const unsigned ADAPT_SHIFT = 5;
+  const uint16_t PROB_INIT = 1 << (PROB_BITS - 1);
+  const uint32_t RANGE_TOP = 1U << 24;
+
+  const size_t IO_BUFFER_SIZE = 1 << 16;
+
+  // every vertex and face is coded with at least one adaptive binary
+  // decision. Probabilities stop adapting within 2^ADAPT_SHIFT of
+  // either end, so a decision costs at least -log2(2017 / 2048) > 1/64
+  // bits, and a payload of n bytes holds fewer than 8 * 64 * n
+  // vertices or faces.
+  const uint64_t MAX_ELEMENTS_PER_BYTE = 8 * 64;
+
+
+
+  // An LZMA style binary range coder with adaptive probabilities.
+  class RangeEncoder {
+    std::vector<char> &out;
+    uint64_t low;
+    uint32_t range;
+    unsigned char cache;
+    uint64_t cache_size;
+
+    void shiftLow() {
+      if ((uint32_t)low < 0xff000000U || (low >> 32) != 0) {
+        unsigned char carry = (unsigned char)(low >> 32);
+        unsigned char c = cache;
+        do {
+          out.push_back((char)(unsigned char)(c + carry));
+          c = 0xff;
+        } while (--cache_size != 0);
+        cache = (unsigned char)(low >> 24);
+      }
+      ++cache_size;
+      low = (low & 0x00ffffffU) << 8;
+    }
+
+  public:
+    RangeEncoder(std::vector<char> &_out) : out(_out), low(0), range(0xffffffffU), cache(0), cache_size(1) {
+    }
+
+    void encodeBit(uint16_t &prob, unsigned bit) {
+      uint32_t bound = (range >> PROB_BITS) * prob;
+      if (bit) {
+        low += bound;
+        range -= bound;
+        prob -= prob >> ADAPT_SHIFT;
+      } else {
+        range = bound;
+        prob += ((1 << PROB_BITS) - prob) >> ADAPT_SHIFT;
+      }
+      while (range < RANGE_TOP) {
+        range <<= 8;
+        shiftLow();
+      }
+    }
+
+    void encodeDirect(uint64_t value, unsigned n_bits) {
+      while (n_bits--) {
+        range >>= 1;
+        if ((value >> n_bits) & 1) low += range;
+        while (range < RANGE_TOP) {
+          range <<= 8;
+          shiftLow();
+        }
+      }
+    }
+
+    void finish() {
+      for (unsigned i = 0; i < 5; ++i) shiftLow();
+    }
+  };
+
+
+
+  class RangeDecoder {
+    std::istream &in;
+    uint64_t remaining;
+    std::vector<char> buffer;
+    size_t pos;
+    uint32_t range;
+    uint32_t code;
+
+    // bytes past the end of the payload read as zero, as written by
+    // RangeEncoder::finish().
+    unsigned char next() {
+      if (pos == buffer.size()) {
+        if (remaining == 0) return 0;
+        buffer.resize((size_t)std::min<uint64_t>(remaining, IO_BUFFER_SIZE));
+        in.read(&buffer[0], (std::streamsize)buffer.size());
+        if ((size_t)in.gcount() != buffer.size()) throw carve::exception("readCompressed: unexpected end of data");
+        remaining -= buffer.size();
+        pos = 0;
+      }
+      return (unsigned char)buffer[pos++];
+    }
+
+  public:
+    RangeDecoder(std::istream &_in, uint64_t size) : in(_in), remaining(size), buffer(), pos(0), range(0xffffffffU), code(0) {
+      for (unsigned i = 0; i < 5; ++i) code = (code << 8) | next();
+    }
+
+    unsigned decodeBit(uint16_t &prob) {
+      uint32_t bound = (range >> PROB_BITS) * prob;
+      unsigned bit;
+      if (code < bound) {
+        range = bound;
+        prob += ((1 << PROB_BITS) - prob) >> ADAPT_SHIFT;
+        bit = 0;
+      } else {
+        code -= bound;
+        range -= bound;
+        prob -= prob >> ADAPT_SHIFT;
+        bit = 1;
+      }
+      while (range < RANGE_TOP) {
+        range <<= 8;
+        code = (code << 8) | next();
+      }
+      return bit;
+    }
+
+    uint64_t decodeDirect(unsigned n_bits) {
+      uint64_t value = 0;
+      while (n_bits--) {
+        range >>= 1;
+        unsigned bit = code >= range;
+        if (bit) code -= range;
+        value = (value << 1) | bit;
+        while (range < RANGE_TOP) {
+          range <<= 8;
+          code = (code << 8) | next();
+        }
+      }
+      return value;
+    }
+  };
+
+
+
+  // Unsigned integers are coded as their bit length, followed by the
+  // bits below the leading one. The length and the first of those
+  // bits are modelled; the rest are close to uniform.
+  struct uint_model_t {
+    uint16_t length[128];
+    uint16_t high[65];
+
+    uint_model_t() {
+      std::fill(length, length + 128, PROB_INIT);
+      std::fill(high, high + 65, PROB_INIT);
+    }
+
+    void encode(RangeEncoder &rc, uint64_t value) {
+      unsigned n = 0;
+      while (n < 64 && (value >> n) != 0) ++n;
+      unsigned m = 1;
+      for (int i = 6; i >= 0; --i) {
+        unsigned bit = (n >> i) & 1;
+        rc.encodeBit(length[m], bit);
+        m = (m << 1) | bit;
+      }
+      if (n >= 2) {
+        rc.encodeBit(high[n], (unsigned)(value >> (n - 2)) & 1);
+        rc.encodeDirect(value, n - 2);
+      }
+    }
+
+    uint64_t decode(RangeDecoder &rc) {
+      unsigned m = 1;
+      for (int i = 6; i >= 0; --i) {
+        m = (m << 1) | rc.decodeBit(length[m]);
+      }
+      unsigned n = m - 128;
+      if (n > 64) throw carve::exception("readCompressed: invalid data");
+      if (n < 2) return n;
+      uint64_t value = 2 | rc.decodeBit(high[n]);
+      return (value << (n - 2)) | rc.decodeDirect(n - 2);
+    }
+  };
+
+  inline uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+  }
+
+  inline int64_t unzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+  }
+
+  // Maps doubles to integers in the same order, so that the
+  // difference between nearby values is small.
+  inline uint64_t doubleKey(double d) {
+    uint64_t u;
+    std::memcpy(&u, &d, sizeof(u));
+    return (u >> 63) ? ~u : (u | ((uint64_t)1 << 63));
+  }
+
+  inline double keyDouble(uint64_t u) {
+    u = (u >> 63) ? (u & ~((uint64_t)1 << 63)) : ~u;
+    double d;
+    std::memcpy(&d, &u, sizeof(d));
+    return d;
+  }
+
+
+
+  struct models_t {
+    // context: whether the previous gate led to a new face.
+    uint16_t gate[2];
+    // context: 0 for the first vertex of a face reached through a
+    // gate, 1 otherwise.
+    uint16_t is_new[2];
+    uint16_t more_seeds;
+    uint_model_t degree;
+    uint_model_t ref;
+    uint_model_t coord[3];
+
+    models_t() : degree(), ref() {
+      gate[0] = gate[1] = PROB_INIT;
+      is_new[0] = is_new[1] = PROB_INIT;
+      more_seeds = PROB_INIT;
+    }
+  };
+
+
+
+  // How a vertex at position i of a face is coded. If it is new, its
+  // position is predicted as P[a] + P[b] - P[c], P[a] or 0, depending
+  // on which of a, b, c are NONE. Otherwise its number is coded
+  // relative to prev.
+  struct vertex_context_t {
+    size_t a, b, c;
+    size_t prev;
+    unsigned ctx;
+
+    // face holds the numbers of the vertices before i. gate_c is the
+    // number of the vertex opposite the gate in the parent face, or
+    // NONE for a seed face.
+    vertex_context_t(const std::vector<size_t> &face, size_t i, size_t gate_c, size_t n_coded) {
+      b = c = NONE;
+      ctx = 1;
+      if (i == 0) {
+        a = prev = n_coded ? n_coded - 1 : NONE;
+        if (prev == NONE) prev = 0;
+        return;
+      }
+      a = prev = face[i - 1];
+      if (gate_c == NONE) return;
+      if (i == 2) {
+        // the parallelogram across the gate edge.
+        b = face[0];
+        c = gate_c;
+        ctx = 0;
+      } else {
+        b = face[i - 3];
+        c = face[i - 2];
+      }
+    }
+  };
+
+  template<typename T>
+  inline T predict(const std::vector<T> &coords, unsigned axis, const vertex_context_t &ctx) {
+    if (ctx.a == NONE) return T(0);
+    if (ctx.b == NONE) return coords[ctx.a * 3 + axis];
+    return coords[ctx.a * 3 + axis] + coords[ctx.b * 3 + axis] - coords[ctx.c * 3 + axis];
+  }
+
+
+
+  class Encoder {
+    const meshset_t *meshset;
+    RangeEncoder &rc;
+    models_t models;
+    bool quantised;
+    double quantum;
+    vector_t origin;
+
+    // the number of each vertex of vertex_storage, or NONE if it has
+    // not yet been coded.
+    std::vector<size_t> number;
+    std::vector<int64_t> q_coords;
+    std::vector<double> d_coords;
+    std::vector<size_t> face_verts;
+
+    size_t numberOf(const vertex_t *v) const {
+      return number[(size_t)(v - &meshset->vertex_storage[0])];
+    }
+
+    void encodeVertex(const vertex_t *v, const vertex_context_t &ctx) {
+      size_t &num = number[(size_t)(v - &meshset->vertex_storage[0])];
+      if (num != NONE) {
+        rc.encodeBit(models.is_new[ctx.ctx], 0);
+        models.ref.encode(rc, zigzag((int64_t)num - (int64_t)ctx.prev));
+        face_verts.push_back(num);
+        return;
+      }
+
+      rc.encodeBit(models.is_new[ctx.ctx], 1);
+      for (unsigned axis = 0; axis < 3; ++axis) {
+        if (quantised) {
+          int64_t q = (int64_t)std::floor((v->v[axis] - origin.v[axis]) / quantum + 0.5);
+          models.coord[axis].encode(rc, zigzag(q - predict(q_coords, axis, ctx)));
+          q_coords.push_back(q);
+        } else {
+          uint64_t delta = doubleKey(v->v[axis]) - doubleKey(predict(d_coords, axis, ctx));
+          models.coord[axis].encode(rc, zigzag((int64_t)delta));
+          d_coords.push_back(v->v[axis]);
+        }
+      }
+      num = n_vertices++;
+      face_verts.push_back(num);
+    }
+
+    // Code the vertices of the face of start, beginning at start. If
+    // gate is not NULL, the face is reached across it, and the first
+    // two vertices are known.
+    void encodeFace(const edge_t *start, const edge_t *gate) {
+      const face_t *face = start->face;
+      if (face->n_edges < 3) throw carve::exception("writeCompressed: degenerate face");
+      models.degree.encode(rc, face->n_edges - 3);
+
+      face_verts.clear();
+      size_t gate_c = NONE;
+      const edge_t *e = start;
+      if (gate != NULL) {
+        face_verts.push_back(numberOf(start->vert));
+        face_verts.push_back(numberOf(start->next->vert));
+        gate_c = numberOf(gate->prev->vert);
+        e = start->next->next;
+      }
+      for (size_t i = face_verts.size(); i < face->n_edges; ++i, e = e->next) {
+        encodeVertex(e->vert, vertex_context_t(face_verts, i, gate_c, n_vertices));
+      }
+      ++n_faces;
+    }
+
+  public:
+    size_t n_vertices;
+    size_t n_faces;
+
+    Encoder(const meshset_t *_meshset, RangeEncoder &_rc, double _quantum, const vector_t &_origin) :
+        meshset(_meshset), rc(_rc), models(), quantised(_quantum > 0.0), quantum(_quantum), origin(_origin),
+        number(_meshset->vertex_storage.size(), NONE), q_coords(), d_coords(), face_verts(),
+        n_vertices(0), n_faces(0) {
+    }
+
+    void encodeMesh(const mesh_t *mesh) {
+      std::vector<const face_t *> faces(mesh->faces.begin(), mesh->faces.end());
+      std::sort(faces.begin(), faces.end());
+      std::vector<bool> visited(faces.size(), false);
+
+      std::vector<const edge_t *> queue;
+      unsigned gate_ctx = 0;
+      for (size_t seed = 0; seed < mesh->faces.size(); ++seed) {
+        size_t s = std::lower_bound(faces.begin(), faces.end(), mesh->faces[seed]) - faces.begin();
+        if (visited[s]) continue;
+        if (seed) rc.encodeBit(models.more_seeds, 1);
+
+        visited[s] = true;
+        encodeFace(mesh->faces[seed]->edge, NULL);
+        queue.clear();
+        const edge_t *e = mesh->faces[seed]->edge;
+        do {
+          queue.push_back(e);
+          e = e->next;
+        } while (e != mesh->faces[seed]->edge);
+
+        for (size_t head = 0; head < queue.size(); ++head) {
+          const edge_t *gate = queue[head];
+          const edge_t *r = gate->rev;
+          size_t f = NONE;
+          if (r != NULL) {
+            std::vector<const face_t *>::iterator i = std::lower_bound(faces.begin(), faces.end(), r->face);
+            if (i != faces.end() && *i == r->face && !visited[i - faces.begin()]) f = i - faces.begin();
+          }
+          rc.encodeBit(models.gate[gate_ctx], f != NONE);
+          gate_ctx = f != NONE;
+          if (f == NONE) continue;
+
+          visited[f] = true;
+          encodeFace(r, gate);
+          for (e = r->next; e != r; e = e->next) queue.push_back(e);
+        }
+      }
+      rc.encodeBit(models.more_seeds, 0);
+    }
+  };
+
+
+
+  class Decoder {
+    RangeDecoder &rc;
+    models_t models;
+    bool quantised;
+    double quantum;
+    vector_t origin;
+    std::vector<vertex_t> &vertex_storage;
+
+    std::vector<int64_t> q_coords;
+    std::vector<double> d_coords;
+    std::vector<size_t> face_verts;
+    std::vector<vertex_t *> face_ptrs;
+    size_t n_vertices;
+
+    void decodeVertex(const vertex_context_t &ctx) {
+      if (!rc.decodeBit(models.is_new[ctx.ctx])) {
+        int64_t num = (int64_t)ctx.prev + unzigzag(models.ref.decode(rc));
+        if (num < 0 || (uint64_t)num >= n_vertices) throw carve::exception("readCompressed: invalid vertex reference");
+        face_verts.push_back((size_t)num);
+        return;
+      }
+
+      if (n_vertices == vertex_storage.size()) throw carve::exception("readCompressed: too many vertices");
+      vector_t &v = vertex_storage[n_vertices].v;
+      for (unsigned axis = 0; axis < 3; ++axis) {
+        if (quantised) {
+          int64_t q = predict(q_coords, axis, ctx) + unzigzag(models.coord[axis].decode(rc));
+          q_coords.push_back(q);
+          v.v[axis] = origin.v[axis] + (double)q * quantum;
+        } else {
+          uint64_t key = doubleKey(predict(d_coords, axis, ctx)) + (uint64_t)unzigzag(models.coord[axis].decode(rc));
+          d_coords.push_back(keyDouble(key));
+          v.v[axis] = d_coords.back();
+        }
+      }
+      face_verts.push_back(n_vertices++);
+    }
+
+    face_t *decodeFace(const edge_t *gate) {
+      uint64_t degree = models.degree.decode(rc) + 3;
+      if (degree > vertex_storage.size()) throw carve::exception("readCompressed: invalid face");
+
+      face_verts.clear();
+      size_t gate_c = NONE;
+      if (gate != NULL) {
+        face_verts.push_back((size_t)(gate->v2() - &vertex_storage[0]));
+        face_verts.push_back((size_t)(gate->v1() - &vertex_storage[0]));
+        gate_c = (size_t)(gate->prev->v1() - &vertex_storage[0]);
+      }
+      for (size_t i = face_verts.size(); i < degree; ++i) {
+        decodeVertex(vertex_context_t(face_verts, i, gate_c, n_vertices));
+      }
+
+      face_ptrs.clear();
+      for (size_t i = 0; i < face_verts.size(); ++i) face_ptrs.push_back(&vertex_storage[face_verts[i]]);
+      return new face_t(face_ptrs.begin(), face_ptrs.end());
+    }
+
+    struct half_edge_t {
+      size_t lo, hi;
+      bool fwd;
+      edge_t *edge;
+
+      half_edge_t(edge_t *e, const vertex_t *base) : edge(e) {
+        size_t a = (size_t)(e->v1() - base), b = (size_t)(e->v2() - base);
+        lo = std::min(a, b);
+        hi = std::max(a, b);
+        fwd = a < b;
+      }
+
+      bool operator<(const half_edge_t &o) const {
+        if (lo != o.lo) return lo < o.lo;
+        if (hi != o.hi) return hi < o.hi;
+        return fwd < o.fwd;
+      }
+    };
+
+    // Link the edges that were not crossed by the traversal, where
+    // exactly two edges join the same pair of vertices in opposite
+    // directions.
+    void linkRemainingEdges(const std::vector<face_t *> &faces) {
+      std::vector<half_edge_t> edges;
+      for (size_t f = 0; f < faces.size(); ++f) {
+        edge_t *e = faces[f]->edge;
+        do {
+          if (e->rev == NULL) edges.push_back(half_edge_t(e, &vertex_storage[0]));
+          e = e->next;
+        } while (e != faces[f]->edge);
+      }
+      std::sort(edges.begin(), edges.end());
+
+      for (size_t i = 0, j; i < edges.size(); i = j) {
+        for (j = i + 1; j < edges.size() && edges[j].lo == edges[i].lo && edges[j].hi == edges[i].hi; ++j) {}
+        if (j - i == 2 && edges[i].fwd != edges[i + 1].fwd) {
+          edges[i].edge->rev = edges[i + 1].edge;
+          edges[i + 1].edge->rev = edges[i].edge;
+        }
+      }
+    }
+
+    void decodeFaces(std::vector<face_t *> &faces) {
+      std::vector<edge_t *> queue;
+      unsigned gate_ctx = 0;
+
+      do {
+        faces.push_back(decodeFace(NULL));
+        queue.clear();
+        edge_t *e = faces.back()->edge;
+        do {
+          queue.push_back(e);
+          e = e->next;
+        } while (e != faces.back()->edge);
+
+        for (size_t head = 0; head < queue.size(); ++head) {
+          unsigned bit = rc.decodeBit(models.gate[gate_ctx]);
+          gate_ctx = bit;
+          if (!bit) continue;
+
+          edge_t *gate = queue[head];
+          face_t *face = decodeFace(gate);
+          faces.push_back(face);
+          edge_t *r = face->edge;
+          r->rev = gate;
+          gate->rev = r;
+          for (e = r->next; e != r; e = e->next) queue.push_back(e);
+        }
+      } while (rc.decodeBit(models.more_seeds));
+    }
+
+  public:
+    size_t n_faces;
+
+    Decoder(RangeDecoder &_rc, double _quantum, const vector_t &_origin, std::vector<vertex_t> &_vertex_storage) :
+        rc(_rc), models(), quantised(_quantum > 0.0), quantum(_quantum), origin(_origin),
+        vertex_storage(_vertex_storage), q_coords(), d_coords(), face_verts(), face_ptrs(),
+        n_vertices(0), n_faces(0) {
+    }
+
+    mesh_t *decodeMesh() {
+      std::vector<face_t *> faces;
+      try {
+        decodeFaces(faces);
+      } catch (...) {
+        for (size_t i = 0; i < faces.size(); ++i) delete faces[i];
+        throw;
+      }
+
+      linkRemainingEdges(faces);
+      for (size_t i = 0; i < faces.size(); ++i) faces[i]->id = i;
+      n_faces += faces.size();
+      return new mesh_t(faces);
+    }
+
+    size_t vertexCount() const {
+      return n_vertices;
+    }
+  };
+
+
+
+  void writeU64(std::ostream &out, uint64_t v) {
+    char buf[8];
+    for (unsigned i = 0; i < 8; ++i) buf[i] = (char)(unsigned char)(v >> (i * 8));
+    out.write(buf, 8);
+  }
+
+  void writeDouble(std::ostream &out, double d) {
+    uint64_t u;
+    std::memcpy(&u, &d, sizeof(u));
+    writeU64(out, u);
+  }
+
+  uint64_t readU64(std::istream &in) {
+    unsigned char buf[8];
+    in.read((char *)buf, 8);
+    if (in.gcount() != 8) throw carve::exception("readCompressed: unexpected end of data");
+    uint64_t v = 0;
+    for (unsigned i = 0; i < 8; ++i) v |= (uint64_t)buf[i] << (i * 8);
+    return v;
+  }
+
+  double readDouble(std::istream &in) {
+    uint64_t u = readU64(in);
+    double d;
+    std::memcpy(&d, &u, sizeof(d));
+    return d;
+  }
+
+}
+
+
+
+void carve::mesh::writeCompressed(std::ostream &out, const MeshSet<3> *meshset, double quantum) {
+  static carve::TimingName FUNC_NAME("writeCompressed()");
+  carve::TimingBlock block(FUNC_NAME);
+
+  vector_t origin = carve::geom::VECTOR(0.0, 0.0, 0.0);
+  if (quantum > 0.0 && meshset->vertex_storage.size()) {
+    origin = meshset->vertex_storage[0].v;
+    for (size_t i = 1; i < meshset->vertex_storage.size(); ++i) {
+      origin = carve::geom::VECTOR(std::min(origin.x, meshset->vertex_storage[i].v.x),
+                                   std::min(origin.y, meshset->vertex_storage[i].v.y),
+                                   std::min(origin.z, meshset->vertex_storage[i].v.z));
+    }
+  } else {
+    quantum = 0.0;
+  }
+
+  std::vector<char> payload;
+  RangeEncoder rc(payload);
+  Encoder encoder(meshset, rc, quantum, origin);
+  for (size_t i = 0; i < meshset->meshes.size(); ++i) {
+    if (meshset->meshes[i]->faces.size()) encoder.encodeMesh(meshset->meshes[i]);
+  }
+  rc.finish();
+
+  size_t n_meshes = 0;
+  for (size_t i = 0; i < meshset->meshes.size(); ++i) {
+    if (meshset->meshes[i]->faces.size()) ++n_meshes;
+  }
+
+  out.write(MAGIC, 4);
+  out.put((char)VERSION);
+  out.put((char)(quantum > 0.0 ? FLAG_QUANTISED : 0));
+  writeU64(out, encoder.n_vertices);
+  writeU64(out, encoder.n_faces);
+  writeU64(out, n_meshes);
+  writeU64(out, payload.size());
+  if (quantum > 0.0) {
+    writeDouble(out, origin.x);
+    writeDouble(out, origin.y);
+    writeDouble(out, origin.z);
+    writeDouble(out, quantum);
+  }
+  if (payload.size()) out.write(&payload[0], (std::streamsize)payload.size());
+  if (!out) throw carve::exception("writeCompressed: failed to write");
+}
+
+
+
+carve::mesh::MeshSet<3> *carve::mesh::readCompressed(std::istream &in) {
+  static carve::TimingName FUNC_NAME("readCompressed()");
+  carve::TimingBlock block(FUNC_NAME);
+
+  char magic[4];
+  in.read(magic, 4);
+  if (in.gcount() != 4 || std::memcmp(magic, MAGIC, 4)) throw carve::exception("readCompressed: not a compressed mesh");
+  int version = in.get();
+  int flags = in.get();
+  if (version != VERSION || flags < 0) throw carve::exception("readCompressed: unsupported version");
+
+  uint64_t n_vertices = readU64(in);
+  uint64_t n_faces = readU64(in);
+  uint64_t n_meshes = readU64(in);
+  uint64_t payload_size = readU64(in);
+  double quantum = 0.0;
+  vector_t origin = carve::geom::VECTOR(0.0, 0.0, 0.0);
+  if (flags & FLAG_QUANTISED) {
+    origin.x = readDouble(in);
+    origin.y = readDouble(in);
+    origin.z = readDouble(in);
+    quantum = readDouble(in);
+    if (!(quantum > 0.0)) throw carve::exception("readCompressed: invalid quantum");
+  }
+  if (n_meshes > n_faces ||
+      (uint64_t)(size_t)n_vertices != n_vertices ||
+      n_vertices / MAX_ELEMENTS_PER_BYTE > payload_size ||
+      n_faces / MAX_ELEMENTS_PER_BYTE > payload_size) {
+    throw carve::exception("readCompressed: invalid header");
+  }
+
+  std::vector<vertex_t> vertex_storage;
+  std::vector<mesh_t *> meshes;
+  try {
+    vertex_storage.resize((size_t)n_vertices);
+    meshes.reserve((size_t)n_meshes);
+  } catch (std::bad_alloc &) {
+    throw carve::exception("readCompressed: header counts too large");
+  } catch (std::length_error &) {
+    throw carve::exception("readCompressed: header counts too large");
+  }
+
+  try {
+    RangeDecoder rc(in, payload_size);
+    Decoder decoder(rc, quantum, origin, vertex_storage);
+    for (uint64_t i = 0; i < n_meshes; ++i) meshes.push_back(decoder.decodeMesh());
+    if (decoder.vertexCount() != n_vertices || decoder.n_faces != n_faces) {
+      throw carve::exception("readCompressed: counts do not match header");
+    }
+  } catch (...) {
+    for (size_t i = 0; i < meshes.size(); ++i) delete meshes[i];
+    throw;
+  }
+
+  return new meshset_t(vertex_storage, meshes);
+}
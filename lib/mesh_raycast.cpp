@@ -0,0 +1,417 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/mesh_raycast.hpp>
+
+#include <carve/rtree.hpp>
+#include <carve/triangulator.hpp>
+#include <carve/timing.hpp>
+#include <carve/executor.hpp>
+
+#include <algorithm>
+#include <memory>
+
+namespace carve {
+  namespace mesh {
+    namespace {
+
+      const unsigned P = RayCaster::PACKET_SIZE;
+
+      // packets are distributed in chunks of this many for firstHits().
+      const size_t PACKET_GRAIN = 16;
+
+      // rays are gathered into chunks of this many for allHits().
+      const size_t RAY_CHUNK = 256;
+
+      // tolerance on barycentric coordinates, so that rays through
+      // shared edges are not lost to rounding.
+      const double BARY_EPSILON = 1e-12;
+
+      // a packet of rays, in structure of arrays form.
+      struct packet_t {
+        double o[3][P];
+        double d[3][P];
+        double inv[3][P];
+        unsigned n;
+
+        packet_t(const RayCaster::ray_t *rays, unsigned _n) : n(_n) {
+          for (unsigned r = 0; r < P; ++r) {
+            // unused lanes duplicate the first ray.
+            const RayCaster::ray_t &ray = rays[r < n ? r : 0];
+            for (unsigned k = 0; k < 3; ++k) {
+              o[k][r] = ray.v.v[k];
+              d[k][r] = ray.D.v[k];
+              inv[k][r] = 1.0 / ray.D.v[k];
+            }
+          }
+        }
+
+        // true if any ray of the packet meets the box within [0, t_max].
+        bool hitsBox(const carve::geom::vector<3> &lo,
+                     const carve::geom::vector<3> &hi,
+                     const double *t_max) const {
+          unsigned hit = 0;
+          for (unsigned r = 0; r < P; ++r) {
+            double t0 = 0.0, t1 = t_max[r];
+            for (unsigned k = 0; k < 3; ++k) {
+              double a = (lo.v[k] - o[k][r]) * inv[k][r];
+              double b = (hi.v[k] - o[k][r]) * inv[k][r];
+              if (a > b) std::swap(a, b);
+              // written so that NaN (a zero direction component with
+              // the origin on the slab boundary) leaves t0, t1 alone.
+              t0 = a > t0 ? a : t0;
+              t1 = b < t1 ? b : t1;
+            }
+            hit |= (t0 <= t1);
+          }
+          return hit != 0;
+        }
+      };
+
+      // keeps the nearest hit of each ray, shrinking t_max as hits
+      // are found so that further boxes and triangles are culled.
+      struct first_hit_t {
+        unsigned tri[P];
+        double u[P], v[P];
+
+        first_hit_t() {
+          std::fill(tri, tri + P, ~0U);
+        }
+
+        void operator()(unsigned r, unsigned t, double hit_t, double hit_u, double hit_v, double *t_max) {
+          tri[r] = t;
+          u[r] = hit_u;
+          v[r] = hit_v;
+          t_max[r] = hit_t;
+        }
+      };
+
+      struct all_hits_t {
+        struct entry_t {
+          unsigned tri;
+          double t, u, v;
+
+          bool operator<(const entry_t &other) const {
+            if (t != other.t) return t < other.t;
+            return tri < other.tri;
+          }
+        };
+
+        std::vector<entry_t> hits[P];
+
+        void operator()(unsigned r, unsigned t, double hit_t, double u, double v, double * /* t_max */) {
+          entry_t h;
+          h.tri = t;
+          h.t = hit_t;
+          h.u = u;
+          h.v = v;
+          hits[r].push_back(h);
+        }
+      };
+
+    }
+
+
+
+    RayCaster::RayCaster(const meshset_t *meshset, carve::Executor *_executor) : nodes(), tris(), tri_face(), tri_vert(), executor(_executor) {
+      static carve::TimingName FUNC_NAME("RayCaster::RayCaster()");
+      carve::TimingBlock block(FUNC_NAME);
+
+      typedef carve::geom::RTreeNode<3, const Face<3> *> face_rtree_t;
+
+      if (meshset->faceBegin() == meshset->faceEnd()) return;
+
+      std::auto_ptr<face_rtree_t> rtree(face_rtree_t::construct_STR(meshset->faceBegin(), meshset->faceEnd(), 4, 4));
+      flatten(rtree.get());
+    }
+
+
+
+    template<typename node_t>
+    void RayCaster::flatten(const node_t *node) {
+      size_t idx = nodes.size();
+      nodes.push_back(Node());
+      nodes[idx].lo = node->bbox.min();
+      nodes[idx].hi = node->bbox.max();
+      nodes[idx].begin = nodes[idx].end = (uint32_t)tris.size();
+
+      if (node->child) {
+        nodes[idx].is_leaf = false;
+        for (const node_t *c = node->child; c; c = c->sibling) {
+          flatten(c);
+        }
+      } else {
+        nodes[idx].is_leaf = true;
+        for (size_t i = 0; i < node->data.size(); ++i) {
+          addFace(node->data[i]);
+        }
+        nodes[idx].end = (uint32_t)tris.size();
+      }
+      nodes[idx].skip = (uint32_t)nodes.size();
+    }
+
+
+
+    void RayCaster::addFace(const Face<3> *face) {
+      std::vector<Vertex<3> *> verts;
+      face->getVertices(verts);
+      if (verts.size() < 3) return;
+
+      std::vector<carve::triangulate::tri_idx> result;
+      if (verts.size() == 3) {
+        result.push_back(carve::triangulate::tri_idx(0, 1, 2));
+      } else {
+        std::vector<carve::geom2d::P2> projected;
+        projected.reserve(verts.size());
+        for (size_t i = 0; i < verts.size(); ++i) {
+          projected.push_back(face->project(verts[i]->v));
+        }
+        carve::triangulate::triangulate(projected, result);
+      }
+
+      for (size_t i = 0; i < result.size(); ++i) {
+        const Vertex<3> *a = verts[result[i].a];
+        const Vertex<3> *b = verts[result[i].b];
+        const Vertex<3> *c = verts[result[i].c];
+        Triangle tri;
+        tri.v0 = a->v;
+        tri.e1 = b->v - a->v;
+        tri.e2 = c->v - a->v;
+        tris.push_back(tri);
+        tri_face.push_back(face);
+        tri_vert.push_back(a);
+        tri_vert.push_back(b);
+        tri_vert.push_back(c);
+      }
+    }
+
+
+
+    template<typename visitor_t>
+    void RayCaster::trace(const ray_t *rays, size_t n_rays, double *t_max, visitor_t &visit) const {
+      packet_t packet(rays, (unsigned)n_rays);
+      for (unsigned r = (unsigned)n_rays; r < P; ++r) t_max[r] = -1.0;
+
+      const size_t n_nodes = nodes.size();
+      size_t i = 0;
+      while (i < n_nodes) {
+        const Node &node = nodes[i];
+        if (!packet.hitsBox(node.lo, node.hi, t_max)) {
+          i = node.skip;
+          continue;
+        }
+        if (node.is_leaf) {
+          for (uint32_t t = node.begin; t < node.end; ++t) {
+            const Triangle &tri = tris[t];
+            double hit_t[P], hit_u[P], hit_v[P];
+            unsigned ok[P];
+
+            // Moller-Trumbore, evaluated for all rays of the packet.
+            for (unsigned r = 0; r < P; ++r) {
+              double px = packet.d[1][r] * tri.e2.z - packet.d[2][r] * tri.e2.y;
+              double py = packet.d[2][r] * tri.e2.x - packet.d[0][r] * tri.e2.z;
+              double pz = packet.d[0][r] * tri.e2.y - packet.d[1][r] * tri.e2.x;
+              double det = tri.e1.x * px + tri.e1.y * py + tri.e1.z * pz;
+              double inv_det = 1.0 / det;
+              double sx = packet.o[0][r] - tri.v0.x;
+              double sy = packet.o[1][r] - tri.v0.y;
+              double sz = packet.o[2][r] - tri.v0.z;
+              double u = (sx * px + sy * py + sz * pz) * inv_det;
+              double qx = sy * tri.e1.z - sz * tri.e1.y;
+              double qy = sz * tri.e1.x - sx * tri.e1.z;
+              double qz = sx * tri.e1.y - sy * tri.e1.x;
+              double v = (packet.d[0][r] * qx + packet.d[1][r] * qy + packet.d[2][r] * qz) * inv_det;
+              double tt = (tri.e2.x * qx + tri.e2.y * qy + tri.e2.z * qz) * inv_det;
+              hit_t[r] = tt;
+              hit_u[r] = u;
+              hit_v[r] = v;
+              ok[r] = (det != 0.0) &
+                (u >= -BARY_EPSILON) & (v >= -BARY_EPSILON) & (u + v <= 1.0 + BARY_EPSILON) &
+                (tt >= 0.0) & (tt <= t_max[r]);
+            }
+
+            for (unsigned r = 0; r < P; ++r) {
+              if (ok[r]) visit(r, t, hit_t[r], hit_u[r], hit_v[r], t_max);
+            }
+          }
+        }
+        ++i;
+      }
+    }
+
+
+
+    void RayCaster::makeHit(unsigned tri, double t, double u, double v, RayHit &hit) const {
+      hit.face = tri_face[tri];
+      for (unsigned k = 0; k < 3; ++k) hit.vertex[k] = tri_vert[tri * 3 + k];
+      hit.t = t;
+      hit.u = u;
+      hit.v = v;
+    }
+
+
+
+    bool RayCaster::firstHit(const ray_t &ray, RayHit &hit, double t_max) const {
+      double t[P];
+      std::fill(t, t + P, t_max);
+      first_hit_t visit;
+      trace(&ray, 1, t, visit);
+
+      hit = RayHit();
+      if (visit.tri[0] == ~0U) return false;
+      makeHit(visit.tri[0], t[0], visit.u[0], visit.v[0], hit);
+      return true;
+    }
+
+
+
+    class RayCaster::FirstHitsTask : public carve::ParallelTask {
+      const RayCaster &caster;
+      const std::vector<ray_t> &rays;
+      std::vector<RayHit> &hits;
+      double t_max;
+
+    public:
+      FirstHitsTask(const RayCaster &_caster,
+                    const std::vector<ray_t> &_rays,
+                    std::vector<RayHit> &_hits,
+                    double _t_max) : caster(_caster), rays(_rays), hits(_hits), t_max(_t_max) {
+      }
+
+      virtual void run(size_t begin, size_t end) {
+        const size_t n = rays.size();
+        for (size_t p = begin; p < end; ++p) {
+          size_t base = p * P;
+          size_t n_rays = std::min((size_t)P, n - base);
+          double t[P];
+          std::fill(t, t + P, t_max);
+          first_hit_t visit;
+          caster.trace(&rays[base], n_rays, t, visit);
+          for (size_t r = 0; r < n_rays; ++r) {
+            if (visit.tri[r] != ~0U) caster.makeHit(visit.tri[r], t[r], visit.u[r], visit.v[r], hits[base + r]);
+          }
+        }
+      }
+    };
+
+
+
+    // hits are gathered per chunk of RAY_CHUNK rays, and then
+    // concatenated in ray order. offsets[i + 1] receives the number of
+    // hits of ray i.
+    class RayCaster::AllHitsTask : public carve::ParallelTask {
+      const RayCaster &caster;
+      const std::vector<ray_t> &rays;
+      std::vector<size_t> &offsets;
+      std::vector<std::vector<RayHit> > &chunk_hits;
+      double t_max;
+
+    public:
+      AllHitsTask(const RayCaster &_caster,
+                  const std::vector<ray_t> &_rays,
+                  std::vector<size_t> &_offsets,
+                  std::vector<std::vector<RayHit> > &_chunk_hits,
+                  double _t_max) :
+          caster(_caster), rays(_rays), offsets(_offsets), chunk_hits(_chunk_hits), t_max(_t_max) {
+      }
+
+      virtual void run(size_t begin, size_t end) {
+        std::vector<RayHit> &out = chunk_hits[begin / RAY_CHUNK];
+        for (size_t base = begin; base < end; base += P) {
+          size_t n_rays = std::min((size_t)P, end - base);
+          double t[P];
+          std::fill(t, t + P, t_max);
+          all_hits_t visit;
+          caster.trace(&rays[base], n_rays, t, visit);
+
+          for (size_t r = 0; r < n_rays; ++r) {
+            std::vector<all_hits_t::entry_t> &ray_hits = visit.hits[r];
+            std::sort(ray_hits.begin(), ray_hits.end());
+            size_t before = out.size();
+            for (size_t i = 0; i < ray_hits.size(); ++i) {
+              const Face<3> *face = caster.tri_face[ray_hits[i].tri];
+              // a ray through an internal edge of a triangulated face
+              // hits both triangles; report the face once.
+              bool dup = false;
+              for (size_t j = before; !dup && j < out.size(); ++j) dup = out[j].face == face;
+              if (dup) continue;
+              out.push_back(RayHit());
+              caster.makeHit(ray_hits[i].tri, ray_hits[i].t, ray_hits[i].u, ray_hits[i].v, out.back());
+            }
+            offsets[base + r + 1] = out.size() - before;
+          }
+        }
+      }
+    };
+
+
+
+    void RayCaster::firstHits(const std::vector<ray_t> &rays,
+                              std::vector<RayHit> &hits,
+                              double t_max) const {
+      static carve::TimingName FUNC_NAME("RayCaster::firstHits()");
+      carve::TimingBlock block(FUNC_NAME);
+
+      const size_t n = rays.size();
+      hits.clear();
+      hits.resize(n);
+
+      FirstHitsTask task(*this, rays, hits, t_max);
+      carve::parallelFor(getExecutor(), (n + P - 1) / P, PACKET_GRAIN, task);
+    }
+
+
+
+    void RayCaster::allHits(const std::vector<ray_t> &rays,
+                            std::vector<size_t> &offsets,
+                            std::vector<RayHit> &hits,
+                            double t_max) const {
+      static carve::TimingName FUNC_NAME("RayCaster::allHits()");
+      carve::TimingBlock block(FUNC_NAME);
+
+      const size_t n = rays.size();
+      const size_t n_chunks = (n + RAY_CHUNK - 1) / RAY_CHUNK;
+
+      offsets.resize(n + 1);
+      offsets[0] = 0;
+
+      std::vector<std::vector<RayHit> > chunk_hits(n_chunks);
+      AllHitsTask task(*this, rays, offsets, chunk_hits, t_max);
+      carve::parallelFor(getExecutor(), n, RAY_CHUNK, task);
+
+      std::vector<size_t> chunk_base(n_chunks);
+      size_t total = 0;
+      for (size_t c = 0; c < n_chunks; ++c) {
+        chunk_base[c] = total;
+        total += chunk_hits[c].size();
+      }
+      for (size_t i = 0; i < n; ++i) {
+        offsets[i + 1] += offsets[i];
+      }
+
+      hits.resize(total);
+      for (size_t c = 0; c < n_chunks; ++c) {
+        std::copy(chunk_hits[c].begin(), chunk_hits[c].end(), hits.begin() + chunk_base[c]);
+      }
+    }
+
+  }
+}
@@ -0,0 +1,299 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/mesh_triangulate.hpp>
+
+#include <carve/triangulator.hpp>
+#include <carve/timing.hpp>
+#include <carve/executor.hpp>
+
+#include <algorithm>
+
+namespace carve {
+  namespace mesh {
+    namespace {
+
+      typedef MeshSet<3> meshset_t;
+      typedef meshset_t::vertex_t vertex_t;
+      typedef meshset_t::edge_t edge_t;
+      typedef meshset_t::face_t face_t;
+      typedef meshset_t::mesh_t mesh_t;
+
+      // faces are distributed in chunks of this many.
+      const size_t FACE_GRAIN = 64;
+
+      // an internal edge of a triangulation, from polygon vertex
+      // index a to b, which is side slot % 3 of triangle slot / 3.
+      struct diagonal_t {
+        unsigned lo, hi;
+        unsigned slot;
+        bool fwd;
+
+        diagonal_t(unsigned a, unsigned b, unsigned _slot) :
+            lo(std::min(a, b)), hi(std::max(a, b)), slot(_slot), fwd(a < b) {
+        }
+
+        bool operator<(const diagonal_t &other) const {
+          if (lo != other.lo) return lo < other.lo;
+          if (hi != other.hi) return hi < other.hi;
+          return fwd && !other.fwd;
+        }
+      };
+
+      // buffers shared by the faces of a chunk, so that they are
+      // allocated once per chunk rather than once per face.
+      struct scratch_t {
+        std::vector<vertex_t *> verts;
+        std::vector<edge_t *> edges;
+        std::vector<carve::geom2d::P2> proj;
+        std::vector<carve::triangulate::tri_idx> tris;
+        std::vector<diagonal_t> diags;
+        std::vector<char> boundary;
+        std::vector<edge_t *> tri_edges;
+      };
+
+      inline unsigned corner(const carve::triangulate::tri_idx &tri, unsigned k) {
+        return k == 0 ? tri.a : k == 1 ? tri.b : tri.c;
+      }
+
+      inline bool isPositive(const carve::geom3d::Vector &N,
+                             const vertex_t *a, const vertex_t *b, const vertex_t *c) {
+        return carve::geom::dot(carve::geom::cross(b->v - a->v, c->v - a->v), N) > 0.0;
+      }
+
+      // split a quad along the shorter diagonal that gives two
+      // triangles with the orientation of the quad.
+      bool splitQuad(scratch_t &s) {
+        vertex_t **v = &s.verts[0];
+        carve::geom3d::Vector N = carve::geom::VECTOR(0.0, 0.0, 0.0);
+        for (unsigned i = 0; i < 4; ++i) {
+          N += carve::geom::cross(v[i]->v, v[(i + 1) % 4]->v);
+        }
+
+        bool ok02 = isPositive(N, v[0], v[1], v[2]) && isPositive(N, v[0], v[2], v[3]);
+        bool ok13 = isPositive(N, v[1], v[2], v[3]) && isPositive(N, v[1], v[3], v[0]);
+        if (ok02 && ok13 && (v[1]->v - v[3]->v).length2() < (v[0]->v - v[2]->v).length2()) {
+          ok02 = false;
+        }
+
+        s.tris.clear();
+        if (ok02) {
+          s.tris.push_back(carve::triangulate::tri_idx(0, 1, 2));
+          s.tris.push_back(carve::triangulate::tri_idx(0, 2, 3));
+        } else if (ok13) {
+          s.tris.push_back(carve::triangulate::tri_idx(1, 2, 3));
+          s.tris.push_back(carve::triangulate::tri_idx(1, 3, 0));
+        } else {
+          return false;
+        }
+        return true;
+      }
+
+      bool splitPolygon(const face_t *face, bool improve, scratch_t &s) {
+        s.proj.clear();
+        for (size_t i = 0; i < s.verts.size(); ++i) {
+          s.proj.push_back(face->project(s.verts[i]->v));
+        }
+
+        s.tris.clear();
+        try {
+          carve::triangulate::triangulate(s.proj, s.tris);
+          if (improve) {
+            carve::triangulate::improve(face->projector(), s.verts, carve::mesh::vertex_distance(), s.tris);
+          }
+        } catch (carve::exception) {
+          return false;
+        }
+        return true;
+      }
+
+      // check that s.tris is a triangulation of the polygon, and pair
+      // up the two sides of each internal edge in s.diags.
+      bool checkTriangulation(scratch_t &s) {
+        const unsigned n = (unsigned)s.verts.size();
+        if (s.tris.size() != n - 2) return false;
+
+        s.diags.clear();
+        s.boundary.assign(n, 0);
+        for (unsigned t = 0; t < s.tris.size(); ++t) {
+          for (unsigned k = 0; k < 3; ++k) {
+            unsigned a = corner(s.tris[t], k);
+            unsigned b = corner(s.tris[t], (k + 1) % 3);
+            if (a >= n || b >= n || a == b) return false;
+            if (b == (a + 1) % n) {
+              if (s.boundary[a]++) return false;
+            } else {
+              s.diags.push_back(diagonal_t(a, b, t * 3 + k));
+            }
+          }
+        }
+
+        // every boundary edge is used exactly once, and the n - 3
+        // internal edges twice each.
+        for (unsigned a = 0; a < n; ++a) {
+          if (s.boundary[a] != 1) return false;
+        }
+        if (s.diags.size() != 2 * n - 6) return false;
+
+        std::sort(s.diags.begin(), s.diags.end());
+        for (size_t i = 0; i < s.diags.size(); i += 2) {
+          const diagonal_t &d1 = s.diags[i];
+          const diagonal_t &d2 = s.diags[i + 1];
+          if (d1.lo != d2.lo || d1.hi != d2.hi || !d1.fwd || d2.fwd) return false;
+        }
+        return true;
+      }
+
+      // replace face by the triangles of s.tris. The first triangle
+      // reuses face; the others are appended to out.
+      void applySplit(face_t *face, scratch_t &s, std::vector<face_t *> &out) {
+        const unsigned n = (unsigned)s.verts.size();
+
+        s.tri_edges.resize(s.tris.size() * 3);
+        for (unsigned t = 0; t < s.tris.size(); ++t) {
+          for (unsigned k = 0; k < 3; ++k) {
+            unsigned a = corner(s.tris[t], k);
+            unsigned b = corner(s.tris[t], (k + 1) % 3);
+            s.tri_edges[t * 3 + k] = (b == (a + 1) % n) ? s.edges[a] : new edge_t(s.verts[a], NULL);
+          }
+        }
+
+        for (size_t i = 0; i < s.diags.size(); i += 2) {
+          edge_t *e1 = s.tri_edges[s.diags[i].slot];
+          edge_t *e2 = s.tri_edges[s.diags[i + 1].slot];
+          e1->rev = e2;
+          e2->rev = e1;
+        }
+
+        for (unsigned t = 0; t < s.tris.size(); ++t) {
+          edge_t **e = &s.tri_edges[t * 3];
+          e[0]->next = e[1]; e[1]->next = e[2]; e[2]->next = e[0];
+          e[0]->prev = e[2]; e[1]->prev = e[0]; e[2]->prev = e[1];
+        }
+
+        face->edge = s.tri_edges[0];
+        face->n_edges = 3;
+        for (unsigned k = 0; k < 3; ++k) s.tri_edges[k]->face = face;
+        face->recalc();
+
+        for (unsigned t = 1; t < s.tris.size(); ++t) {
+          face_t *tri = new face_t(s.tri_edges[t * 3]);
+          tri->id = face->id;
+          tri->mesh = face->mesh;
+          out.push_back(tri);
+        }
+      }
+
+      class TriangulateTask : public carve::ParallelTask {
+        const std::vector<face_t *> &faces;
+        bool improve;
+        std::vector<unsigned> &n_added;
+        std::vector<std::vector<face_t *> > &chunk_faces;
+
+      public:
+        TriangulateTask(const std::vector<face_t *> &_faces,
+                        bool _improve,
+                        std::vector<unsigned> &_n_added,
+                        std::vector<std::vector<face_t *> > &_chunk_faces) :
+            faces(_faces), improve(_improve), n_added(_n_added), chunk_faces(_chunk_faces) {
+        }
+
+        virtual void run(size_t begin, size_t end) {
+          scratch_t s;
+          std::vector<face_t *> &out = chunk_faces[begin / FACE_GRAIN];
+
+          for (size_t i = begin; i < end; ++i) {
+            face_t *face = faces[i];
+            if (face->n_edges <= 3) continue;
+
+            s.verts.clear();
+            s.edges.clear();
+            edge_t *e = face->edge;
+            do {
+              s.verts.push_back(e->vert);
+              s.edges.push_back(e);
+              e = e->next;
+            } while (e != face->edge);
+
+            bool ok = s.verts.size() == 4 && splitQuad(s);
+            if (!ok) ok = splitPolygon(face, improve, s);
+            if (!ok || !checkTriangulation(s)) continue;
+
+            size_t before = out.size();
+            applySplit(face, s, out);
+            n_added[i] = (unsigned)(out.size() - before);
+          }
+        }
+      };
+
+    }
+
+
+
+    size_t triangulateFaces(MeshSet<3> *meshset, bool improve, carve::Executor *executor) {
+      static carve::TimingName FUNC_NAME("triangulateFaces()");
+      carve::TimingBlock block(FUNC_NAME);
+
+      std::vector<face_t *> faces;
+      for (meshset_t::face_iter i = meshset->faceBegin(); i != meshset->faceEnd(); ++i) {
+        faces.push_back(*i);
+      }
+
+      std::vector<unsigned> n_added(faces.size(), 0);
+      std::vector<std::vector<face_t *> > chunk_faces((faces.size() + FACE_GRAIN - 1) / FACE_GRAIN);
+
+      TriangulateTask task(faces, improve, n_added, chunk_faces);
+      carve::parallelFor(executor != NULL ? *executor : carve::defaultExecutor(), faces.size(), FACE_GRAIN, task);
+
+      // insert the new triangles after the faces they were split
+      // from. Faces were enumerated mesh by mesh, so the chunks are
+      // consumed in order.
+      size_t n_split = 0;
+      size_t f = 0, pos = 0;
+      std::vector<face_t *> mesh_faces;
+      for (size_t m = 0; m < meshset->meshes.size(); ++m) {
+        mesh_t *mesh = meshset->meshes[m];
+        size_t mesh_split = 0;
+
+        mesh_faces.clear();
+        for (size_t i = 0; i < mesh->faces.size(); ++i, ++f) {
+          if (f % FACE_GRAIN == 0) pos = 0;
+          mesh_faces.push_back(mesh->faces[i]);
+          if (!n_added[f]) continue;
+
+          const std::vector<face_t *> &src = chunk_faces[f / FACE_GRAIN];
+          mesh_faces.insert(mesh_faces.end(), src.begin() + pos, src.begin() + pos + n_added[f]);
+          pos += n_added[f];
+          ++mesh_split;
+        }
+
+        if (mesh_split) {
+          mesh->faces.swap(mesh_faces);
+          mesh->cacheEdges();
+          n_split += mesh_split;
+        }
+      }
+
+      return n_split;
+    }
+
+  }
+}
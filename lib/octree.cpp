@@ -67,6 +67,10 @@ namespace carve {
       return aabb.containsPoint(p.v);
     }
 
+    unsigned Octree::Node::childrenIntersecting(const carve::geom::aabb<3> &box) const {
+      return child_aabbs.blockMask(0, box) | (child_aabbs.blockMask(1, box) << 4);
+    }
+
     bool Octree::Node::hasChildren() {
       return !is_leaf;
     }
@@ -85,7 +89,9 @@ namespace carve {
         children[6] = new (ptr + sizeof(Node) * 6) Node(this, min.x, mid.y, mid.z, mid.x, max.y, max.z);
         children[7] = new (ptr + sizeof(Node) * 7) Node(this, mid.x, mid.y, mid.z, max.x, max.y, max.z);
 
+        child_aabbs.reserve(8);
         for (int i = 0; i < 8; ++i) {
+          child_aabbs.push_back(children[i]->aabb);
           putInside(faces, children[i], children[i]->faces);
           putInside(edges, children[i], children[i]->edges);
           putInside(vertices, children[i], children[i]->vertices);
@@ -164,23 +170,32 @@ namespace carve {
       }
 
       if (node->aabb.intersects(aabb)) {
-        if (node->hasChildren()) {
-          for (int i = 0; i < 8; ++i) {
-            doFindEdges(aabb, node->children[i], out, depth + 1);
-          }
-        } else {
-          if (depth < MAX_SPLIT_DEPTH && node->edges.size() > EDGE_SPLIT_THRESHOLD) {
-            if (!node->split()) {
-              for (int i = 0; i < 8; ++i) {
-                doFindEdges(aabb, node->children[i], out, depth + 1);
-              }
-              return;
+        doFindEdgesInside(aabb, node, out, depth);
+      }
+    }
+
+    void Octree::doFindEdgesInside(const carve::geom::aabb<3> &aabb,
+                                   Node *node,
+                                   std::vector<const carve::poly::Edge<3> *> &out,
+                                   unsigned depth) const {
+      if (node->hasChildren()) {
+        const unsigned mask = node->childrenIntersecting(aabb);
+        for (int i = 0; i < 8; ++i) {
+          if (mask & (1U << i)) doFindEdgesInside(aabb, node->children[i], out, depth + 1);
+        }
+      } else {
+        if (depth < MAX_SPLIT_DEPTH && node->edges.size() > EDGE_SPLIT_THRESHOLD) {
+          if (!node->split()) {
+            const unsigned mask = node->childrenIntersecting(aabb);
+            for (int i = 0; i < 8; ++i) {
+              if (mask & (1U << i)) doFindEdgesInside(aabb, node->children[i], out, depth + 1);
             }
+            return;
           }
-          for (std::vector<const carve::poly::Edge<3>*>::const_iterator it = node->edges.begin(), e = node->edges.end(); it != e; ++it) {
-            if ((*it)->tag_once()) {
-              out.push_back(*it);
-            }
+        }
+        for (std::vector<const carve::poly::Edge<3> *>::const_iterator it = node->edges.begin(), e = node->edges.end(); it != e; ++it) {
+          if ((*it)->tag_once()) {
+            out.push_back(*it);
           }
         }
       }
@@ -258,23 +273,32 @@ namespace carve {
       }
 
       if (node->aabb.intersects(aabb)) {
-        if (node->hasChildren()) {
-          for (int i = 0; i < 8; ++i) {
-            doFindFaces(aabb, node->children[i], out, depth + 1);
-          }
-        } else {
-          if (depth < MAX_SPLIT_DEPTH && node->faces.size() > FACE_SPLIT_THRESHOLD) {
-            if (!node->split()) {
-              for (int i = 0; i < 8; ++i) {
-                doFindFaces(aabb, node->children[i], out, depth + 1);
-              }
-              return;
+        doFindFacesInside(aabb, node, out, depth);
+      }
+    }
+
+    void Octree::doFindFacesInside(const carve::geom::aabb<3> &aabb,
+                                   Node *node,
+                                   std::vector<const carve::poly::Face<3> *> &out,
+                                   unsigned depth) const {
+      if (node->hasChildren()) {
+        const unsigned mask = node->childrenIntersecting(aabb);
+        for (int i = 0; i < 8; ++i) {
+          if (mask & (1U << i)) doFindFacesInside(aabb, node->children[i], out, depth + 1);
+        }
+      } else {
+        if (depth < MAX_SPLIT_DEPTH && node->faces.size() > FACE_SPLIT_THRESHOLD) {
+          if (!node->split()) {
+            const unsigned mask = node->childrenIntersecting(aabb);
+            for (int i = 0; i < 8; ++i) {
+              if (mask & (1U << i)) doFindFacesInside(aabb, node->children[i], out, depth + 1);
             }
+            return;
           }
-          for (std::vector<const carve::poly::Face<3>*>::const_iterator it = node->faces.begin(), e = node->faces.end(); it != e; ++it) {
-            if ((*it)->tag_once()) {
-              out.push_back(*it);
-            }
+        }
+        for (std::vector<const carve::poly::Face<3> *>::const_iterator it = node->faces.begin(), e = node->faces.end(); it != e; ++it) {
+          if ((*it)->tag_once()) {
+            out.push_back(*it);
           }
         }
       }
@@ -317,22 +341,31 @@ namespace carve {
       }
 
       if (node->aabb.containsPoint(v)) {
-        if (node->hasChildren()) {
-          for (int i = 0; i < 8; ++i) {
-            doFindVerticesAllowDupes(v, node->children[i], out, depth + 1);
-          }
-        } else {
-          if (depth < MAX_SPLIT_DEPTH && node->vertices.size() > POINT_SPLIT_THRESHOLD) {
-            if (!node->split()) {
-              for (int i = 0; i < 8; ++i) {
-                doFindVerticesAllowDupes(v, node->children[i], out, depth + 1);
-              }
-              return;
+        doFindVerticesInside(carve::geom3d::AABB(v, carve::geom::VECTOR(0.0, 0.0, 0.0)), node, out, depth);
+      }
+    }
+
+    void Octree::doFindVerticesInside(const carve::geom::aabb<3> &aabb,
+                                      Node *node,
+                                      std::vector<const carve::poly::Vertex<3> *> &out,
+                                      unsigned depth) const {
+      if (node->hasChildren()) {
+        const unsigned mask = node->childrenIntersecting(aabb);
+        for (int i = 0; i < 8; ++i) {
+          if (mask & (1U << i)) doFindVerticesInside(aabb, node->children[i], out, depth + 1);
+        }
+      } else {
+        if (depth < MAX_SPLIT_DEPTH && node->vertices.size() > POINT_SPLIT_THRESHOLD) {
+          if (!node->split()) {
+            const unsigned mask = node->childrenIntersecting(aabb);
+            for (int i = 0; i < 8; ++i) {
+              if (mask & (1U << i)) doFindVerticesInside(aabb, node->children[i], out, depth + 1);
             }
+            return;
           }
-          for (std::vector<const carve::poly::Vertex<3> *>::const_iterator it = node->vertices.begin(), e = node->vertices.end(); it != e; ++it) {
-            out.push_back(*it);
-          }
+        }
+        for (std::vector<const carve::poly::Vertex<3> *>::const_iterator it = node->vertices.begin(), e = node->vertices.end(); it != e; ++it) {
+          out.push_back(*it);
         }
       }
     }
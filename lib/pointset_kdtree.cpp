@@ -0,0 +1,441 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/pointset_kdtree.hpp>
+
+#include <carve/timing.hpp>
+#include <carve/executor.hpp>
+
+#include <algorithm>
+
+namespace carve {
+  namespace point {
+    namespace {
+
+      // the number of tree levels built serially before the
+      // remaining subtrees are built in parallel.
+      const unsigned TOP_LEVELS = 6;
+
+      // queries are processed in chunks of this many; chunking
+      // depends only on the number of queries.
+      const size_t QUERY_CHUNK = 256;
+
+      // points are copied into leaf order in chunks of this many.
+      const size_t GATHER_GRAIN = 4096;
+
+      // deep enough for any tree addressable with 32 bit indices.
+      const int MAX_STACK = 64;
+
+      struct axis_cmp {
+        const std::vector<carve::geom3d::Vector> &input;
+        int axis;
+
+        axis_cmp(const std::vector<carve::geom3d::Vector> &_input, int _axis) : input(_input), axis(_axis) {
+        }
+
+        bool operator()(uint32_t a, uint32_t b) const {
+          return input[a].v[axis] < input[b].v[axis];
+        }
+      };
+
+      struct stack_entry_t {
+        uint32_t node;
+        double d2;
+      };
+
+      struct build_task_t {
+        size_t node;
+        uint32_t begin, end;
+
+        build_task_t(size_t _node, uint32_t _begin, uint32_t _end) : node(_node), begin(_begin), end(_end) {
+        }
+      };
+
+      std::vector<carve::geom3d::Vector> pointSetVectors(const PointSet &pointset) {
+        std::vector<carve::geom3d::Vector> result(pointset.vertices.size());
+        for (size_t i = 0; i < pointset.vertices.size(); ++i) {
+          result[i] = pointset.vertices[i].v;
+        }
+        return result;
+      }
+
+    }
+
+
+
+    class KdTree::BuildTask : public carve::ParallelTask {
+      KdTree &tree;
+      const std::vector<build_task_t> &tasks;
+      const std::vector<carve::geom3d::Vector> &input;
+
+    public:
+      BuildTask(KdTree &_tree,
+                const std::vector<build_task_t> &_tasks,
+                const std::vector<carve::geom3d::Vector> &_input) : tree(_tree), tasks(_tasks), input(_input) {
+      }
+
+      virtual void run(size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          tree.buildNode(tasks[i].node, tasks[i].begin, tasks[i].end, input);
+        }
+      }
+    };
+
+
+
+    class KdTree::GatherTask : public carve::ParallelTask {
+      KdTree &tree;
+      const std::vector<carve::geom3d::Vector> &input;
+
+    public:
+      GatherTask(KdTree &_tree, const std::vector<carve::geom3d::Vector> &_input) : tree(_tree), input(_input) {
+      }
+
+      virtual void run(size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          tree.points[i] = input[tree.index[i]];
+        }
+      }
+    };
+
+
+
+    class KdTree::NearestTask : public carve::ParallelTask {
+      const KdTree &tree;
+      const std::vector<carve::geom3d::Vector> &queries;
+      size_t stride;
+      std::vector<size_t> &out_idx;
+      std::vector<double> *out_dist2;
+
+    public:
+      NearestTask(const KdTree &_tree,
+                  const std::vector<carve::geom3d::Vector> &_queries,
+                  size_t _stride,
+                  std::vector<size_t> &_out_idx,
+                  std::vector<double> *_out_dist2) :
+          tree(_tree), queries(_queries), stride(_stride), out_idx(_out_idx), out_dist2(_out_dist2) {
+      }
+
+      virtual void run(size_t begin, size_t end) {
+        heap_t heap;
+        heap.reserve(stride);
+        for (size_t q = begin; q < end; ++q) {
+          tree.search(queries[q], stride, heap);
+          for (size_t i = 0; i < stride; ++i) {
+            out_idx[q * stride + i] = heap[i].second;
+            if (out_dist2) (*out_dist2)[q * stride + i] = heap[i].first;
+          }
+        }
+      }
+    };
+
+
+
+    // gathers the results of each chunk of queries separately.
+    // out_offsets[q + 1] receives the number of results of query q.
+    class KdTree::RadiusTask : public carve::ParallelTask {
+      const KdTree &tree;
+      const std::vector<carve::geom3d::Vector> &queries;
+      double r2;
+      std::vector<size_t> &out_offsets;
+      std::vector<std::vector<size_t> > &chunk_idx;
+
+    public:
+      RadiusTask(const KdTree &_tree,
+                 const std::vector<carve::geom3d::Vector> &_queries,
+                 double _r2,
+                 std::vector<size_t> &_out_offsets,
+                 std::vector<std::vector<size_t> > &_chunk_idx) :
+          tree(_tree), queries(_queries), r2(_r2), out_offsets(_out_offsets), chunk_idx(_chunk_idx) {
+      }
+
+      virtual void run(size_t begin, size_t end) {
+        std::vector<size_t> &result = chunk_idx[begin / QUERY_CHUNK];
+        for (size_t q = begin; q < end; ++q) {
+          size_t before = result.size();
+          tree.search(queries[q], r2, result);
+          out_offsets[q + 1] = result.size() - before;
+        }
+      }
+    };
+
+
+
+    KdTree::KdTree(const PointSet &pointset, carve::Executor *_executor) : nodes(), points(), index(), executor(_executor) {
+      build(pointSetVectors(pointset));
+    }
+
+
+
+    KdTree::KdTree(const std::vector<carve::geom3d::Vector> &input, carve::Executor *_executor) : nodes(), points(), index(), executor(_executor) {
+      build(input);
+    }
+
+
+
+    size_t KdTree::nodeCount(size_t n) {
+      if (n <= LEAF_SIZE) return 1;
+      return 1 + nodeCount(n / 2) + nodeCount(n - n / 2);
+    }
+
+
+
+    void KdTree::build(const std::vector<carve::geom3d::Vector> &input) {
+      static carve::TimingName FUNC_NAME("KdTree::build()");
+      carve::TimingBlock block(FUNC_NAME);
+
+      const size_t n = input.size();
+      if (n >= 0xffffffffU) {
+        throw carve::exception("KdTree: too many points");
+      }
+
+      nodes.clear();
+      points.clear();
+      index.resize(n);
+      for (size_t i = 0; i < n; ++i) index[i] = (uint32_t)i;
+      if (!n) return;
+
+      // subtree sizes depend only on the number of points they
+      // contain, so the position of every node is known in advance,
+      // and independent subtrees can be built concurrently.
+      nodes.resize(nodeCount(n));
+
+      std::vector<build_task_t> tasks, next;
+      tasks.push_back(build_task_t(0, 0, (uint32_t)n));
+      for (unsigned level = 0; level < TOP_LEVELS; ++level) {
+        next.clear();
+        for (size_t i = 0; i < tasks.size(); ++i) {
+          const build_task_t &t = tasks[i];
+          uint32_t mid = splitNode(t.node, t.begin, t.end, input);
+          if (mid == t.end) continue;
+          next.push_back(build_task_t(t.node + 1, t.begin, mid));
+          next.push_back(build_task_t(nodes[t.node].right, mid, t.end));
+        }
+        tasks.swap(next);
+      }
+
+      BuildTask build_task(*this, tasks, input);
+      getExecutor().parallelFor(tasks.size(), 1, build_task);
+
+      points.resize(n);
+      GatherTask gather_task(*this, input);
+      carve::parallelFor(getExecutor(), n, GATHER_GRAIN, gather_task);
+    }
+
+
+
+    uint32_t KdTree::splitNode(size_t node, uint32_t begin, uint32_t end, const std::vector<carve::geom3d::Vector> &input) {
+      Node &nd = nodes[node];
+      nd.begin = begin;
+      nd.end = end;
+
+      if (end - begin <= LEAF_SIZE) {
+        nd.axis = -1;
+        nd.split = 0.0;
+        nd.right = 0;
+        return end;
+      }
+
+      carve::geom3d::Vector lo = input[index[begin]], hi = lo;
+      for (uint32_t i = begin + 1; i < end; ++i) {
+        assign_op(lo, lo, input[index[i]], carve::util::min_functor());
+        assign_op(hi, hi, input[index[i]], carve::util::max_functor());
+      }
+      carve::geom3d::Vector extent = hi - lo;
+      int axis = 0;
+      if (extent.y > extent.v[axis]) axis = 1;
+      if (extent.z > extent.v[axis]) axis = 2;
+
+      uint32_t mid = begin + (end - begin) / 2;
+      std::nth_element(index.begin() + begin, index.begin() + mid, index.begin() + end, axis_cmp(input, axis));
+
+      nd.axis = axis;
+      nd.split = input[index[mid]].v[axis];
+      nd.right = (uint32_t)(node + 1 + nodeCount(mid - begin));
+      return mid;
+    }
+
+
+
+    void KdTree::buildNode(size_t node, uint32_t begin, uint32_t end, const std::vector<carve::geom3d::Vector> &input) {
+      uint32_t mid = splitNode(node, begin, end, input);
+      if (mid == end) return;
+      buildNode(node + 1, begin, mid, input);
+      buildNode(nodes[node].right, mid, end, input);
+    }
+
+
+
+    void KdTree::search(const carve::geom3d::Vector &p, size_t k, heap_t &heap) const {
+      heap.clear();
+      if (!k || nodes.empty()) return;
+
+      stack_entry_t stack[MAX_STACK];
+      int sp = 0;
+      stack[sp].node = 0;
+      stack[sp].d2 = 0.0;
+      ++sp;
+
+      while (sp) {
+        --sp;
+        // subtrees strictly further away than the current kth
+        // neighbour cannot improve the result.
+        if (heap.size() == k && stack[sp].d2 > heap.front().first) continue;
+
+        uint32_t n = stack[sp].node;
+        for (;;) {
+          const Node &node = nodes[n];
+          if (node.isLeaf()) {
+            for (uint32_t i = node.begin; i < node.end; ++i) {
+              std::pair<double, uint32_t> c((points[i] - p).length2(), index[i]);
+              if (heap.size() < k) {
+                heap.push_back(c);
+                std::push_heap(heap.begin(), heap.end());
+              } else if (c < heap.front()) {
+                std::pop_heap(heap.begin(), heap.end());
+                heap.back() = c;
+                std::push_heap(heap.begin(), heap.end());
+              }
+            }
+            break;
+          }
+          double delta = p.v[node.axis] - node.split;
+          stack[sp].node = delta < 0.0 ? node.right : n + 1;
+          stack[sp].d2 = delta * delta;
+          ++sp;
+          n = delta < 0.0 ? n + 1 : node.right;
+        }
+      }
+
+      std::sort_heap(heap.begin(), heap.end());
+    }
+
+
+
+    void KdTree::search(const carve::geom3d::Vector &p, double r2, std::vector<size_t> &out_idx) const {
+      if (nodes.empty()) return;
+
+      uint32_t stack[MAX_STACK];
+      int sp = 0;
+      stack[sp++] = 0;
+
+      while (sp) {
+        const Node &node = nodes[stack[--sp]];
+        if (node.isLeaf()) {
+          for (uint32_t i = node.begin; i < node.end; ++i) {
+            if ((points[i] - p).length2() <= r2) out_idx.push_back(index[i]);
+          }
+          continue;
+        }
+        double delta = p.v[node.axis] - node.split;
+        uint32_t n = (uint32_t)(&node - &nodes[0]);
+        if (delta <= 0.0 || delta * delta <= r2) stack[sp++] = n + 1;
+        if (delta >= 0.0 || delta * delta <= r2) stack[sp++] = node.right;
+      }
+    }
+
+
+
+    void KdTree::nearest(const carve::geom3d::Vector &p,
+                         size_t k,
+                         std::vector<size_t> &out_idx,
+                         std::vector<double> *out_dist2) const {
+      heap_t heap;
+      search(p, k, heap);
+      out_idx.resize(heap.size());
+      if (out_dist2) out_dist2->resize(heap.size());
+      for (size_t i = 0; i < heap.size(); ++i) {
+        out_idx[i] = heap[i].second;
+        if (out_dist2) (*out_dist2)[i] = heap[i].first;
+      }
+    }
+
+
+
+    void KdTree::withinRadius(const carve::geom3d::Vector &p,
+                              double r,
+                              std::vector<size_t> &out_idx) const {
+      out_idx.clear();
+      search(p, r * r, out_idx);
+    }
+
+
+
+    size_t KdTree::nearest(const std::vector<carve::geom3d::Vector> &queries,
+                           size_t k,
+                           std::vector<size_t> &out_idx,
+                           std::vector<double> *out_dist2) const {
+      static carve::TimingName FUNC_NAME("KdTree::nearest() batch");
+      carve::TimingBlock block(FUNC_NAME);
+
+      const size_t stride = std::min(k, size());
+      const size_t n = queries.size();
+      out_idx.resize(n * stride);
+      if (out_dist2) out_dist2->resize(n * stride);
+      if (!stride) return 0;
+
+      NearestTask task(*this, queries, stride, out_idx, out_dist2);
+      carve::parallelFor(getExecutor(), n, QUERY_CHUNK, task);
+
+      return stride;
+    }
+
+
+
+    void KdTree::withinRadius(const std::vector<carve::geom3d::Vector> &queries,
+                              double r,
+                              std::vector<size_t> &out_offsets,
+                              std::vector<size_t> &out_idx) const {
+      static carve::TimingName FUNC_NAME("KdTree::withinRadius() batch");
+      carve::TimingBlock block(FUNC_NAME);
+
+      const size_t n = queries.size();
+      const double r2 = r * r;
+      const int n_chunks = (int)((n + QUERY_CHUNK - 1) / QUERY_CHUNK);
+
+      out_offsets.resize(n + 1);
+      out_offsets[0] = 0;
+
+      // results are gathered per chunk and then concatenated in query
+      // order.
+      std::vector<std::vector<size_t> > chunk_idx(n_chunks);
+
+      RadiusTask task(*this, queries, r2, out_offsets, chunk_idx);
+      carve::parallelFor(getExecutor(), n, QUERY_CHUNK, task);
+
+      std::vector<size_t> chunk_base(n_chunks);
+      size_t total = 0;
+      for (int c = 0; c < n_chunks; ++c) {
+        chunk_base[c] = total;
+        total += chunk_idx[c].size();
+      }
+      for (size_t q = 0; q < n; ++q) {
+        out_offsets[q + 1] += out_offsets[q];
+      }
+
+      out_idx.resize(total);
+      for (int c = 0; c < n_chunks; ++c) {
+        std::copy(chunk_idx[c].begin(), chunk_idx[c].end(), out_idx.begin() + chunk_base[c]);
+      }
+    }
+
+  }
+}
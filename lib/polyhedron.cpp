@@ -28,7 +28,7 @@
 #include <carve/geom.hpp>
 #include <carve/poly.hpp>
 
-#include <carve/octree_impl.hpp>
+#include <carve/linear_octree.hpp>
 
 #include <carve/timing.hpp>
 
@@ -93,10 +93,10 @@ namespace carve {
       static carve::TimingName FUNC_NAME("Polyhedron::initSpatialIndex()");
       carve::TimingBlock block(FUNC_NAME);
 
-      octree.setBounds(aabb);
+      octree.clear();
       octree.addFaces(faces);
       octree.addEdges(edges);
-      octree.splitTree();
+      octree.build();
 
       return true;
     }
@@ -0,0 +1,307 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/polyline_clip.hpp>
+
+#include <carve/timing.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+
+namespace carve {
+  namespace mesh {
+    namespace {
+
+      // polylines are distributed in chunks of this many.
+      const size_t LINE_GRAIN = 16;
+
+      // a point at which a polyline meets the surface, and the class
+      // of the polyline immediately after it, if that is known.
+      struct crossing_t {
+        double t;
+        carve::PointClass cls;
+
+        crossing_t(double _t, carve::PointClass _cls) : t(_t), cls(_cls) {
+        }
+
+        bool operator<(const crossing_t &other) const { return t < other.t; }
+      };
+
+      carve::PointClass combine(carve::PointClass a, carve::PointClass b) {
+        return a == b ? a : carve::POINT_UNK;
+      }
+
+    }
+
+
+
+    class PolylineClipper::ClipTask : public carve::ParallelTask {
+      const PolylineClipper &clipper;
+      const std::vector<const carve::line::Polyline *> &lines;
+      std::vector<std::vector<Piece> > &pieces;
+
+    public:
+      ClipTask(const PolylineClipper &_clipper,
+               const std::vector<const carve::line::Polyline *> &_lines,
+               std::vector<std::vector<Piece> > &_pieces) :
+          clipper(_clipper), lines(_lines), pieces(_pieces) {
+      }
+
+      virtual void run(size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          clipper.clipLine(i, lines[i], pieces[i]);
+        }
+      }
+    };
+
+
+
+    PolylineClipper::PolylineClipper(const meshset_t *_meshset) : meshset(_meshset), face_rtree(NULL), executor(NULL) {
+      static carve::TimingName FUNC_NAME("PolylineClipper::PolylineClipper()");
+      carve::TimingBlock block(FUNC_NAME);
+
+      if (meshset->faceBegin() == meshset->faceEnd()) return;
+
+      // classifyPoint() wants a tree of non-const faces; the tree is
+      // only ever read.
+      meshset_t *m = const_cast<meshset_t *>(meshset);
+      face_rtree = face_rtree_t::construct_STR(m->faceBegin(), m->faceEnd(), 4, 4);
+    }
+
+
+
+    PolylineClipper::~PolylineClipper() {
+      delete face_rtree;
+    }
+
+
+
+    carve::geom3d::Vector PolylineClipper::point(const carve::line::Polyline *line, double t) {
+      size_t n = line->edgeCount();
+      double e = floor(t);
+      double f = t - e;
+      size_t i = (size_t)e;
+      if (!line->closed && i >= n) {
+        i = n - 1;
+        f = 1.0;
+      }
+      const carve::line::PolylineEdge *edge = line->edge(i);
+      if (f == 0.0) return edge->v1->v;
+      if (f == 1.0) return edge->v2->v;
+      return edge->v1->v + (edge->v2->v - edge->v1->v) * f;
+    }
+
+
+
+    carve::PointClass PolylineClipper::classify(const carve::geom3d::Vector &v) const {
+      if (face_rtree == NULL) return carve::POINT_OUT;
+      return carve::mesh::classifyPoint(meshset, face_rtree, v);
+    }
+
+
+
+    void PolylineClipper::clipLine(size_t index, const carve::line::Polyline *line, std::vector<Piece> &pieces) const {
+      const size_t n = line->edgeCount();
+      if (n == 0) return;
+      const double end_t = (double)n;
+
+      std::vector<crossing_t> crossings;
+
+      if (face_rtree != NULL) {
+        std::vector<Face<3> *> near_faces;
+        for (size_t e = 0; e < n; ++e) {
+          const carve::geom3d::Vector &v1 = line->edge(e)->v1->v;
+          const carve::geom3d::Vector &v2 = line->edge(e)->v2->v;
+          carve::geom::linesegment<3> seg(v1, v2);
+          if (!seg.OK()) continue;
+
+          near_faces.clear();
+          face_rtree->search(seg, std::back_inserter(near_faces));
+
+          carve::geom3d::Vector d = v2 - v1;
+          double len = d.length();
+          for (size_t i = 0; i < near_faces.size(); ++i) {
+            carve::geom3d::Vector p;
+            IntersectionClass ic = near_faces[i]->lineSegmentIntersection(seg, p);
+            if (ic == INTERSECT_NONE || ic == INTERSECT_BAD) continue;
+
+            double t;
+            if (carve::geom::distance(p, v1) <= EPSILON) {
+              t = 0.0;
+            } else if (carve::geom::distance(p, v2) <= EPSILON) {
+              t = 1.0;
+            } else {
+              t = std::min(1.0, std::max(0.0, dot(p - v1, d) / (len * len)));
+            }
+
+            // a clean crossing of the interior of a face determines
+            // the class of what follows; anything else is settled by
+            // classifying a point.
+            double dp = dot(near_faces[i]->plane.N, d) / len;
+            carve::PointClass cls = carve::POINT_UNK;
+            if (ic == INTERSECT_FACE && fabs(dp) >= EPSILON) {
+              cls = dp < 0.0 ? carve::POINT_IN : carve::POINT_OUT;
+            }
+            double s = e + t;
+            if (line->closed && s >= end_t) s = 0.0;
+            crossings.push_back(crossing_t(s, cls));
+          }
+        }
+      }
+
+      std::sort(crossings.begin(), crossings.end());
+
+      // merge crossings at the same point: where the polyline passes
+      // through a polyline vertex, or a shared edge or vertex of the
+      // surface.
+      std::vector<crossing_t> clusters;
+      carve::geom3d::Vector cluster_pt;
+      for (size_t i = 0; i < crossings.size(); ++i) {
+        carve::geom3d::Vector p = point(line, crossings[i].t);
+        if (clusters.size() && carve::geom::distance(p, cluster_pt) <= EPSILON) {
+          clusters.back().cls = combine(clusters.back().cls, crossings[i].cls);
+        } else {
+          clusters.push_back(crossings[i]);
+          cluster_pt = p;
+        }
+      }
+      if (line->closed && clusters.size() > 1 &&
+          carve::geom::distance(point(line, clusters.back().t), point(line, clusters.front().t)) <= EPSILON) {
+        clusters.front().cls = combine(clusters.front().cls, clusters.back().cls);
+        clusters.pop_back();
+      }
+
+      // the boundaries of the pieces, each with the class of the piece
+      // that starts there if it is known.
+      std::vector<crossing_t> bounds;
+      if (line->closed) {
+        if (clusters.empty()) {
+          pieces.push_back(Piece(index, 0.0, end_t, classify(point(line, 0.5)), true));
+          return;
+        }
+        bounds = clusters;
+        bounds.push_back(crossing_t(clusters.front().t + end_t, carve::POINT_UNK));
+      } else {
+        bounds.push_back(crossing_t(0.0, carve::POINT_UNK));
+        for (size_t i = 0; i < clusters.size(); ++i) {
+          if (clusters[i].t <= 0.0) {
+            bounds[0].cls = clusters[i].cls;
+          } else if (clusters[i].t < end_t) {
+            bounds.push_back(clusters[i]);
+          }
+        }
+        bounds.push_back(crossing_t(end_t, carve::POINT_UNK));
+      }
+
+      size_t first = pieces.size();
+      for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+        double b = bounds[i].t, e = bounds[i + 1].t;
+        carve::PointClass cls = bounds[i].cls;
+        if (cls == carve::POINT_UNK) cls = classify(point(line, (b + e) / 2.0));
+        if (pieces.size() > first && pieces.back().cls == cls) {
+          pieces.back().end = e;
+        } else {
+          pieces.push_back(Piece(index, b, e, cls));
+        }
+      }
+
+      if (line->closed && pieces.size() - first > 1 && pieces.back().cls == pieces[first].cls) {
+        pieces.back().end = pieces[first].end + end_t;
+        pieces.erase(pieces.begin() + first);
+      }
+      if (line->closed && pieces.size() - first == 1) {
+        pieces.back() = Piece(index, 0.0, end_t, pieces.back().cls, true);
+      }
+    }
+
+
+
+    void PolylineClipper::classify(const carve::line::PolylineSet &lines, std::vector<Piece> &pieces) const {
+      static carve::TimingName FUNC_NAME("PolylineClipper::classify()");
+      carve::TimingBlock block(FUNC_NAME);
+
+      std::vector<const carve::line::Polyline *> line_vec(lines.lines.begin(), lines.lines.end());
+      std::vector<std::vector<Piece> > line_pieces(line_vec.size());
+
+      ClipTask task(*this, line_vec, line_pieces);
+      carve::parallelFor(executor != NULL ? *executor : carve::defaultExecutor(), line_vec.size(), LINE_GRAIN, task);
+
+      for (size_t i = 0; i < line_pieces.size(); ++i) {
+        pieces.insert(pieces.end(), line_pieces[i].begin(), line_pieces[i].end());
+      }
+    }
+
+
+
+    void PolylineClipper::clip(const carve::line::PolylineSet &lines,
+                               carve::line::PolylineSet **inside,
+                               carve::line::PolylineSet **outside) const {
+      std::vector<Piece> pieces;
+      classify(lines, pieces);
+
+      std::vector<const carve::line::Polyline *> line_vec(lines.lines.begin(), lines.lines.end());
+
+      // points and polylines (as a closed flag and a point count) of
+      // the inside [0] and outside [1] results.
+      std::vector<carve::geom3d::Vector> points[2];
+      std::vector<std::pair<bool, size_t> > polys[2];
+
+      for (size_t i = 0; i < pieces.size(); ++i) {
+        const Piece &piece = pieces[i];
+        if (piece.cls != carve::POINT_IN && piece.cls != carve::POINT_OUT) continue;
+        int r = piece.cls == carve::POINT_IN ? 0 : 1;
+        if (r == 0 && inside == NULL) continue;
+        if (r == 1 && outside == NULL) continue;
+
+        const carve::line::Polyline *line = line_vec[piece.line];
+        size_t n = points[r].size();
+        if (piece.closed) {
+          for (size_t k = 0; k < line->edgeCount(); ++k) {
+            points[r].push_back(line->vertex(k)->v);
+          }
+        } else {
+          points[r].push_back(point(line, piece.begin));
+          for (double k = floor(piece.begin) + 1.0; k < piece.end; k += 1.0) {
+            points[r].push_back(point(line, k));
+          }
+          points[r].push_back(point(line, piece.end));
+        }
+        polys[r].push_back(std::make_pair(piece.closed, points[r].size() - n));
+      }
+
+      carve::line::PolylineSet **result[2] = { inside, outside };
+      for (int r = 0; r < 2; ++r) {
+        if (result[r] == NULL) continue;
+        carve::line::PolylineSet *lines_out = new carve::line::PolylineSet(points[r]);
+        std::vector<size_t> idx;
+        size_t base = 0;
+        for (size_t i = 0; i < polys[r].size(); ++i) {
+          idx.clear();
+          for (size_t k = 0; k < polys[r][i].second; ++k) idx.push_back(base + k);
+          lines_out->addPolyline(polys[r][i].first, idx.begin(), idx.end());
+          base += polys[r][i].second;
+        }
+        *result[r] = lines_out;
+      }
+    }
+
+  }
+}
@@ -0,0 +1,380 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/sweep.hpp>
+#include <carve/executor.hpp>
+
+#include <algorithm>
+
+namespace {
+
+  typedef carve::mesh::MeshSet<3> meshset_t;
+  typedef meshset_t::vertex_t vertex_t;
+  typedef meshset_t::edge_t edge_t;
+  typedef meshset_t::face_t face_t;
+  typedef meshset_t::mesh_t mesh_t;
+
+  typedef carve::sweep::P2 P2;
+  typedef carve::sweep::vec3_t vec3_t;
+
+  // the maximum miter scale applied at sharp bends of the path.
+  const double MAX_MITER = 4.0;
+
+  struct prepared_sweep {
+    size_t n_profile;
+    size_t n_rings;
+    std::vector<vec3_t> points;
+  };
+
+  template<typename vec_t>
+  void removeRepeats(const std::vector<vec_t> &in, std::vector<vec_t> &out, bool closed) {
+    out.clear();
+    out.reserve(in.size());
+    for (size_t i = 0; i < in.size(); ++i) {
+      if (!out.size() || !carve::geom::equal(out.back(), in[i])) {
+        out.push_back(in[i]);
+      }
+    }
+    if (closed) {
+      while (out.size() > 1 && carve::geom::equal(out.back(), out.front())) out.pop_back();
+    }
+  }
+
+  vec3_t perpendicular(const vec3_t &t) {
+    vec3_t a = vec3_t::ZERO();
+    a.v[carve::geom::smallestAxis(carve::geom::abs(t))] = 1.0;
+    return (a - t * carve::geom::dot(a, t)).normalized();
+  }
+
+  // reflect v in the plane with normal n (n need not be unit length).
+  vec3_t reflect(const vec3_t &v, const vec3_t &n, double n2) {
+    return v - n * (2.0 * carve::geom::dot(n, v) / n2);
+  }
+
+  void placeSwept(const std::vector<P2> &profile,
+                  const std::vector<vec3_t> &path,
+                  std::vector<vec3_t> &points) {
+    const size_t N = profile.size();
+    const size_t M = path.size();
+
+    std::vector<vec3_t> seg_dir(M - 1);
+    for (size_t i = 0; i + 1 < M; ++i) {
+      seg_dir[i] = (path[i+1] - path[i]).normalized();
+    }
+
+    std::vector<vec3_t> tangent(M);
+    tangent[0] = seg_dir[0];
+    tangent[M-1] = seg_dir[M-2];
+    for (size_t i = 1; i + 1 < M; ++i) {
+      vec3_t t = seg_dir[i-1] + seg_dir[i];
+      tangent[i] = t.isZero() ? seg_dir[i] : t.normalized();
+    }
+
+    points.resize(N * M);
+
+    vec3_t u = perpendicular(tangent[0]);
+    for (size_t r = 0; r < M; ++r) {
+      if (r) {
+        // double reflection rotation minimizing frame.
+        vec3_t v1 = path[r] - path[r-1];
+        double c1 = carve::geom::dot(v1, v1);
+        vec3_t uL = reflect(u, v1, c1);
+        vec3_t tL = reflect(tangent[r-1], v1, c1);
+        vec3_t v2 = tangent[r] - tL;
+        double c2 = carve::geom::dot(v2, v2);
+        u = c2 > carve::EPSILON2 ? reflect(uL, v2, c2) : uL;
+        u = (u - tangent[r] * carve::geom::dot(u, tangent[r])).normalized();
+      }
+      vec3_t v = carve::geom::cross(tangent[r], u);
+
+      // at interior points the profile lies in the bisecting plane,
+      // and is stretched along the direction of the bend so that the
+      // swept cross section keeps its shape.
+      double miter = 1.0;
+      vec3_t bend = vec3_t::ZERO();
+      if (r > 0 && r + 1 < M) {
+        double c = carve::geom::dot(tangent[r], seg_dir[r]);
+        bend = seg_dir[r] - seg_dir[r-1];
+        bend = bend - tangent[r] * carve::geom::dot(bend, tangent[r]);
+        if (c > carve::EPSILON && !bend.isZero()) {
+          bend.normalize();
+          miter = std::min(1.0 / c, MAX_MITER);
+        }
+      }
+
+      for (size_t j = 0; j < N; ++j) {
+        vec3_t o = profile[j].x * u + profile[j].y * v;
+        if (miter != 1.0) {
+          o += bend * ((miter - 1.0) * carve::geom::dot(o, bend));
+        }
+        points[r * N + j] = path[r] + o;
+      }
+    }
+  }
+
+  void placeExtruded(const std::vector<P2> &profile,
+                     const std::vector<vec3_t> &path,
+                     std::vector<vec3_t> &points) {
+    const size_t N = profile.size();
+    const size_t M = path.size();
+
+    points.resize(N * M);
+    for (size_t r = 0; r < M; ++r) {
+      for (size_t j = 0; j < N; ++j) {
+        points[r * N + j] = carve::geom::VECTOR(profile[j].x, profile[j].y, 0.0) + path[r];
+      }
+    }
+  }
+
+  bool prepare(const carve::sweep::Sweep &sweep, prepared_sweep &out) {
+    std::vector<P2> profile;
+    std::vector<vec3_t> path;
+
+    removeRepeats(sweep.profile, profile, true);
+    removeRepeats(sweep.path, path, false);
+
+    if (profile.size() < 3 || path.size() < 2) return false;
+
+    double area = carve::geom2d::signedArea(profile);
+    if (fabs(area) < carve::EPSILON2) return false;
+
+    // side faces are oriented outwards when the profile winds
+    // anticlockwise when viewed from the end of the path (note that
+    // geom2d::signedArea() is negative for anticlockwise polygons).
+    bool reverse = area > 0.0;
+
+    if (sweep.extrude) {
+      double dz = path[1].z - path[0].z;
+      if (fabs(dz) < carve::EPSILON) return false;
+      if (dz < 0.0) reverse = !reverse;
+    }
+
+    if (reverse) std::reverse(profile.begin(), profile.end());
+
+    out.n_profile = profile.size();
+    out.n_rings = path.size();
+
+    if (sweep.extrude) {
+      placeExtruded(profile, path, out.points);
+    } else {
+      placeSwept(profile, path, out.points);
+    }
+    return true;
+  }
+
+  inline void linkRev(edge_t *a, edge_t *b) {
+    a->rev = b;
+    b->rev = a;
+  }
+
+  // Construct a closed mesh for a sweep whose ring major vertices
+  // are already stored at vbase. All rev links are set from the
+  // known topology of the sweep.
+  mesh_t *buildMesh(vertex_t *vbase, size_t N, size_t M) {
+    std::vector<face_t *> faces;
+    faces.reserve((M - 1) * N * 2 + 2);
+
+    std::vector<vertex_t *> loop(N);
+
+    for (size_t j = 0; j < N; ++j) loop[j] = vbase + (N - 1 - j);
+    face_t *start_cap = new face_t(loop.begin(), loop.end());
+    faces.push_back(start_cap);
+
+    for (size_t j = 0; j < N; ++j) loop[j] = vbase + (M - 1) * N + j;
+    face_t *end_cap = new face_t(loop.begin(), loop.end());
+
+    // start_edge[j] begins at vertex (0, j); end_edge[j] begins at
+    // vertex (M-1, j).
+    std::vector<edge_t *> start_edge(N), end_edge(N);
+    {
+      edge_t *e = start_cap->edge;
+      for (size_t k = 0; k < N; ++k, e = e->next) start_edge[N - 1 - k] = e;
+      e = end_cap->edge;
+      for (size_t k = 0; k < N; ++k, e = e->next) end_edge[k] = e;
+    }
+
+    // the four boundary half-edges of each side quad, in order
+    // (r,j)->(r,j+1)->(r+1,j+1)->(r+1,j).
+    std::vector<edge_t *> side((M - 1) * N * 4);
+
+    for (size_t r = 0; r + 1 < M; ++r) {
+      for (size_t j = 0; j < N; ++j) {
+        size_t j1 = (j + 1) % N;
+        vertex_t *a = vbase + r * N + j;
+        vertex_t *b = vbase + r * N + j1;
+        vertex_t *c = vbase + (r + 1) * N + j1;
+        vertex_t *d = vbase + (r + 1) * N + j;
+        edge_t **e = &side[(r * N + j) * 4];
+
+        carve::geom3d::Plane p(carve::geom::cross(b->v - a->v, c->v - a->v).normalized(), a->v);
+        if (fabs(carve::geom::distance(p, d->v)) <= carve::EPSILON) {
+          face_t *q = new face_t(a, b, c, d);
+          e[0] = q->edge;
+          e[1] = e[0]->next;
+          e[2] = e[1]->next;
+          e[3] = e[2]->next;
+          faces.push_back(q);
+        } else {
+          face_t *t1 = new face_t(a, b, c);
+          face_t *t2 = new face_t(a, c, d);
+          e[0] = t1->edge;
+          e[1] = e[0]->next;
+          e[2] = t2->edge->next;
+          e[3] = e[2]->next;
+          linkRev(t1->edge->prev, t2->edge);
+          faces.push_back(t1);
+          faces.push_back(t2);
+        }
+      }
+    }
+
+    for (size_t r = 0; r + 1 < M; ++r) {
+      for (size_t j = 0; j < N; ++j) {
+        size_t j1 = (j + 1) % N;
+        edge_t **e = &side[(r * N + j) * 4];
+        linkRev(e[1], side[(r * N + j1) * 4 + 3]);
+        if (r + 2 < M) {
+          linkRev(e[2], side[((r + 1) * N + j) * 4 + 0]);
+        } else {
+          linkRev(e[2], end_edge[j]);
+        }
+        if (r == 0) {
+          linkRev(e[0], start_edge[j1]);
+        }
+      }
+    }
+
+    faces.push_back(end_cap);
+
+    return new mesh_t(faces);
+  }
+
+  // sweeps are processed in chunks of this many.
+  const size_t SWEEP_GRAIN = 16;
+
+  class PrepareTask : public carve::ParallelTask {
+    const std::vector<carve::sweep::Sweep> &sweeps;
+    std::vector<prepared_sweep> &prepared;
+    std::vector<char> &ok;
+
+  public:
+    PrepareTask(const std::vector<carve::sweep::Sweep> &_sweeps,
+                std::vector<prepared_sweep> &_prepared,
+                std::vector<char> &_ok) : sweeps(_sweeps), prepared(_prepared), ok(_ok) {
+    }
+
+    virtual void run(size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        ok[i] = prepare(sweeps[i], prepared[i]);
+      }
+    }
+  };
+
+  class BuildTask : public carve::ParallelTask {
+    std::vector<prepared_sweep> &prepared;
+    const std::vector<size_t> &offset;
+    std::vector<vertex_t> &vertex_storage;
+    std::vector<mesh_t *> &meshes;
+
+  public:
+    BuildTask(std::vector<prepared_sweep> &_prepared,
+              const std::vector<size_t> &_offset,
+              std::vector<vertex_t> &_vertex_storage,
+              std::vector<mesh_t *> &_meshes) :
+        prepared(_prepared), offset(_offset), vertex_storage(_vertex_storage), meshes(_meshes) {
+    }
+
+    virtual void run(size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        prepared_sweep &p = prepared[i];
+        for (size_t j = 0; j < p.points.size(); ++j) {
+          vertex_storage[offset[i] + j].v = p.points[j];
+        }
+        std::vector<vec3_t>().swap(p.points);
+        meshes[i] = buildMesh(&vertex_storage[offset[i]], p.n_profile, p.n_rings);
+      }
+    }
+  };
+
+}
+
+
+
+namespace carve {
+  namespace sweep {
+
+    carve::mesh::MeshSet<3> *sweepMany(const std::vector<Sweep> &sweeps,
+                                       carve::Executor *executor) {
+      const int n_sweeps = (int)sweeps.size();
+      carve::Executor &exec = executor != NULL ? *executor : carve::defaultExecutor();
+
+      std::vector<prepared_sweep> prepared(n_sweeps);
+      std::vector<char> ok(n_sweeps);
+
+      PrepareTask prepare_task(sweeps, prepared, ok);
+      carve::parallelFor(exec, n_sweeps, SWEEP_GRAIN, prepare_task);
+
+      std::vector<size_t> offset(n_sweeps + 1, 0);
+      for (int i = 0; i < n_sweeps; ++i) {
+        if (!ok[i]) {
+          throw carve::exception() << "degenerate sweep " << i;
+        }
+        offset[i + 1] = offset[i] + prepared[i].points.size();
+      }
+
+      std::vector<vertex_t> vertex_storage(offset[n_sweeps]);
+      std::vector<mesh_t *> meshes(n_sweeps);
+
+      BuildTask build_task(prepared, offset, vertex_storage, meshes);
+      carve::parallelFor(exec, n_sweeps, SWEEP_GRAIN, build_task);
+
+      return new meshset_t(vertex_storage, meshes);
+    }
+
+
+
+    carve::mesh::MeshSet<3> *sweep(const std::vector<P2> &profile,
+                                   const std::vector<vec3_t> &path) {
+      return sweepMany(std::vector<Sweep>(1, Sweep(profile, path)));
+    }
+
+
+
+    carve::mesh::MeshSet<3> *sweep(const std::vector<P2> &profile,
+                                   const std::vector<segment_t> &path,
+                                   double tolerance) {
+      std::vector<vec3_t> points;
+      carve::geom::flattenPath(path.begin(), path.end(), tolerance, points);
+      return sweep(profile, points);
+    }
+
+
+
+    carve::mesh::MeshSet<3> *extrude(const std::vector<P2> &profile,
+                                     const vec3_t &dir) {
+      std::vector<vec3_t> path;
+      path.push_back(vec3_t::ZERO());
+      path.push_back(dir);
+      return sweepMany(std::vector<Sweep>(1, Sweep(profile, path, true)));
+    }
+
+  }
+}
@@ -389,13 +389,13 @@ namespace carve {
   Timer timer;
 
 
-  TimingBlock::TimingBlock(int id) {
+  TimingBlock::TimingBlock(int id) : phase() {
 #if CARVE_USE_TIMINGS
     timer.startTiming(id);
 #endif
   }
 
-  TimingBlock::TimingBlock(const TimingName &name) {
+  TimingBlock::TimingBlock(const TimingName &name) : phase(&name, name.name) {
 #if CARVE_USE_TIMINGS
     timer.startTiming(name.id);
 #endif
@@ -427,7 +427,7 @@ namespace carve {
     timer.registerID(id, name);
   }
  
-  TimingName::TimingName(const char *name) {
+  TimingName::TimingName(const char *_name) : name(_name) {
     id = timer.registerID(name);
   }
 
@@ -0,0 +1,181 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/tree_cache.hpp>
+
+#include <carve/timing.hpp>
+
+#include <string.h>
+
+namespace carve {
+  namespace csg {
+
+    CSG_TreeCache::CSG_TreeCache(size_t _max_bytes) :
+      lru(), index(), max_bytes(_max_bytes), cur_bytes(0), n_hits(0), n_misses(0) {
+    }
+
+    CSG_TreeCache::~CSG_TreeCache() {
+      clear();
+    }
+
+
+
+    CSG_TreeCache::index_t::iterator CSG_TreeCache::find(const key_t &key) {
+      std::pair<index_t::iterator, index_t::iterator> range = index.equal_range(key.hash());
+      for (index_t::iterator i = range.first; i != range.second; ++i) {
+        if ((*i).second->key == key) return i;
+      }
+      return index.end();
+    }
+
+
+
+    void CSG_TreeCache::evict(size_t required) {
+      while (lru.size() && cur_bytes + required > max_bytes) {
+        entry_t &e = lru.back();
+        cur_bytes -= e.bytes;
+        index.erase(find(e.key));
+        delete e.result;
+        lru.pop_back();
+      }
+    }
+
+
+
+    CSG_TreeCache::meshset_t *CSG_TreeCache::lookup(const key_t &key) {
+      index_t::iterator i = find(key);
+      if (i == index.end()) {
+        ++n_misses;
+        return NULL;
+      }
+      ++n_hits;
+      lru.splice(lru.begin(), lru, (*i).second);
+
+      static carve::TimingName FUNC_NAME("CSG_TreeCache::lookup() clone");
+      carve::TimingBlock block(FUNC_NAME);
+      return (*i).second->result->clone();
+    }
+
+
+
+    void CSG_TreeCache::insert(const key_t &key, const meshset_t *result) {
+      index_t::iterator i = find(key);
+      if (i != index.end()) {
+        lru.splice(lru.begin(), lru, (*i).second);
+        return;
+      }
+
+      size_t bytes = estimateBytes(result) + sizeof(entry_t);
+      if (bytes > max_bytes) return;
+
+      evict(bytes);
+      lru.push_front(entry_t(key, result->clone(), bytes));
+      index.insert(std::make_pair(key.hash(), lru.begin()));
+      cur_bytes += bytes;
+    }
+
+
+
+    void CSG_TreeCache::clear() {
+      for (lru_t::iterator i = lru.begin(); i != lru.end(); ++i) {
+        delete (*i).result;
+      }
+      lru.clear();
+      index.clear();
+      cur_bytes = 0;
+    }
+
+
+
+    size_t CSG_TreeCache::estimateBytes(const meshset_t *meshset) {
+      size_t bytes = sizeof(meshset_t) + meshset->vertex_storage.size() * sizeof(meshset_t::vertex_t);
+      for (size_t i = 0; i < meshset->meshes.size(); ++i) {
+        const meshset_t::mesh_t *mesh = meshset->meshes[i];
+        bytes += sizeof(meshset_t::mesh_t);
+        bytes += (mesh->open_edges.size() + mesh->closed_edges.size()) * sizeof(meshset_t::edge_t *);
+        for (size_t j = 0; j < mesh->faces.size(); ++j) {
+          bytes += sizeof(meshset_t::face_t *) + sizeof(meshset_t::face_t);
+          bytes += mesh->faces[j]->n_edges * sizeof(meshset_t::edge_t);
+        }
+      }
+      return bytes;
+    }
+
+
+
+    CSG_TreeCache::hash_t CSG_TreeCache::hash(double v) {
+      // +0.0 and -0.0 compare equal, so must hash equally.
+      if (v == 0.0) v = 0.0;
+      hash_t k;
+      memcpy(&k, &v, sizeof(k));
+      return k;
+    }
+
+
+
+    void CSG_TreeCache::append(key_t &key, const carve::math::Matrix &matrix) {
+      for (unsigned i = 0; i < 16; ++i) {
+        append(key, matrix.v[i]);
+      }
+    }
+
+
+
+    void CSG_TreeCache::append(key_t &key, const meshset_t *meshset) {
+      static carve::TimingName FUNC_NAME("CSG_TreeCache::append()");
+      carve::TimingBlock block(FUNC_NAME);
+
+      const meshset_t::vertex_t *base = meshset->vertex_storage.size() ? &meshset->vertex_storage[0] : NULL;
+
+      key.add(meshset->vertex_storage.size());
+      for (size_t i = 0; i < meshset->vertex_storage.size(); ++i) {
+        const carve::geom3d::Vector &v = meshset->vertex_storage[i].v;
+        append(key, v.x);
+        append(key, v.y);
+        append(key, v.z);
+      }
+
+      key.add(meshset->meshes.size());
+      for (size_t i = 0; i < meshset->meshes.size(); ++i) {
+        const meshset_t::mesh_t *mesh = meshset->meshes[i];
+        key.add(mesh->faces.size());
+        for (size_t j = 0; j < mesh->faces.size(); ++j) {
+          const meshset_t::face_t *face = mesh->faces[j];
+          key.add(face->n_edges);
+          const meshset_t::edge_t *e = face->edge;
+          do {
+            key.add((uint64_t)(e->vert - base));
+            e = e->next;
+          } while (e != face->edge);
+        }
+      }
+    }
+
+
+
+    CSG_TreeCache::hash_t CSG_TreeCache::hash(const meshset_t *meshset) {
+      key_t key;
+      append(key, meshset);
+      return key.hash();
+    }
+
+  }
+}
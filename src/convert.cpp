@@ -22,6 +22,7 @@
 #include <carve/csg.hpp>
 #include <carve/tree.hpp>
 #include <carve/csg_triangulator.hpp>
+#include <carve/mesh_codec.hpp>
 
 #include "geometry.hpp"
 #include "glu_triangulator.hpp"
@@ -47,6 +48,8 @@ struct Options : public opt::Parser {
   bool ascii;
   bool obj;
   bool vtk;
+  bool compressed;
+  double quantum;
   bool canonicalize;
   bool triangulate;
 
@@ -57,6 +60,8 @@ struct Options : public opt::Parser {
     if (o == "--binary"       || o == "-b") { ascii = false; return; }
     if (o == "--obj"          || o == "-O") { obj = true; return; }
     if (o == "--vtk"          || o == "-V") { vtk = true; return; }
+    if (o == "--compressed"   || o == "-C") { compressed = true; return; }
+    if (o == "--quantum"      || o == "-q") { quantum = strtod(v.c_str(), NULL); return; }
     if (o == "--ascii"        || o == "-a") { ascii = true; return; }
     if (o == "--triangulate"  || o == "-t") { triangulate = true; return; }
     if (o == "--help"         || o == "-h") { help(std::cout); exit(0); }
@@ -78,6 +83,8 @@ struct Options : public opt::Parser {
     ascii = true;
     obj = false;
     vtk = false;
+    compressed = false;
+    quantum = 0.0;
     triangulate = false;
 
     option("canonicalize", 'c', false, "Canonicalize before output (for comparing output).");
@@ -85,6 +92,8 @@ struct Options : public opt::Parser {
     option("ascii",        'a', false, "ASCII output (default).");
     option("obj",          'O', false, "Output in .obj format.");
     option("vtk",          'V', false, "Output in .vtk format.");
+    option("compressed",   'C', false, "Output in compressed mesh format.");
+    option("quantum",      'q', true,  "Round compressed coordinates to multiples of this value.");
     option("triangulate",  't', false, "Triangulate output.");
     option("help",         'h', false, "This help message.");
   }
@@ -105,9 +114,30 @@ static bool endswith(const std::string &a, const std::string &b) {
   return true;
 }
 
+static void writeMesh(carve::mesh::MeshSet<3> *p) {
+  if (options.canonicalize) p->canonicalize();
+  if (options.obj) {
+    writeOBJ(std::cout, p);
+  } else if (options.vtk) {
+    writeVTK(std::cout, p);
+  } else if (options.compressed) {
+    carve::mesh::writeCompressed(std::cout, p, options.quantum);
+  } else {
+    writePLY(std::cout, p, options.ascii);
+  }
+}
+
 int main(int argc, char **argv) {
   options.parse(argc, argv);
 
+  if (endswith(options.file, ".cmesh")) {
+    std::ifstream in(options.file.c_str(), std::ios::binary);
+    carve::mesh::MeshSet<3> *p = carve::mesh::readCompressed(in);
+    writeMesh(p);
+    delete p;
+    return 0;
+  }
+
   carve::input::Input inputs;
   std::vector<carve::mesh::MeshSet<3> *> polys;
   std::vector<carve::line::PolylineSet *> lines;
@@ -131,20 +161,15 @@ int main(int argc, char **argv) {
     carve::line::PolylineSet *l;
 
     if ((p = carve::input::Input::create<carve::mesh::MeshSet<3> >(*i)) != NULL)  {
-      if (options.canonicalize) p->canonicalize();
-      if (options.obj) {
-        writeOBJ(std::cout, p);
-      } else if (options.vtk) {
-        writeVTK(std::cout, p);
-      } else {
-        writePLY(std::cout, p, options.ascii);
-      }
+      writeMesh(p);
       delete p;
     } else if ((l = carve::input::Input::create<carve::line::PolylineSet>(*i)) != NULL)  {
       if (options.obj) {
         writeOBJ(std::cout, l);
       } else if (options.vtk) {
         writeVTK(std::cout, l);
+      } else if (options.compressed) {
+        std::cerr << "Can't write a polyline set in compressed format" << std::endl;
       } else {
         writePLY(std::cout, l, options.ascii);
       }
@@ -154,6 +179,8 @@ int main(int argc, char **argv) {
         std::cerr << "Can't write a point set in .obj format" << std::endl;
       } else if (options.vtk) {
         std::cerr << "Can't write a point set in .vtk format" << std::endl;
+      } else if (options.compressed) {
+        std::cerr << "Can't write a point set in compressed format" << std::endl;
       } else {
         writePLY(std::cout, ps, options.ascii);
       }
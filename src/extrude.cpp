@@ -24,6 +24,7 @@
 #include <carve/input.hpp>
 #include <carve/triangulator.hpp>
 #include <carve/matrix.hpp>
+#include <carve/bezier.hpp>
 
 #include <fstream>
 #include <sstream>
@@ -34,100 +35,8 @@
 #include <cctype>
 #include <stdexcept>
 
-template<unsigned ndim>
-carve::geom::vector<ndim> lerp(
-    double t,
-    const carve::geom::vector<ndim> &p1,
-    const carve::geom::vector<ndim> &p2) {
-  return (1-t)*p1 + t*p2;
-}
-
-template<unsigned ndim>
-class cubic_bezier {
-
-public:
-  typedef carve::geom::vector<ndim> vec_t;
-  typedef cubic_bezier<ndim> cubic_bezier_t;
-
-  vec_t p[4];
-
-  cubic_bezier() {
-  }
-
-  cubic_bezier(const vec_t &p1, const vec_t &p2, const vec_t &p3, const vec_t &p4) {
-    p[0] = p1; p[1] = p2; p[2] = p3; p[3] = p4;
-  }
-
-  template<typename iter_t>
-  cubic_bezier(iter_t begin, iter_t end) {
-    if (std::distance(begin, end) != 4) throw std::runtime_error("failed");
-    std::copy(begin, end, p);
-  }
-
-  vec_t eval(double t) const {
-    double u = 1-t;
-    return u*u*u*p[0] + 3*t*u*u*p[1] + 3*t*t*u*p[2] + t*t*t*p[3];
-  }
-
-  double flatness() const {
-    carve::geom::ray<ndim> ray = carve::geom::rayThrough(p[0], p[3]);
-    return sqrt(std::max(carve::geom::distance2(ray, p[1]), carve::geom::distance2(ray, p[2])));
-  }
-
-  void split(double t, cubic_bezier_t &a, cubic_bezier_t &b) const {
-    a.p[0] = p[0]; b.p[3] = p[3];
-    a.p[1] = lerp(t, p[0], p[1]);
-    vec_t m = lerp(t, p[1], p[2]);
-    b.p[2] = lerp(t, p[2], p[3]);
-    a.p[2] = lerp(t, a.p[1], m);
-    b.p[1] = lerp(t, m, b.p[2]);
-    a.p[3] = b.p[0] = lerp(t, a.p[2], b.p[1]);
-  }
-
-  void approximateSimple(std::vector<vec_t> &out, double max_flatness) const {
-    double f = flatness();
-    if (f < max_flatness) {
-      out.push_back(p[3]);
-    } else {
-      cubic_bezier a, b;
-      split(0.5, a, b);
-      a.approximateSimple(out, max_flatness);
-      b.approximateSimple(out, max_flatness);
-    }
-  }
-
-  void approximate(std::vector<vec_t> &out, double max_flatness, unsigned n_tests = 128) const {
-    double f = flatness();
-    if (f < max_flatness) {
-      out.push_back(p[3]);
-    } else {
-      double best_t = .5;
-      double best_f = f;
-      cubic_bezier a, b;
-      for (size_t i = 1; i < n_tests; ++i) {
-        double t = double(i) / n_tests;
-        split(t, a, b);
-        double f = a.flatness() + b.flatness();
-        if (f < best_f) {
-          best_t = t;
-          best_f = f;
-        }
-      }
-      split(best_t, a, b);
-      a.approximate(out, max_flatness, n_tests);
-      b.approximate(out, max_flatness, n_tests);
-    }
-  }
-};
-
-template<unsigned ndim>
-cubic_bezier<ndim> make_bezier(
-    const carve::geom::vector<ndim> &p1,
-    const carve::geom::vector<ndim> &p2,
-    const carve::geom::vector<ndim> &p3,
-    const carve::geom::vector<ndim> &p4) {
-  return cubic_bezier<ndim>(p1, p2, p3, p4);
-}
+using carve::geom::cubic_bezier;
+using carve::geom::make_bezier;
 
 void consume(std::istream &in, char ch) {
   while (in.good()) {
@@ -22,6 +22,7 @@
 #include <carve/csg.hpp>
 #include <carve/tree.hpp>
 #include <carve/csg_triangulator.hpp>
+#include <carve/executor.hpp>
 
 #include "geometry.hpp"
 
@@ -41,8 +42,15 @@
 #include <set>
 #include <iostream>
 #include <iomanip>
+#include <list>
+#include <map>
+#include <new>
+#include <exception>
 
+#include <stdio.h>
 #include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 typedef std::vector<std::string>::iterator TOK;
 
 
@@ -61,6 +69,9 @@ struct Options : public opt::Parser {
 #endif
   bool improve;
   carve::csg::CSG::CLASSIFY_TYPE classifier;
+  bool batch;
+  std::string batch_file;
+  size_t cache_mb;
 
   std::string stream;
   
@@ -91,6 +102,12 @@ struct Options : public opt::Parser {
     if (o == "--edge"         || o == "-e") { classifier = carve::csg::CSG::CLASSIFY_EDGE; return; }
     if (o == "--epsilon"      || o == "-E") { carve::setEpsilon(strtod(v.c_str(), NULL)); return; }
     if (o == "--help"         || o == "-h") { help(std::cout); exit(0); }
+    if (o == "--batch"        || o == "-B") {
+      batch = true;
+      batch_file = v;
+      return;
+    }
+    if (o == "--cache-size"   || o == "-C") { cache_mb = strtoul(v.c_str(), NULL, 0); return; }
     if (o == "--file"         || o == "-f") {
       from_file = true;
       if (v == "-") {
@@ -147,6 +164,13 @@ struct Options : public opt::Parser {
     out << "examples:" << std::endl;
     out << "  CUBE & ROT(0.78539816339744828,1,1,1,CUBE)" << std::endl;
     out << "  data/cylinderx.ply | data/cylindery.ply | data/cylinderz.ply" << std::endl;
+    out << std::endl;
+    out << "in batch mode (-B), each line of input is a job of the form:" << std::endl;
+    out << "  output expression" << std::endl;
+    out << "where output is a .ply, .obj or .vtk file, or - for standard" << std::endl;
+    out << "output. Blank lines and lines beginning with # are ignored." << std::endl;
+    out << "Input meshes are kept in memory between jobs, and reloaded" << std::endl;
+    out << "when the file is modified." << std::endl;
 
   }
 
@@ -162,6 +186,8 @@ struct Options : public opt::Parser {
 #endif
     improve = false;
     classifier = carve::csg::CSG::CLASSIFY_NORMAL;
+    batch = false;
+    cache_mb = 256;
 
     option("canonicalize", 'c', false, "Canonicalize before output (for comparing output).");
     option("binary",       'b', false, "Produce binary output.");
@@ -178,6 +204,8 @@ struct Options : public opt::Parser {
     option("edge",         'e', false, "Use edge classifier.");
     option("epsilon",      'E', true,  "Set epsilon used for calculations.");
     option("file",         'f', true,  "Read CSG expression from file.");
+    option("batch",        'B', true,  "Evaluate a stream of jobs from a file (- for stdin).");
+    option("cache-size",   'C', true,  "Size of the batch mode mesh cache in MB (default 256).");
     option("help",         'h', false, "This help message.");
   }
 };
@@ -197,6 +225,219 @@ static bool endswith(const std::string &a, const std::string &b) {
   return true;
 }
 
+static bool isMeshFile(const std::string &path) {
+  return endswith(path, ".ply") || endswith(path, ".vtk") || endswith(path, ".obj");
+}
+
+static carve::mesh::MeshSet<3> *readMeshFile(const std::string &path) {
+  if (endswith(path, ".ply")) return readPLYasMesh(path);
+  if (endswith(path, ".vtk")) return readVTKasMesh(path);
+  if (endswith(path, ".obj")) return readOBJasMesh(path);
+  return NULL;
+}
+
+// an estimate of the heap footprint of a mesh, for the cache bound.
+static size_t meshBytes(const carve::mesh::MeshSet<3> *poly) {
+  size_t bytes = sizeof(*poly) + poly->vertex_storage.size() * sizeof(carve::mesh::MeshSet<3>::vertex_t);
+  for (size_t i = 0; i < poly->meshes.size(); ++i) {
+    const carve::mesh::Mesh<3> *mesh = poly->meshes[i];
+    bytes += sizeof(*mesh);
+    for (size_t j = 0; j < mesh->faces.size(); ++j) {
+      bytes += sizeof(carve::mesh::MeshSet<3>::face_t) + mesh->faces[j]->n_edges * sizeof(carve::mesh::MeshSet<3>::edge_t);
+    }
+  }
+  return bytes;
+}
+
+
+
+// Meshes loaded in batch mode, keyed by path. An entry is reused only
+// while the file's modification time (to the nanosecond, where the
+// platform records it) and size are unchanged. Least recently used
+// entries are evicted to keep the total below the configured size.
+class MeshCache {
+  struct entry_t {
+    std::string path;
+    int64_t mtime;
+    off_t size;
+    carve::mesh::MeshSet<3> *poly;
+    size_t bytes;
+  };
+
+  typedef std::list<entry_t> lru_t;
+
+  // most recently used first.
+  lru_t lru;
+  std::map<std::string, lru_t::iterator> index;
+  size_t bytes;
+  size_t max_bytes;
+
+  // read a mesh without throwing. On failure, returns NULL and sets
+  // error to a description of the exception, if there was one.
+  static carve::mesh::MeshSet<3> *read(const std::string &path, std::string &error) {
+    try {
+      return readMeshFile(path);
+    } catch (carve::exception &e) {
+      error = e.str();
+    } catch (std::bad_alloc &) {
+      error = "out of memory";
+    } catch (std::exception &e) {
+      error = e.what();
+    } catch (...) {
+      error = "unknown exception";
+    }
+    return NULL;
+  }
+
+  // tasks must not throw, so a failure to load is recorded in error
+  // and reported by prefetch() on the calling thread.
+  struct LoadTask : public carve::Task {
+    std::string path;
+    carve::mesh::MeshSet<3> *poly;
+    std::string error;
+
+    LoadTask(const std::string &_path) : path(_path), poly(NULL), error() {
+    }
+
+    virtual void run() {
+      poly = read(path, error);
+    }
+  };
+
+  MeshCache(const MeshCache &);
+  MeshCache &operator=(const MeshCache &);
+
+  // mtime is in nanoseconds.
+  static bool fileStat(const std::string &path, int64_t &mtime, off_t &size) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+#if defined(__APPLE__)
+    mtime = (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+    mtime = (int64_t)st.st_mtime * 1000000000;
+#else
+    mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    size = st.st_size;
+    return true;
+  }
+
+  // the current entry for path, or NULL if there is none or the file
+  // has changed since it was loaded.
+  entry_t *lookup(const std::string &path, int64_t mtime, off_t size) {
+    std::map<std::string, lru_t::iterator>::iterator i = index.find(path);
+    if (i == index.end()) return NULL;
+    if ((*i).second->mtime != mtime || (*i).second->size != size) {
+      erase((*i).second);
+      return NULL;
+    }
+    lru.splice(lru.begin(), lru, (*i).second);
+    return &lru.front();
+  }
+
+  void erase(lru_t::iterator i) {
+    bytes -= (*i).bytes;
+    delete (*i).poly;
+    index.erase((*i).path);
+    lru.erase(i);
+  }
+
+  // takes ownership of poly. Returns false if it is too large to be
+  // cached, in which case the caller keeps ownership.
+  bool insert(const std::string &path, int64_t mtime, off_t size, carve::mesh::MeshSet<3> *poly) {
+    entry_t entry;
+    entry.path = path;
+    entry.mtime = mtime;
+    entry.size = size;
+    entry.poly = poly;
+    entry.bytes = meshBytes(poly);
+    if (entry.bytes > max_bytes) return false;
+
+    while (lru.size() && bytes + entry.bytes > max_bytes) {
+      erase(--lru.end());
+    }
+    lru.push_front(entry);
+    index[path] = lru.begin();
+    bytes += entry.bytes;
+    return true;
+  }
+
+public:
+  size_t hits;
+  size_t misses;
+
+  MeshCache(size_t _max_bytes) : lru(), index(), bytes(0), max_bytes(_max_bytes), hits(0), misses(0) {
+  }
+
+  ~MeshCache() {
+    for (lru_t::iterator i = lru.begin(); i != lru.end(); ++i) {
+      delete (*i).poly;
+    }
+  }
+
+  // load, in parallel, each of paths that is not already cached.
+  void prefetch(const std::vector<std::string> &paths) {
+    std::vector<LoadTask *> tasks;
+    std::vector<std::pair<int64_t, off_t> > stamps;
+    std::set<std::string> seen;
+    carve::TaskGroup group(carve::defaultExecutor());
+
+    for (size_t i = 0; i < paths.size(); ++i) {
+      int64_t mtime;
+      off_t size;
+      if (!seen.insert(paths[i]).second) continue;
+      if (!fileStat(paths[i], mtime, size) || lookup(paths[i], mtime, size)) continue;
+      tasks.push_back(new LoadTask(paths[i]));
+      stamps.push_back(std::make_pair(mtime, size));
+      group.add(tasks.back());
+    }
+    group.wait();
+
+    for (size_t i = 0; i < tasks.size(); ++i) {
+      if (tasks[i]->error.size()) {
+        std::cerr << "can't load " << tasks[i]->path << ": " << tasks[i]->error << std::endl;
+      }
+      if (tasks[i]->poly) {
+        ++misses;
+        if (!insert(tasks[i]->path, stamps[i].first, stamps[i].second, tasks[i]->poly)) delete tasks[i]->poly;
+      }
+      delete tasks[i];
+    }
+  }
+
+  // a copy of the mesh at path, owned by the caller, or NULL if it
+  // cannot be read.
+  carve::mesh::MeshSet<3> *get(const std::string &path) {
+    int64_t mtime;
+    off_t size;
+    if (!fileStat(path, mtime, size)) return NULL;
+
+    entry_t *entry = lookup(path, mtime, size);
+    if (entry == NULL) {
+      std::string error;
+      carve::mesh::MeshSet<3> *poly = read(path, error);
+      if (error.size()) std::cerr << "can't load " << path << ": " << error << std::endl;
+      if (poly == NULL) return NULL;
+      ++misses;
+      if (!insert(path, mtime, size, poly)) return poly;
+      entry = &lru.front();
+    } else {
+      ++hits;
+    }
+    return entry->poly->clone();
+  }
+};
+
+
+
+// set while running in batch mode.
+static MeshCache *mesh_cache = NULL;
+
+static carve::mesh::MeshSet<3> *loadMesh(const std::string &path) {
+  if (mesh_cache) return mesh_cache->get(path);
+  return readMeshFile(path);
+}
+
 bool charTok(char ch) {
   return strchr("()|&^,-:", ch) != NULL;
 }
@@ -350,12 +591,8 @@ carve::csg::CSG_TreeNode *parseAtom(TOK &tok) {
       if (!STRTOD(*tok, rad2)) { return NULL; } ++tok;
       if (*tok != ")") { return NULL; }
       poly = makeTorus(slices, rings, rad1, rad2);
-    } else if (endswith(*tok, ".ply")) {
-      poly = readPLYasMesh(*tok);
-    } else if (endswith(*tok, ".vtk")) {
-      poly = readVTKasMesh(*tok);
-    } else if (endswith(*tok, ".obj")) {
-      poly = readOBJasMesh(*tok);
+    } else if (isMeshFile(*tok)) {
+      poly = loadMesh(*tok);
     }
     if (poly == NULL) return NULL;
 
@@ -509,20 +746,59 @@ carve::csg::CSG_TreeNode *parse(TOK &tok) {
 
 
 
-int main(int argc, char **argv) {
-  static carve::TimingName MAIN_BLOCK("Application");
+enum OutputFormat {
+  OUTPUT_PLY,
+  OUTPUT_OBJ,
+  OUTPUT_VTK
+};
+
+static OutputFormat defaultFormat() {
+  if (options.obj) return OUTPUT_OBJ;
+  if (options.vtk) return OUTPUT_VTK;
+  return OUTPUT_PLY;
+}
+
+static OutputFormat formatForPath(const std::string &path) {
+  if (endswith(path, ".obj")) return OUTPUT_OBJ;
+  if (endswith(path, ".vtk")) return OUTPUT_VTK;
+  if (endswith(path, ".ply")) return OUTPUT_PLY;
+  return defaultFormat();
+}
+
+static void registerHooks(carve::csg::CSG &csg) {
+  if (options.triangulate) {
+#if !defined(DISABLE_GLU_TRIANGULATOR)
+    if (options.glu_triangulate) {
+      csg.hooks.registerHook(new GLUTriangulator, carve::csg::CSG::Hooks::PROCESS_OUTPUT_FACE_BIT);
+      if (options.improve) {
+        csg.hooks.registerHook(new carve::csg::CarveTriangulationImprover, carve::csg::CSG::Hooks::PROCESS_OUTPUT_FACE_BIT);
+      }
+    } else {
+#endif
+      if (options.improve) {
+        csg.hooks.registerHook(new carve::csg::CarveTriangulatorWithImprovement, carve::csg::CSG::Hooks::PROCESS_OUTPUT_FACE_BIT);
+      } else {
+        csg.hooks.registerHook(new carve::csg::CarveTriangulator, carve::csg::CSG::Hooks::PROCESS_OUTPUT_FACE_BIT);
+      }
+#if !defined(DISABLE_GLU_TRIANGULATOR)
+    }
+#endif
+  } else if (options.no_holes) {
+    csg.hooks.registerHook(new carve::csg::CarveHoleResolver, carve::csg::CSG::Hooks::PROCESS_OUTPUT_FACE_BIT);
+  }
+}
+
+// parse and evaluate expr, and write the result to out. Returns false
+// if the expression could not be parsed or evaluated.
+static bool evaluate(const std::string &expr, std::ostream &out, OutputFormat format) {
   static carve::TimingName PARSE_BLOCK("Parse");
   static carve::TimingName EVAL_BLOCK("Eval");
   static carve::TimingName WRITE_BLOCK("Write");
 
-  carve::Timing::start(MAIN_BLOCK);
-  
   double duration;
   std::vector<std::string> tokens;
 
-  options.parse(argc, argv);
-
-  tokens = tokenize(options.stream);
+  tokens = tokenize(expr);
   tokens.push_back("$");
 
   carve::Timing::start(PARSE_BLOCK);
@@ -532,68 +808,141 @@ int main(int argc, char **argv) {
 
   std::cerr << "Parse time " << duration << " seconds" << std::endl;
 
-  if (p != NULL) {
-    carve::Timing::start(EVAL_BLOCK);
-    carve::mesh::MeshSet<3> *result = NULL;
+  if (p == NULL) {
+    std::cerr << "syntax error at [" << *tok << "]" << std::endl;
+    return false;
+  }
+
+  carve::Timing::start(EVAL_BLOCK);
+  carve::mesh::MeshSet<3> *result = NULL;
 
-    try {
-      carve::csg::CSG csg;
+  try {
+    carve::csg::CSG csg;
+    registerHooks(csg);
+    result = p->eval(csg);
+  } catch (carve::exception e) {
+    std::cerr << "CSG failed, exception: " << e.str() << std::endl;
+  }
+  duration = carve::Timing::stop();
+  std::cerr << "Eval time " << duration << " seconds" << std::endl;
 
-      if (options.triangulate) {
-#if !defined(DISABLE_GLU_TRIANGULATOR)
-        if (options.glu_triangulate) {
-          csg.hooks.registerHook(new GLUTriangulator, carve::csg::CSG::Hooks::PROCESS_OUTPUT_FACE_BIT);
-          if (options.improve) {
-            csg.hooks.registerHook(new carve::csg::CarveTriangulationImprover, carve::csg::CSG::Hooks::PROCESS_OUTPUT_FACE_BIT);
-          }
-        } else {
-#endif
-          if (options.improve) {
-            csg.hooks.registerHook(new carve::csg::CarveTriangulatorWithImprovement, carve::csg::CSG::Hooks::PROCESS_OUTPUT_FACE_BIT);
-          } else {
-            csg.hooks.registerHook(new carve::csg::CarveTriangulator, carve::csg::CSG::Hooks::PROCESS_OUTPUT_FACE_BIT);
-          }
-#if !defined(DISABLE_GLU_TRIANGULATOR)
-        }
-#endif
-      } else if (options.no_holes) {
-        csg.hooks.registerHook(new carve::csg::CarveHoleResolver, carve::csg::CSG::Hooks::PROCESS_OUTPUT_FACE_BIT);
-      }
+  carve::Timing::start(WRITE_BLOCK);
+  if (result) {
+    if (options.canonicalize) result->canonicalize();
 
-      result = p->eval(csg);
-    } catch (carve::exception e) {
-      std::cerr << "CSG failed, exception: " << e.str() << std::endl;
+    switch (format) {
+    case OUTPUT_OBJ: writeOBJ(out, result); break;
+    case OUTPUT_VTK: writeVTK(out, result); break;
+    case OUTPUT_PLY: writePLY(out, result, options.ascii); break;
     }
-    duration = carve::Timing::stop();
-    std::cerr << "Eval time " << duration << " seconds" << std::endl;
+  }
+  duration = carve::Timing::stop();
+  std::cerr << "Output time " << duration << " seconds" << std::endl;
 
-    carve::Timing::start(WRITE_BLOCK);
-    if (result) {
-      if (options.canonicalize) result->canonicalize();
+  {
+    static carve::TimingName FUNC_NAME("Main app delete polyhedron");
+    carve::TimingBlock block(FUNC_NAME);
+
+    delete p;
+    if (result) delete result;
+  }
 
-      if (options.obj) {
-        writeOBJ(std::cout, result);
-      } else if (options.vtk) {
-        writeVTK(std::cout, result);
+  return result != NULL;
+}
+
+// evaluate each job read from options.batch_file. Input meshes are
+// cached between jobs, and the meshes named by a job are loaded in
+// parallel before it is parsed. Returns false if any job failed.
+static bool runBatch() {
+  std::ifstream file;
+  std::istream *in = &std::cin;
+  if (options.batch_file != "-") {
+    file.open(options.batch_file.c_str());
+    if (!file) {
+      std::cerr << "can't open " << options.batch_file << std::endl;
+      return false;
+    }
+    in = &file;
+  }
+
+  MeshCache cache(options.cache_mb * 1024 * 1024);
+  mesh_cache = &cache;
+
+  size_t n_jobs = 0, n_failed = 0;
+  std::string line;
+  while (std::getline(*in, line)) {
+    size_t b = line.find_first_not_of(" \t\r");
+    if (b == std::string::npos || line[b] == '#') continue;
+    ++n_jobs;
+
+    size_t e = line.find_first_of(" \t", b);
+    if (e == std::string::npos) {
+      std::cerr << "job " << n_jobs << ": missing expression" << std::endl;
+      ++n_failed;
+      continue;
+    }
+    std::string output = line.substr(b, e - b);
+    std::string expr = line.substr(e);
+
+    std::vector<std::string> tokens = tokenize(expr);
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+      if (isMeshFile(tokens[i])) paths.push_back(tokens[i]);
+    }
+    cache.prefetch(paths);
+
+    bool ok;
+    if (output == "-") {
+      ok = evaluate(expr, std::cout, defaultFormat());
+      std::cout.flush();
+    } else {
+      std::ofstream out(output.c_str(), std::ios::out | std::ios::binary);
+      if (!out) {
+        std::cerr << "can't open " << output << std::endl;
+        ok = false;
       } else {
-        writePLY(std::cout, result, options.ascii);
+        ok = evaluate(expr, out, formatForPath(output));
+        out.close();
+        if (!ok) remove(output.c_str());
       }
     }
-    duration = carve::Timing::stop();
-    std::cerr << "Output time " << duration << " seconds" << std::endl;
+    if (!ok) ++n_failed;
+    std::cerr << "job " << n_jobs << " (" << output << "): " << (ok ? "ok" : "FAILED") << std::endl;
+  }
+
+  mesh_cache = NULL;
+
+  std::cerr << n_jobs << " jobs, " << n_failed << " failed; mesh cache "
+            << cache.hits << " hits, " << cache.misses << " misses" << std::endl;
+  return n_failed == 0;
+}
+
+
 
-    {
-      static carve::TimingName FUNC_NAME("Main app delete polyhedron");
-      carve::TimingBlock block(FUNC_NAME);
 
-      delete p;
-      if (result) delete result;
+
+int main(int argc, char **argv) {
+  static carve::TimingName MAIN_BLOCK("Application");
+
+  carve::Timing::start(MAIN_BLOCK);
+
+  int status = 0;
+
+  options.parse(argc, argv);
+
+  if (options.batch) {
+    if (options.stream.size()) {
+      std::cerr << "Can't mix an expression and -B" << std::endl;
+      exit(1);
     }
+    if (!runBatch()) status = 1;
   } else {
-    std::cerr << "syntax error at [" << *tok << "]" << std::endl;
+    evaluate(options.stream, std::cout, defaultFormat());
   }
-  
+
   carve::Timing::stop();
-  
+
   carve::Timing::printTimings();
+
+  return status;
 }
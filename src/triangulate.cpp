@@ -22,6 +22,7 @@
 #include <carve/csg.hpp>
 #include <carve/tree.hpp>
 #include <carve/csg_triangulator.hpp>
+#include <carve/mesh_triangulate.hpp>
 
 #include "read_ply.hpp"
 #include "write_ply.hpp"
@@ -154,55 +155,17 @@ int main(int argc, char **argv) {
   carve::mesh::MeshSet<3> *poly = readModel(options.file);
   if (!poly) exit(1);
 
-  std::vector<carve::mesh::MeshSet<3>::face_t *> out_faces;
+  carve::mesh::triangulateFaces(poly, options.improve);
 
-  size_t N = 0;
-  for (carve::mesh::MeshSet<3>::face_iter i = poly->faceBegin(); i != poly->faceEnd(); ++i) {
-    carve::mesh::MeshSet<3>::face_t *f = *i;
-    N += f->nVertices() - 2;
-  }
-  out_faces.reserve(N);
-
-  for (carve::mesh::MeshSet<3>::face_iter i = poly->faceBegin(); i != poly->faceEnd(); ++i) {
-    carve::mesh::MeshSet<3>::face_t *f = *i;
-    std::vector<carve::triangulate::tri_idx> result;
-
-    std::vector<carve::mesh::MeshSet<3>::vertex_t *> vloop;
-    f->getVertices(vloop);
-
-    carve::triangulate::triangulate(
-      carve::mesh::MeshSet<3>::face_t::projection_mapping(f->project),
-      vloop,
-      result);
-    if (options.improve) {
-      carve::triangulate::improve(
-        carve::mesh::MeshSet<3>::face_t::projection_mapping(f->project),
-        vloop,
-        carve::mesh::vertex_distance(),
-        result);
-    }
-
-    for (size_t j = 0; j < result.size(); ++j) {
-      out_faces.push_back(
-        new carve::mesh::MeshSet<3>::face_t(
-          vloop[result[j].a],
-          vloop[result[j].b],
-          vloop[result[j].c]));
-    }
-  }
-
-  carve::mesh::MeshSet<3> *result = new carve::mesh::MeshSet<3>(out_faces);
-
-  if (options.canonicalize) result->canonicalize();
+  if (options.canonicalize) poly->canonicalize();
 
   if (options.obj) {
-    writeOBJ(std::cout, result);
+    writeOBJ(std::cout, poly);
   } else if (options.vtk) {
-    writeVTK(std::cout, result);
+    writeVTK(std::cout, poly);
   } else {
-    writePLY(std::cout, result, options.ascii);
+    writePLY(std::cout, poly, options.ascii);
   }
 
-  delete result;
   delete poly;
 }
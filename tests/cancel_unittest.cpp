@@ -0,0 +1,97 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#include <gtest/gtest.h>
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/carve.hpp>
+#include <carve/csg.hpp>
+#include <carve/cancel.hpp>
+
+#include "geometry.hpp"
+
+#include <memory>
+
+typedef carve::mesh::MeshSet<3> meshset_t;
+
+struct ProgressRecorder : public carve::csg::CSG::Hook {
+  size_t calls;
+  double last;
+  bool in_range;
+
+  ProgressRecorder() : calls(0), last(0.0), in_range(true) {
+  }
+
+  virtual void progress(const char * /* phase */, double fraction) {
+    ++calls;
+    last = fraction;
+    if (fraction < 0.0 || fraction > 1.0) in_range = false;
+  }
+};
+
+TEST(CancelTest, CancelledTokenAbortsCompute) {
+  std::auto_ptr<meshset_t> a(makeCube(carve::math::Matrix::IDENT()));
+  std::auto_ptr<meshset_t> b(makeCube(carve::math::Matrix::TRANS(0.5, 0.5, 0.5)));
+
+  carve::CancellationToken token;
+  token.cancel();
+
+  carve::csg::CSG csg;
+  csg.hooks.cancellation = &token;
+  ASSERT_THROW(csg.compute(a.get(), b.get(), carve::csg::CSG::UNION), carve::cancelled);
+
+  // inputs are untouched, and the same CSG object is usable again.
+  token.reset();
+  std::auto_ptr<meshset_t> r(csg.compute(a.get(), b.get(), carve::csg::CSG::UNION));
+  ASSERT_TRUE(r.get() != NULL);
+  ASSERT_NEAR(r->meshes[0]->volume(), 8.0 + 8.0 - 1.5 * 1.5 * 1.5, 1e-8);
+}
+
+TEST(CancelTest, ExpiredDeadlineAbortsCompute) {
+  std::auto_ptr<meshset_t> a(makeCube(carve::math::Matrix::IDENT()));
+  std::auto_ptr<meshset_t> b(makeCube(carve::math::Matrix::TRANS(0.5, 0.5, 0.5)));
+
+  carve::CancellationToken token;
+  token.setDeadline(0.0);
+  ASSERT_TRUE(token.isCancelled());
+
+  carve::csg::CSG csg;
+  csg.hooks.cancellation = &token;
+  ASSERT_THROW(csg.compute(a.get(), b.get(), carve::csg::CSG::INTERSECTION), carve::cancelled);
+
+  token.setDeadline(3600.0);
+  ASSERT_FALSE(token.isCancelled());
+  std::auto_ptr<meshset_t> r(csg.compute(a.get(), b.get(), carve::csg::CSG::INTERSECTION));
+  ASSERT_NEAR(r->meshes[0]->volume(), 1.5 * 1.5 * 1.5, 1e-8);
+}
+
+TEST(CancelTest, ProgressIsReported) {
+  std::auto_ptr<meshset_t> a(makeCube(carve::math::Matrix::IDENT()));
+  std::auto_ptr<meshset_t> b(makeCube(carve::math::Matrix::TRANS(0.5, 0.5, 0.5)));
+
+  ProgressRecorder *recorder = new ProgressRecorder;
+  carve::csg::CSG csg;
+  csg.hooks.registerHook(recorder, carve::csg::CSG::Hooks::PROGRESS_BIT);
+
+  std::auto_ptr<meshset_t> r(csg.compute(a.get(), b.get(), carve::csg::CSG::A_MINUS_B));
+  ASSERT_TRUE(r.get() != NULL);
+  ASSERT_GT(recorder->calls, 1U);
+  ASSERT_TRUE(recorder->in_range);
+  ASSERT_EQ(recorder->last, 1.0);
+}
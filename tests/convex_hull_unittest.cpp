@@ -0,0 +1,136 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#include <gtest/gtest.h>
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/carve.hpp>
+#include <carve/convex_hull.hpp>
+#include <carve/executor.hpp>
+
+#include <memory>
+
+typedef carve::mesh::MeshSet<3> meshset_t;
+
+static double rnd() {
+  return random() / double(RAND_MAX) * 2.0 - 1.0;
+}
+
+TEST(ConvexHullTest, Hull2D) {
+  std::vector<carve::geom2d::P2> points;
+  for (int i = 0; i < 1000; ++i) {
+    points.push_back(carve::geom::VECTOR(rnd() * 0.9, rnd() * 0.9));
+  }
+  points.push_back(carve::geom::VECTOR(-1.0, -1.0));
+  points.push_back(carve::geom::VECTOR(+1.0, -1.0));
+  points.push_back(carve::geom::VECTOR(+1.0, +1.0));
+  points.push_back(carve::geom::VECTOR(-1.0, +1.0));
+  // on the boundary, and repeated.
+  points.push_back(carve::geom::VECTOR(0.0, 1.0));
+  points.push_back(carve::geom::VECTOR(1.0, 0.5));
+  points.push_back(carve::geom::VECTOR(1.0, 1.0));
+  points.push_back(carve::geom::VECTOR(-1.0, -1.0));
+
+  std::vector<int> hull = carve::geom::convexHull(points);
+  ASSERT_EQ(hull.size(), 4U);
+  ASSERT_EQ(hull[0], 1002);
+  ASSERT_EQ(hull[1], 1003);
+  ASSERT_EQ(hull[2], 1000);
+  ASSERT_EQ(hull[3], 1001);
+}
+
+TEST(ConvexHullTest, Hull2DDegenerate) {
+  std::vector<carve::geom2d::P2> points;
+  ASSERT_TRUE(carve::geom::convexHull(points).empty());
+
+  for (int i = 0; i < 10; ++i) points.push_back(carve::geom::VECTOR(1.0, 2.0));
+  std::vector<int> hull = carve::geom::convexHull(points);
+  ASSERT_EQ(hull.size(), 1U);
+  ASSERT_EQ(hull[0], 0);
+
+  points.clear();
+  for (int i = 0; i < 10; ++i) points.push_back(carve::geom::VECTOR((double)((i * 7) % 10), 3.0 * ((i * 7) % 10)));
+  hull = carve::geom::convexHull(points);
+  ASSERT_EQ(hull.size(), 2U);
+  ASSERT_TRUE(points[hull[0]] == carve::geom::VECTOR(9.0, 27.0));
+  ASSERT_TRUE(points[hull[1]] == carve::geom::VECTOR(0.0, 0.0));
+}
+
+TEST(ConvexHullTest, Hull3D) {
+  std::vector<carve::geom3d::Vector> points;
+  for (int i = 0; i < 20000; ++i) {
+    points.push_back(carve::geom::VECTOR(rnd(), rnd(), rnd()) * 0.99);
+  }
+  for (int i = 0; i < 8; ++i) {
+    points.push_back(carve::geom::VECTOR(i & 1 ? 1.0 : -1.0, i & 2 ? 1.0 : -1.0, i & 4 ? 1.0 : -1.0));
+  }
+  // on a face of the cube, and repeated.
+  points.push_back(carve::geom::VECTOR(0.5, 0.25, 1.0));
+  points.push_back(carve::geom::VECTOR(1.0, 1.0, 1.0));
+
+  std::auto_ptr<meshset_t> hull(carve::geom3d::convexHull(points));
+  ASSERT_TRUE(hull.get() != NULL);
+  ASSERT_EQ(hull->meshes.size(), 1U);
+  ASSERT_TRUE(hull->isClosed());
+  ASSERT_FALSE(hull->meshes[0]->isNegative());
+  ASSERT_EQ(hull->vertex_storage.size(), 8U);
+  ASSERT_NEAR(hull->meshes[0]->volume(), 8.0, 1e-9);
+  ASSERT_TRUE(hull->meshes[0]->isConvex());
+}
+
+TEST(ConvexHullTest, Hull3DSphere) {
+  std::vector<carve::geom3d::Vector> points;
+  while (points.size() < 10000) {
+    carve::geom3d::Vector v = carve::geom::VECTOR(rnd(), rnd(), rnd());
+    if (v.length2() < 1e-6 || v.length2() > 1.0) continue;
+    points.push_back(v.normalized());
+  }
+
+  std::auto_ptr<meshset_t> hull(carve::geom3d::convexHull(points));
+  ASSERT_TRUE(hull.get() != NULL);
+  ASSERT_TRUE(hull->isClosed());
+  ASSERT_EQ(hull->vertex_storage.size(), points.size());
+  ASSERT_EQ(hull->faceEnd() - hull->faceBegin(), 2 * (int)points.size() - 4);
+  ASSERT_TRUE(hull->meshes[0]->isConvex());
+  ASSERT_NEAR(hull->meshes[0]->volume(), 4.0 / 3.0 * M_PI, 1e-2);
+
+  // the result does not depend on the executor.
+  carve::SerialExecutor serial;
+  std::auto_ptr<meshset_t> serial_hull(carve::geom3d::convexHull(points, &serial));
+  ASSERT_EQ(serial_hull->vertex_storage.size(), hull->vertex_storage.size());
+  for (size_t i = 0; i < hull->vertex_storage.size(); ++i) {
+    ASSERT_TRUE(serial_hull->vertex_storage[i].v == hull->vertex_storage[i].v);
+  }
+}
+
+TEST(ConvexHullTest, Hull3DDegenerate) {
+  std::vector<carve::geom3d::Vector> points;
+  ASSERT_TRUE(carve::geom3d::convexHull(points) == NULL);
+
+  for (int i = 0; i < 100; ++i) {
+    points.push_back(carve::geom::VECTOR(rnd(), rnd(), 0.5));
+  }
+  ASSERT_TRUE(carve::geom3d::convexHull(points) == NULL);
+
+  points.push_back(carve::geom::VECTOR(0.0, 0.0, 0.0));
+  std::auto_ptr<meshset_t> hull(carve::geom3d::convexHull(points));
+  ASSERT_TRUE(hull.get() != NULL);
+  ASSERT_TRUE(hull->isClosed());
+  ASSERT_TRUE(hull->meshes[0]->isConvex());
+}
@@ -0,0 +1,75 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#include <gtest/gtest.h>
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/carve.hpp>
+#include <carve/csg.hpp>
+
+#include "geometry.hpp"
+
+#include <memory>
+#include <algorithm>
+
+typedef carve::mesh::MeshSet<3> meshset_t;
+
+// an ordering-independent description of a result.
+static std::vector<std::vector<carve::geom3d::Vector> > describe(const meshset_t *m) {
+  std::vector<std::vector<carve::geom3d::Vector> > result;
+  std::vector<meshset_t::vertex_t *> verts;
+  for (meshset_t::const_face_iter i = m->faceBegin(); i != m->faceEnd(); ++i) {
+    (*i)->getVertices(verts);
+    std::vector<carve::geom3d::Vector> f;
+    for (size_t j = 0; j < verts.size(); ++j) f.push_back(verts[j]->v);
+    std::sort(f.begin(), f.end());
+    result.push_back(f);
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+TEST(CSGMultiOutputTest, MatchesSeparateComputes) {
+  std::auto_ptr<meshset_t> a(makeCube(carve::math::Matrix::IDENT()));
+  std::auto_ptr<meshset_t> b(makeCube(carve::math::Matrix::TRANS(0.5, 0.3, 0.2) *
+                                      carve::math::Matrix::ROT(0.6, carve::geom::VECTOR(1.0, 0.4, 0.2))));
+
+  std::vector<carve::csg::CSG::OP> ops;
+  ops.push_back(carve::csg::CSG::UNION);
+  ops.push_back(carve::csg::CSG::A_MINUS_B);
+  ops.push_back(carve::csg::CSG::INTERSECTION);
+  ops.push_back(carve::csg::CSG::SYMMETRIC_DIFFERENCE);
+
+  carve::csg::CSG csg;
+  std::vector<meshset_t *> results;
+  std::vector<carve::csg::V2Set> shared_edges;
+  csg.compute(a.get(), b.get(), ops, results, &shared_edges);
+  ASSERT_EQ(results.size(), ops.size());
+  ASSERT_EQ(shared_edges.size(), ops.size());
+
+  for (size_t i = 0; i < ops.size(); ++i) {
+    carve::csg::V2Set expected_edges;
+    std::auto_ptr<meshset_t> expected(csg.compute(a.get(), b.get(), ops[i], &expected_edges));
+    std::auto_ptr<meshset_t> r(results[i]);
+    ASSERT_TRUE(r.get() != NULL);
+    ASSERT_TRUE(describe(r.get()) == describe(expected.get()));
+    ASSERT_EQ(shared_edges[i].size(), expected_edges.size());
+    ASSERT_GT(shared_edges[i].size(), 0U);
+  }
+}
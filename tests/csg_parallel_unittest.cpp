@@ -0,0 +1,160 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#include <gtest/gtest.h>
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/carve.hpp>
+#include <carve/csg.hpp>
+#include <carve/executor.hpp>
+#include <carve/input.hpp>
+
+#include <memory>
+#include <algorithm>
+
+#if defined(_OPENMP)
+#  include <omp.h>
+#endif
+
+typedef carve::mesh::MeshSet<3> meshset_t;
+
+static void addCube(carve::input::PolyhedronData &data, const carve::math::Matrix &t) {
+  int b = data.getVertexCount();
+  data.addVertex(t * carve::geom::VECTOR(+1.0, +1.0, +1.0));
+  data.addVertex(t * carve::geom::VECTOR(-1.0, +1.0, +1.0));
+  data.addVertex(t * carve::geom::VECTOR(-1.0, -1.0, +1.0));
+  data.addVertex(t * carve::geom::VECTOR(+1.0, -1.0, +1.0));
+  data.addVertex(t * carve::geom::VECTOR(+1.0, +1.0, -1.0));
+  data.addVertex(t * carve::geom::VECTOR(-1.0, +1.0, -1.0));
+  data.addVertex(t * carve::geom::VECTOR(-1.0, -1.0, -1.0));
+  data.addVertex(t * carve::geom::VECTOR(+1.0, -1.0, -1.0));
+  data.addFace(b + 0, b + 1, b + 2, b + 3);
+  data.addFace(b + 7, b + 6, b + 5, b + 4);
+  data.addFace(b + 0, b + 4, b + 5, b + 1);
+  data.addFace(b + 1, b + 5, b + 6, b + 2);
+  data.addFace(b + 2, b + 6, b + 7, b + 3);
+  data.addFace(b + 3, b + 7, b + 4, b + 0);
+}
+
+// a grid of small, disjoint cubes.
+static meshset_t *makeLattice(int n) {
+  carve::input::PolyhedronData data;
+  for (int x = 0; x < n; ++x) {
+    for (int y = 0; y < n; ++y) {
+      for (int z = 0; z < n; ++z) {
+        addCube(data,
+                carve::math::Matrix::TRANS(x - (n - 1) / 2.0, y - (n - 1) / 2.0, z - (n - 1) / 2.0) *
+                carve::math::Matrix::SCALE(0.3, 0.3, 0.3));
+      }
+    }
+  }
+  return new meshset_t(data.points, data.getFaceCount(), data.faceIndices);
+}
+
+static meshset_t *makeShell() {
+  carve::input::PolyhedronData data;
+  addCube(data,
+          carve::math::Matrix::ROT(0.4, carve::geom::VECTOR(1.0, 1.0, 0.5)) *
+          carve::math::Matrix::SCALE(2.1, 2.1, 2.1));
+  return new meshset_t(data.points, data.getFaceCount(), data.faceIndices);
+}
+
+// an ordering-independent description of a result: the sorted
+// vertex coordinates of each face, in sorted order.
+static std::vector<std::vector<carve::geom3d::Vector> > describe(const meshset_t *m) {
+  std::vector<std::vector<carve::geom3d::Vector> > result;
+  std::vector<meshset_t::vertex_t *> verts;
+  for (meshset_t::const_face_iter i = m->faceBegin(); i != m->faceEnd(); ++i) {
+    (*i)->getVertices(verts);
+    std::vector<carve::geom3d::Vector> f;
+    for (size_t j = 0; j < verts.size(); ++j) f.push_back(verts[j]->v);
+    std::sort(f.begin(), f.end());
+    result.push_back(f);
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+static meshset_t *compute(meshset_t *a, meshset_t *b, carve::csg::CSG::OP op) {
+  carve::csg::CSG csg;
+  return csg.compute(a, b, op);
+}
+
+TEST(CSGParallelTest, LatticeOnShell) {
+  std::auto_ptr<meshset_t> lattice(makeLattice(5));
+  std::auto_ptr<meshset_t> shell(makeShell());
+
+  std::auto_ptr<meshset_t> r(compute(lattice.get(), shell.get(), carve::csg::CSG::INTERSECTION));
+  ASSERT_TRUE(r.get() != NULL);
+  ASSERT_GT(r->meshes.size(), 0U);
+  for (size_t i = 0; i < r->meshes.size(); ++i) {
+    ASSERT_TRUE(r->meshes[i]->isClosed());
+  }
+
+  // repeated runs produce the same result.
+  std::auto_ptr<meshset_t> r2(compute(lattice.get(), shell.get(), carve::csg::CSG::INTERSECTION));
+  ASSERT_TRUE(describe(r.get()) == describe(r2.get()));
+
+#if defined(_OPENMP)
+  // as does a single threaded run.
+  int n_threads = omp_get_max_threads();
+  omp_set_num_threads(1);
+  std::auto_ptr<meshset_t> serial(compute(lattice.get(), shell.get(), carve::csg::CSG::INTERSECTION));
+  omp_set_num_threads(n_threads);
+  ASSERT_TRUE(describe(r.get()) == describe(serial.get()));
+#endif
+}
+
+TEST(CSGParallelTest, VertexPool) {
+  carve::csg::VertexPool pool;
+  const size_t n = 20000;
+  std::vector<meshset_t::vertex_t *> verts(n);
+  for (size_t i = 0; i < n; ++i) {
+    verts[i] = pool.get(carve::geom::VECTOR((double)i, 0.0, 0.0));
+  }
+
+  std::vector<meshset_t::vertex_t *> sorted(verts);
+  std::sort(sorted.begin(), sorted.end());
+  ASSERT_TRUE(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end());
+  for (size_t i = 0; i < n; ++i) {
+    ASSERT_TRUE(pool.inPool(verts[i]));
+    ASSERT_EQ(verts[i]->v.x, (double)i);
+  }
+
+  std::vector<meshset_t::vertex_t> outside(10);
+  for (size_t i = 0; i < outside.size(); ++i) {
+    ASSERT_FALSE(pool.inPool(&outside[i]));
+  }
+
+  pool.reset();
+  ASSERT_FALSE(pool.inPool(verts[0]));
+  ASSERT_TRUE(pool.inPool(pool.get()));
+}
+
+TEST(CSGParallelTest, VertexPoolStartsSmall) {
+  carve::MemoryAccounting::reset();
+  carve::MemoryAccounting::enable();
+  {
+    carve::csg::VertexPool pool;
+    pool.get();
+    ASSERT_LE(carve::MemoryAccounting::liveBytes(), 16 * 1024);
+  }
+  carve::MemoryAccounting::disable();
+  carve::MemoryAccounting::reset();
+}
@@ -0,0 +1,105 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#include <gtest/gtest.h>
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/carve.hpp>
+#include <carve/csg.hpp>
+#include <carve/executor.hpp>
+
+#include "geometry.hpp"
+
+#include <memory>
+
+typedef carve::mesh::MeshSet<3> meshset_t;
+
+static double volume(const meshset_t *m) {
+  double v = 0.0;
+  for (size_t i = 0; i < m->meshes.size(); ++i) {
+    v += m->meshes[i]->volume();
+  }
+  return v;
+}
+
+TEST(CSGPreviewTest, Boxes) {
+  // offset from the grid, so that the box faces fall between samples.
+  std::auto_ptr<meshset_t> a(makeBox(carve::geom::VECTOR(-1.03, -1.03, -1.03), carve::geom::VECTOR(1.03, 1.03, 1.03)));
+  std::auto_ptr<meshset_t> b(makeBox(carve::geom::VECTOR(0.01, 0.01, 0.01), carve::geom::VECTOR(2.01, 2.01, 2.01)));
+
+  const double va = 2.06 * 2.06 * 2.06;
+  const double vb = 8.0;
+  const double vi = 1.02 * 1.02 * 1.02;
+
+  const carve::csg::CSG::OP ops[] = {
+    carve::csg::CSG::UNION,
+    carve::csg::CSG::INTERSECTION,
+    carve::csg::CSG::A_MINUS_B,
+    carve::csg::CSG::B_MINUS_A,
+    carve::csg::CSG::SYMMETRIC_DIFFERENCE
+  };
+  const double expected[] = { va + vb - vi, vi, va - vi, vb - vi, va + vb - 2 * vi };
+
+  carve::csg::CSG csg;
+  for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); ++i) {
+    std::auto_ptr<meshset_t> result(csg.computePreview(a.get(), b.get(), ops[i], 32));
+    ASSERT_TRUE(result.get() != NULL);
+    ASSERT_TRUE(result->isClosed());
+    for (size_t m = 0; m < result->meshes.size(); ++m) {
+      ASSERT_FALSE(result->meshes[m]->isNegative());
+    }
+    // corners and edges are rounded off, so the volume is a little
+    // smaller than that of the exact result.
+    ASSERT_NEAR(volume(result.get()), expected[i], expected[i] * 0.05);
+  }
+
+  ASSERT_TRUE(csg.computePreview(a.get(), b.get(), carve::csg::CSG::ALL) == NULL);
+}
+
+TEST(CSGPreviewTest, Disjoint) {
+  std::auto_ptr<meshset_t> a(makeBox(carve::geom::VECTOR(0.0, 0.0, 0.0), carve::geom::VECTOR(1.0, 1.0, 1.0)));
+  std::auto_ptr<meshset_t> b(makeBox(carve::geom::VECTOR(3.0, 0.0, 0.0), carve::geom::VECTOR(4.0, 1.0, 1.0)));
+
+  carve::csg::CSG csg;
+  std::auto_ptr<meshset_t> i(csg.computePreview(a.get(), b.get(), carve::csg::CSG::INTERSECTION, 16));
+  ASSERT_EQ(i->meshes.size(), 0U);
+
+  std::auto_ptr<meshset_t> u(csg.computePreview(a.get(), b.get(), carve::csg::CSG::UNION, 32));
+  ASSERT_EQ(u->meshes.size(), 2U);
+  ASSERT_TRUE(u->isClosed());
+}
+
+TEST(CSGPreviewTest, IndependentOfThreads) {
+  std::auto_ptr<meshset_t> a(makeBox(carve::geom::VECTOR(-1.0, -1.0, -1.0), carve::geom::VECTOR(1.0, 1.0, 1.0)));
+  std::auto_ptr<meshset_t> b(makeBox(carve::geom::VECTOR(-0.5, -0.5, -2.0), carve::geom::VECTOR(0.5, 0.5, 2.0)));
+  b->transform(carve::math::Matrix::ROT(0.3, carve::geom::VECTOR(1.0, 1.0, 0.0)));
+
+  carve::csg::CSG csg;
+  std::auto_ptr<meshset_t> parallel(csg.computePreview(a.get(), b.get(), carve::csg::CSG::A_MINUS_B, 24));
+
+  carve::SerialExecutor serial;
+  csg.executor = &serial;
+  std::auto_ptr<meshset_t> serial_result(csg.computePreview(a.get(), b.get(), carve::csg::CSG::A_MINUS_B, 24));
+
+  ASSERT_TRUE(parallel->isClosed());
+  ASSERT_EQ(parallel->vertex_storage.size(), serial_result->vertex_storage.size());
+  for (size_t i = 0; i < parallel->vertex_storage.size(); ++i) {
+    ASSERT_TRUE(parallel->vertex_storage[i].v == serial_result->vertex_storage[i].v);
+  }
+}
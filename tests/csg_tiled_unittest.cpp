@@ -0,0 +1,97 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#include <gtest/gtest.h>
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/carve.hpp>
+#include <carve/csg.hpp>
+#include <carve/csg_tiled.hpp>
+#include <carve/executor.hpp>
+
+#include "geometry.hpp"
+
+#include <memory>
+
+typedef carve::mesh::MeshSet<3> meshset_t;
+
+static double volume(const meshset_t *m) {
+  double v = 0.0;
+  for (size_t i = 0; i < m->meshes.size(); ++i) {
+    v += m->meshes[i]->volume();
+  }
+  return v;
+}
+
+static meshset_t *computeTiled(meshset_t *a,
+                               meshset_t *b,
+                               carve::csg::CSG::OP op,
+                               double tile_size,
+                               carve::Executor *executor = NULL) {
+  carve::geom::aabb<3> bounds(carve::geom::VECTOR(0.0, 0.0, 0.0), carve::geom::VECTOR(2.5, 2.5, 2.5));
+  carve::csg::TiledCSG tiled(bounds, tile_size, ".");
+  tiled.executor = executor;
+  tiled.addMeshSet(carve::csg::TiledCSG::A, a);
+  tiled.addMeshSet(carve::csg::TiledCSG::B, b);
+
+  carve::csg::TiledCSG::MeshSetOutput output;
+  tiled.compute(op, output);
+  return output.createMeshSet();
+}
+
+TEST(TiledCSGTest, Boxes) {
+  std::auto_ptr<meshset_t> a(makeBox(carve::geom::VECTOR(-1.0, -1.0, -1.0), carve::geom::VECTOR(1.0, 1.0, 1.0)));
+  std::auto_ptr<meshset_t> b(makeBox(carve::geom::VECTOR(0.3, 0.2, 0.1), carve::geom::VECTOR(2.2, 2.1, 2.0)));
+
+  const carve::csg::CSG::OP ops[] = {
+    carve::csg::CSG::UNION,
+    carve::csg::CSG::INTERSECTION,
+    carve::csg::CSG::A_MINUS_B,
+    carve::csg::CSG::B_MINUS_A,
+    carve::csg::CSG::SYMMETRIC_DIFFERENCE
+  };
+
+  carve::csg::CSG csg;
+  for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); ++i) {
+    std::auto_ptr<meshset_t> exact(csg.compute(a.get(), b.get(), ops[i]));
+    std::auto_ptr<meshset_t> tiled(computeTiled(a.get(), b.get(), ops[i], 1.0));
+    ASSERT_TRUE(tiled->isClosed());
+    ASSERT_NEAR(volume(tiled.get()), volume(exact.get()), 1e-9);
+  }
+}
+
+TEST(TiledCSGTest, RotatedBox) {
+  std::auto_ptr<meshset_t> a(makeBox(carve::geom::VECTOR(-1.0, -1.0, -1.0), carve::geom::VECTOR(1.0, 1.0, 1.0)));
+  std::auto_ptr<meshset_t> b(makeBox(carve::geom::VECTOR(-0.5, -0.5, -2.0), carve::geom::VECTOR(0.5, 0.5, 2.0)));
+  b->transform(carve::math::Matrix::ROT(0.3, carve::geom::VECTOR(1.0, 1.0, 0.0)));
+
+  carve::csg::CSG csg;
+  std::auto_ptr<meshset_t> exact(csg.compute(a.get(), b.get(), carve::csg::CSG::A_MINUS_B));
+  std::auto_ptr<meshset_t> tiled(computeTiled(a.get(), b.get(), carve::csg::CSG::A_MINUS_B, 0.7));
+
+  ASSERT_TRUE(tiled->isClosed());
+  ASSERT_NEAR(volume(tiled.get()), volume(exact.get()), 1e-9);
+
+  carve::SerialExecutor serial;
+  std::auto_ptr<meshset_t> serial_result(computeTiled(a.get(), b.get(), carve::csg::CSG::A_MINUS_B, 0.7, &serial));
+  ASSERT_EQ(tiled->vertex_storage.size(), serial_result->vertex_storage.size());
+  for (size_t i = 0; i < tiled->vertex_storage.size(); ++i) {
+    ASSERT_TRUE(tiled->vertex_storage[i].v == serial_result->vertex_storage[i].v);
+  }
+}
@@ -0,0 +1,220 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#include <gtest/gtest.h>
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/carve.hpp>
+#include <carve/executor.hpp>
+#include <carve/csg.hpp>
+
+#include "geometry.hpp"
+
+#include <memory>
+#include <algorithm>
+
+typedef carve::mesh::MeshSet<3> meshset_t;
+
+// records the chunks it is given; each chunk writes only its own
+// slots, so this is safe to run concurrently.
+class CoverTask : public carve::ParallelTask {
+public:
+  std::vector<int> hits;
+  std::vector<size_t> chunk_end;
+
+  CoverTask(size_t n) : hits(n, 0), chunk_end(n, 0) {
+  }
+
+  virtual void run(size_t begin, size_t end) {
+    chunk_end[begin] = end;
+    for (size_t i = begin; i < end; ++i) hits[i]++;
+  }
+};
+
+class CountingExecutor : public carve::Executor {
+public:
+  carve::Executor &base;
+  int calls;
+
+  CountingExecutor(carve::Executor &_base) : base(_base), calls(0) {
+  }
+
+  virtual void parallelFor(size_t n, size_t grain, carve::ParallelTask &task) {
+    ++calls;
+    base.parallelFor(n, grain, task);
+  }
+
+  virtual unsigned concurrency() const {
+    return base.concurrency();
+  }
+};
+
+class SetTask : public carve::Task {
+  int &slot;
+  int value;
+
+public:
+  SetTask(int &_slot, int _value) : slot(_slot), value(_value) {
+  }
+
+  virtual void run() {
+    slot = value;
+  }
+};
+
+static void checkCover(carve::Executor &executor, size_t n, size_t grain) {
+  CoverTask task(n);
+  executor.parallelFor(n, grain, task);
+  for (size_t i = 0; i < n; ++i) {
+    ASSERT_EQ(task.hits[i], 1);
+    if (i % grain == 0) {
+      ASSERT_EQ(task.chunk_end[i], std::min(n, i + grain));
+    } else {
+      ASSERT_EQ(task.chunk_end[i], 0U);
+    }
+  }
+}
+
+// an ordering-independent description of a result.
+static std::vector<std::vector<carve::geom3d::Vector> > describe(const meshset_t *m) {
+  std::vector<std::vector<carve::geom3d::Vector> > result;
+  std::vector<meshset_t::vertex_t *> verts;
+  for (meshset_t::const_face_iter i = m->faceBegin(); i != m->faceEnd(); ++i) {
+    (*i)->getVertices(verts);
+    std::vector<carve::geom3d::Vector> f;
+    for (size_t j = 0; j < verts.size(); ++j) f.push_back(verts[j]->v);
+    std::sort(f.begin(), f.end());
+    result.push_back(f);
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+TEST(ExecutorTest, ChunkCoverage) {
+  carve::SerialExecutor serial;
+  carve::OpenMPExecutor omp;
+  carve::OpenMPExecutor omp_one(1);
+  carve::LimitedExecutor limited(omp, 2);
+  carve::LimitedExecutor limited_serial(serial, 3);
+
+  ASSERT_EQ(serial.concurrency(), 1U);
+  ASSERT_EQ(omp_one.concurrency(), 1U);
+  ASSERT_LE(limited.concurrency(), 2U);
+  ASSERT_EQ(limited_serial.concurrency(), 1U);
+
+  carve::Executor *executors[] = { &serial, &omp, &omp_one, &limited, &limited_serial };
+  for (size_t i = 0; i < sizeof(executors) / sizeof(executors[0]); ++i) {
+    checkCover(*executors[i], 0, 4);
+    checkCover(*executors[i], 1, 4);
+    checkCover(*executors[i], 100, 1);
+    checkCover(*executors[i], 1000, 7);
+    checkCover(*executors[i], 1024, 256);
+  }
+
+  // the free function only involves the executor for more than one
+  // chunk.
+  CountingExecutor counting(serial);
+  CoverTask task(10);
+  carve::parallelFor(counting, 3, 4, task);
+  ASSERT_EQ(counting.calls, 0);
+  carve::parallelFor(counting, 10, 4, task);
+  ASSERT_EQ(counting.calls, 1);
+  ASSERT_EQ(task.hits[0], 2);
+  ASSERT_EQ(task.hits[9], 1);
+}
+
+TEST(ExecutorTest, TaskGroup) {
+  carve::LimitedExecutor limited(carve::defaultExecutor(), 2);
+  std::vector<int> slots(50, 0);
+  std::vector<SetTask *> tasks;
+
+  carve::TaskGroup group(limited);
+  for (size_t i = 0; i < slots.size(); ++i) {
+    tasks.push_back(new SetTask(slots[i], (int)i + 1));
+    group.add(tasks.back());
+  }
+  group.wait();
+
+  for (size_t i = 0; i < slots.size(); ++i) {
+    ASSERT_EQ(slots[i], (int)i + 1);
+    delete tasks[i];
+  }
+
+  // a group may be reused once it has been waited on.
+  group.wait();
+}
+
+TEST(ExecutorTest, CSGUsesExecutor) {
+  std::auto_ptr<meshset_t> a(makeCube(carve::math::Matrix::IDENT()));
+  std::auto_ptr<meshset_t> b(makeCube(carve::math::Matrix::TRANS(0.5, 0.3, 0.2) *
+                                      carve::math::Matrix::ROT(0.6, carve::geom::VECTOR(1.0, 0.4, 0.2))));
+
+  carve::csg::CSG csg;
+  std::auto_ptr<meshset_t> expected(csg.compute(a.get(), b.get(), carve::csg::CSG::UNION));
+
+  carve::SerialExecutor serial;
+  CountingExecutor counting(serial);
+  csg.executor = &counting;
+  std::auto_ptr<meshset_t> result(csg.compute(a.get(), b.get(), carve::csg::CSG::UNION));
+
+  ASSERT_TRUE(describe(result.get()) == describe(expected.get()));
+  ASSERT_TRUE(result->isClosed());
+
+  // an installed default executor is used by CSG instances without
+  // their own.
+  CountingExecutor counting_default(serial);
+  carve::setDefaultExecutor(&counting_default);
+  carve::csg::CSG csg2;
+  std::auto_ptr<meshset_t> result2(csg2.compute(a.get(), b.get(), carve::csg::CSG::UNION));
+  carve::setDefaultExecutor(NULL);
+
+  ASSERT_TRUE(describe(result2.get()) == describe(expected.get()));
+  ASSERT_EQ(&carve::defaultExecutor() == &counting_default, false);
+}
+
+TEST(ExecutorTest, MeshSetUsesExecutor) {
+  // enough disjoint triangles that vertex and face loops are split.
+  const size_t n = 5000;
+  std::vector<carve::geom3d::Vector> points;
+  std::vector<int> faces;
+  for (size_t i = 0; i < n; ++i) {
+    const double x = (double)i;
+    points.push_back(carve::geom::VECTOR(x, 0.0, 0.0));
+    points.push_back(carve::geom::VECTOR(x + 0.5, 0.0, 0.0));
+    points.push_back(carve::geom::VECTOR(x, 1.0, 0.0));
+    faces.push_back(3);
+    for (int j = 0; j < 3; ++j) faces.push_back((int)(3 * i) + j);
+  }
+  std::auto_ptr<meshset_t> m(new meshset_t(points, n, faces));
+
+  carve::SerialExecutor serial;
+  CountingExecutor counting(serial);
+  m->transform(carve::math::Matrix::TRANS(1.0, 2.0, 3.0), &counting);
+  ASSERT_EQ(counting.calls, 2);
+  ASSERT_EQ(m->vertex_storage[0].v.z, 3.0);
+
+  counting.calls = 0;
+  m->collectVertices(&counting);
+  ASSERT_TRUE(counting.calls > 0);
+  ASSERT_EQ(m->vertex_storage.size(), 3 * n);
+
+  counting.calls = 0;
+  m->separateMeshes(&counting);
+  ASSERT_TRUE(counting.calls > 0);
+}
@@ -25,6 +25,12 @@
 #include <carve/geom2d.hpp>
 #include <carve/geom3d.hpp>
 #include <carve/matrix.hpp>
+#include <carve/aabb.hpp>
+#include <carve/rtree.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
 
 using namespace carve::geom;
 using namespace carve::geom3d;
@@ -175,3 +181,86 @@ TEST(GeomTest, Geom3D) {
   }
 }
 
+TEST(GeomTest, AABBBatch) {
+  using namespace carve::geom3d;
+
+  boost::uniform_real<double> coord(-1.0, 1.0);
+  boost::variate_generator<boost::mt19937 &, boost::uniform_real<double> > rand(rng, coord);
+
+  // sizes that leave the last block of four full, partial and empty.
+  const size_t sizes[] = { 0, 1, 3, 4, 5, 8, 103 };
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    AABBBatch batch;
+    std::vector<AABB> boxes;
+    for (size_t i = 0; i < sizes[s]; ++i) {
+      Vector ext = VECTOR(fabs(rand()), fabs(rand()), fabs(rand())) * 0.25;
+      boxes.push_back(AABB(VECTOR(rand(), rand(), rand()), ext));
+      batch.push_back(boxes.back());
+    }
+    ASSERT_EQ(batch.size(), boxes.size());
+
+    for (size_t i = 0; i < boxes.size(); ++i) {
+      ASSERT_TRUE(batch[i] == boxes[i]);
+    }
+
+    for (size_t q = 0; q < 50; ++q) {
+      AABB query(VECTOR(rand(), rand(), rand()), VECTOR(fabs(rand()), fabs(rand()), fabs(rand())) * 0.5);
+      double tolerance = (q & 1) ? 0.0 : 0.1;
+
+      std::vector<size_t> expected(1, 12345), result(1, 12345);
+      for (size_t i = 0; i < boxes.size(); ++i) {
+        if (boxes[i].maxAxisSeparation(query) <= tolerance) expected.push_back(i);
+      }
+      ASSERT_EQ(batch.intersects(query, result, tolerance), expected.size() - 1);
+      ASSERT_TRUE(result == expected);
+
+      ASSERT_EQ(batch.blockCount(), (boxes.size() + 3) / 4);
+      for (size_t i = 0; i < boxes.size(); ++i) {
+        bool hit = (batch.blockMask(i / 4, query, tolerance) >> (i % 4)) & 1;
+        ASSERT_EQ(hit, boxes[i].maxAxisSeparation(query) <= tolerance);
+      }
+    }
+  }
+
+  // touching boxes intersect; separated ones do not.
+  AABBBatch batch;
+  batch.push_back(AABB(VECTOR(0, 0, 0), VECTOR(1, 1, 1)));
+  batch.push_back(AABB(VECTOR(3, 0, 0), VECTOR(1, 1, 1)));
+  std::vector<size_t> hits;
+  ASSERT_EQ(batch.intersects(AABB(VECTOR(1.5, 0, 0), VECTOR(0.5, 0.5, 0.5)), hits), 2U);
+  hits.clear();
+  ASSERT_EQ(batch.intersects(AABB(VECTOR(0, 3, 0), VECTOR(0.5, 0.5, 0.5)), hits), 0U);
+}
+
+TEST(GeomTest, RTreeBoxSearch) {
+  using namespace carve::geom3d;
+  typedef carve::geom::RTreeNode<3, const AABB *> rtree_t;
+
+  boost::uniform_real<double> coord(-1.0, 1.0);
+  boost::variate_generator<boost::mt19937 &, boost::uniform_real<double> > rand(rng, coord);
+
+  std::vector<AABB> boxes;
+  for (size_t i = 0; i < 1000; ++i) {
+    boxes.push_back(AABB(VECTOR(rand(), rand(), rand()), VECTOR(fabs(rand()), fabs(rand()), fabs(rand())) * 0.05));
+  }
+  std::vector<const AABB *> ptrs;
+  for (size_t i = 0; i < boxes.size(); ++i) ptrs.push_back(&boxes[i]);
+
+  std::auto_ptr<rtree_t> rtree(rtree_t::construct_STR(ptrs.begin(), ptrs.end(), 4, 4));
+
+  // searching by box uses the batched child test. It returns whole
+  // leaves, so it must find every box that a brute force scan finds.
+  for (size_t q = 0; q < 100; ++q) {
+    AABB query(VECTOR(rand(), rand(), rand()), VECTOR(fabs(rand()), fabs(rand()), fabs(rand())) * 0.25);
+    std::vector<const AABB *> result, found, expected;
+    rtree->search(query, std::back_inserter(result));
+    for (size_t i = 0; i < result.size(); ++i) {
+      if (result[i]->intersects(query)) found.push_back(result[i]);
+    }
+    for (size_t i = 0; i < boxes.size(); ++i) {
+      if (boxes[i].intersects(query)) expected.push_back(&boxes[i]);
+    }
+    std::sort(found.begin(), found.end());
+    ASSERT_TRUE(found == expected);
+  }
+}
@@ -0,0 +1,93 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#include <gtest/gtest.h>
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/carve.hpp>
+#include <carve/csg.hpp>
+#include <carve/polyline.hpp>
+
+#include "geometry.hpp"
+
+#include <memory>
+
+typedef carve::mesh::MeshSet<3> meshset_t;
+
+static double length(const carve::line::Polyline *line) {
+  double len = 0.0;
+  for (size_t i = 0; i < line->edgeCount(); ++i) {
+    const carve::line::PolylineEdge *e = line->edge(i);
+    len += (e->v2->v - e->v1->v).length();
+  }
+  return len;
+}
+
+static bool onSurface(const meshset_t *m, const carve::geom3d::Vector &p) {
+  for (meshset_t::const_face_iter i = m->faceBegin(); i != m->faceEnd(); ++i) {
+    if (std::fabs(carve::geom::distance((*i)->plane, p)) < 1e-9 && (*i)->containsPointInProjection(p)) return true;
+  }
+  return false;
+}
+
+TEST(IntersectionCurvesTest, SlabThroughCube) {
+  // a thin slab crossing the cube meets it in two square loops.
+  std::auto_ptr<meshset_t> a(makeCube(carve::math::Matrix::IDENT()));
+  std::auto_ptr<meshset_t> b(makeCube(carve::math::Matrix::SCALE(2.0, 2.0, 0.25)));
+
+  carve::csg::CSG csg;
+  std::auto_ptr<carve::line::PolylineSet> curves(csg.intersectionCurves(a.get(), b.get()));
+  ASSERT_EQ(curves->lines.size(), 2U);
+  for (carve::line::PolylineSet::const_line_iter i = curves->lines.begin(); i != curves->lines.end(); ++i) {
+    ASSERT_TRUE((*i)->isClosed());
+    ASSERT_NEAR(length(*i), 8.0, 1e-9);
+    for (size_t j = 0; j < (*i)->vertexCount(); ++j) {
+      ASSERT_NEAR(std::fabs((*i)->vertex(j)->v.z), 0.25, 1e-9);
+    }
+  }
+}
+
+TEST(IntersectionCurvesTest, RotatedCubes) {
+  std::auto_ptr<meshset_t> a(makeCube(carve::math::Matrix::IDENT()));
+  std::auto_ptr<meshset_t> b(makeCube(carve::math::Matrix::TRANS(0.5, 0.3, 0.2) *
+                                      carve::math::Matrix::ROT(0.6, carve::geom::VECTOR(1.0, 0.4, 0.2))));
+
+  carve::csg::CSG csg;
+  std::auto_ptr<carve::line::PolylineSet> curves(csg.intersectionCurves(a.get(), b.get()));
+  ASSERT_GT(curves->lines.size(), 0U);
+
+  // every curve point lies on the surface of both cubes.
+  for (size_t i = 0; i < curves->vertices.size(); ++i) {
+    const carve::geom3d::Vector &p = curves->vertices[i].v;
+    ASSERT_TRUE(onSurface(a.get(), p));
+    ASSERT_TRUE(onSurface(b.get(), p));
+  }
+
+  // the curves are closed, and repeated calls give the same result.
+  std::auto_ptr<carve::line::PolylineSet> again(csg.intersectionCurves(a.get(), b.get()));
+  ASSERT_EQ(again->vertices.size(), curves->vertices.size());
+  ASSERT_EQ(again->lines.size(), curves->lines.size());
+  for (carve::line::PolylineSet::const_line_iter i = curves->lines.begin(), j = again->lines.begin(); i != curves->lines.end(); ++i, ++j) {
+    ASSERT_TRUE((*i)->isClosed());
+    ASSERT_EQ((*i)->vertexCount(), (*j)->vertexCount());
+  }
+  for (size_t i = 0; i < curves->vertices.size(); ++i) {
+    ASSERT_TRUE(curves->vertices[i].v == again->vertices[i].v);
+  }
+}
@@ -0,0 +1,199 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#include <gtest/gtest.h>
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/carve.hpp>
+#include <carve/poly.hpp>
+#include <carve/input.hpp>
+#include <carve/linear_octree.hpp>
+
+#include <algorithm>
+
+#include BOOST_INCLUDE(random.hpp)
+
+typedef carve::csg::LinearOctree octree_t;
+
+static boost::mt19937 rng(42);
+static boost::uniform_real<double> unit(0.0, 1.0);
+static boost::variate_generator<boost::mt19937 &, boost::uniform_real<double> > gen(rng, unit);
+
+static carve::geom3d::Vector randomPoint(double scale) {
+  return carve::geom::VECTOR(gen() * scale, gen() * scale, gen() * scale);
+}
+
+template<typename T>
+static void sortPtrs(std::vector<T> &v) {
+  std::sort(v.begin(), v.end());
+}
+
+TEST(LinearOctreeTest, RadixSort) {
+  std::vector<uint32_t> keys, values;
+  for (uint32_t i = 0; i < 100000; ++i) {
+    keys.push_back((uint32_t)(gen() * (1U << 30)) & ~0xffU);
+    values.push_back(i);
+  }
+  std::vector<std::pair<uint32_t, uint32_t> > pairs;
+  for (size_t i = 0; i < keys.size(); ++i) pairs.push_back(std::make_pair(keys[i], values[i]));
+  std::stable_sort(pairs.begin(), pairs.end());
+
+  octree_t::radixSort(keys, values);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    ASSERT_EQ(keys[i], pairs[i].first);
+    ASSERT_EQ(values[i], pairs[i].second);
+  }
+}
+
+TEST(LinearOctreeTest, VerticesNear) {
+  std::vector<carve::poly::Vertex<3> > vertices;
+  for (int i = 0; i < 5000; ++i) {
+    vertices.push_back(carve::poly::Vertex<3>(randomPoint(10.0)));
+  }
+  std::vector<const carve::poly::Vertex<3> *> vptrs;
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    vptrs.push_back(&vertices[i]);
+    if (i % 10 == 0) vptrs.push_back(&vertices[i]);
+  }
+
+  octree_t octree;
+  octree.addVertices(vptrs);
+  octree.build();
+
+  for (size_t i = 0; i < vertices.size(); i += 7) {
+    std::vector<const carve::poly::Vertex<3> *> out, ref;
+    octree.findVerticesNearAllowDupes(vertices[i].v, 0.5, out);
+    carve::geom3d::AABB box(vertices[i].v, carve::geom::VECTOR(0.5, 0.5, 0.5));
+    for (size_t j = 0; j < vptrs.size(); ++j) {
+      if (box.containsPoint(vptrs[j]->v)) ref.push_back(vptrs[j]);
+    }
+    sortPtrs(out);
+    sortPtrs(ref);
+    ASSERT_TRUE(out == ref);
+
+    out.clear();
+    octree.findVerticesNearAllowDupes(vertices[i].v, out);
+    ASSERT_EQ(std::count(out.begin(), out.end(), &vertices[i]), i % 10 == 0 ? 2 : 1);
+  }
+}
+
+TEST(LinearOctreeTest, PointsNear) {
+  std::vector<carve::geom3d::Vector> points;
+  for (int i = 0; i < 5000; ++i) {
+    points.push_back(randomPoint(10.0));
+    if (i % 10 == 0) points.push_back(points.back());
+  }
+
+  octree_t octree;
+  octree.addPoints(points);
+  octree.build();
+  ASSERT_EQ(octree.points.items.size(), points.size());
+
+  for (size_t i = 0; i < points.size(); i += 7) {
+    std::vector<const carve::geom3d::Vector *> out;
+    std::vector<size_t> found, ref;
+    octree.findPointsNearAllowDupes(points[i], 0.5, out);
+    for (size_t j = 0; j < out.size(); ++j) found.push_back(out[j] - &points[0]);
+    carve::geom3d::AABB box(points[i], carve::geom::VECTOR(0.5, 0.5, 0.5));
+    for (size_t j = 0; j < points.size(); ++j) {
+      if (box.containsPoint(points[j])) ref.push_back(j);
+    }
+    std::sort(found.begin(), found.end());
+    ASSERT_TRUE(found == ref);
+
+    out.clear();
+    octree.findPointsNearAllowDupes(points[i], out);
+    ASSERT_EQ(std::count(out.begin(), out.end(), &points[i]), 1);
+  }
+}
+
+TEST(LinearOctreeTest, EdgesNear) {
+  std::vector<carve::poly::Vertex<3> > vertices;
+  for (int i = 0; i < 6000; ++i) {
+    vertices.push_back(carve::poly::Vertex<3>(randomPoint(10.0)));
+  }
+  std::vector<carve::poly::Edge<3> > edges;
+  for (size_t i = 0; i + 1 < vertices.size(); i += 2) {
+    vertices[i + 1].v = vertices[i].v + randomPoint(1.0);
+    edges.push_back(carve::poly::Edge<3>(&vertices[i], &vertices[i + 1], NULL));
+  }
+
+  octree_t octree;
+  octree.addEdges(edges);
+  octree.build();
+  ASSERT_EQ(octree.edges.items.size(), edges.size());
+
+  for (int q = 0; q < 100; ++q) {
+    carve::geom3d::AABB box(randomPoint(10.0), randomPoint(1.0));
+    carve::geom3d::LineSegment line(randomPoint(10.0), randomPoint(10.0));
+
+    std::vector<const carve::poly::Edge<3> *> out_box, ref_box, out_line, ref_line;
+    octree.findEdgesNear(box, out_box);
+    octree.findEdgesNear(line, out_line);
+
+    for (size_t j = 0; j < edges.size(); ++j) {
+      carve::geom3d::AABB e_box;
+      e_box.fit(edges[j].v1->v, edges[j].v2->v);
+      e_box.expand(carve::EPSILON);
+      if (e_box.intersects(box)) ref_box.push_back(&edges[j]);
+      if (e_box.intersectsLineSegment(line.v1, line.v2)) ref_line.push_back(&edges[j]);
+    }
+
+    sortPtrs(out_box); sortPtrs(ref_box);
+    sortPtrs(out_line); sortPtrs(ref_line);
+    ASSERT_TRUE(out_box == ref_box);
+    ASSERT_TRUE(out_line == ref_line);
+  }
+}
+
+TEST(LinearOctreeTest, PolyhedronFacesNear) {
+  carve::input::PolyhedronData data;
+  data.addVertex(carve::geom::VECTOR(+1.0, +1.0, +1.0));
+  data.addVertex(carve::geom::VECTOR(-1.0, +1.0, +1.0));
+  data.addVertex(carve::geom::VECTOR(-1.0, -1.0, +1.0));
+  data.addVertex(carve::geom::VECTOR(+1.0, -1.0, +1.0));
+  data.addVertex(carve::geom::VECTOR(+1.0, +1.0, -1.0));
+  data.addVertex(carve::geom::VECTOR(-1.0, +1.0, -1.0));
+  data.addVertex(carve::geom::VECTOR(-1.0, -1.0, -1.0));
+  data.addVertex(carve::geom::VECTOR(+1.0, -1.0, -1.0));
+  data.addFace(0, 1, 2, 3);
+  data.addFace(7, 6, 5, 4);
+  data.addFace(0, 4, 5, 1);
+  data.addFace(1, 5, 6, 2);
+  data.addFace(2, 6, 7, 3);
+  data.addFace(3, 7, 4, 0);
+
+  carve::poly::Polyhedron poly(data.points, data.getFaceCount(), data.faceIndices);
+
+  std::vector<const carve::poly::Face<3> *> faces;
+  poly.findFacesNear(carve::geom3d::LineSegment(carve::geom::VECTOR(0.1, 0.2, -5.0),
+                                                carve::geom::VECTOR(0.1, 0.2, +5.0)), faces);
+  sortPtrs(faces);
+  ASSERT_EQ(faces.size(), 2U);
+  ASSERT_TRUE(std::binary_search(faces.begin(), faces.end(), &poly.faces[0]));
+  ASSERT_TRUE(std::binary_search(faces.begin(), faces.end(), &poly.faces[1]));
+
+  ASSERT_EQ(poly.containsVertex(carve::geom::VECTOR(0.1, 0.2, 0.3)), carve::POINT_IN);
+  ASSERT_EQ(poly.containsVertex(carve::geom::VECTOR(2.0, 0.2, 0.3)), carve::POINT_OUT);
+  ASSERT_EQ(poly.containsVertex(carve::geom::VECTOR(1.0, 0.2, 0.3)), carve::POINT_ON);
+
+  std::vector<const carve::poly::Edge<3> *> edges;
+  poly.findEdgesNear(poly.faces[0], edges);
+  ASSERT_GE(edges.size(), 4U);
+}
@@ -0,0 +1,139 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#include <gtest/gtest.h>
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/carve.hpp>
+#include <carve/csg.hpp>
+#include <carve/timing.hpp>
+#include <carve/memory_accounting.hpp>
+
+#include "geometry.hpp"
+
+#include <memory>
+
+typedef carve::mesh::MeshSet<3> meshset_t;
+
+TEST(MemoryAccountingTest, DisabledByDefault) {
+  carve::MemoryAccounting::reset();
+  ASSERT_FALSE(carve::MemoryAccounting::enabled());
+
+  static carve::TimingName PHASE("MemoryAccountingTest - disabled");
+  {
+    carve::TimingBlock block(PHASE);
+    std::vector<int, carve::tracking_allocator<int> > v(1000);
+  }
+  std::vector<carve::MemoryAccounting::Record> records;
+  carve::MemoryAccounting::records(records);
+  ASSERT_EQ(records.size(), 0U);
+  ASSERT_EQ(carve::MemoryAccounting::peakBytes(), 0);
+}
+
+TEST(MemoryAccountingTest, NestedPhases) {
+  carve::MemoryAccounting::reset();
+  carve::MemoryAccounting::enable();
+
+  static carve::TimingName OUTER("MemoryAccountingTest - outer");
+  static carve::TimingName INNER("MemoryAccountingTest - inner");
+  {
+    carve::TimingBlock outer(OUTER);
+    std::vector<char, carve::tracking_allocator<char> > a(1000);
+    {
+      carve::TimingBlock inner(INNER);
+      std::vector<char, carve::tracking_allocator<char> > b(4000);
+    }
+    std::vector<char, carve::tracking_allocator<char> > c(2000);
+  }
+  carve::MemoryAccounting::disable();
+
+  carve::MemoryAccounting::Record outer = carve::MemoryAccounting::record("MemoryAccountingTest - outer");
+  carve::MemoryAccounting::Record inner = carve::MemoryAccounting::record("MemoryAccountingTest - inner");
+
+  ASSERT_EQ(outer.n_calls, 1U);
+  ASSERT_EQ(outer.n_allocs, 2U);
+  ASSERT_EQ(outer.bytes_allocated, 3000U);
+  ASSERT_EQ(outer.peak_growth, 5000U);
+
+  ASSERT_EQ(inner.n_allocs, 1U);
+  ASSERT_EQ(inner.bytes_released, 4000U);
+  ASSERT_EQ(inner.peak_growth, 4000U);
+  ASSERT_EQ(inner.peak_live, 5000U);
+
+  ASSERT_EQ(carve::MemoryAccounting::liveBytes(), 0);
+  ASSERT_EQ(carve::MemoryAccounting::peakBytes(), 5000);
+
+  std::vector<carve::MemoryAccounting::Record> records;
+  carve::MemoryAccounting::records(records);
+  ASSERT_EQ(records.size(), 2U);
+  ASSERT_EQ(records[0].peak_growth, 5000U);
+}
+
+TEST(MemoryAccountingTest, InterleavedPhases) {
+  carve::MemoryAccounting::reset();
+  carve::MemoryAccounting::enable();
+
+  // phases of two threads that open and close out of order.
+  static int a_key, b_key;
+  {
+    std::auto_ptr<carve::MemoryPhase> a(new carve::MemoryPhase(&a_key, "MemoryAccountingTest - a"));
+    carve::MemoryPhase b(&b_key, "MemoryAccountingTest - b");
+    a.reset();
+    std::vector<char, carve::tracking_allocator<char> > v(1000);
+  }
+  carve::MemoryAccounting::disable();
+
+  ASSERT_EQ(carve::MemoryAccounting::record("MemoryAccountingTest - a").bytes_allocated, 0U);
+  ASSERT_EQ(carve::MemoryAccounting::record("MemoryAccountingTest - b").bytes_allocated, 1000U);
+}
+
+TEST(MemoryAccountingTest, ComputePhases) {
+  carve::MemoryAccounting::reset();
+  carve::MemoryAccounting::enable();
+  {
+    std::auto_ptr<meshset_t> a(makeCube(carve::math::Matrix::IDENT()));
+    std::auto_ptr<meshset_t> b(makeCube(carve::math::Matrix::ROT(0.3, 1.0, 1.0, 1.0) *
+                                        carve::math::Matrix::TRANS(0.5, 0.5, 0.5)));
+    carve::csg::CSG csg;
+    std::auto_ptr<meshset_t> r(csg.compute(a.get(), b.get(), carve::csg::CSG::UNION));
+    ASSERT_TRUE(r.get() != NULL);
+  }
+  carve::MemoryAccounting::disable();
+
+  carve::MemoryAccounting::Record compute = carve::MemoryAccounting::record("CSG::compute");
+  ASSERT_EQ(compute.n_calls, 1U);
+  ASSERT_GT(compute.peak_growth, 0U);
+
+  const char *phases[] = {
+    "CSG::compute - calc()",
+    "CSG::generateIntersections()",
+    "CSG::generateFaceLoops()",
+    "CSG::compute - classify()"
+  };
+  for (size_t i = 0; i < sizeof(phases) / sizeof(phases[0]); ++i) {
+    carve::MemoryAccounting::Record r = carve::MemoryAccounting::record(phases[i]);
+    ASSERT_GT(r.n_calls, 0U) << phases[i];
+    ASSERT_GT(r.peak_growth, 0U) << phases[i];
+    ASSERT_LE(r.peak_growth, compute.peak_growth) << phases[i];
+  }
+
+  // everything tracked during the computation is released with the
+  // CSG object.
+  ASSERT_EQ(carve::MemoryAccounting::liveBytes(), 0);
+}
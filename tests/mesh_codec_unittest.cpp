@@ -0,0 +1,157 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#include <gtest/gtest.h>
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/carve.hpp>
+#include <carve/mesh_codec.hpp>
+#include <carve/input.hpp>
+
+#include "geometry.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <sstream>
+
+typedef carve::mesh::MeshSet<3> meshset_t;
+
+// A torus of n x m quads, triangulated, with irregular coordinates.
+static meshset_t *makeTorus(unsigned n, unsigned m) {
+  carve::input::PolyhedronData data;
+  for (unsigned i = 0; i < n; ++i) {
+    double a = 2.0 * M_PI * i / n;
+    for (unsigned j = 0; j < m; ++j) {
+      double b = 2.0 * M_PI * j / m;
+      double r = 3.0 + cos(b);
+      data.addVertex(carve::geom::VECTOR(r * cos(a), r * sin(a), sin(b)));
+    }
+  }
+  for (unsigned i = 0; i < n; ++i) {
+    for (unsigned j = 0; j < m; ++j) {
+      int v00 = i * m + j, v01 = i * m + (j + 1) % m;
+      int v10 = ((i + 1) % n) * m + j, v11 = ((i + 1) % n) * m + (j + 1) % m;
+      data.addFace(v00, v10, v11);
+      data.addFace(v00, v11, v01);
+    }
+  }
+  return new meshset_t(data.points, data.getFaceCount(), data.faceIndices);
+}
+
+// The faces of a MeshSet as sorted lists of vertex positions, each
+// starting at its smallest vertex.
+static std::vector<std::vector<carve::geom3d::Vector> > faceList(const meshset_t *m) {
+  std::vector<std::vector<carve::geom3d::Vector> > result;
+  for (meshset_t::const_face_iter i = m->faceBegin(); i != m->faceEnd(); ++i) {
+    std::vector<carve::geom3d::Vector> f;
+    const meshset_t::edge_t *e = (*i)->edge;
+    do {
+      f.push_back(e->vert->v);
+      e = e->next;
+    } while (e != (*i)->edge);
+    std::rotate(f.begin(), std::min_element(f.begin(), f.end()), f.end());
+    result.push_back(f);
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+TEST(MeshCodecTest, Lossless) {
+  std::auto_ptr<meshset_t> torus(makeTorus(40, 24));
+
+  std::stringstream stream;
+  carve::mesh::writeCompressed(stream, torus.get());
+  std::auto_ptr<meshset_t> decoded(carve::mesh::readCompressed(stream));
+
+  ASSERT_EQ(decoded->meshes.size(), 1U);
+  ASSERT_TRUE(decoded->isClosed());
+  ASSERT_EQ(decoded->vertex_storage.size(), torus->vertex_storage.size());
+  ASSERT_TRUE(faceList(decoded.get()) == faceList(torus.get()));
+
+  // 24 bytes per vertex and 13 per triangle as binary PLY.
+  size_t raw = torus->vertex_storage.size() * 24 + 40 * 24 * 2 * 13;
+  ASSERT_LT(stream.str().size() * 2, raw);
+}
+
+TEST(MeshCodecTest, Quantised) {
+  std::auto_ptr<meshset_t> torus(makeTorus(40, 24));
+  const double quantum = 1e-4;
+
+  std::stringstream stream;
+  carve::mesh::writeCompressed(stream, torus.get(), quantum);
+  std::auto_ptr<meshset_t> decoded(carve::mesh::readCompressed(stream));
+
+  ASSERT_TRUE(decoded->isClosed());
+  ASSERT_EQ(decoded->vertex_storage.size(), torus->vertex_storage.size());
+  ASSERT_NEAR(decoded->meshes[0]->volume(), torus->meshes[0]->volume(), 1e-2);
+
+  size_t raw = torus->vertex_storage.size() * 24 + 40 * 24 * 2 * 13;
+  ASSERT_LT(stream.str().size() * 5, raw);
+
+  // every decoded vertex is within half a quantum of an original.
+  std::vector<carve::geom3d::Vector> original;
+  for (size_t i = 0; i < torus->vertex_storage.size(); ++i) original.push_back(torus->vertex_storage[i].v);
+  for (size_t i = 0; i < decoded->vertex_storage.size(); ++i) {
+    const carve::geom3d::Vector &v = decoded->vertex_storage[i].v;
+    double best = 1e30;
+    for (size_t j = 0; j < original.size(); ++j) {
+      const carve::geom3d::Vector &o = original[j];
+      best = std::min(best, std::max(fabs(v.x - o.x), std::max(fabs(v.y - o.y), fabs(v.z - o.z))));
+    }
+    ASSERT_LE(best, quantum * 0.5 + 1e-12);
+  }
+}
+
+TEST(MeshCodecTest, Sequence) {
+  std::auto_ptr<meshset_t> a(makeBox(carve::geom::VECTOR(-1.0, -1.0, -1.0), carve::geom::VECTOR(1.0, 1.0, 1.0)));
+  std::auto_ptr<meshset_t> b(makeTorus(8, 6));
+
+  std::stringstream stream;
+  carve::mesh::writeCompressed(stream, a.get());
+  carve::mesh::writeCompressed(stream, b.get(), 1e-3);
+
+  std::auto_ptr<meshset_t> a2(carve::mesh::readCompressed(stream));
+  std::auto_ptr<meshset_t> b2(carve::mesh::readCompressed(stream));
+  ASSERT_TRUE(faceList(a2.get()) == faceList(a.get()));
+  ASSERT_EQ(b2->faceEnd() - b2->faceBegin(), b->faceEnd() - b->faceBegin());
+
+  std::stringstream bad("CVMC not really a mesh");
+  ASSERT_THROW(carve::mesh::readCompressed(bad), carve::exception);
+}
+
+TEST(MeshCodecTest, CorruptHeader) {
+  std::auto_ptr<meshset_t> a(makeBox(carve::geom::VECTOR(-1.0, -1.0, -1.0), carve::geom::VECTOR(1.0, 1.0, 1.0)));
+  std::stringstream stream;
+  carve::mesh::writeCompressed(stream, a.get());
+  const std::string good = stream.str();
+
+  // the vertex and face counts follow the magic number, version and
+  // flags, as little endian 64 bit values.
+  for (size_t field = 0; field < 2; ++field) {
+    const size_t counts[] = { 1U << 20, ~(size_t)0 };
+    for (size_t c = 0; c < 2; ++c) {
+      std::string data = good;
+      for (size_t i = 0; i < 8; ++i) {
+        data[6 + field * 8 + i] = (char)(unsigned char)((uint64_t)counts[c] >> (i * 8));
+      }
+      std::stringstream bad(data);
+      ASSERT_THROW(carve::mesh::readCompressed(bad), carve::exception);
+    }
+  }
+}
@@ -0,0 +1,175 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#include <gtest/gtest.h>
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/carve.hpp>
+#include <carve/mesh.hpp>
+#include <carve/mesh_raycast.hpp>
+#include <carve/executor.hpp>
+#include <carve/input.hpp>
+
+#include <memory>
+#include <limits>
+
+#include BOOST_INCLUDE(random.hpp)
+
+typedef carve::mesh::MeshSet<3> meshset_t;
+typedef carve::mesh::RayCaster::ray_t ray_t;
+
+static boost::mt19937 rng(42);
+static boost::uniform_real<double> unit(0.0, 1.0);
+static boost::variate_generator<boost::mt19937 &, boost::uniform_real<double> > gen(rng, unit);
+
+static carve::geom3d::Vector randomPoint(double scale) {
+  return carve::geom::VECTOR(gen() * scale, gen() * scale, gen() * scale);
+}
+
+static void addCube(carve::input::PolyhedronData &data, const carve::math::Matrix &t) {
+  int b = data.getVertexCount();
+  data.addVertex(t * carve::geom::VECTOR(+1.0, +1.0, +1.0));
+  data.addVertex(t * carve::geom::VECTOR(-1.0, +1.0, +1.0));
+  data.addVertex(t * carve::geom::VECTOR(-1.0, -1.0, +1.0));
+  data.addVertex(t * carve::geom::VECTOR(+1.0, -1.0, +1.0));
+  data.addVertex(t * carve::geom::VECTOR(+1.0, +1.0, -1.0));
+  data.addVertex(t * carve::geom::VECTOR(-1.0, +1.0, -1.0));
+  data.addVertex(t * carve::geom::VECTOR(-1.0, -1.0, -1.0));
+  data.addVertex(t * carve::geom::VECTOR(+1.0, -1.0, -1.0));
+  data.addFace(b + 0, b + 1, b + 2, b + 3);
+  data.addFace(b + 7, b + 6, b + 5, b + 4);
+  data.addFace(b + 0, b + 4, b + 5, b + 1);
+  data.addFace(b + 1, b + 5, b + 6, b + 2);
+  data.addFace(b + 2, b + 6, b + 7, b + 3);
+  data.addFace(b + 3, b + 7, b + 4, b + 0);
+}
+
+static meshset_t *makeScene() {
+  carve::input::PolyhedronData data;
+  addCube(data, carve::math::Matrix::IDENT());
+  for (int i = 0; i < 20; ++i) {
+    addCube(data,
+            carve::math::Matrix::TRANS(randomPoint(20.0) - carve::geom::VECTOR(10, 10, 10)) *
+            carve::math::Matrix::ROT(gen() * 3.0, randomPoint(1.0) + carve::geom::VECTOR(0.1, 0, 0)) *
+            carve::math::Matrix::SCALE(0.5, 0.5, 0.5));
+  }
+  return new meshset_t(data.points, data.getFaceCount(), data.faceIndices);
+}
+
+static ray_t randomRay() {
+  carve::geom3d::Vector d;
+  do { d = randomPoint(2.0) - carve::geom::VECTOR(1, 1, 1); } while (d.length2() < 1e-3 || d.length2() > 1.0);
+  return ray_t(d.normalized(), randomPoint(24.0) - carve::geom::VECTOR(12, 12, 12));
+}
+
+// all face hits along the ray, by brute force.
+static void bruteHits(const meshset_t *m, const ray_t &ray, std::vector<std::pair<double, const carve::mesh::Face<3> *> > &out) {
+  out.clear();
+  carve::geom::linesegment<3> seg(ray.v, ray.v + ray.D * 100.0);
+  for (meshset_t::const_face_iter i = m->faceBegin(); i != m->faceEnd(); ++i) {
+    carve::geom3d::Vector p;
+    if ((*i)->lineSegmentIntersection(seg, p) != carve::INTERSECT_NONE) {
+      out.push_back(std::make_pair(carve::geom::dot(p - ray.v, ray.D), *i));
+    }
+  }
+  std::sort(out.begin(), out.end());
+}
+
+TEST(MeshRayCastTest, AxisRays) {
+  carve::input::PolyhedronData data;
+  addCube(data, carve::math::Matrix::IDENT());
+  std::auto_ptr<meshset_t> cube(new meshset_t(data.points, data.getFaceCount(), data.faceIndices));
+  carve::mesh::RayCaster caster(cube.get());
+  ASSERT_EQ(caster.triangleCount(), 12U);
+
+  carve::mesh::RayHit hit;
+  ASSERT_TRUE(caster.firstHit(ray_t(carve::geom::VECTOR(1, 0, 0), carve::geom::VECTOR(-5, 0.25, 0.5)), hit));
+  ASSERT_NEAR(hit.t, 4.0, 1e-12);
+  carve::geom3d::Vector p =
+    (1.0 - hit.u - hit.v) * hit.vertex[0]->v + hit.u * hit.vertex[1]->v + hit.v * hit.vertex[2]->v;
+  ASSERT_NEAR((p - carve::geom::VECTOR(-1, 0.25, 0.5)).length(), 0.0, 1e-12);
+  ASSERT_TRUE(std::fabs(hit.face->plane.N.x) > 0.99);
+
+  // t_max limits the search, and misses are reported.
+  ASSERT_FALSE(caster.firstHit(ray_t(carve::geom::VECTOR(1, 0, 0), carve::geom::VECTOR(-5, 0.25, 0.5)), hit, 3.5));
+  ASSERT_FALSE(hit.isHit());
+  ASSERT_FALSE(caster.firstHit(ray_t(carve::geom::VECTOR(-1, 0, 0), carve::geom::VECTOR(-5, 0.25, 0.5)), hit));
+
+  // from the inside, a ray leaves through exactly one face.
+  std::vector<ray_t> rays;
+  rays.push_back(ray_t(carve::geom::VECTOR(0, 0, 1), carve::geom::VECTOR(0.1, 0.2, 0.3)));
+  rays.push_back(ray_t(carve::geom::VECTOR(0, 1, 0), carve::geom::VECTOR(0, 0, -5)));
+  rays.push_back(ray_t(carve::geom::VECTOR(0, 0, 1), carve::geom::VECTOR(0, 0, -5)));
+  std::vector<size_t> offsets;
+  std::vector<carve::mesh::RayHit> hits;
+  caster.allHits(rays, offsets, hits);
+  ASSERT_EQ(offsets[1] - offsets[0], 1U);
+  ASSERT_EQ(offsets[2] - offsets[1], 0U);
+  // through the centre of two faces, crossing triangulation diagonals.
+  ASSERT_EQ(offsets[3] - offsets[2], 2U);
+  ASSERT_NEAR(hits[offsets[2]].t, 4.0, 1e-12);
+  ASSERT_NEAR(hits[offsets[2] + 1].t, 6.0, 1e-12);
+}
+
+TEST(MeshRayCastTest, MatchesBruteForce) {
+  std::auto_ptr<meshset_t> scene(makeScene());
+  carve::mesh::RayCaster caster(scene.get());
+
+  std::vector<ray_t> rays;
+  for (size_t i = 0; i < 2000; ++i) rays.push_back(randomRay());
+
+  std::vector<carve::mesh::RayHit> first;
+  caster.firstHits(rays, first);
+  ASSERT_EQ(first.size(), rays.size());
+
+  std::vector<size_t> offsets;
+  std::vector<carve::mesh::RayHit> all;
+  caster.allHits(rays, offsets, all);
+  ASSERT_EQ(offsets.size(), rays.size() + 1);
+  ASSERT_EQ(offsets.back(), all.size());
+
+  size_t n_hit = 0;
+  std::vector<std::pair<double, const carve::mesh::Face<3> *> > expected;
+  for (size_t i = 0; i < rays.size(); ++i) {
+    bruteHits(scene.get(), rays[i], expected);
+    ASSERT_EQ(offsets[i + 1] - offsets[i], expected.size());
+    ASSERT_EQ(first[i].isHit(), !expected.empty());
+    if (expected.empty()) continue;
+    ++n_hit;
+    ASSERT_NEAR(first[i].t, expected[0].first, 1e-9);
+    for (size_t j = 0; j < expected.size(); ++j) {
+      ASSERT_NEAR(all[offsets[i] + j].t, expected[j].first, 1e-9);
+    }
+    carve::mesh::RayHit single;
+    ASSERT_TRUE(caster.firstHit(rays[i], single));
+    ASSERT_EQ(single.face, first[i].face);
+  }
+  ASSERT_GT(n_hit, 0U);
+
+  // the result does not depend on the executor.
+  carve::SerialExecutor serial;
+  carve::mesh::RayCaster serial_caster(scene.get(), &serial);
+  std::vector<carve::mesh::RayHit> serial_first;
+  serial_caster.firstHits(rays, serial_first);
+  ASSERT_EQ(serial_first.size(), first.size());
+  for (size_t i = 0; i < first.size(); ++i) {
+    ASSERT_EQ(serial_first[i].face, first[i].face);
+    ASSERT_EQ(serial_first[i].t, first[i].t);
+  }
+}
@@ -0,0 +1,114 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#include <gtest/gtest.h>
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/carve.hpp>
+#include <carve/csg.hpp>
+#include <carve/input.hpp>
+#include <carve/executor.hpp>
+#include <carve/mesh_simplify.hpp>
+#include <carve/mesh_triangulate.hpp>
+
+#include "geometry.hpp"
+
+#include <map>
+#include <memory>
+
+typedef carve::mesh::MeshSet<3> meshset_t;
+
+// the unit cube, with each side split into n x n pairs of triangles.
+static meshset_t *makeTessellatedCube(int n) {
+  carve::input::PolyhedronData data;
+  std::map<carve::geom3d::Vector, int> index;
+
+  for (int axis = 0; axis < 3; ++axis) {
+    for (int side = 0; side < 2; ++side) {
+      int u = (axis + 1) % 3, v = (axis + 2) % 3;
+      if (side == 0) std::swap(u, v);
+      std::vector<int> grid;
+      for (int i = 0; i <= n; ++i) {
+        for (int j = 0; j <= n; ++j) {
+          carve::geom3d::Vector p;
+          p.v[axis] = side;
+          p.v[u] = (double)i / n;
+          p.v[v] = (double)j / n;
+          std::map<carve::geom3d::Vector, int>::iterator k = index.find(p);
+          if (k == index.end()) k = index.insert(std::make_pair(p, data.addVertex(p))).first;
+          grid.push_back((*k).second);
+        }
+      }
+      for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+          int a = grid[i * (n + 1) + j], b = grid[(i + 1) * (n + 1) + j];
+          int c = grid[(i + 1) * (n + 1) + j + 1], d = grid[i * (n + 1) + j + 1];
+          data.addFace(a, b, c);
+          data.addFace(a, c, d);
+        }
+      }
+    }
+  }
+  return new meshset_t(data.points, data.getFaceCount(), data.faceIndices);
+}
+
+static double volume(const meshset_t *m) {
+  double v = 0.0;
+  for (size_t i = 0; i < m->meshes.size(); ++i) {
+    v += m->meshes[i]->volume();
+  }
+  return v;
+}
+
+TEST(MeshSimplifyTest, CoplanarRegions) {
+  std::auto_ptr<meshset_t> cube(makeTessellatedCube(20));
+  ASSERT_TRUE(cube->isClosed());
+  ASSERT_NEAR(volume(cube.get()), 1.0, 1e-9);
+
+  carve::mesh::MeshSimplifier simplifier;
+  size_t n_removed = simplifier.mergeCoplanarRegions(cube.get(), 1e-3);
+
+  ASSERT_EQ(n_removed, 6U * 20U * 20U * 2U - 6U);
+  ASSERT_EQ(cube->meshes[0]->faces.size(), 6U);
+  ASSERT_TRUE(cube->isClosed());
+  ASSERT_NEAR(volume(cube.get()), 1.0, 1e-9);
+}
+
+TEST(MeshSimplifyTest, CoplanarRegionsWithHoles) {
+  // a box with a square tunnel through it, triangulated, so that its
+  // top and bottom are regions with holes.
+  std::auto_ptr<meshset_t> a(makeBox(carve::geom::VECTOR(-1.0, -1.0, -1.0), carve::geom::VECTOR(1.0, 1.0, 1.0)));
+  std::auto_ptr<meshset_t> b(makeBox(carve::geom::VECTOR(-0.3, -0.4, -2.0), carve::geom::VECTOR(0.5, 0.2, 2.0)));
+  carve::csg::CSG csg;
+  std::auto_ptr<meshset_t> r(csg.compute(a.get(), b.get(), carve::csg::CSG::A_MINUS_B));
+  carve::mesh::triangulateFaces(r.get());
+  double v = volume(r.get());
+
+  std::auto_ptr<meshset_t> pairwise(r->clone());
+  carve::mesh::MeshSimplifier simplifier;
+  simplifier.mergeCoplanarFaces(pairwise.get(), 1e-3);
+
+  carve::SerialExecutor serial;
+  simplifier.mergeCoplanarRegions(r.get(), 1e-3, &serial);
+
+  ASSERT_TRUE(r->isClosed());
+  ASSERT_NEAR(volume(r.get()), v, 1e-9);
+  ASSERT_EQ(r->meshes[0]->faces.size(), pairwise->meshes[0]->faces.size());
+  ASSERT_EQ(r->meshes[0]->faces.size(), 10U);
+}
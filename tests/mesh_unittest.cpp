@@ -27,6 +27,8 @@
 #include "write_ply.hpp"
 
 #include <vector>
+#include <memory>
+#include <set>
 
 void dumpMeshes(carve::mesh::MeshSet<3> *meshes) {
   std::cout << "*** meshes->meshes.size()=" << meshes->meshes.size() << std::endl;
@@ -343,3 +345,301 @@ TEST(MeshTest, MeshConstruction1) {
   dumpMeshes(mesh);
   delete mesh;
 }
+
+static void checkStructure(carve::mesh::MeshSet<3> *mesh) {
+  const carve::mesh::Vertex<3> *base = &mesh->vertex_storage[0];
+  for (size_t m = 0; m < mesh->meshes.size(); ++m) {
+    carve::mesh::Mesh<3> *sub = mesh->meshes[m];
+    ASSERT_EQ(sub->meshset, mesh);
+    for (size_t f = 0; f < sub->faces.size(); ++f) {
+      carve::mesh::Face<3> *face = sub->faces[f];
+      ASSERT_EQ(face->mesh, sub);
+      carve::mesh::Edge<3> *e = face->edge;
+      do {
+        ASSERT_EQ(e->face, face);
+        ASSERT_TRUE(e->vert >= base && e->vert < base + mesh->vertex_storage.size());
+        if (e->rev) {
+          ASSERT_EQ(e->rev->rev, e);
+          ASSERT_EQ(e->rev->vert, e->next->vert);
+          ASSERT_EQ(e->rev->face->mesh, sub);
+        }
+        e = e->next;
+      } while (e != face->edge);
+    }
+  }
+}
+
+TEST(MeshTest, Reorder) {
+  std::vector<carve::mesh::Vertex<3> > vertices;
+  std::vector<carve::mesh::Face<3> *> faces;
+  obj2(vertices, faces);
+  std::vector<carve::mesh::Mesh<3> *> meshes;
+  carve::mesh::Mesh<3>::create(faces.begin(), faces.end(), meshes, carve::mesh::MeshOptions());
+  carve::mesh::MeshSet<3> *mesh = new carve::mesh::MeshSet<3>(vertices, meshes);
+
+  std::vector<size_t> n_faces, n_open, n_closed;
+  std::vector<double> volume;
+  for (size_t m = 0; m < mesh->meshes.size(); ++m) {
+    n_faces.push_back(mesh->meshes[m]->faces.size());
+    n_open.push_back(mesh->meshes[m]->open_edges.size());
+    n_closed.push_back(mesh->meshes[m]->closed_edges.size());
+    volume.push_back(mesh->meshes[m]->volume());
+  }
+
+  mesh->reorder();
+  checkStructure(mesh);
+
+  ASSERT_EQ(mesh->meshes.size(), n_faces.size());
+  for (size_t m = 0; m < mesh->meshes.size(); ++m) {
+    ASSERT_EQ(mesh->meshes[m]->faces.size(), n_faces[m]);
+    ASSERT_EQ(mesh->meshes[m]->open_edges.size(), n_open[m]);
+    ASSERT_EQ(mesh->meshes[m]->closed_edges.size(), n_closed[m]);
+    ASSERT_NEAR(mesh->meshes[m]->volume(), volume[m], 1e-9);
+  }
+
+  // reordering is idempotent.
+  std::vector<carve::geom3d::Vector> order;
+  for (size_t i = 0; i < mesh->vertex_storage.size(); ++i) order.push_back(mesh->vertex_storage[i].v);
+  mesh->reorder();
+  checkStructure(mesh);
+  for (size_t i = 0; i < mesh->vertex_storage.size(); ++i) {
+    ASSERT_TRUE(mesh->vertex_storage[i].v == order[i]);
+  }
+
+  // with keep_faces, face pointers stay valid.
+  std::set<carve::mesh::Face<3> *> before, after;
+  for (carve::mesh::MeshSet<3>::face_iter i = mesh->faceBegin(); i != mesh->faceEnd(); ++i) before.insert(*i);
+  mesh->reorder(true);
+  checkStructure(mesh);
+  for (carve::mesh::MeshSet<3>::face_iter i = mesh->faceBegin(); i != mesh->faceEnd(); ++i) after.insert(*i);
+  ASSERT_TRUE(before == after);
+
+  delete mesh;
+
+  // applied on construction when requested.
+  std::vector<carve::geom3d::Vector> points;
+  std::vector<int> face_indices;
+  for (size_t i = 0; i < order.size(); ++i) points.push_back(order[order.size() - 1 - i]);
+  face_indices.push_back(3);
+  face_indices.push_back(0);
+  face_indices.push_back(1);
+  face_indices.push_back(2);
+  carve::mesh::MeshSet<3> *tri = new carve::mesh::MeshSet<3>(points, 1, face_indices, carve::mesh::MeshOptions().reorder(true));
+  checkStructure(tri);
+  ASSERT_EQ(tri->vertex_storage.size(), points.size());
+  for (size_t i = 0; i < tri->vertex_storage.size(); ++i) {
+    ASSERT_TRUE(tri->vertex_storage[i].v == order[i]);
+  }
+  delete tri;
+}
+
+// a functor that is not a matrix_transformation, so that transform()
+// takes the general, refitting path.
+struct apply_matrix {
+  carve::math::Matrix m;
+  apply_matrix(const carve::math::Matrix &_m) : m(_m) {}
+  carve::geom::vector<3> operator()(const carve::geom::vector<3> &v) const { return m * v; }
+};
+
+TEST(MeshTest, AffineTransform) {
+  carve::math::Matrix transforms[] = {
+    carve::math::Matrix::TRANS(1.0, -2.0, 0.5) * carve::math::Matrix::ROT(0.7, carve::geom::VECTOR(1.0, 2.0, 3.0)),
+    carve::math::Matrix::SCALE(2.0, 0.5, 3.0) * carve::math::Matrix::ROT(1.1, carve::geom::VECTOR(0.0, 1.0, 1.0)),
+    carve::math::Matrix::SCALE(-1.0, 1.0, 1.0) * carve::math::Matrix::TRANS(0.3, 0.2, 0.1)
+  };
+
+  for (size_t t = 0; t < sizeof(transforms) / sizeof(transforms[0]); ++t) {
+    std::vector<carve::mesh::Vertex<3> > vertices;
+    std::vector<carve::mesh::Face<3> *> faces;
+    obj2(vertices, faces);
+    std::vector<carve::mesh::Mesh<3> *> meshes;
+    carve::mesh::Mesh<3>::create(faces.begin(), faces.end(), meshes, carve::mesh::MeshOptions());
+    std::auto_ptr<carve::mesh::MeshSet<3> > fast(new carve::mesh::MeshSet<3>(vertices, meshes));
+    std::auto_ptr<carve::mesh::MeshSet<3> > slow(fast->clone());
+
+    fast->transform(carve::math::matrix_transformation(transforms[t]));
+    slow->transform(apply_matrix(transforms[t]));
+    checkStructure(fast.get());
+
+    ASSERT_EQ(fast->vertex_storage.size(), slow->vertex_storage.size());
+    for (size_t i = 0; i < fast->vertex_storage.size(); ++i) {
+      ASSERT_TRUE(fast->vertex_storage[i].v == slow->vertex_storage[i].v);
+    }
+    for (size_t m = 0; m < fast->meshes.size(); ++m) {
+      ASSERT_EQ(fast->meshes[m]->isNegative(), slow->meshes[m]->isNegative());
+    }
+
+    carve::mesh::MeshSet<3>::face_iter i = fast->faceBegin(), j = slow->faceBegin();
+    for (; i != fast->faceEnd(); ++i, ++j) {
+      ASSERT_NEAR(((*i)->plane.N - (*j)->plane.N).length(), 0.0, 1e-9);
+      ASSERT_NEAR((*i)->plane.d, (*j)->plane.d, 1e-9);
+      ASSERT_TRUE((*i)->project == (*j)->project);
+    }
+  }
+}
+
+TEST(MeshTest, CollectAndSeparateVertices) {
+  std::vector<carve::mesh::Vertex<3> > vertices;
+  std::vector<carve::mesh::Face<3> *> faces;
+  obj2(vertices, faces);
+  std::vector<carve::mesh::Mesh<3> *> meshes;
+  carve::mesh::Mesh<3>::create(faces.begin(), faces.end(), meshes, carve::mesh::MeshOptions());
+  std::auto_ptr<carve::mesh::MeshSet<3> > mesh(new carve::mesh::MeshSet<3>(vertices, meshes));
+
+  std::set<const carve::mesh::Vertex<3> *> used;
+  std::vector<std::set<const carve::mesh::Vertex<3> *> > used_by_mesh(mesh->meshes.size());
+  std::vector<double> volume;
+  for (size_t m = 0; m < mesh->meshes.size(); ++m) {
+    volume.push_back(mesh->meshes[m]->volume());
+    for (size_t f = 0; f < mesh->meshes[m]->faces.size(); ++f) {
+      carve::mesh::Edge<3> *e = mesh->meshes[m]->faces[f]->edge;
+      do {
+        used.insert(e->vert);
+        used_by_mesh[m].insert(e->vert);
+        e = e->next;
+      } while (e != mesh->meshes[m]->faces[f]->edge);
+    }
+  }
+  size_t n_separate = 0;
+  for (size_t m = 0; m < used_by_mesh.size(); ++m) n_separate += used_by_mesh[m].size();
+
+  mesh->collectVertices();
+  checkStructure(mesh.get());
+  ASSERT_EQ(mesh->vertex_storage.size(), used.size());
+
+  mesh->separateMeshes();
+  checkStructure(mesh.get());
+  ASSERT_EQ(mesh->vertex_storage.size(), n_separate);
+
+  // no vertex is shared between meshes.
+  std::vector<size_t> owner(mesh->vertex_storage.size(), mesh->meshes.size());
+  for (size_t m = 0; m < mesh->meshes.size(); ++m) {
+    ASSERT_NEAR(mesh->meshes[m]->volume(), volume[m], 1e-9);
+    for (size_t f = 0; f < mesh->meshes[m]->faces.size(); ++f) {
+      carve::mesh::Edge<3> *e = mesh->meshes[m]->faces[f]->edge;
+      do {
+        size_t i = (size_t)(e->vert - &mesh->vertex_storage[0]);
+        ASSERT_TRUE(owner[i] == mesh->meshes.size() || owner[i] == m);
+        owner[i] = m;
+        e = e->next;
+      } while (e != mesh->meshes[m]->faces[f]->edge);
+    }
+  }
+}
+
+TEST(MeshTest, ConstructFromFacesAndMeshes) {
+  std::vector<carve::mesh::Vertex<3> > vertices;
+  std::vector<carve::mesh::Face<3> *> faces;
+  obj2(vertices, faces);
+  std::set<const carve::mesh::Vertex<3> *> used;
+  for (size_t f = 0; f < faces.size(); ++f) {
+    carve::mesh::Edge<3> *e = faces[f]->edge;
+    do {
+      used.insert(e->vert);
+      e = e->next;
+    } while (e != faces[f]->edge);
+  }
+
+  carve::SerialExecutor serial;
+  std::auto_ptr<carve::mesh::MeshSet<3> > from_faces(
+      new carve::mesh::MeshSet<3>(faces, carve::mesh::MeshOptions().executor(&serial)));
+  checkStructure(from_faces.get());
+  ASSERT_EQ(from_faces->vertex_storage.size(), used.size());
+  ASSERT_TRUE(from_faces->isClosed());
+
+  // the vertices of each face keep their positions.
+  for (carve::mesh::MeshSet<3>::face_iter i = from_faces->faceBegin(); i != from_faces->faceEnd(); ++i) {
+    ASSERT_NEAR(carve::geom::distance((*i)->plane, (*i)->edge->vert->v), 0.0, 1e-9);
+  }
+
+  std::vector<carve::mesh::Mesh<3> *> meshes;
+  for (size_t m = 0; m < from_faces->meshes.size(); ++m) {
+    meshes.push_back(from_faces->meshes[m]->clone(&from_faces->vertex_storage[0], &from_faces->vertex_storage[0]));
+    meshes.back()->meshset = NULL;
+  }
+  std::auto_ptr<carve::mesh::MeshSet<3> > from_meshes(new carve::mesh::MeshSet<3>(meshes, &serial));
+  checkStructure(from_meshes.get());
+  ASSERT_EQ(from_meshes->vertex_storage.size(), used.size());
+  for (size_t m = 0; m < from_meshes->meshes.size(); ++m) {
+    ASSERT_NEAR(from_meshes->meshes[m]->volume(), from_faces->meshes[m]->volume(), 1e-9);
+  }
+}
+
+struct move_vertex {
+  carve::geom::vector<3> from, to;
+  move_vertex(const carve::geom::vector<3> &_from, const carve::geom::vector<3> &_to) : from(_from), to(_to) {}
+  carve::geom::vector<3> operator()(const carve::geom::vector<3> &v) const { return v == from ? to : v; }
+};
+
+TEST(MeshTest, CachedProperties) {
+  // a triangular bipyramid.
+  const double s = sqrt(3.0) / 2.0;
+  const carve::geom::vector<3> vec[] = {
+    carve::geom::VECTOR(0.0, 0.0, +1.0),
+    carve::geom::VECTOR(0.0, 0.0, -1.0),
+    carve::geom::VECTOR(1.0, 0.0, 0.0),
+    carve::geom::VECTOR(-0.5, +s, 0.0),
+    carve::geom::VECTOR(-0.5, -s, 0.0)
+  };
+  const size_t f_idx[] = {
+    3, 0, 2, 3,
+    3, 0, 3, 4,
+    3, 0, 4, 2,
+    3, 1, 3, 2,
+    3, 1, 4, 3,
+    3, 1, 2, 4,
+    0
+  };
+  const double area = 3.0 * sqrt(3.0) / 4.0;
+
+  std::vector<carve::mesh::Vertex<3> > vertices;
+  std::vector<carve::mesh::Face<3> *> faces;
+  make(vec, 5, f_idx, vertices, faces);
+  std::auto_ptr<carve::mesh::MeshSet<3> > mesh(new carve::mesh::MeshSet<3>(faces));
+  ASSERT_EQ(mesh->meshes.size(), 1U);
+  carve::mesh::Mesh<3> *m = mesh->meshes[0];
+
+  ASSERT_NEAR(m->volume(), area * 2.0 / 3.0, 1e-9);
+  ASSERT_TRUE(m->isConvex());
+  ASSERT_NEAR(mesh->getAABB().max().z, 1.0, 1e-12);
+
+  // transform() refits the faces and drops the cached properties.
+  mesh->transform(move_vertex(vec[0], carve::geom::VECTOR(0.0, 0.0, -0.5)));
+  ASSERT_NEAR(m->volume(), area * 0.5 / 3.0, 1e-9);
+  ASSERT_FALSE(m->isConvex());
+  ASSERT_NEAR(mesh->getAABB().max().z, 0.0, 1e-12);
+
+  mesh->transform(carve::math::Matrix::SCALE(2.0, 2.0, 2.0));
+  ASSERT_NEAR(m->volume(), area * 4.0 / 3.0, 1e-9);
+  ASSERT_NEAR(mesh->getAABB().min().z, -2.0, 1e-12);
+
+  // vertices moved directly need an explicit invalidate().
+  for (size_t i = 0; i < mesh->vertex_storage.size(); ++i) {
+    if (mesh->vertex_storage[i].v.z == -1.0) mesh->vertex_storage[i].v.z = 2.0;
+  }
+  mesh->invalidate();
+  ASSERT_NEAR(m->volume(), area * 16.0 / 3.0, 1e-9);
+  ASSERT_NEAR(mesh->getAABB().max().z, 2.0, 1e-12);
+  for (carve::mesh::MeshSet<3>::face_iter i = mesh->faceBegin(); i != mesh->faceEnd(); ++i) {
+    carve::geom::aabb<3> box;
+    box.fit((*i)->begin(), (*i)->end(), carve::mesh::Face<3>::vector_mapping());
+    ASSERT_TRUE((*i)->getAABB().pos == box.pos && (*i)->getAABB().extent == box.extent);
+  }
+
+  // a face box filled by getAABB() is kept until the next invalidate().
+  carve::mesh::Face<3> *f = *mesh->faceBegin();
+  f->invalidate();
+  const carve::geom::aabb<3> filled = f->getAABB();
+  const carve::geom::vector<3> old = f->edge->vert->v;
+  f->edge->vert->v.x += 10.0;
+  ASSERT_TRUE(f->getAABB().pos == filled.pos && f->getAABB().extent == filled.extent);
+  f->invalidate();
+  ASSERT_FALSE(f->getAABB().pos == filled.pos);
+  f->edge->vert->v = old;
+  mesh->invalidate();
+
+  m->invert();
+  ASSERT_TRUE(m->isNegative());
+  ASSERT_EQ(m->volume(), 0.0);
+  ASSERT_FALSE(m->isConvex());
+}
@@ -0,0 +1,161 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#include <gtest/gtest.h>
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/carve.hpp>
+#include <carve/pointset.hpp>
+#include <carve/pointset_kdtree.hpp>
+#include <carve/executor.hpp>
+
+#include <algorithm>
+
+#include BOOST_INCLUDE(random.hpp)
+
+static boost::mt19937 rng(42);
+static boost::uniform_real<double> unit(0.0, 1.0);
+static boost::variate_generator<boost::mt19937 &, boost::uniform_real<double> > gen(rng, unit);
+
+static carve::geom3d::Vector randomPoint(double scale) {
+  return carve::geom::VECTOR(gen() * scale, gen() * scale, gen() * scale);
+}
+
+static void bruteNearest(const std::vector<carve::geom3d::Vector> &points,
+                         const carve::geom3d::Vector &p,
+                         size_t k,
+                         std::vector<size_t> &out) {
+  std::vector<std::pair<double, size_t> > d;
+  for (size_t i = 0; i < points.size(); ++i) {
+    d.push_back(std::make_pair((points[i] - p).length2(), i));
+  }
+  std::sort(d.begin(), d.end());
+  out.clear();
+  for (size_t i = 0; i < std::min(k, d.size()); ++i) out.push_back(d[i].second);
+}
+
+static void bruteRadius(const std::vector<carve::geom3d::Vector> &points,
+                        const carve::geom3d::Vector &p,
+                        double r,
+                        std::vector<size_t> &out) {
+  out.clear();
+  for (size_t i = 0; i < points.size(); ++i) {
+    if ((points[i] - p).length2() <= r * r) out.push_back(i);
+  }
+}
+
+TEST(PointSetKdTreeTest, Structure) {
+  std::vector<carve::geom3d::Vector> points;
+  for (size_t i = 0; i < 1000; ++i) points.push_back(randomPoint(1.0));
+  carve::point::KdTree tree(points);
+
+  const std::vector<carve::point::KdTree::Node> &nodes = tree.getNodes();
+  ASSERT_EQ(nodes.size(), carve::point::KdTree::nodeCount(points.size()));
+
+  size_t n_leaf_points = 0;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    if (nodes[i].isLeaf()) {
+      ASSERT_LE(nodes[i].end - nodes[i].begin, (uint32_t)carve::point::KdTree::LEAF_SIZE);
+      n_leaf_points += nodes[i].end - nodes[i].begin;
+    } else {
+      ASSERT_EQ(nodes[i + 1].begin, nodes[i].begin);
+      ASSERT_EQ(nodes[nodes[i].right].end, nodes[i].end);
+    }
+  }
+  ASSERT_EQ(n_leaf_points, points.size());
+
+  carve::point::KdTree empty((std::vector<carve::geom3d::Vector>()));
+  std::vector<size_t> idx;
+  empty.nearest(carve::geom::VECTOR(0, 0, 0), 3, idx);
+  ASSERT_EQ(idx.size(), 0U);
+}
+
+TEST(PointSetKdTreeTest, NearestMatchesBruteForce) {
+  std::vector<carve::geom3d::Vector> points;
+  for (size_t i = 0; i < 5000; ++i) points.push_back(randomPoint(10.0));
+  // duplicates and points on split planes.
+  for (size_t i = 0; i < 100; ++i) points.push_back(points[i * 7]);
+  carve::point::PointSet pointset(points);
+  carve::point::KdTree tree(pointset);
+
+  std::vector<carve::geom3d::Vector> queries;
+  for (size_t i = 0; i < 1000; ++i) queries.push_back(randomPoint(12.0) - carve::geom::VECTOR(1, 1, 1));
+
+  const size_t k = 7;
+  std::vector<size_t> idx;
+  std::vector<double> dist2;
+  ASSERT_EQ(tree.nearest(queries, k, idx, &dist2), k);
+  ASSERT_EQ(idx.size(), queries.size() * k);
+
+  std::vector<size_t> expected, single;
+  for (size_t q = 0; q < queries.size(); ++q) {
+    bruteNearest(points, queries[q], k, expected);
+    std::vector<size_t> got(idx.begin() + q * k, idx.begin() + (q + 1) * k);
+    ASSERT_TRUE(got == expected);
+    for (size_t i = 0; i < k; ++i) {
+      ASSERT_EQ(dist2[q * k + i], (points[got[i]] - queries[q]).length2());
+    }
+    tree.nearest(queries[q], k, single);
+    ASSERT_TRUE(single == expected);
+  }
+
+  // the result does not depend on the executor.
+  carve::SerialExecutor serial;
+  carve::point::KdTree serial_tree(pointset, &serial);
+  std::vector<size_t> serial_idx;
+  ASSERT_EQ(serial_tree.nearest(queries, k, serial_idx), k);
+  ASSERT_TRUE(serial_idx == idx);
+
+  // fewer points than neighbours requested.
+  std::vector<carve::geom3d::Vector> few(points.begin(), points.begin() + 3);
+  carve::point::KdTree small(few);
+  ASSERT_EQ(small.nearest(queries, 5, idx), 3U);
+  ASSERT_EQ(idx.size(), queries.size() * 3);
+}
+
+TEST(PointSetKdTreeTest, RadiusMatchesBruteForce) {
+  std::vector<carve::geom3d::Vector> points;
+  for (size_t i = 0; i < 5000; ++i) points.push_back(randomPoint(10.0));
+  carve::point::KdTree tree(points);
+
+  std::vector<carve::geom3d::Vector> queries;
+  for (size_t i = 0; i < 700; ++i) queries.push_back(randomPoint(10.0));
+
+  const double r = 0.75;
+  std::vector<size_t> offsets, idx;
+  tree.withinRadius(queries, r, offsets, idx);
+  ASSERT_EQ(offsets.size(), queries.size() + 1);
+  ASSERT_EQ(offsets.back(), idx.size());
+
+  std::vector<size_t> expected, single;
+  for (size_t q = 0; q < queries.size(); ++q) {
+    bruteRadius(points, queries[q], r, expected);
+    std::vector<size_t> got(idx.begin() + offsets[q], idx.begin() + offsets[q + 1]);
+    std::sort(got.begin(), got.end());
+    ASSERT_TRUE(got == expected);
+
+    tree.withinRadius(queries[q], r, single);
+    std::sort(single.begin(), single.end());
+    ASSERT_TRUE(single == expected);
+  }
+
+  // radius queries centred on the points themselves include them.
+  tree.withinRadius(points[17], 0.0, single);
+  ASSERT_TRUE(std::find(single.begin(), single.end(), 17U) != single.end());
+}
@@ -0,0 +1,184 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#include <gtest/gtest.h>
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/carve.hpp>
+#include <carve/polyline_clip.hpp>
+#include <carve/executor.hpp>
+
+#include "geometry.hpp"
+
+#include <memory>
+
+typedef carve::mesh::MeshSet<3> meshset_t;
+typedef carve::mesh::PolylineClipper clipper_t;
+
+static double length(const carve::line::PolylineSet *lines) {
+  double len = 0.0;
+  for (carve::line::PolylineSet::const_line_iter i = lines->lines.begin(); i != lines->lines.end(); ++i) {
+    for (size_t e = 0; e < (*i)->edgeCount(); ++e) {
+      len += carve::geom::distance((*i)->edge(e)->v1->v, (*i)->edge(e)->v2->v);
+    }
+  }
+  return len;
+}
+
+// a polyline from a list of points, as a PolylineSet of its own.
+static carve::line::PolylineSet *makeLine(bool closed, const std::vector<carve::geom3d::Vector> &points) {
+  carve::line::PolylineSet *lines = new carve::line::PolylineSet(points);
+  std::vector<size_t> idx;
+  for (size_t i = 0; i < points.size(); ++i) idx.push_back(i);
+  lines->addPolyline(closed, idx.begin(), idx.end());
+  return lines;
+}
+
+TEST(PolylineClipTest, Crossings) {
+  std::auto_ptr<meshset_t> box(makeBox(carve::geom::VECTOR(-1.0, -1.0, -1.0), carve::geom::VECTOR(1.0, 1.0, 1.0)));
+  clipper_t clipper(box.get());
+
+  // passes through the box, with a vertex inside it.
+  std::vector<carve::geom3d::Vector> p;
+  p.push_back(carve::geom::VECTOR(-3.0, 0.1, 0.2));
+  p.push_back(carve::geom::VECTOR(0.0, 0.1, 0.2));
+  p.push_back(carve::geom::VECTOR(3.0, 0.1, 0.2));
+  std::auto_ptr<carve::line::PolylineSet> line(makeLine(false, p));
+
+  std::vector<clipper_t::Piece> pieces;
+  clipper.classify(*line, pieces);
+  ASSERT_EQ(pieces.size(), 3U);
+  ASSERT_EQ(pieces[0].cls, carve::POINT_OUT);
+  ASSERT_EQ(pieces[1].cls, carve::POINT_IN);
+  ASSERT_EQ(pieces[2].cls, carve::POINT_OUT);
+  ASSERT_NEAR(pieces[1].begin, 2.0 / 3.0, 1e-12);
+  ASSERT_NEAR(pieces[1].end, 1.0 + 1.0 / 3.0, 1e-12);
+
+  carve::line::PolylineSet *inside = NULL, *outside = NULL;
+  clipper.clip(*line, &inside, &outside);
+  std::auto_ptr<carve::line::PolylineSet> in_ptr(inside), out_ptr(outside);
+  ASSERT_EQ(inside->lines.size(), 1U);
+  ASSERT_EQ(outside->lines.size(), 2U);
+  ASSERT_NEAR(length(inside), 2.0, 1e-12);
+  ASSERT_NEAR(length(outside), 4.0, 1e-12);
+
+  // a closed loop that crosses the box twice comes back as one piece
+  // inside and one outside, joined across its start.
+  p.clear();
+  p.push_back(carve::geom::VECTOR(0.0, 0.0, 0.5));
+  p.push_back(carve::geom::VECTOR(2.0, 0.0, 0.5));
+  p.push_back(carve::geom::VECTOR(2.0, 0.5, 0.5));
+  p.push_back(carve::geom::VECTOR(0.0, 0.5, 0.5));
+  std::auto_ptr<carve::line::PolylineSet> loop(makeLine(true, p));
+  pieces.clear();
+  clipper.classify(*loop, pieces);
+  ASSERT_EQ(pieces.size(), 2U);
+  ASSERT_EQ(pieces[0].cls, carve::POINT_OUT);
+  ASSERT_EQ(pieces[1].cls, carve::POINT_IN);
+  ASSERT_NEAR(pieces[1].begin, 2.5, 1e-12);
+  ASSERT_NEAR(pieces[1].end, 4.5, 1e-12);
+
+  // a loop that misses the box stays whole and closed.
+  for (size_t i = 0; i < p.size(); ++i) p[i].z += 2.0;
+  std::auto_ptr<carve::line::PolylineSet> loop2(makeLine(true, p));
+  pieces.clear();
+  clipper.classify(*loop2, pieces);
+  ASSERT_EQ(pieces.size(), 1U);
+  ASSERT_TRUE(pieces[0].closed);
+  ASSERT_EQ(pieces[0].cls, carve::POINT_OUT);
+}
+
+TEST(PolylineClipTest, Degenerate) {
+  std::auto_ptr<meshset_t> box(makeBox(carve::geom::VECTOR(-1.0, -1.0, -1.0), carve::geom::VECTOR(1.0, 1.0, 1.0)));
+  clipper_t clipper(box.get());
+
+  std::vector<carve::geom3d::Vector> p;
+  std::vector<clipper_t::Piece> pieces;
+
+  // grazes the vertical edge at (1, 1) without entering.
+  p.push_back(carve::geom::VECTOR(0.0, 2.0, 0.3));
+  p.push_back(carve::geom::VECTOR(2.0, 0.0, 0.3));
+  std::auto_ptr<carve::line::PolylineSet> graze(makeLine(false, p));
+  clipper.classify(*graze, pieces);
+  ASSERT_EQ(pieces.size(), 1U);
+  ASSERT_EQ(pieces[0].cls, carve::POINT_OUT);
+
+  // enters through the same edge.
+  p.clear();
+  p.push_back(carve::geom::VECTOR(2.0, 2.0, 0.3));
+  p.push_back(carve::geom::VECTOR(0.0, 0.0, 0.3));
+  std::auto_ptr<carve::line::PolylineSet> enter(makeLine(false, p));
+  carve::line::PolylineSet *inside = NULL;
+  clipper.clip(*enter, &inside, NULL);
+  std::auto_ptr<carve::line::PolylineSet> in_ptr(inside);
+  ASSERT_NEAR(length(inside), sqrt(2.0), 1e-12);
+
+  // has a vertex on a face, and bounces off it.
+  p.clear();
+  p.push_back(carve::geom::VECTOR(2.0, 0.0, 0.3));
+  p.push_back(carve::geom::VECTOR(1.0, 0.2, 0.3));
+  p.push_back(carve::geom::VECTOR(2.0, 0.4, 0.3));
+  p.push_back(carve::geom::VECTOR(-2.0, 0.4, 0.3));
+  std::auto_ptr<carve::line::PolylineSet> bounce(makeLine(false, p));
+  pieces.clear();
+  clipper.classify(*bounce, pieces);
+  ASSERT_EQ(pieces.size(), 3U);
+  ASSERT_EQ(pieces[0].cls, carve::POINT_OUT);
+  ASSERT_NEAR(pieces[0].end, 2.25, 1e-12);
+  ASSERT_EQ(pieces[1].cls, carve::POINT_IN);
+  ASSERT_EQ(pieces[2].cls, carve::POINT_OUT);
+}
+
+TEST(PolylineClipTest, Serial) {
+  std::auto_ptr<meshset_t> box(makeBox(carve::geom::VECTOR(-1.0, -1.0, -1.0), carve::geom::VECTOR(1.0, 1.0, 1.0)));
+
+  // many lines in a fan, through and around the box.
+  std::vector<carve::geom3d::Vector> points;
+  for (int i = 0; i < 200; ++i) {
+    double a = i * 0.05;
+    points.push_back(carve::geom::VECTOR(-3.0, 0.1, 0.2));
+    points.push_back(carve::geom::VECTOR(0.0, 2.0 * sin(a), 1.5 * cos(a)));
+    points.push_back(carve::geom::VECTOR(3.0, cos(a), -0.3));
+  }
+  carve::line::PolylineSet lines(points);
+  for (size_t i = 0; i < points.size(); i += 3) {
+    size_t idx[3] = { i, i + 1, i + 2 };
+    lines.addPolyline(false, idx, idx + 3);
+  }
+
+  clipper_t clipper(box.get());
+  std::vector<clipper_t::Piece> parallel, serial;
+  clipper.classify(lines, parallel);
+
+  carve::SerialExecutor exec;
+  clipper.executor = &exec;
+  clipper.classify(lines, serial);
+
+  ASSERT_EQ(parallel.size(), serial.size());
+  for (size_t i = 0; i < parallel.size(); ++i) {
+    ASSERT_EQ(parallel[i].line, serial[i].line);
+    ASSERT_EQ(parallel[i].begin, serial[i].begin);
+    ASSERT_EQ(parallel[i].cls, serial[i].cls);
+  }
+
+  carve::line::PolylineSet *inside = NULL, *outside = NULL;
+  clipper.clip(lines, &inside, &outside);
+  std::auto_ptr<carve::line::PolylineSet> in_ptr(inside), out_ptr(outside);
+  ASSERT_NEAR(length(inside) + length(outside), length(&lines), 1e-9);
+}
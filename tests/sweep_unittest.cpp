@@ -0,0 +1,145 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#include <gtest/gtest.h>
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/carve.hpp>
+#include <carve/sweep.hpp>
+#include <carve/csg.hpp>
+
+#include <memory>
+
+using carve::geom::VECTOR;
+
+static std::vector<carve::geom2d::P2> square(double s) {
+  std::vector<carve::geom2d::P2> p;
+  p.push_back(VECTOR(-s, -s));
+  p.push_back(VECTOR(+s, -s));
+  p.push_back(VECTOR(+s, +s));
+  p.push_back(VECTOR(-s, +s));
+  return p;
+}
+
+static void checkClosedMesh(const carve::mesh::MeshSet<3> *m) {
+  for (size_t i = 0; i < m->meshes.size(); ++i) {
+    const carve::mesh::Mesh<3> *mesh = m->meshes[i];
+    ASSERT_TRUE(mesh->isClosed());
+    for (size_t f = 0; f < mesh->faces.size(); ++f) {
+      const carve::mesh::Edge<3> *e = mesh->faces[f]->edge;
+      do {
+        ASSERT_TRUE(e->rev != NULL);
+        ASSERT_EQ(e->rev->rev, e);
+        ASSERT_EQ(e->rev->vert, e->next->vert);
+        ASSERT_EQ(e->rev->face->mesh, mesh);
+        e = e->next;
+      } while (e != mesh->faces[f]->edge);
+    }
+  }
+}
+
+TEST(SweepTest, Extrude) {
+  std::auto_ptr<carve::mesh::MeshSet<3> > m(carve::sweep::extrude(square(1.0), VECTOR(0, 0, 3)));
+  ASSERT_EQ(m->meshes.size(), 1U);
+  ASSERT_EQ(m->vertex_storage.size(), 8U);
+  ASSERT_EQ(m->meshes[0]->faces.size(), 6U);
+  checkClosedMesh(m.get());
+  EXPECT_NEAR(m->meshes[0]->volume(), 12.0, 1e-9);
+}
+
+TEST(SweepTest, ExtrudeReversedProfileAndDirection) {
+  std::vector<carve::geom2d::P2> p = square(1.0);
+  std::reverse(p.begin(), p.end());
+  std::auto_ptr<carve::mesh::MeshSet<3> > m(carve::sweep::extrude(p, VECTOR(1, 0, -2)));
+  checkClosedMesh(m.get());
+  EXPECT_NEAR(m->meshes[0]->volume(), 8.0, 1e-9);
+}
+
+TEST(SweepTest, SweepAlongBentPath) {
+  std::vector<carve::geom::vector<3> > path;
+  path.push_back(VECTOR(0, 0, 0));
+  path.push_back(VECTOR(0, 0, 10));
+  path.push_back(VECTOR(10, 0, 10));
+  path.push_back(VECTOR(10, 5, 15));
+  std::auto_ptr<carve::mesh::MeshSet<3> > m(carve::sweep::sweep(square(1.0), path));
+  ASSERT_EQ(m->meshes.size(), 1U);
+  checkClosedMesh(m.get());
+  EXPECT_GT(m->meshes[0]->volume(), 0.0);
+}
+
+TEST(SweepTest, SweepAlongBezier) {
+  std::vector<carve::geom::cubic_bezier<3> > path;
+  path.push_back(carve::geom::make_bezier(VECTOR(0, 0, 0), VECTOR(0, 0, 10), VECTOR(10, 0, 10), VECTOR(10, 10, 10)));
+  std::auto_ptr<carve::mesh::MeshSet<3> > m(carve::sweep::sweep(square(0.5), path, 0.01));
+  checkClosedMesh(m.get());
+  EXPECT_GT(m->meshes[0]->volume(), 0.0);
+}
+
+TEST(SweepTest, FlattenTolerance) {
+  carve::geom::cubic_bezier<2> b(VECTOR(0, 0), VECTOR(0, 1), VECTOR(1, 1), VECTOR(1, 0));
+  std::vector<carve::geom::vector<2> > pts;
+  pts.push_back(b.p[0]);
+  b.flatten(pts, 1e-3);
+  ASSERT_GT(pts.size(), 8U);
+  EXPECT_EQ(pts.back(), b.p[3]);
+  for (size_t i = 0; i <= 100; ++i) {
+    carve::geom::vector<2> c = b.eval(i / 100.0);
+    double best = 1e30;
+    for (size_t j = 0; j + 1 < pts.size(); ++j) {
+      carve::geom::linesegment<2> s(pts[j], pts[j+1]);
+      best = std::min(best, carve::geom::distance(s, c));
+    }
+    EXPECT_LT(best, 1e-3);
+  }
+}
+
+TEST(SweepTest, SweepMany) {
+  std::vector<carve::sweep::Sweep> sweeps;
+  for (int i = 0; i < 200; ++i) {
+    std::vector<carve::geom::vector<3> > path;
+    path.push_back(VECTOR(i * 3.0, 0, 0));
+    path.push_back(VECTOR(i * 3.0, 0, 5));
+    path.push_back(VECTOR(i * 3.0, 5, 5 + i % 7));
+    sweeps.push_back(carve::sweep::Sweep(square(0.5 + 0.001 * i), path));
+  }
+  std::auto_ptr<carve::mesh::MeshSet<3> > m(carve::sweep::sweepMany(sweeps));
+  ASSERT_EQ(m->meshes.size(), sweeps.size());
+  checkClosedMesh(m.get());
+  for (size_t i = 0; i < m->meshes.size(); ++i) {
+    EXPECT_EQ(m->meshes[i]->meshset, m.get());
+    EXPECT_GT(m->meshes[i]->volume(), 0.0);
+  }
+}
+
+TEST(SweepTest, Degenerate) {
+  std::vector<carve::geom2d::P2> p;
+  p.push_back(VECTOR(0, 0));
+  p.push_back(VECTOR(1, 0));
+  ASSERT_THROW(carve::sweep::extrude(p, VECTOR(0, 0, 1)), carve::exception);
+  ASSERT_THROW(carve::sweep::extrude(square(1.0), VECTOR(1, 0, 0)), carve::exception);
+}
+
+TEST(SweepTest, UsableInCSG) {
+  std::auto_ptr<carve::mesh::MeshSet<3> > a(carve::sweep::extrude(square(1.0), VECTOR(0, 0, 2)));
+  std::auto_ptr<carve::mesh::MeshSet<3> > b(carve::sweep::extrude(square(0.5), VECTOR(0.25, 0.25, 4)));
+  carve::csg::CSG csg;
+  std::auto_ptr<carve::mesh::MeshSet<3> > r(csg.compute(a.get(), b.get(), carve::csg::CSG::A_MINUS_B));
+  ASSERT_TRUE(r.get() != NULL);
+  ASSERT_TRUE(r->isClosed());
+}
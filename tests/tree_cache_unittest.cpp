@@ -0,0 +1,176 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#include <gtest/gtest.h>
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/carve.hpp>
+#include <carve/csg.hpp>
+#include <carve/tree.hpp>
+
+#include "geometry.hpp"
+
+#include <memory>
+
+typedef carve::mesh::MeshSet<3> meshset_t;
+
+static carve::csg::CSG_TreeNode *makeTree(double offset, carve::csg::CSG::OP op) {
+  using namespace carve::csg;
+  CSG_TreeNode *a = new CSG_PolyNode(makeCube(carve::math::Matrix::IDENT()), true);
+  CSG_TreeNode *b = new CSG_TransformNode(carve::math::Matrix::TRANS(offset, offset, offset),
+                                          new CSG_PolyNode(makeCube(carve::math::Matrix::IDENT()), true));
+  CSG_TreeNode *c = new CSG_PolyNode(makeCube(carve::math::Matrix::SCALE(0.5, 0.5, 4.0)), true);
+  return new CSG_OPNode(new CSG_OPNode(a, b, CSG::UNION, false), c, op, false);
+}
+
+TEST(TreeCacheTest, HitsOnRepeatedAndEditedTrees) {
+  carve::csg::CSG_TreeCache cache(64 * 1024 * 1024);
+  carve::csg::CSG csg;
+  csg.tree_cache = &cache;
+
+  std::auto_ptr<carve::csg::CSG_TreeNode> t1(makeTree(0.5, carve::csg::CSG::A_MINUS_B));
+  std::auto_ptr<meshset_t> r1(t1->eval(csg));
+  size_t n_entries = cache.size();
+  ASSERT_EQ(cache.hits(), 0U);
+  ASSERT_EQ(n_entries, 3U);
+
+  // an identical tree is answered from the cache at the root.
+  std::auto_ptr<carve::csg::CSG_TreeNode> t2(makeTree(0.5, carve::csg::CSG::A_MINUS_B));
+  std::auto_ptr<meshset_t> r2(t2->eval(csg));
+  ASSERT_EQ(cache.hits(), 1U);
+  ASSERT_EQ(cache.size(), n_entries);
+  ASSERT_EQ(carve::csg::CSG_TreeCache::hash(r1.get()), carve::csg::CSG_TreeCache::hash(r2.get()));
+
+  // changing only the final operation reuses the shared subtree.
+  std::auto_ptr<carve::csg::CSG_TreeNode> t3(makeTree(0.5, carve::csg::CSG::UNION));
+  std::auto_ptr<meshset_t> r3(t3->eval(csg));
+  ASSERT_EQ(cache.hits(), 2U);
+  ASSERT_EQ(cache.size(), n_entries + 1);
+
+  // a different transform misses.
+  std::auto_ptr<carve::csg::CSG_TreeNode> t4(makeTree(0.25, carve::csg::CSG::A_MINUS_B));
+  std::auto_ptr<meshset_t> r4(t4->eval(csg));
+  ASSERT_EQ(cache.hits(), 2U);
+  ASSERT_NE(carve::csg::CSG_TreeCache::hash(r1.get()), carve::csg::CSG_TreeCache::hash(r4.get()));
+
+  // cached results are unaffected by changes to returned copies.
+  r2->transform(carve::math::matrix_transformation(carve::math::Matrix::TRANS(1, 0, 0)));
+  std::auto_ptr<meshset_t> r5(t2->eval(csg));
+  ASSERT_EQ(carve::csg::CSG_TreeCache::hash(r1.get()), carve::csg::CSG_TreeCache::hash(r5.get()));
+}
+
+static carve::csg::CSG_TreeCache::key_t makeKey(uint64_t w) {
+  carve::csg::CSG_TreeCache::key_t key;
+  key.add(w);
+  return key;
+}
+
+TEST(TreeCacheTest, Eviction) {
+  std::auto_ptr<meshset_t> cube(makeCube(carve::math::Matrix::IDENT()));
+  // leaves room for the bookkeeping of each entry.
+  size_t bytes = carve::csg::CSG_TreeCache::estimateBytes(cube.get()) + 64;
+
+  carve::csg::CSG_TreeCache cache(bytes * 2);
+  cache.insert(makeKey(1), cube.get());
+  cache.insert(makeKey(2), cube.get());
+  ASSERT_EQ(cache.size(), 2U);
+
+  delete cache.lookup(makeKey(1));
+  cache.insert(makeKey(3), cube.get());
+  ASSERT_EQ(cache.size(), 2U);
+  ASSERT_LE(cache.bytes(), cache.maxBytes());
+
+  meshset_t *r;
+  ASSERT_TRUE((r = cache.lookup(makeKey(1))) != NULL); delete r;
+  ASSERT_TRUE((r = cache.lookup(makeKey(2))) == NULL);
+  ASSERT_TRUE((r = cache.lookup(makeKey(3))) != NULL); delete r;
+
+  carve::csg::CSG_TreeCache tiny(bytes / 2);
+  tiny.insert(makeKey(1), cube.get());
+  ASSERT_EQ(tiny.size(), 0U);
+}
+
+TEST(TreeCacheTest, HashCollisionsMiss) {
+  std::auto_ptr<meshset_t> cube(makeCube(carve::math::Matrix::IDENT()));
+  carve::csg::CSG_TreeCache cache(64 * 1024 * 1024);
+
+  // keys that share the word used to index entries.
+  carve::csg::CSG_TreeCache::key_t a(5, 1);
+  carve::csg::CSG_TreeCache::key_t b(5, 2);
+  ASSERT_EQ(a.hash(), b.hash());
+  ASSERT_TRUE(a != b);
+
+  cache.insert(a, cube.get());
+  meshset_t *r;
+  ASSERT_TRUE((r = cache.lookup(b)) == NULL);
+  ASSERT_TRUE((r = cache.lookup(a)) != NULL); delete r;
+
+  cache.insert(b, cube.get());
+  ASSERT_EQ(cache.size(), 2U);
+
+  // digests depend on the order of words.
+  carve::csg::CSG_TreeCache::key_t c, d;
+  c.add(1).add(2);
+  d.add(2).add(1);
+  ASSERT_TRUE(c != d);
+}
+
+TEST(TreeCacheTest, EpsilonIsPartOfKey) {
+  carve::csg::CSG_TreeCache cache(64 * 1024 * 1024);
+  carve::csg::CSG csg;
+  csg.tree_cache = &cache;
+
+  std::auto_ptr<carve::csg::CSG_TreeNode> t1(makeTree(0.5, carve::csg::CSG::A_MINUS_B));
+  std::auto_ptr<meshset_t> r1(t1->eval(csg));
+  ASSERT_EQ(cache.size(), 3U);
+
+  const double epsilon = carve::EPSILON;
+  carve::setEpsilon(epsilon * 2.0);
+  std::auto_ptr<meshset_t> r2(t1->eval(csg));
+  carve::setEpsilon(epsilon);
+  ASSERT_EQ(cache.hits(), 0U);
+  ASSERT_EQ(cache.size(), 6U);
+
+  std::auto_ptr<meshset_t> r3(t1->eval(csg));
+  ASSERT_EQ(cache.hits(), 1U);
+}
+
+struct NullHook : public carve::csg::CSG::Hook {
+};
+
+TEST(TreeCacheTest, DisabledByFaceHooks) {
+  carve::csg::CSG_TreeCache cache(64 * 1024 * 1024);
+  carve::csg::CSG csg;
+  csg.tree_cache = &cache;
+  NullHook hook;
+  csg.hooks.registerHook(&hook, carve::csg::CSG::Hooks::RESULT_FACE_BIT);
+
+  std::auto_ptr<carve::csg::CSG_TreeNode> t1(makeTree(0.5, carve::csg::CSG::A_MINUS_B));
+  std::auto_ptr<meshset_t> r1(t1->eval(csg));
+  ASSERT_EQ(cache.size(), 0U);
+
+  csg.hooks.unregisterHook(&hook);
+  std::auto_ptr<meshset_t> r2(t1->eval(csg));
+  ASSERT_EQ(cache.size(), 3U);
+}
+
+TEST(TreeCacheTest, HashIgnoresSignOfZero) {
+  ASSERT_EQ(carve::csg::CSG_TreeCache::hash(0.0), carve::csg::CSG_TreeCache::hash(-0.0));
+  ASSERT_NE(carve::csg::CSG_TreeCache::hash(1.0), carve::csg::CSG_TreeCache::hash(-1.0));
+}
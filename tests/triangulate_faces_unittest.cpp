@@ -0,0 +1,161 @@
+// Begin License:
+// Copyright (C) 2006-2014 Tobias Sargeant (tobias.sargeant@gmail.com).
+// All rights reserved.
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// This file may be used under the terms of either the GNU General
+// Public License version 2 or 3 (at your option) as published by the
+// Free Software Foundation and appearing in the files LICENSE.GPL2
+// and LICENSE.GPL3 included in the packaging of this file.
+//
+// This file is provided "AS IS" with NO WARRANTY OF ANY KIND,
+// INCLUDING THE WARRANTIES OF DESIGN, MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE.
+// End:
+
+#include <gtest/gtest.h>
+
+#if defined(HAVE_CONFIG_H)
+#  include <carve_config.h>
+#endif
+
+#include <carve/carve.hpp>
+#include <carve/mesh.hpp>
+#include <carve/mesh_triangulate.hpp>
+#include <carve/executor.hpp>
+#include <carve/input.hpp>
+
+#include <memory>
+
+typedef carve::mesh::MeshSet<3> meshset_t;
+
+// a prism of height 2 over a counterclockwise polygon.
+static void addPrism(carve::input::PolyhedronData &data,
+                     const std::vector<carve::geom2d::P2> &poly,
+                     const carve::geom3d::Vector &offset) {
+  const int b = data.getVertexCount();
+  const int n = (int)poly.size();
+  for (int i = 0; i < n; ++i) data.addVertex(offset + carve::geom::VECTOR(poly[i].x, poly[i].y, +1.0));
+  for (int i = 0; i < n; ++i) data.addVertex(offset + carve::geom::VECTOR(poly[i].x, poly[i].y, -1.0));
+
+  std::vector<int> top, bottom;
+  for (int i = 0; i < n; ++i) {
+    top.push_back(b + i);
+    bottom.push_back(b + 2 * n - 1 - i);
+  }
+  data.addFace(top.begin(), top.end());
+  data.addFace(bottom.begin(), bottom.end());
+  for (int i = 0; i < n; ++i) {
+    int j = (i + 1) % n;
+    data.addFace(b + n + i, b + n + j, b + j, b + i);
+  }
+}
+
+static std::vector<carve::geom2d::P2> star(int points) {
+  std::vector<carve::geom2d::P2> p;
+  for (int i = 0; i < points * 2; ++i) {
+    double a = M_PI * i / points;
+    double r = (i & 1) ? 0.4 : 1.0;
+    p.push_back(carve::geom::VECTOR(r * cos(a), r * sin(a)));
+  }
+  return p;
+}
+
+static void checkTriangulated(const meshset_t *m) {
+  for (size_t i = 0; i < m->meshes.size(); ++i) {
+    const carve::mesh::Mesh<3> *mesh = m->meshes[i];
+    ASSERT_TRUE(mesh->isClosed());
+    ASSERT_FALSE(mesh->isNegative());
+    for (size_t f = 0; f < mesh->faces.size(); ++f) {
+      const carve::mesh::Face<3> *face = mesh->faces[f];
+      ASSERT_EQ(face->nEdges(), 3U);
+      ASSERT_EQ(face->mesh, mesh);
+      const carve::mesh::Edge<3> *e = face->edge;
+      do {
+        ASSERT_EQ(e->face, face);
+        ASSERT_EQ(e->next->prev, e);
+        ASSERT_TRUE(e->rev != NULL);
+        ASSERT_EQ(e->rev->rev, e);
+        ASSERT_EQ(e->rev->vert, e->next->vert);
+        e = e->next;
+      } while (e != face->edge);
+    }
+  }
+}
+
+static std::vector<size_t> faceIndices(const meshset_t *m) {
+  std::vector<size_t> result;
+  for (meshset_t::const_face_iter i = m->faceBegin(); i != m->faceEnd(); ++i) {
+    const carve::mesh::Edge<3> *e = (*i)->edge;
+    do {
+      result.push_back(e->vert - &m->vertex_storage[0]);
+      e = e->next;
+    } while (e != (*i)->edge);
+    result.push_back(~(size_t)0);
+  }
+  return result;
+}
+
+TEST(TriangulateFacesTest, StarPrism) {
+  carve::input::PolyhedronData data;
+  addPrism(data, star(5), carve::geom::VECTOR(0, 0, 0));
+  std::auto_ptr<meshset_t> m(new meshset_t(data.points, data.getFaceCount(), data.faceIndices));
+  ASSERT_EQ(m->meshes.size(), 1U);
+  double volume = m->meshes[0]->volume();
+
+  ASSERT_EQ(carve::mesh::triangulateFaces(m.get()), 12U);
+  ASSERT_EQ(m->meshes[0]->faces.size(), 2U * 8U + 10U * 2U);
+  checkTriangulated(m.get());
+  ASSERT_NEAR(m->meshes[0]->volume(), volume, 1e-9);
+
+  // already triangulated faces are left alone.
+  std::vector<size_t> before = faceIndices(m.get());
+  ASSERT_EQ(carve::mesh::triangulateFaces(m.get()), 0U);
+  ASSERT_TRUE(faceIndices(m.get()) == before);
+}
+
+TEST(TriangulateFacesTest, NonConvexQuad) {
+  // the shorter diagonal of this dart, 1-3, lies outside it.
+  std::vector<carve::geom2d::P2> dart;
+  dart.push_back(carve::geom::VECTOR(0.0, 0.0));
+  dart.push_back(carve::geom::VECTOR(4.0, -1.0));
+  dart.push_back(carve::geom::VECTOR(3.5, 0.0));
+  dart.push_back(carve::geom::VECTOR(4.0, 1.0));
+
+  carve::input::PolyhedronData data;
+  addPrism(data, dart, carve::geom::VECTOR(0, 0, 0));
+  std::auto_ptr<meshset_t> m(new meshset_t(data.points, data.getFaceCount(), data.faceIndices));
+
+  carve::mesh::triangulateFaces(m.get());
+  checkTriangulated(m.get());
+
+  for (meshset_t::face_iter i = m->faceBegin(); i != m->faceEnd(); ++i) {
+    carve::geom3d::Vector c = (*i)->centroid();
+    if (c.z > 0.99) {
+      ASSERT_GT((*i)->plane.N.z, 0.99);
+    }
+    if (c.z < -0.99) {
+      ASSERT_LT((*i)->plane.N.z, -0.99);
+    }
+  }
+}
+
+TEST(TriangulateFacesTest, IndependentOfThreads) {
+  carve::input::PolyhedronData data;
+  for (int i = 0; i < 40; ++i) {
+    addPrism(data, star(3 + i % 7), carve::geom::VECTOR(3.0 * i, 0, 0));
+  }
+  std::auto_ptr<meshset_t> a(new meshset_t(data.points, data.getFaceCount(), data.faceIndices));
+  std::auto_ptr<meshset_t> b(a->clone());
+
+  carve::mesh::triangulateFaces(a.get(), true);
+
+  carve::SerialExecutor serial;
+  carve::setDefaultExecutor(&serial);
+  carve::mesh::triangulateFaces(b.get(), true);
+  carve::setDefaultExecutor(NULL);
+
+  checkTriangulated(a.get());
+  ASSERT_TRUE(faceIndices(a.get()) == faceIndices(b.get()));
+}